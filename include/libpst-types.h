@@ -11,6 +11,18 @@
 #include <stdint.h>
 #include <libunwind.h>
 
+/// @brief method of stack unwinding used by pst_unwind_simple()
+typedef enum {
+    UNWINDER_LIBUNWIND      = 0,    ///< use libunwind, i.e. interpret .eh_frame CFI for every frame (default)
+    UNWINDER_FRAME_POINTER  = 1,    ///< walk RBP chain, program should be built with -fno-omit-frame-pointer. falls back to libunwind for frames where chain is broken. frame records of threads which didn't call pst_thread_prepare() are checked against index of memory mappings
+} pst_unwinder;
+
+/// @brief clock used by sampling profiler
+typedef enum {
+    PROFILER_CPU    = 0,    ///< sample threads proportionally to consumed CPU time
+    PROFILER_WALL   = 1,    ///< sample threads by wall clock, i.e. including time spent in blocking calls
+} pst_profiler_mode;
+
 /// @brief bitmask of function's options
 typedef enum {
     FUNC_GLOBAL     = 0x00000001,   ///< function has global visibility
@@ -23,6 +23,9 @@ extern "C" {
 typedef struct pst_handler pst_handler;
 typedef struct pst_function pst_function;
 typedef struct pst_parameter pst_parameter;
+typedef struct pst_sink pst_sink;
+
+typedef int (*pst_sink_callback)(void* arg, const char* data, uint32_t size);
 
 //
 // Initialization of the library
@@ -30,7 +33,9 @@ typedef struct pst_parameter pst_parameter;
 
 /**
  * @brief allocate libpst handler and initialize the library
- * @param context context of process given to signal handler of a program. If NULL, then we are not in signal handler
+ * @param context context of process given to signal handler of a program. If NULL, then we are not in signal handler, use pst_set_signal()
+ * to tell otherwise. In signal handler information about process shared by all handlers is only borrowed, it's never created there, so at
+ * least one stack trace should be unwound outside of signal handler (after pst_lib_invalidate() as well) to get names of functions
  * @param buff pointer to buffer for libpst custom allocator(i.e. no malloc()/free() will be used). if NULL, then standard allocator will be used
  * @param size of 'buff'. recommended size is not less than 4Kb
  *
@@ -44,6 +49,37 @@ pst_handler* pst_lib_init(ucontext_t* context, void* buff, uint32_t size);
  */
 void pst_lib_fini(pst_handler* handler);
 
+/**
+ * @brief invalidate information about process (loaded modules, debug information and caches derived from it) shared by all handlers.
+ * Should be called after dlopen()/dlclose() to let next pst_lib_init() see actual list of modules. Handlers initialized before the call continue
+ * to use old information till pst_lib_fini(). Index of memory mappings used by pst_pointer_valid() and index of modules with thread-local
+ * storage are rebuilt immediately, so it must not be called by signal handler
+ */
+void pst_lib_invalidate();
+
+/**
+ * @brief Get number of memory allocation requests which weren't satisfied since pst_lib_init(). For custom allocator non-zero value means that
+ * 'buff' given to pst_lib_init() is too small and stack trace may be incomplete
+ * @return number of failed allocations
+ */
+uint32_t pst_lib_alloc_failures();
+
+/**
+ * @brief Get number of diagnostic messages of the library dropped since log ring was full, since their callers didn't finish them in time
+ * (i.e. were interrupted or killed), or in deferred mode since buffer of thread was full. Messages are formatted into bounded ring without
+ * locks, while their time is formatted and they are written by background thread, so logging never waits for locks or output
+ * @return number of dropped messages
+ */
+uint64_t pst_lib_log_dropped();
+
+/**
+ * @brief Switch diagnostics of the library to deferred mode and back. In deferred mode the caller stores only time, format string and raw
+ * arguments of message to buffer of its thread, while formatting is done by background thread of the logger. Takes effect immediately.
+ * Diagnostics and the logger thread exist only in library built with PST_DEBUG, which starts the thread when library is loaded
+ * @param enable non-zero to defer formatting, zero to format messages by the caller
+ */
+void pst_lib_log_deferred(int enable);
+
 //
 // Basic unwind routines.
 // Allows to retrieve stack trace information about function's name, line and file if possibly
@@ -56,6 +92,29 @@ void pst_lib_fini(pst_handler* handler);
  */
 int pst_unwind_simple(pst_handler* handler);
 
+/**
+ * @brief Select method of stack unwinding used by pst_unwind_simple(). pst_unwind_pretty() always uses libunwind since it needs registers of each frame
+ * @param handler The handler obtained by pst_lib_init()
+ * @param unwinder unwinding method
+ */
+void pst_set_unwinder(pst_handler* handler, pst_unwinder unwinder);
+
+/**
+ * @brief Tell whether handler is used by signal handler, i.e. it must not wait for locks or allocate shared information about process.
+ * By default it's used by signal handler if 'context' given to pst_lib_init() isn't NULL
+ * @param handler The handler obtained by pst_lib_init()
+ * @param signal non-zero if handler is used by signal handler
+ */
+void pst_set_signal(pst_handler* handler, int signal);
+
+/**
+ * @brief Prepare calling thread for unwinding by frame pointers, i.e. determine bounds of its stack. Not async-signal-safe, so it should be called
+ * by each thread outside of signal handler, for example, right after the thread starts. In threads which didn't call it frame records of RBP
+ * chain are checked against index of memory mappings instead of bounds of the stack, and only frames failing the check are unwound by libunwind
+ * @return 1 on success, 0 on failure
+ */
+int pst_thread_prepare();
+
 /**
  * @brief Print unwound stack trace to internal buffer
  * @param handler The handler obtained by pst_lib_init()
@@ -88,10 +147,11 @@ const pst_function_info* pst_get_function_info(pst_function* function);
 int pst_get_register(pst_function* function, int regno, unw_word_t* val);
 
 /**
- * @brief Check memory range of process for validity (i.e. that process has access to this range)
+ * @brief Check memory range of process for validity (i.e. that process has access to this range). Range is looked up in index of
+ * mappings of the process built at the last capture or pst_lib_invalidate(), so the check costs no syscalls
  * @param p pointer to start of range
  * @param size size of range to check
- * @return zero if range of memory pointed by 'p' is valid
+ * @return zero if range of memory pointed by 'p' is valid, EINVAL if part of range isn't mapped, EFAULT if it isn't readable
  */
 int pst_pointer_valid(void *p, uint32_t size);
 
@@ -118,6 +178,22 @@ const pst_parameter* pst_parameter_next_child(pst_parameter* parent, pst_paramet
  */
 const pst_parameter_info* pst_get_parameter_info(pst_parameter* parameter);
 
+/**
+ * @brief Get compact ID of unwound stack trace. The same stack traces get the same ID within the process, so it can be logged instead of whole
+ * stack trace and resolved later by pst_stack_print()
+ * @param handler The handler obtained by pst_lib_init() after pst_unwind_simple() or pst_unwind_pretty()
+ * @return non-zero ID on success, 0 on failure (no stack trace or registry of stack traces is full)
+ */
+uint32_t pst_stack_id(pst_handler* handler);
+
+/**
+ * @brief Print stack trace identified by ID obtained by pst_stack_id(). Names of functions are resolved only once per stack trace
+ * @param id ID of stack trace
+ * @return pointer to zero terminated C string valid till the end of the process, NULL if ID is unknown, its names are being resolved by
+ * another thread or storage of stack traces is exhausted
+ */
+const char* pst_stack_print(uint32_t id);
+
 //
 // Advanced unwind routines.
 // Additionally to pst_unwind_simple() provides types of parameters and variables in functions and their values if possible
@@ -137,6 +213,163 @@ int pst_unwind_pretty(pst_handler* handler);
  */
 const char* pst_print_pretty(pst_handler* handler);
 
+//
+// Output sinks.
+// Stream printed stack trace of any size to destination without truncation by size of internal buffer. Sinks are allocated by malloc() independently
+// of pst_lib_init()/pst_lib_fini(), so they should be created and deleted outside of signal handler. Buffer sink allocates its chunks while output
+// grows, so only fd, callback and ring sinks may be written by signal handler
+//
+
+/**
+ * @brief Create sink writing output to file descriptor by writev() batches
+ * @param fd file descriptor, isn't closed by pst_sink_del()
+ * @return pointer to sink, NULL on failure
+ */
+pst_sink* pst_sink_new_fd(int fd);
+
+/**
+ * @brief Create sink passing output to user callback piece by piece. Non-zero return value of callback stops output
+ * @param cb callback
+ * @param arg argument passed to callback
+ * @return pointer to sink, NULL on failure
+ */
+pst_sink* pst_sink_new_callback(pst_sink_callback cb, void* arg);
+
+/**
+ * @brief Create sink collecting output in growable buffer. Collected output is obtained by pst_sink_read()
+ * @return pointer to sink, NULL on failure
+ */
+pst_sink* pst_sink_new_buffer();
+
+/**
+ * @brief Create sink keeping only the last 'size' bytes of output. Collected output is obtained by pst_sink_read()
+ * @param size size of ring buffer
+ * @return pointer to sink, NULL on failure
+ */
+pst_sink* pst_sink_new_ring(uint32_t size);
+
+/**
+ * @brief Get size of output collected by buffer or ring sink
+ * @param sink sink obtained by pst_sink_new_buffer() or pst_sink_new_ring()
+ * @return number of bytes available to pst_sink_read()
+ */
+uint64_t pst_sink_size(pst_sink* sink);
+
+/**
+ * @brief Copy output collected by buffer or ring sink
+ * @param sink sink obtained by pst_sink_new_buffer() or pst_sink_new_ring()
+ * @param offset offset from the start of collected output
+ * @param buff buffer to copy output to
+ * @param size size of 'buff'
+ * @return number of copied bytes
+ */
+uint32_t pst_sink_read(pst_sink* sink, uint64_t offset, char* buff, uint32_t size);
+
+/**
+ * @brief Flush pending output and deallocate sink
+ * @param sink sink obtained by one of pst_sink_new_...() functions
+ */
+void pst_sink_del(pst_sink* sink);
+
+/**
+ * @brief Print unwound stack trace to the sink
+ * @param handler The handler obtained by pst_lib_init() after pst_unwind_simple() or pst_unwind_pretty()
+ * @param sink destination of output
+ * @param pretty non-zero to print stack trace like pst_print_pretty(), zero to print it like pst_print_simple()
+ * @return 1 on success, 0 on failure (destination failed to accept output)
+ */
+int pst_print_to_sink(pst_handler* handler, pst_sink* sink, int pretty);
+
+/**
+ * @brief Write compact binary record of unwound stack trace to the sink: build IDs and paths of modules, PCs as offsets in modules, registers
+ * of frames and raw values of parameters. Nothing is formatted, so it's cheap enough for dying process. Use pst-decode tool to print the record
+ * @param handler The handler obtained by pst_lib_init() after pst_unwind_simple() or pst_unwind_pretty()
+ * @param sink destination of record
+ * @return 1 on success, 0 on failure
+ */
+int pst_record_to_sink(pst_handler* handler, pst_sink* sink);
+
+//
+// Out-of-process unwinding.
+// Helper process keeps parsed debug information of the process and unwinds crashed thread on behalf of it, so the crashed thread only copies
+// its registers and top of its stack
+//
+
+/**
+ * @brief Fork helper process for the calling process. Should be called at program start, before threads are created
+ * @return 1 on success (including already started helper), 0 on failure
+ */
+int pst_helper_init();
+
+/**
+ * @brief Stop helper process started by pst_helper_init()
+ */
+void pst_helper_fini();
+
+/**
+ * @brief Print stack trace of calling thread by helper process, in the same format as pst_print_simple(). Async-signal-safe
+ * @param context context of process given to signal handler of a program. If NULL, then stack trace starts at the caller
+ * @param fd file descriptor to print stack trace to. It's passed to the helper, so it may be opened after pst_helper_init()
+ * @return 1 on success, 0 on failure (helper isn't started, died or didn't reply in time)
+ */
+int pst_helper_print(ucontext_t* context, int fd);
+
+//
+// Dump of all threads.
+// Every thread of the process is interrupted by a realtime signal (SIGRTMIN + 2 by default) and captures its own stack into preallocated slot.
+// Threads with identical stack traces are printed together, so names of functions are resolved once per unique stack trace
+//
+
+/**
+ * @brief Choose realtime signal used by dump instead of SIGRTMIN + 2. Should be called before the first dump, since handler of the signal is
+ * installed by the first dump and is never removed. Dump fails instead of overriding handler which the application already set for the signal
+ * @param signal realtime signal, SIGRTMIN...SIGRTMAX, not used by the application
+ * @return 1 on success, 0 if signal isn't realtime or handler of another signal is already installed
+ */
+int pst_dump_set_signal(int signal);
+
+/**
+ * @brief Print stack traces of all threads of the process, grouped by identical stack traces. The most populated group goes first
+ * @param context context of process given to signal handler of a program. If NULL, then stack trace of calling thread starts at the caller
+ * @param fd file descriptor to print stack traces to
+ * @return 1 on success (threads which didn't respond in time are listed separately), 0 on failure (including signal of dump handled by the
+ * application) or if another dump is in progress
+ */
+int pst_dump_all_threads(ucontext_t* context, int fd);
+
+//
+// Sampling profiler.
+// Periodically interrupts threads of the process by SIGPROF and collects their stack traces
+//
+
+/**
+ * @brief Start sampling profiler for all threads existing at the moment. Collected profile is reset. Threads should be built with -fno-omit-frame-pointer
+ * to be sampled with low overhead, other frames are unwound by libunwind. Frame records of threads which didn't call pst_thread_prepare() are
+ * checked against index of memory mappings taken at start, instead of bounds of their stacks. SIGPROF handler stays installed after pst_profiler_stop()
+ * @param hz sampling frequency per thread, 1...10000
+ * @param mode clock used to sample threads
+ * @return 1 on success, 0 on failure (including already started profiler)
+ */
+int pst_profiler_start(uint32_t hz, pst_profiler_mode mode);
+
+/**
+ * @brief Stop sampling profiler. Collected profile stays available for pst_profiler_report()
+ */
+void pst_profiler_stop();
+
+/**
+ * @brief Add calling thread to running profiler. Should be called by threads created after pst_profiler_start()
+ * @return 1 on success, 0 on failure
+ */
+int pst_profiler_register_thread();
+
+/**
+ * @brief Write collected profile in folded stacks format ("outermost;...;innermost count" per line), suitable for flame graph tools
+ * @param fd file descriptor to write profile to
+ * @return 1 on success, 0 on failure
+ */
+int pst_profiler_report(int fd);
+
 #ifdef __cplusplus
 }
 #endif
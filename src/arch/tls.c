@@ -0,0 +1,152 @@
+/*
+ * tls.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nnosov
+ */
+
+#include <link.h>
+#include <string.h>
+
+#include "context.h"
+#include "utils/safe_read.h"
+#include "tls.h"
+
+#define TLS_DTV_UNALLOCATED ((uintptr_t)-1)    // value of DTV entry of module which storage isn't allocated yet (glibc)
+
+static pst_tls          tls;                            // published index
+static pst_tls_module   staging[PST_TLS_MODULES];       // index being collected, not visible to readers
+static uint32_t         refreshing = 0;                 // non-zero while some thread rebuilds index
+
+// collect module to 'staging' if it has thread-local storage
+static int collect(struct dl_phdr_info* info, size_t size, void* data)
+{
+    uint32_t* count = (uint32_t*)data;
+    if(!info->dlpi_tls_modid) {
+        return 0;
+    }
+
+    if(*count == PST_TLS_MODULES) {
+        pst_log(SEVERITY_WARNING, "Too many modules with thread-local storage, only the first %u are indexed", PST_TLS_MODULES);
+        return 1;
+    }
+
+    pst_tls_module* m = &staging[*count];
+    m->start = UINTPTR_MAX;
+    m->end = 0;
+    m->modid = info->dlpi_tls_modid;
+    for(int i = 0; i < info->dlpi_phnum; ++i) {
+        const ElfW(Phdr)* ph = &info->dlpi_phdr[i];
+        if(ph->p_type != PT_LOAD) {
+            continue;
+        }
+
+        uintptr_t start = info->dlpi_addr + ph->p_vaddr;
+        if(start < m->start) {
+            m->start = start;
+        }
+        if(start + ph->p_memsz > m->end) {
+            m->end = start + ph->p_memsz;
+        }
+    }
+
+    if(m->start < m->end) {
+        (*count)++;
+    }
+
+    return 0;
+}
+
+// rebuild index of TLS module IDs. must be called outside of signal handler, when library is loaded and after dlopen()/dlclose()
+bool pst_tls_refresh()
+{
+    uint32_t expected = 0;
+    if(!__atomic_compare_exchange_n(&refreshing, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        // another thread is collecting the same modules right now
+        return true;
+    }
+
+    uint32_t count = 0;
+    dl_iterate_phdr(collect, &count);
+
+    __atomic_add_fetch(&tls.seq, 1, __ATOMIC_ACQ_REL);
+    memcpy(tls.modules, staging, count * sizeof(pst_tls_module));
+    tls.count = count;
+    __atomic_add_fetch(&tls.seq, 1, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&refreshing, 0, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+// TLS module ID of the module containing address, 0 if it's unknown
+static size_t find_modid(uintptr_t pc)
+{
+    for(uint32_t attempt = 0; attempt < PST_TLS_RETRIES; ++attempt) {
+        uint32_t seq = __atomic_load_n(&tls.seq, __ATOMIC_ACQUIRE);
+        if(seq & 1) {
+            continue;
+        }
+
+        size_t modid = 0;
+        uint32_t count = tls.count < PST_TLS_MODULES ? tls.count : PST_TLS_MODULES;
+        for(uint32_t i = 0; i < count; ++i) {
+            if(pc >= tls.modules[i].start && pc < tls.modules[i].end) {
+                modid = tls.modules[i].modid;
+                break;
+            }
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&tls.seq, __ATOMIC_RELAXED) == seq) {
+            return modid;
+        }
+    }
+
+    return 0;
+}
+
+// pointer to DTV of the calling thread from its thread control block, NULL if it's unknown for the architecture
+static uintptr_t thread_dtv()
+{
+    uintptr_t dtv = 0;
+#if defined(__x86_64__)
+    // %fs points to tcbhead_t { void* tcb; dtv_t* dtv; ... }
+    __asm__ volatile("mov %%fs:8, %0" : "=r"(dtv));
+#elif defined(__aarch64__)
+    // thread pointer points to tcbhead_t { dtv_t* dtv; void* private; }
+    pst_safe_read(&dtv, (uintptr_t)__builtin_thread_pointer(), sizeof(dtv));
+#endif
+
+    return dtv;
+}
+
+// address of thread-local variable at 'offset' in storage of module containing 'pc' for the calling thread
+bool pst_tls_address(uintptr_t pc, uint64_t offset, uintptr_t* addr)
+{
+    size_t modid = find_modid(pc);
+    if(!modid) {
+        pst_log(SEVERITY_ERROR, "Unknown TLS module ID of the module containing address %#lX", pc);
+        return false;
+    }
+
+    // glibc's DTV is array of { void* val; void* to_free; } pairs, dtv[-1] keeps number of entries and dtv[0] generation
+    uintptr_t dtv = thread_dtv();
+    uintptr_t entries = 0;
+    if(!dtv || !pst_safe_read(&entries, dtv - 2 * sizeof(uintptr_t), sizeof(entries))) {
+        pst_log(SEVERITY_ERROR, "Failed to read DTV of thread");
+        return false;
+    }
+
+    // DTV of thread is extended by __tls_get_addr() on first access to storage of module loaded after the thread was started
+    uintptr_t block = 0;
+    if(modid > entries || !pst_safe_read(&block, dtv + modid * 2 * sizeof(uintptr_t), sizeof(block)) ||
+       !block || block == TLS_DTV_UNALLOCATED) {
+        pst_log(SEVERITY_ERROR, "Storage of TLS module %zu isn't allocated for the thread", modid);
+        return false;
+    }
+
+    *addr = block + offset;
+
+    return true;
+}
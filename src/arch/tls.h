@@ -0,0 +1,42 @@
+/*
+ * tls.h
+ *
+ * Addresses of thread-local variables computed without dynamic loader
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_TLS_H__
+#define __PST_TLS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define PST_TLS_MODULES     (256)   // maximum number of indexed modules having thread-local storage
+#define PST_TLS_RETRIES     (64)    // maximum number of attempts to read index while it's being updated
+
+// loaded module having thread-local storage
+typedef struct pst_tls_module {
+    uintptr_t   start;  // the lowest address of loaded segments
+    uintptr_t   end;    // address after the last byte of loaded segments
+    size_t      modid;  // TLS module ID assigned by dynamic loader
+} pst_tls_module;
+
+// -----------------------------------------------------------------------------------
+// pst_tls
+// -----------------------------------------------------------------------------------
+// TLS module IDs are collected by dl_iterate_phdr() outside of signal handler, when library is loaded and after dlopen(), since it takes
+// loader's lock. Address of variable is read from DTV (dynamic thread vector) of the calling thread, instead of __tls_get_addr() which
+// may allocate storage. Index is published under seqlock like the one of memory mappings.
+typedef struct pst_tls {
+    pst_tls_module  modules[PST_TLS_MODULES];
+    uint32_t        count;  // number of valid entries in 'modules'
+    uint32_t        seq;    // sequence counter of seqlock, odd while index is being updated
+} pst_tls;
+
+bool pst_tls_refresh();
+bool pst_tls_address(uintptr_t pc, uint64_t offset, uintptr_t* addr);
+
+#endif /* __PST_TLS_H__ */
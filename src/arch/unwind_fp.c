@@ -0,0 +1,139 @@
+/*
+ * unwind_fp.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "context.h"
+#include "maps.h"
+#include "unwind_fp.h"
+
+// bounds of the stack of current thread. determined once per thread since pthread_getattr_np() isn't async-signal-safe
+static __thread uintptr_t stack_lo __attribute__((tls_model("initial-exec"))) = 0;
+static __thread uintptr_t stack_hi __attribute__((tls_model("initial-exec"))) = 0;
+
+// determine stack bounds of the calling thread. should be called outside of signal handler at least once per thread
+// to make pst_unwind_fp() async-signal-safe
+bool pst_unwind_fp_prepare()
+{
+    if(stack_hi) {
+        return true;
+    }
+
+    pthread_attr_t attr;
+    if(pthread_getattr_np(pthread_self(), &attr)) {
+        pst_log(SEVERITY_ERROR, "Failed to get attributes of thread");
+        return false;
+    }
+
+    void* addr = NULL;
+    size_t size = 0;
+    int ret = pthread_attr_getstack(&attr, &addr, &size);
+    pthread_attr_destroy(&attr);
+    if(ret) {
+        pst_log(SEVERITY_ERROR, "Failed to get stack bounds of thread");
+        return false;
+    }
+
+    stack_lo = (uintptr_t)addr;
+    stack_hi = (uintptr_t)addr + size;
+
+    return true;
+}
+
+#if defined(__x86_64__)
+
+// unwind one frame using CFI when RBP chain is broken (i.e. function was compiled without frame pointer)
+static bool step_libunwind(unw_word_t* pc, unw_word_t* sp, unw_word_t* fp)
+{
+    unw_context_t uc;
+    unw_cursor_t cursor;
+
+    // libunwind's context is ucontext_t on x86_64, so fill only registers needed to find caller's frame
+    unw_getcontext(&uc);
+    uc.uc_mcontext.gregs[REG_RIP] = *pc;
+    uc.uc_mcontext.gregs[REG_RSP] = *sp;
+    uc.uc_mcontext.gregs[REG_RBP] = *fp;
+
+    if(unw_init_local(&cursor, &uc) < 0 || unw_step(&cursor) <= 0) {
+        return false;
+    }
+
+    unw_word_t npc, nsp, nfp;
+    if(unw_get_reg(&cursor, UNW_REG_IP, &npc) || unw_get_reg(&cursor, UNW_REG_SP, &nsp) || unw_get_reg(&cursor, UNW_X86_64_RBP, &nfp)) {
+        return false;
+    }
+
+    // stack grows down, so caller's frame must be above callee's one
+    if(nsp <= *sp) {
+        return false;
+    }
+
+    *pc = npc; *sp = nsp; *fp = nfp;
+
+    return true;
+}
+
+// Walks RBP chain starting from signal handler's context or from the caller of this function, if 'hctx' is NULL.
+// Each frame pointer is checked against stack bounds before dereference, or against index of mappings in threads which stack bounds
+// are unknown. If the chain is broken, falls back to libunwind for one frame and continues with the RBP obtained from it.
+// Returns number of frames saved to 'frames'
+__attribute__((noinline, optimize("no-omit-frame-pointer")))
+int pst_unwind_fp(ucontext_t* hctx, pst_frame* frames, int max)
+{
+    unw_word_t pc, sp, fp;
+    if(hctx) {
+        pc = hctx->uc_mcontext.gregs[REG_RIP];
+        sp = hctx->uc_mcontext.gregs[REG_RSP];
+        fp = hctx->uc_mcontext.gregs[REG_RBP];
+    } else {
+        unw_word_t* self = (unw_word_t*)__builtin_frame_address(0);
+        pc = (unw_word_t)__builtin_return_address(0);
+        sp = (unw_word_t)(self + 2);
+        fp = self[0];
+    }
+
+    // if stack bounds are unknown (thread didn't call pst_unwind_fp_prepare()) or SP is outside of them (alternative or user-allocated
+    // stack), frame records are checked by binary search in index of mappings, which is cheaper than libunwind step anyway
+    bool bounded = sp >= stack_lo && sp < stack_hi;
+
+    int count = 0;
+    while(count < max && pc) {
+        frames[count].pc = pc;
+        frames[count].sp = sp;
+        count++;
+
+        // frame record is [saved RBP, return address]
+        if(fp >= sp && !(fp & (sizeof(unw_word_t) - 1)) &&
+           (bounded ? fp + 2 * sizeof(unw_word_t) <= stack_hi : pst_maps_check(fp, 2 * sizeof(unw_word_t)) == 0)) {
+            unw_word_t next_fp = ((unw_word_t*)fp)[0];
+            unw_word_t ret = ((unw_word_t*)fp)[1];
+            if(ret && (next_fp > fp || next_fp == 0)) {
+                pc = ret;
+                sp = fp + 2 * sizeof(unw_word_t);
+                fp = next_fp;
+                continue;
+            }
+        }
+
+        if(!step_libunwind(&pc, &sp, &fp)) {
+            break;
+        }
+    }
+
+    return count;
+}
+
+#else
+
+int pst_unwind_fp(ucontext_t* hctx, pst_frame* frames, int max)
+{
+    // not supported for this architecture yet
+    return 0;
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef __PST_UNWIND_FP_H__
+#define __PST_UNWIND_FP_H__
+
+/*
+ * unwind_fp.h
+ *
+ * Fast frame pointer (RBP chain) based stack unwinder for x86_64
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ucontext.h>
+#include <libunwind.h>
+
+#define PST_MAX_FRAMES  (128)   // maximum number of frames which could be unwound
+
+// PC & SP of unwound stack frame
+typedef struct __pst_frame {
+    unw_word_t  pc;     // address of currently executed instruction in the frame
+    unw_word_t  sp;     // stack pointer of the frame
+} pst_frame;
+
+bool pst_unwind_fp_prepare();
+int pst_unwind_fp(ucontext_t* hctx, pst_frame* frames, int max);
+
+#endif /* __PST_UNWIND_FP_H__ */
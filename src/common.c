@@ -12,6 +12,7 @@
 #include <errno.h>
 
 #include "context.h"
+#include "maps.h"
 
 int32_t decode_sleb128(uint8_t *sleb128)
 {
@@ -122,9 +123,18 @@ unsigned getSLEB128Size(int64_t Value)
 
 int pst_pointer_valid(void *p, uint32_t size)
 {
-    long page_size = sysconf(_SC_PAGESIZE);
+    int ret = pst_maps_check((uintptr_t)p, size);
+    if(ret >= 0) {
+        return ret;
+    }
+
+    // index of mappings isn't available, so ask the kernel
+    static long page_size = 0;
+    if(!page_size) {
+        page_size = sysconf(_SC_PAGESIZE);
+    }
     if(page_size < 0) {
-        pst_log(SEVERITY_ERROR, "%s: Failed to determine page size");
+        pst_log(SEVERITY_ERROR, "%s: Failed to determine page size", __FUNCTION__);
         return EFAULT;
     }
 
@@ -12,6 +12,7 @@
 
 #include "dwarf/dwarf_operations.h"
 #include "arch/registers.h"
+#include "utils/sink.h"
 
 
 extern dwarf_reg_map    reg_map[];
@@ -64,12 +65,23 @@ static bool print(pst_context* ctx, const char* fmt, ...)
 
     va_list args;
     va_start(args, fmt);
+    if(ctx->sink) {
+        nret = pst_sink_vprintf(ctx->sink, fmt, args);
+        va_end(args);
+        return nret;
+    }
+
     int size = sizeof(ctx->buff) - ctx->offset;
     int ret = vsnprintf(ctx->buff + ctx->offset, size, fmt, args);
-    if(ret >= size || ret < 0) {
+    if(ret < 0) {
+        nret = false;
+    } else if(ret >= size) {
+        // output is truncated, keep offset inside of the buffer
         nret = false;
+        ctx->offset = sizeof(ctx->buff) - 1;
+    } else {
+        ctx->offset += ret;
     }
-    ctx->offset += ret;
     va_end(args);
 
     return nret;
@@ -82,24 +94,24 @@ static bool print_expr_block (pst_context* ctx, Dwarf_Op *exprs, int exprlen, Dw
         const dwarf_op_map* map = find_op_map(exprs[i].atom);
         if(map) {
             if(map->op_num >= DW_OP_breg0 && map->op_num <= DW_OP_breg16) {
-                int32_t off = decode_sleb128((unsigned char*)&exprs[i].number);
+                int64_t off = (int64_t)exprs[i].number;
                 int regno = map->op_num - DW_OP_breg0;
                 unw_word_t ptr = 0;
                 unw_get_reg(ctx->curr_frame, regno, &ptr);
 
-                ctx->print(ctx, "%s(*%s%s%d) reg_value: 0x%lX", map->op_name, unw_regname(regno), off >=0 ? "+" : "", off, ptr);
+                ctx->print(ctx, "%s(*%s%s%ld) reg_value: 0x%lX", map->op_name, unw_regname(regno), off >=0 ? "+" : "", off, ptr);
             } else if(map->op_num >= DW_OP_reg0 && map->op_num <= DW_OP_reg16) {
                 unw_word_t value = 0;
                 int regno = map->op_num - DW_OP_reg0;
                 unw_get_reg(ctx->curr_frame, regno, &value);
                 ctx->print(ctx, "%s(*%s) value: 0x%lX", map->op_name, unw_regname(regno), value);
-            } else if(map->op_num == DW_OP_GNU_entry_value) {
+            } else if(map->op_num == DW_OP_GNU_entry_value || map->op_num == DW_OP_entry_value) {
                 if(!attr) {
                     pst_log(SEVERITY_ERROR, "No attribute of DW_OP_GNU_entry_value provided");
                     return false;
                 }
-                uint32_t value = decode_uleb128((unsigned char*)&exprs[i].number);
-                ctx->print(ctx, "%s(%u, ", map->op_name, value);
+                uint64_t value = exprs[i].number;
+                ctx->print(ctx, "%s(%lu, ", map->op_name, value);
                 Dwarf_Attribute attr_mem;
                 if(!dwarf_getlocation_attr(attr, exprs, &attr_mem)) {
                     Dwarf_Op *expr;
@@ -118,17 +130,17 @@ static bool print_expr_block (pst_context* ctx, Dwarf_Op *exprs, int exprlen, Dw
             } else if(map->op_num == DW_OP_stack_value) {
                 ctx->print(ctx, "%s", map->op_name);
             } else if(map->op_num == DW_OP_plus_uconst) {
-                uint32_t value = decode_uleb128((unsigned char*)&exprs[i].number);
-                ctx->print(ctx, "%s(+%u) ", map->op_name, value);
+                uint64_t value = exprs[i].number;
+                ctx->print(ctx, "%s(+%lu) ", map->op_name, value);
             } else if(map->op_num == DW_OP_bregx) {
-                uint32_t regno = decode_uleb128((unsigned char*)&exprs[i].number);
-                int32_t off = decode_sleb128((unsigned char*)&exprs[i].number2);
+                uint64_t regno = exprs[i].number;
+                int64_t off = (int64_t)exprs[i].number2;
                 unw_word_t ptr = 0;
                 unw_get_reg(ctx->curr_frame, regno, &ptr);
                 //ptr += off;
-                ctx->print(ctx, "%s(%s%s%d) reg_value = 0x%lX", map->op_name, unw_regname(regno), off >= 0 ? "+" : "", off, ptr);
+                ctx->print(ctx, "%s(%s%s%ld) reg_value = 0x%lX", map->op_name, unw_regname(regno), off >= 0 ? "+" : "", off, ptr);
             } else if(map->op_num == DW_OP_regx) {
-                int32_t reg = decode_sleb128((unsigned char*)&exprs[i].number);
+                uint64_t reg = exprs[i].number;
 
                 unw_word_t value = 0;
                 unw_get_reg(ctx->curr_frame, reg, &value);
@@ -137,8 +149,8 @@ static bool print_expr_block (pst_context* ctx, Dwarf_Op *exprs, int exprlen, Dw
             } else if(map->op_num == DW_OP_addr) {
                 ctx->print(ctx, "%s value = %p", map->op_name, (void*)exprs[i].number);
             } else if(map->op_num == DW_OP_fbreg) {
-                int32_t off = decode_sleb128((unsigned char*)&exprs[i].number);
-                ctx->print(ctx, "%s(SP%s%d) ", map->op_name, off >=0 ? "+" : "", off);
+                int64_t off = (int64_t)exprs[i].number;
+                ctx->print(ctx, "%s(SP%s%ld) ", map->op_name, off >=0 ? "+" : "", off);
             } else {
                 ctx->print(ctx, "%s(0x%lX, 0x%lx) ", map->op_name, exprs[i].number, exprs[i].number2);
             }
@@ -161,18 +173,23 @@ void pst_context_init(pst_context* ctx, ucontext_t* hctx)
 
     // fields
     ctx->hcontext = hctx;
+    ctx->signal = hctx != NULL;
     ctx->base_addr = 0;
     ctx->sp = 0;
     ctx->cfa = 0;
     ctx->curr_frame = NULL;
     ctx->frame = NULL;
     ctx->dwfl = NULL;
+    ctx->session = NULL;
     ctx->module = NULL;
+    ctx->sink = NULL;
+    ctx->budget = 0;
 }
 
 void pst_context_fini(pst_context* ctx)
 {
     ctx->hcontext = NULL;
+    ctx->signal = false;
     ctx->clean_print(ctx);
     ctx->base_addr = 0;
     ctx->sp = 0;
@@ -181,6 +198,8 @@ void pst_context_fini(pst_context* ctx)
     ctx->frame = NULL;
     ctx->dwfl = NULL;
     ctx->module = NULL;
+    ctx->sink = NULL;
+    ctx->budget = 0;
 }
 
 
@@ -190,6 +209,10 @@ char* pst_strdup(const char* str)
 
     uint32_t len = strlen(str);
     char* dst = (char*)allocator.alloc(&allocator, len + 1);
+    if(!dst) {
+        return NULL;
+    }
+
     memcpy(dst, str, len);
     dst[len] = 0;
 
@@ -28,7 +28,7 @@ extern pst_allocator    allocator;  // custom allocator for PST library
 #define pst_free(NAME) allocator.free(&allocator, NAME)
 
 #ifdef PST_DEBUG
-#define pst_log(SEVERITY, FORMAT, ...) pstlogger.log(&logger, SEVERITY, FORMAT, ##__VA_ARGS__)
+#define pst_log(SEVERITY, FORMAT, ...) pstlogger.log(&pstlogger, SEVERITY, FORMAT, ##__VA_ARGS__)
 #else
 #define pst_log(SEVERITY, FORMAT, ...)
 #endif
@@ -45,6 +45,7 @@ typedef struct __pst_context {
 
     // fields
     ucontext_t*                 hcontext;   // context of signal handler
+    bool                        signal;     // whether handler is used by signal handler, i.e. must not block or allocate
     unw_context_t               context;    // context of stack trace
     unw_cursor_t                cursor;     // libunwind stack frame storage
     unw_cursor_t*               curr_frame; // callee libunwind frame
@@ -53,12 +54,15 @@ typedef struct __pst_context {
     Dwarf_Addr                  sp;         // stack pointer of currently processed stack frame
     Dwarf_Addr                  cfa;        // CFA (Canonical Frame Address) of currently processed stack frame
 
-    Dwarf_Frame*                frame;      // currently examined libdwfl frame
+    Dwarf_Frame*                frame;      // frame rules of currently evaluated CFA expression, NULL outside of evaluation
     Dwfl*                       dwfl;       // DWARF context
+    struct pst_session*         session;    // libdw session borrowed by handler, owns caches
     Dwfl_Module*                module;     // currently processed CU
 
     char                        buff[8192]; // stack trace buffer
     uint32_t                    offset;     // offset in the 'buff'
+    struct pst_sink*            sink;       // destination of print(), NULL to print to 'buff'
+    uint32_t                    budget;     // number of bytes of objects which may still be read to get values of their members
 } pst_context;
 
 void pst_context_init(pst_context* ctx, ucontext_t* hctx);
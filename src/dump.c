@@ -0,0 +1,372 @@
+/*
+ * dump.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "context.h"
+#include "dump.h"
+#include "registry.h"
+#include "utils/sink.h"
+#include "arch/unwind_fp.h"
+
+// entry of getdents64() output
+typedef struct pst_dirent {
+    uint64_t        ino;
+    int64_t         off;
+    unsigned short  reclen;
+    unsigned char   type;
+    char            name[];
+} pst_dirent;
+
+// everything is preallocated, since dump may be requested by crash handler
+static pst_dump_slot    slots[PST_DUMP_THREADS];
+static uint32_t         count = 0;              // number of used slots
+static pst_dump_group   groups[PST_DUMP_THREADS];
+static pst_sink         sink;
+static uint32_t         dumping = 0;            // non-zero while dump is in progress
+static uint32_t         generation = 0;         // number of the current dump, passed to threads with signal
+static uint32_t         handlers = 0;           // number of threads running signal handler
+static uint32_t         handler_installed = 0;
+static int              dump_signo = 0;         // signal asking threads to capture their stacks, 0 till the first dump or pst_dump_use_signal()
+
+static pid_t gettid_safe()
+{
+    return (pid_t)syscall(SYS_gettid);
+}
+
+static void capture(pst_dump_slot* s, ucontext_t* hctx)
+{
+    pst_frame frames[PST_DUMP_DEPTH];
+    int depth = pst_unwind_fp(hctx, frames, PST_DUMP_DEPTH);
+    s->depth = depth > 0 ? depth : 0;
+    for(uint32_t i = 0; i < s->depth; ++i) {
+        s->pcs[i] = frames[i].pc;
+    }
+}
+
+// signal may be delivered after dump, which sent it, is over, so slot is captured only if both signal and slot belong to the current dump
+static void dump_signal(int sig, siginfo_t* si, void* uctx)
+{
+    __atomic_add_fetch(&handlers, 1, __ATOMIC_SEQ_CST);
+    if(!__atomic_load_n(&dumping, __ATOMIC_SEQ_CST)) {
+        __atomic_sub_fetch(&handlers, 1, __ATOMIC_RELEASE);
+        return;
+    }
+
+    uint32_t gen = __atomic_load_n(&generation, __ATOMIC_SEQ_CST);
+    if(si->si_code != SI_QUEUE || (uint32_t)si->si_value.sival_int != gen) {
+        __atomic_sub_fetch(&handlers, 1, __ATOMIC_RELEASE);
+        return;
+    }
+
+    int err = errno;
+    pid_t tid = gettid_safe();
+    for(uint32_t i = 0; i < count; ++i) {
+        uint32_t state = DUMP_WAIT;
+        if(slots[i].tid == tid && slots[i].generation == gen &&
+           __atomic_compare_exchange_n(&slots[i].state, &state, DUMP_BUSY, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            capture(&slots[i], (ucontext_t*)uctx);
+            __atomic_store_n(&slots[i].state, DUMP_DONE, __ATOMIC_RELEASE);
+            break;
+        }
+    }
+    errno = err;
+
+    __atomic_sub_fetch(&handlers, 1, __ATOMIC_RELEASE);
+}
+
+// choose signal of dumps. signal can't be changed once its handler is installed, since late threads may still receive the old one
+bool pst_dump_use_signal(int sig)
+{
+    if(sig < SIGRTMIN || sig > SIGRTMAX) {
+        pst_log(SEVERITY_ERROR, "Signal %d isn't a realtime signal", sig);
+        return false;
+    }
+
+    if(__atomic_load_n(&handler_installed, __ATOMIC_ACQUIRE) && __atomic_load_n(&dump_signo, __ATOMIC_ACQUIRE) != sig) {
+        pst_log(SEVERITY_ERROR, "Handler of dump is already installed for signal %d", __atomic_load_n(&dump_signo, __ATOMIC_ACQUIRE));
+        return false;
+    }
+    __atomic_store_n(&dump_signo, sig, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static bool install_handler()
+{
+    if(__atomic_load_n(&handler_installed, __ATOMIC_ACQUIRE)) {
+        return true;
+    }
+
+    int expected = 0;
+    __atomic_compare_exchange_n(&dump_signo, &expected, PST_DUMP_SIGNAL, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    int sig = __atomic_load_n(&dump_signo, __ATOMIC_ACQUIRE);
+
+    // handler of the application isn't overridden silently
+    struct sigaction old;
+    if(sigaction(sig, NULL, &old)) {
+        pst_log(SEVERITY_ERROR, "Failed to query handler of signal %d", sig);
+        return false;
+    }
+    if((old.sa_flags & SA_SIGINFO) ? old.sa_sigaction != dump_signal : (old.sa_handler != SIG_DFL && old.sa_handler != SIG_IGN)) {
+        pst_log(SEVERITY_ERROR, "Signal %d is already handled by the application, choose another one by pst_dump_set_signal()", sig);
+        return false;
+    }
+
+    // handler is never removed, since signal may be delivered to a late thread after dump is over
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = dump_signal;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if(sigaction(sig, &sa, NULL)) {
+        pst_log(SEVERITY_ERROR, "Failed to install handler of signal %d", sig);
+        return false;
+    }
+    __atomic_store_n(&handler_installed, 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+// parse thread ID from name of /proc/self/task entry, returns 0 for '.' and '..'
+static pid_t parse_tid(const char* name)
+{
+    pid_t tid = 0;
+    for(; *name >= '0' && *name <= '9'; ++name) {
+        tid = tid * 10 + (*name - '0');
+    }
+
+    return *name ? 0 : tid;
+}
+
+// list threads of the process by getdents64(), since opendir() allocates memory
+static void list_threads(uint32_t gen)
+{
+    count = 0;
+    int fd = open("/proc/self/task", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd < 0) {
+        pst_log(SEVERITY_ERROR, "Failed to list threads of the process");
+        return;
+    }
+
+    char buff[4096];
+    long size;
+    while(count < PST_DUMP_THREADS && (size = syscall(SYS_getdents64, fd, buff, sizeof(buff))) > 0) {
+        for(long pos = 0; pos < size && count < PST_DUMP_THREADS; ) {
+            pst_dirent* d = (pst_dirent*)(buff + pos);
+            pid_t tid = parse_tid(d->name);
+            if(tid > 0) {
+                slots[count].tid = tid;
+                slots[count].generation = gen;
+                slots[count].state = DUMP_WAIT;
+                slots[count].depth = 0;
+                slots[count].id = 0;
+                count++;
+            }
+            pos += d->reclen;
+        }
+    }
+    close(fd);
+}
+
+static uint64_t now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sleep_short()
+{
+    struct timespec ts = { 0, 100000 };
+    nanosleep(&ts, NULL);
+}
+
+// wait till threads signaled by previous dumps leave handler, so they don't touch slots being reused
+static bool wait_handlers()
+{
+    uint64_t deadline = now_ms() + PST_DUMP_TIMEOUT;
+    while(__atomic_load_n(&handlers, __ATOMIC_ACQUIRE)) {
+        if(now_ms() >= deadline) {
+            return false;
+        }
+        sleep_short();
+    }
+
+    return true;
+}
+
+// send signal with number of the dump, so the thread can tell whether it belongs to the current dump
+static bool signal_thread(pid_t pid, pid_t tid, uint32_t gen)
+{
+    siginfo_t si;
+    memset(&si, 0, sizeof(si));
+    int sig = __atomic_load_n(&dump_signo, __ATOMIC_ACQUIRE);
+    si.si_signo = sig;
+    si.si_code = SI_QUEUE;
+    si.si_pid = pid;
+    si.si_uid = getuid();
+    si.si_value.sival_int = (int)gen;
+
+    return syscall(SYS_rt_tgsigqueueinfo, pid, tid, sig, &si) == 0;
+}
+
+// signal all threads except the calling one and wait till they capture their stacks
+static void capture_all(ucontext_t* hctx, uint32_t gen)
+{
+    pid_t pid = getpid();
+    pid_t self = gettid_safe();
+    for(uint32_t i = 0; i < count; ++i) {
+        if(slots[i].tid == self) {
+            capture(&slots[i], hctx);
+            slots[i].state = DUMP_DONE;
+        } else if(!signal_thread(pid, slots[i].tid, gen)) {
+            slots[i].state = DUMP_GONE;
+        }
+    }
+
+    uint64_t deadline = now_ms() + PST_DUMP_TIMEOUT;
+    for(uint32_t i = 0; i < count; ) {
+        uint32_t state = __atomic_load_n(&slots[i].state, __ATOMIC_ACQUIRE);
+        if(state != DUMP_WAIT && state != DUMP_BUSY) {
+            ++i;
+            continue;
+        }
+        if(now_ms() >= deadline) {
+            break;
+        }
+        sleep_short();
+    }
+
+    // threads which haven't started capture yet don't get the slot anymore
+    for(uint32_t i = 0; i < count; ++i) {
+        uint32_t state = DUMP_WAIT;
+        __atomic_compare_exchange_n(&slots[i].state, &state, DUMP_LATE, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    }
+}
+
+// group threads by stack trace ID. threads which stack trace didn't get into registry form groups of their own
+static uint32_t group_threads()
+{
+    uint32_t ngroups = 0;
+    for(uint32_t i = 0; i < count; ++i) {
+        pst_dump_slot* s = &slots[i];
+        if(__atomic_load_n(&s->state, __ATOMIC_ACQUIRE) != DUMP_DONE) {
+            continue;
+        }
+
+        s->id = pst_registry_intern(s->pcs, s->depth);
+        uint32_t g = 0;
+        for(; s->id && g < ngroups && groups[g].id != s->id; ++g);
+        if(s->id && g < ngroups) {
+            groups[g].count++;
+            continue;
+        }
+
+        groups[ngroups].id = s->id;
+        groups[ngroups].count = 1;
+        groups[ngroups].first = i;
+        ngroups++;
+    }
+
+    // the most populated stack traces go first
+    for(uint32_t i = 1; i < ngroups; ++i) {
+        pst_dump_group g = groups[i];
+        uint32_t j = i;
+        for(; j > 0 && groups[j - 1].count < g.count; --j) {
+            groups[j] = groups[j - 1];
+        }
+        groups[j] = g;
+    }
+
+    return ngroups;
+}
+
+static void print_group(pst_dump_group* g, bool signal)
+{
+    pst_dump_slot* first = &slots[g->first];
+    pst_sink_printf(&sink, "%u thread%s:", g->count, g->count > 1 ? "s" : "");
+    for(uint32_t i = g->first; i < count; ++i) {
+        if(slots[i].state == DUMP_DONE && (i == g->first || (g->id && slots[i].id == g->id))) {
+            pst_sink_printf(&sink, " %d", slots[i].tid);
+        }
+    }
+    pst_sink_printf(&sink, "\n");
+
+    // names of functions are resolved once per unique stack trace
+    pst_registry_entry* e = g->id ? pst_registry_symbolize(g->id, signal) : NULL;
+    if(e && e->text) {
+        pst_sink_write(&sink, e->text, strlen(e->text));
+    } else {
+        for(uint32_t i = 0; i < first->depth; ++i) {
+            pst_sink_printf(&sink, "[%-2u] %p\n", i, (void*)first->pcs[i]);
+        }
+    }
+    pst_sink_printf(&sink, "\n");
+}
+
+// print stack traces of all threads to file descriptor, threads with identical stack traces are printed together
+bool pst_dump_threads(ucontext_t* hctx, int fd)
+{
+    uint32_t expected = 0;
+    if(!__atomic_compare_exchange_n(&dumping, &expected, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        pst_log(SEVERITY_WARNING, "Dump of threads is already in progress");
+        return false;
+    }
+
+    if(!pst_registry_init() || !install_handler()) {
+        __atomic_store_n(&dumping, 0, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    // threads signaled by previous dump may still be in handler, new number makes them skip slots once they are reused
+    uint32_t gen = __atomic_add_fetch(&generation, 1, __ATOMIC_SEQ_CST);
+    if(!wait_handlers()) {
+        pst_log(SEVERITY_ERROR, "Threads signaled by previous dump are still in handler");
+        __atomic_store_n(&dumping, 0, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    list_threads(gen);
+    capture_all(hctx, gen);
+    uint32_t ngroups = group_threads();
+
+    uint32_t captured = 0;
+    for(uint32_t g = 0; g < ngroups; ++g) {
+        captured += groups[g].count;
+    }
+
+    pst_sink_init_fd(&sink, fd);
+    pst_sink_printf(&sink, "Dump of %u threads, %u unique stack traces\n\n", captured, ngroups);
+    for(uint32_t g = 0; g < ngroups; ++g) {
+        print_group(&groups[g], hctx != NULL);
+    }
+
+    if(captured < count) {
+        pst_sink_printf(&sink, "Threads which didn't respond:");
+        for(uint32_t i = 0; i < count; ++i) {
+            uint32_t state = __atomic_load_n(&slots[i].state, __ATOMIC_ACQUIRE);
+            if(state != DUMP_DONE && state != DUMP_GONE) {
+                pst_sink_printf(&sink, " %d", slots[i].tid);
+            }
+        }
+        pst_sink_printf(&sink, "\n");
+    }
+
+    bool ret = pst_sink_flush(&sink);
+    pst_sink_fini(&sink);
+
+    // late threads may still be in handler, the next dump waits for them before it reuses slots
+    __atomic_store_n(&dumping, 0, __ATOMIC_RELEASE);
+
+    return ret;
+}
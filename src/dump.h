@@ -0,0 +1,53 @@
+/*
+ * dump.h
+ *
+ * Stack traces of all threads of the process, grouped by identical stacks
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_DUMP_H__
+#define __PST_DUMP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <sys/types.h>
+
+#define PST_DUMP_THREADS    (1024)          // maximum number of dumped threads
+#define PST_DUMP_DEPTH      (64)            // maximum number of frames per thread
+#define PST_DUMP_TIMEOUT    (1000)          // time to wait for threads to capture their stacks in milliseconds
+#define PST_DUMP_SIGNAL     (SIGRTMIN + 2)  // default signal asking thread to capture its stack
+
+// state of thread's slot
+typedef enum {
+    DUMP_WAIT   = 0,    // thread is signaled, but hasn't captured its stack yet
+    DUMP_DONE   = 1,    // stack is captured
+    DUMP_GONE   = 2,    // thread exited before it was signaled
+    DUMP_BUSY   = 3,    // thread is capturing its stack
+    DUMP_LATE   = 4,    // thread didn't capture its stack in time, so it must not touch the slot anymore
+} pst_dump_state;
+
+// stack of a thread captured by the thread itself in signal handler
+typedef struct pst_dump_slot {
+    pid_t           tid;                    // kernel thread ID
+    uint32_t        generation;             // number of dump which the slot belongs to
+    uint32_t        state;                  // one of pst_dump_state
+    uint32_t        depth;                  // number of valid entries in 'pcs'
+    uint32_t        id;                     // ID of stack trace in registry, 0 if registry is full
+    uintptr_t       pcs[PST_DUMP_DEPTH];    // PC of interrupted instruction followed by return addresses of callers
+} pst_dump_slot;
+
+// threads with the same stack trace
+typedef struct pst_dump_group {
+    uint32_t        id;         // ID of stack trace in registry
+    uint32_t        count;      // number of threads
+    uint32_t        first;      // index of slot of the first thread
+} pst_dump_group;
+
+bool pst_dump_use_signal(int sig);
+bool pst_dump_threads(ucontext_t* hctx, int fd);
+
+#endif /* __PST_DUMP_H__ */
@@ -57,6 +57,10 @@ void pst_dwarf_op_fini(pst_dwarf_op* dwop)
 static pst_dwarf_op* add_op(pst_dwarf_expr* expr, uint8_t operation, uint64_t arg1, uint64_t arg2)
 {
     pst_new(pst_dwarf_op, op, operation, arg1, arg2);
+    if(!op) {
+        return NULL;
+    }
+
     list_add_bottom(&expr->operations, &op->node);
 
     return op;
@@ -138,7 +142,10 @@ void pst_dwarf_expr_init(pst_dwarf_expr* expr)
 {
     list_head_init(&expr->operations);
     expr->has_value = false;
+    expr->faulted = false;
     expr->value = 0;
+    expr->address = 0;
+    expr->in_value = false;
 
     expr->buff[0] = 0;
     expr->offset = 0;
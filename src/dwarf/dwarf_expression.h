@@ -32,7 +32,10 @@ void pst_dwarf_op_fini(pst_dwarf_op* dwop);
 typedef struct pst_dwarf_expr {
     list_head       operations;
     bool            has_value;
+    bool            faulted;    // memory referenced by expression isn't readable
     uint64_t        value;
+    uint64_t        address;    // address of object if its location is in memory, 0 otherwise
+    bool            in_value;   // object is in 'value' itself, i.e. in register or assembled from pieces
     char            buff[512];
     uint16_t        offset;
     bool            allocated;
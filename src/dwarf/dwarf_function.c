@@ -8,55 +8,45 @@
 
 #include <dwarf.h>
 #include <stdlib.h>
-#include <libiberty/demangle.h>
 #include <stdio.h>
 
 
 #include "dwarf_stack.h"
 #include "dwarf_utils.h"
 #include "dwarf_function.h"
+#include "session.h"
 
 // -----------------------------------------------------------------------------------
 // pst_function
 // -----------------------------------------------------------------------------------
 static bool get_frame(pst_function* fn)
 {
-    // get CFI (Call Frame Information) for current module
-    // from handle_cfi()
-    Dwarf_Addr mod_bias = 0;
-    Dwarf_CFI* cfi = dwfl_module_eh_cfi(fn->ctx->module, &mod_bias); // rty .eh_cfi first
-    if(!cfi) { // then try .debug_fame second
-        cfi = dwfl_module_dwarf_cfi(fn->ctx->module, &mod_bias);
-    }
-    if(!cfi) {
-        pst_log(SEVERITY_ERROR, "Cannot find CFI for module");
+    if(!fn->ctx->session) {
         return false;
     }
 
-    // get frame of CFI for address
-    int result = dwarf_cfi_addrframe (cfi, fn->info.pc - mod_bias, &fn->frame);
-    if (result != 0) {
-        pst_log(SEVERITY_ERROR, "Failed to find CFI frame for module");
+    // get CFI (Call Frame Information) frame for address. CFI of the module and decoded frames are cached by the session,
+    // so recurring frames don't search and decode FDE again
+    pst_frame_rule* rule = pst_frame_cache_lookup(&fn->ctx->session->frames, fn->ctx->module, fn->info.pc);
+    if(!rule) {
         return false;
     }
 
-    // setup context to match frame
-    fn->ctx->frame = fn->frame;
-
     // get return register and PC range for function
-    Dwarf_Addr start = fn->info.pc;
-    Dwarf_Addr end = fn->info.pc;
-    bool signalp;
-    int ra_regno = dwarf_frame_info (fn->frame, &start, &end, &signalp);
-    if(ra_regno >= 0) {
-        start += mod_bias;
-        end += mod_bias;
-        reginfo info; info.regno = ra_regno;
+    if(rule->ra_regno >= 0) {
+        reginfo info; info.regno = rule->ra_regno;
         dwfl_module_register_names(fn->ctx->module, regname_callback, &info);
         pst_log(SEVERITY_INFO, "Function %s(...): '.eh/debug frame' info: PC range:  => [%#" PRIx64 ", %#" PRIx64 "], return register: %s, in_signal = %s",
-                fn->info.name, start, end, info.regname, signalp ? "true" : "false");
+                fn->info.name, rule->start, rule->end, info.regname, rule->signalp ? "true" : "false");
     } else {
-        pst_log(SEVERITY_WARNING, "Return address register info unavailable (%s)", dwarf_errmsg(0));
+        pst_log(SEVERITY_WARNING, "Return address register info unavailable");
+    }
+
+    // CFA of the most of frames is value of register plus offset, so don't evaluate expression for them
+    if(pst_frame_rule_cfa(rule, fn->ctx->curr_frame, &fn->info.cfa)) {
+        pst_log(SEVERITY_INFO, "Function %s(...): CFA: reg%d%+" PRId64 " ==> %#lX", fn->info.name, rule->cfa_regno, rule->cfa_offset, fn->info.cfa);
+        fn->ctx->cfa = fn->info.cfa;
+        return true;
     }
 
     // finally get CFA (Canonical Frame Address)
@@ -65,13 +55,16 @@ static bool get_frame(pst_function* fn)
     Dwarf_Op dummy;
     Dwarf_Op *cfa_ops = &dummy;
     size_t cfa_nops;
-    if(dwarf_frame_cfa(fn->frame, &cfa_ops, &cfa_nops)) {
+    if(dwarf_frame_cfa(rule->frame, &cfa_ops, &cfa_nops)) {
         pst_log(SEVERITY_ERROR, "Failed to get CFA for frame");
         return false;
     }
 
     fn->ctx->print_expr(fn->ctx, cfa_ops, cfa_nops, NULL);
 
+    // rule may be evicted by the next lookup, so context refers to its frame only while CFA is evaluated
+    fn->ctx->frame = rule->frame;
+
     bool nret = true;
     pst_decl(pst_dwarf_stack, stack, fn->ctx);
     if(pst_dwarf_stack_calc(&stack, cfa_ops, cfa_nops, NULL, NULL) && pst_dwarf_stack_get_value(&stack, &fn->info.cfa)) {
@@ -85,6 +78,7 @@ static bool get_frame(pst_function* fn)
     }
 
     pst_dwarf_stack_fini(&stack);
+    fn->ctx->frame = NULL;
 
     return nret;
 }
@@ -92,6 +86,11 @@ static bool get_frame(pst_function* fn)
 static pst_parameter* add_param(pst_function* fn)
 {
     pst_new(pst_parameter, p, fn->ctx);
+    if(!p) {
+        pst_log(SEVERITY_ERROR, "Failed to allocate parameter of function %s(...)", fn->info.name);
+        return NULL;
+    }
+
     list_add_bottom(&fn->params, &p->node);
 
     return p;
@@ -146,7 +145,7 @@ static bool handle_lexical_block(pst_function* fn, Dwarf_Die* result)
                     break;
                 case DW_TAG_variable: {
                     pst_parameter* param = add_param(fn);
-                    if(!parameter_handle_dwarf(param, &child, fn)) {
+                    if(param && !parameter_handle_dwarf(param, &child, fn)) {
                         del_param(param);
                     }
                     break;
@@ -155,7 +154,7 @@ static bool handle_lexical_block(pst_function* fn, Dwarf_Die* result)
                     pst_call_site_storage_handle_dwarf(&fn->call_sites, &child, fn);
                     break;
                 case DW_TAG_inlined_subroutine:
-                    pst_log(SEVERITY_DEBUG, "Skipping Lexical block tag 'DW_TAG_inlined_subroutine'");
+                    // functions inlined at PC are handled as separate virtual frames
                     break;
                 default:
                     pst_log(SEVERITY_WARNING, "Unknown Lexical block tag 0x%X", dwarf_tag(&child));
@@ -167,6 +166,59 @@ static bool handle_lexical_block(pst_function* fn, Dwarf_Die* result)
     return true;
 }
 
+// handle parameters, local variables and call sites of the function
+static bool handle_children(pst_function* fn)
+{
+    Dwarf_Die result;
+    if(dwarf_child(fn->die, &result) != 0)
+        return false;
+
+    // went through parameters and local variables of the function
+    do {
+        switch (dwarf_tag(&result)) {
+            case DW_TAG_formal_parameter:
+            case DW_TAG_variable: {
+                pst_parameter* param = add_param(fn);
+                if(param && !parameter_handle_dwarf(param, &result, fn)) {
+                    del_param(param);
+                }
+
+                break;
+            }
+            case DW_TAG_GNU_call_site:
+                pst_call_site_storage_handle_dwarf(&fn->call_sites, &result, fn);
+                break;
+
+            case DW_TAG_inlined_subroutine:
+                // functions inlined at PC are handled as separate virtual frames
+                break;
+            case DW_TAG_lexical_block: {
+                handle_lexical_block(fn, &result);
+                break;
+            }
+            case DW_TAG_unspecified_parameters: {
+                pst_parameter* param = add_param(fn);
+                if(!param) {
+                    break;
+                }
+
+                param->info.flags |= PARAM_TYPE_UNSPEC;
+                param->info.name = pst_strdup("...");
+                break;
+            }
+
+            // Also handle:
+            // DW_AT_inline
+            default:
+                pst_log(SEVERITY_WARNING, "Unknown TAG of function: 0x%X", dwarf_tag(&result));
+                break;
+        }
+    } while(dwarf_siblingof(&result, &result) == 0);
+
+    return true;
+}
+
+
 pst_parameter* function_next_parameter(pst_function* fn, pst_parameter* p)
 {
     struct list_node* n = (p == NULL) ? list_first(&fn->params) : list_next(&p->node);
@@ -256,6 +308,7 @@ bool function_print_pretty(pst_function* fn)
 bool function_handle_dwarf(pst_function * fn, Dwarf_Die* d)
 {
     fn->die = d;
+    fn->offset = dwarf_dieoffset(d);
     get_frame(fn);
 
     Dwarf_Attribute attr_mem;
@@ -308,14 +361,19 @@ bool function_handle_dwarf(pst_function * fn, Dwarf_Die* d)
 
     // Get reference to return attribute type of the function
     // may be to use dwfl_module_return_value_location() instead
-    pst_parameter* ret_p = add_param(fn); ret_p->info.flags |= PARAM_RETURN;
+    pst_parameter* ret_p = add_param(fn);
+    if(!ret_p) {
+        return false;
+    }
+
+    ret_p->info.flags |= PARAM_RETURN;
     if(dwarf_hasattr(fn->die, DW_AT_type)) {
         if(!parameter_handle_type(ret_p, fn->die)) {
             pst_log(SEVERITY_ERROR, "Failed to handle return parameter type for function %s(...)", fn->info.name);
             del_param(ret_p);
         }
     } else {
-        parameter_add_type(ret_p, "void", PARAM_TYPE_VOID);
+        parameter_set_type(ret_p, &pst_type_void);
     }
 
     // handle and save additionally these attributes:
@@ -334,89 +392,58 @@ bool function_handle_dwarf(pst_function * fn, Dwarf_Die* d)
     //      any one of them may be the starting subroutine of the program.
 
 
-    Dwarf_Die result;
-    if(dwarf_child(fn->die, &result) != 0)
-        return false;
+    return handle_children(fn);
+}
 
-    // went through parameters and local variables of the function
-    do {
-        switch (dwarf_tag(&result)) {
-            case DW_TAG_formal_parameter:
-            case DW_TAG_variable: {
-                pst_parameter* param = add_param(fn);
-                if(!parameter_handle_dwarf(param, &result, fn)) {
-                    del_param(param);
-                }
+// handle DW_TAG_inlined_subroutine DIE of virtual frame. such frame shares registers, CFA and frame base with the physical frame
+// of the function which it was inlined into, so there is no CFI and DW_AT_frame_base to handle
+bool function_handle_inlined(pst_function* fn, Dwarf_Die* d)
+{
+    fn->die = d;
+    fn->offset = dwarf_dieoffset(d);
 
-                break;
-            }
-            case DW_TAG_GNU_call_site:
-                pst_call_site_storage_handle_dwarf(&fn->call_sites, &result, fn);
-                break;
+    // return type is declared in abstract origin of inlined function
+    Dwarf_Attribute attr_mem;
+    Dwarf_Die origin;
+    Dwarf_Die* decl = d;
+    if(dwarf_formref_die(dwarf_attr(d, DW_AT_abstract_origin, &attr_mem), &origin)) {
+        decl = &origin;
+    }
 
-                //              case DW_TAG_inlined_subroutine:
-                //                  /* Recurse further down */
-                //                  HandleFunction(&result);
-                //                  break;
-            case DW_TAG_lexical_block: {
-                handle_lexical_block(fn, &result);
-                break;
-            }
-            case DW_TAG_unspecified_parameters: {
-                pst_parameter* param = add_param(fn);
-                param->info.flags |= PARAM_TYPE_UNSPEC;
-                param->info.name = pst_strdup("...");
-                break;
-            }
+    pst_parameter* ret_p = add_param(fn);
+    if(!ret_p) {
+        return false;
+    }
 
-            // Also handle:
-            // DW_AT_inline
-            default:
-                pst_log(SEVERITY_WARNING, "Unknown TAG of function: 0x%X", dwarf_tag(&result));
-                break;
+    ret_p->info.flags |= PARAM_RETURN;
+    if(dwarf_hasattr(decl, DW_AT_type)) {
+        if(!parameter_handle_type(ret_p, decl)) {
+            pst_log(SEVERITY_ERROR, "Failed to handle return parameter type for inlined function %s(...)", fn->info.name);
+            del_param(ret_p);
         }
-    } while(dwarf_siblingof(&result, &result) == 0);
+    } else {
+        parameter_set_type(ret_p, &pst_type_void);
+    }
 
-    return true;
+    return handle_children(fn);
 }
 
 bool function_unwind(pst_function* fn)
 {
-    Dwfl_Line *dwline = dwfl_getsrc(fn->ctx->dwfl, fn->info.pc);
-    if(dwline != NULL) {
-        const char* filename = dwfl_lineinfo (dwline, &fn->info.pc, &fn->info.line, NULL, NULL, NULL);
-        if(filename) {
-            const char* file = strrchr(filename, '/');
-            if(file && *file != 0) {
-                file++;
-            } else {
-                file = filename;
-            }
-            fn->info.file = pst_strdup(file);
-        }
+    if(!fn->ctx->session) {
+        // session wasn't locked, so frame is printed by its PC only
+        fn->info.name = NULL;
+        fn->info.file = NULL;
+        fn->info.line = -1;
+        return true;
     }
 
-    Dwfl_Module* module = dwfl_addrmodule(fn->ctx->dwfl, fn->info.pc);
-    const char* addrname = dwfl_module_addrname(module, fn->info.pc);
-    if(addrname) {
-        char* demangle_name = cplus_demangle(addrname, 0);
-        char* function_name = NULL;
-        if(asprintf(&function_name, "%s%s", demangle_name ? demangle_name : addrname, demangle_name ? "" : "()") == -1) {
-            pst_log(SEVERITY_ERROR, "Failed to allocate memory");
-            return false;
-        }
-
-        char* str = strchr(function_name, '(');
-        if(str) {
-            *str = 0;
-        }
-        fn->info.name = pst_strdup(function_name);
-        free(function_name);
-
-        if(demangle_name) {
-            free(demangle_name);
-        }
-    }
+    // names are interned by session's cache, so they are valid while handler holds the session
+    pst_symbol sym;
+    pst_symbol_cache_resolve(&fn->ctx->session->symbols, fn->ctx->dwfl, fn->info.pc, &sym, fn->ctx->signal);
+    fn->info.name = (char*)sym.name;
+    fn->info.file = (char*)sym.file;
+    fn->info.line = sym.line;
 
     return true;
 }
@@ -438,12 +465,12 @@ void pst_function_init(pst_function* fn, pst_context* _ctx, pst_function* _paren
     // internal fields
     bzero(&fn->context, sizeof(fn->context));
     fn->die = NULL;
+    fn->offset = 0;
     list_head_init(&fn->params);
     pst_call_site_storage_init(&fn->call_sites, _ctx);
 
     memcpy(&fn->context, &_ctx->cursor, sizeof(fn->context));
     fn->parent = _parent;
-    fn->frame = NULL;
     fn->ctx = _ctx;
     fn->allocated = false;
 }
@@ -463,19 +490,6 @@ void pst_function_fini(pst_function* fn)
 {
     clear(fn);
 
-    if(fn->frame) {
-        // use free() here because it was allocated out of our control by libdw
-        free(fn->frame);
-    }
-
-    if(fn->info.name) {
-        pst_free(fn->info.name);
-    }
-
-    if(fn->info.file) {
-        pst_free(fn->info.file);
-    }
-
     if(fn->allocated) {
         pst_free(fn);
     }
@@ -24,11 +24,11 @@
 typedef struct pst_function {
     list_node               node;       // uplink
     Dwarf_Die*              die;        // DWARF DIE containing definition of the function
+    Dwarf_Off               offset;     // offset of 'die', identifies function in binary record
     pst_function_info       info;       // information about the function itself
     list_head               params;     // parameters of the function
     pst_call_site_storage   call_sites; // call-sites of the function
     pst_function*           parent;     // parent function in call trace (caller)
-    Dwarf_Frame*            frame;      // function's stack frame
     pst_context*            ctx;        // context of unwinding
     unw_cursor_t            context;    ///< Function's frame including register's values
     bool                    allocated;  // whether this object was allocated or not
@@ -39,6 +39,7 @@ void pst_function_fini(pst_function* fn);
 
 bool function_unwind(pst_function* fn);
 bool function_handle_dwarf(pst_function * fn, Dwarf_Die* d);
+bool function_handle_inlined(pst_function* fn, Dwarf_Die* d);
 bool function_print_pretty(pst_function* fn);
 void function_print_simple(pst_function* fn);
 
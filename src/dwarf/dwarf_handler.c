@@ -19,6 +19,9 @@
 #include <dlfcn.h>
 
 #include "dwarf_handler.h"
+#include "session.h"
+#include "registry.h"
+#include "maps.h"
 
 
 #define USE_LIBUNWIND
@@ -38,6 +41,8 @@
 // dwarf_getattrs() allows to enumerate all DIE attributes
 // dwarf_getfuncs() allows to enumerate functions within CU
 
+static void add_inlined(pst_handler* h, pst_function* fun, const pst_unit_index* unit, int32_t idx);
+
 bool get_dwarf_function(pst_handler* h, pst_function* fun)
 {
     Dwarf_Addr mod_cu = 0;
@@ -55,27 +60,39 @@ bool get_dwarf_function(pst_handler* h, pst_function* fun)
     	return false;
     }
 
+    // the innermost out-of-line function containing PC, the ones inlined into it are added as virtual frames
+    const pst_unit_index* unit = pst_function_index_unit(&h->session->functions, cdie);
+    int32_t inner = pst_unit_index_find(unit, fun->info.pc - mod_cu);
+    int32_t idx = inner;
+    while(idx >= 0 && unit->ranges[idx].inlined) {
+        idx = unit->ranges[idx].parent;
+    }
+
+    if(idx < 0) {
+        pst_log(SEVERITY_INFO, "Failed to find function DIE for address %#lX in CU %s", fun->info.pc, dwarf_diename(cdie));
+        return false;
+    }
+
     Dwarf_Die result;
-	if(dwarf_child(cdie, &result)) {
-	    pst_log(SEVERITY_ERROR, "No child DIE found for CU %s", dwarf_diename(cdie));
-		return false;
-	}
-
-	do {
-		int tag = dwarf_tag(&result);
-		if(tag == DW_TAG_subprogram || tag == DW_TAG_entry_point || tag == DW_TAG_inlined_subroutine) {
-			if(!strcmp(fun->info.name, dwarf_diename(&result))) {
-				return function_handle_dwarf(fun, &result);
-			}
-		}
-	} while(dwarf_siblingof(&result, &result) == 0);
-
-	return false;
+    if(!dwarf_offdie(unit->dwarf, unit->ranges[idx].offset, &result)) {
+        pst_log(SEVERITY_ERROR, "Failed to get function DIE at offset %#lX", unit->ranges[idx].offset);
+        return false;
+    }
+
+    bool ret = function_handle_dwarf(fun, &result);
+    add_inlined(h, fun, unit, inner);
+
+    return ret;
 }
 
 static pst_function* add_function(pst_handler* h, pst_function* parent)
 {
     pst_new(pst_function, fn, &h->ctx, parent);
+    if(!fn) {
+        pst_log(SEVERITY_ERROR, "Failed to allocate function of stack trace");
+        return NULL;
+    }
+
     list_add_bottom(&h->functions, &fn->node);
 
     return fn;
@@ -129,10 +146,96 @@ static pst_function* last_function(pst_handler* h)
     return NULL;
 }
 
+// add virtual frames of functions inlined at PC of the physical frame just before it, the innermost one goes first
+static void add_inlined(pst_handler* h, pst_function* fun, const pst_unit_index* unit, int32_t idx)
+{
+    // source line of PC is executed by the innermost inlined function, and each enclosing one executes the call of the previous one
+    char* file = fun->info.file;
+    int line = fun->info.line;
+    pst_function* callee = prev_function(h, fun);
+    bool inlined = false;
+
+    for(; idx >= 0 && unit->ranges[idx].inlined; idx = unit->ranges[idx].parent) {
+        const pst_function_range* r = &unit->ranges[idx];
+
+        pst_new(pst_function, fn, &h->ctx, fun);
+        if(!fn) {
+            pst_log(SEVERITY_ERROR, "Failed to allocate inlined function of stack trace");
+            break;
+        }
+
+        list_add_before(&fun->node, &fn->node);
+        if(callee) {
+            callee->parent = fn;
+        }
+        callee = fn;
+        inlined = true;
+
+        // virtual frame shares registers and CFA with the physical one
+        memcpy(&fn->context, &fun->context, sizeof(fn->context));
+        fn->info.pc = fun->info.pc;
+        fn->info.sp = fun->info.sp;
+        fn->info.cfa = fun->info.cfa;
+        fn->info.lowpc = r->start;
+        fn->info.highpc = r->end;
+        fn->info.name = (char*)r->name;
+        fn->info.file = file;
+        fn->info.line = line;
+        fn->info.flags |= IS_INLINED;
+
+        file = (char*)r->call_file;
+        line = r->call_line;
+
+        Dwarf_Die die;
+        if(dwarf_offdie(unit->dwarf, r->offset, &die)) {
+            function_handle_inlined(fn, &die);
+        } else {
+            pst_log(SEVERITY_ERROR, "Failed to get inlined function DIE at offset %#lX", r->offset);
+        }
+    }
+
+    if(inlined) {
+        fun->info.file = file;
+        fun->info.line = line;
+    }
+}
+
+// remove virtual frames of inlined functions added by previous handling of DWARF, so that they aren't duplicated
+static void del_inlined(pst_handler* h)
+{
+    bool removed = false;
+    pst_function*  fn = NULL;
+    struct list_node  *pos, *tn;
+    list_for_each_entry_safe(fn, pos, tn, &h->functions, node) {
+        if(fn->info.flags & IS_INLINED) {
+            del_function(fn);
+            removed = true;
+        }
+    }
+
+    if(!removed) {
+        return;
+    }
+
+    // restore links to callers and source lines of physical frames
+    for(fn = pst_handler_next_function(h, NULL); fn; fn = pst_handler_next_function(h, fn)) {
+        fn->parent = pst_handler_next_function(h, fn);
+        function_unwind(fn);
+    }
+}
+
+static bool handler_unwind(pst_handler* h, pst_unwinder unwinder);
+
 bool pst_handler_handle_dwarf(pst_handler* h)
 {
+    if(h->unwinder != UNWINDER_LIBUNWIND || !h->ctx.session) {
+        // frames unwound without libunwind have no registers needed to evaluate DWARF expressions, and frames unwound without session
+        // have no names, so unwind once again
+        clear(h);
+    }
+
     if(!h->functions.count) {
-        if(!pst_handler_unwind_simple(h)) {
+        if(!handler_unwind(h, UNWINDER_LIBUNWIND) || !h->ctx.session) {
             return false;
         }
     }
@@ -140,8 +243,22 @@ bool pst_handler_handle_dwarf(pst_handler* h)
     h->ctx.clean_print(&h->ctx);
     Dl_info info;
 
+    // pointers of parameters are checked against mappings as they are at the moment of capture
+    pst_maps_refresh();
+    h->ctx.budget = PST_MEMBERS_BUDGET;
+
+    if(!pst_session_lock(h->session, h->ctx.signal)) {
+        return false;
+    }
+    del_inlined(h);
+
     //for(pst_function* fun = next_function(NULL); fun; fun = next_function(fun)) {
     for(pst_function* fun = last_function(h); fun; fun = prev_function(h, fun)) {
+        if(fun->info.flags & IS_INLINED) {
+            // virtual frame just added for the physical one
+            continue;
+        }
+
         dladdr((void*)(fun->info.pc), &info);
         pst_log(SEVERITY_INFO, "Function %s(...): module name: %s, base address: %p, CFA: %#lX",
                 fun->info.name, info.dli_fname, info.dli_fbase, fun->parent ? fun->parent->info.sp : 0);
@@ -155,47 +272,113 @@ bool pst_handler_handle_dwarf(pst_handler* h)
 
         get_dwarf_function(h, fun);
     }
+    pst_session_unlock(h->session);
 
     return true;
 }
 
-const char* pst_print_pretty(pst_handler* h)
+static void print_trace(pst_handler* h, bool pretty)
 {
-    h->ctx.clean_print(&h->ctx);
     uint32_t idx = 0;
     for(pst_function* fn = pst_handler_next_function(h, NULL); fn; fn = pst_handler_next_function(h, fn)) {
         h->ctx.print(&h->ctx, "[%-2u] ", idx); idx++;
-        function_print_pretty(fn);
-        h->ctx.print(&h->ctx, "\n");
+        if(pretty) {
+            function_print_pretty(fn);
+            h->ctx.print(&h->ctx, "\n");
+        } else {
+            function_print_simple(fn);
+        }
     }
+}
+
+const char* pst_print_pretty(pst_handler* h)
+{
+    h->ctx.clean_print(&h->ctx);
+    print_trace(h, true);
 
     return h->ctx.buff;
 }
 
-char *debuginfo_path = NULL;
-Dwfl_Callbacks callbacks = {
-        .find_elf           = dwfl_linux_proc_find_elf,
-        .find_debuginfo     = dwfl_standard_find_debuginfo,
-        .section_address    = dwfl_offline_section_address,
-        .debuginfo_path     = &debuginfo_path,
-};
-
 #include <dlfcn.h>
 const char* pst_print_simple(pst_handler* h)
 {
     h->ctx.clean_print(&h->ctx);
-    uint32_t idx = 0;
-    for(pst_function* fn = pst_handler_next_function(h, NULL); fn; fn = pst_handler_next_function(h, fn)) {
-        h->ctx.print(&h->ctx, "[%-2u] ", idx);
-        function_print_simple(fn);
-        idx++;
-    }
+    print_trace(h, false);
 
     return h->ctx.buff;
 }
 
+// stream stack trace to the sink, so it isn't limited by size of context's buffer
+bool pst_handler_print(pst_handler* h, pst_sink* sink, bool pretty)
+{
+    h->ctx.sink = sink;
+    print_trace(h, pretty);
+    h->ctx.sink = NULL;
 
-bool pst_handler_unwind_simple(pst_handler* h)
+    return pst_sink_flush(sink);
+}
+
+
+// add function of the frame to the end of stack trace
+static void add_frame(pst_handler* h, Dwarf_Addr pc, Dwarf_Addr sp)
+{
+    pst_function* last = last_function(h);
+    pst_function* fn = add_function(h, NULL);
+    if(!fn) {
+        return;
+    }
+
+    fn->info.pc = pc; fn->info.sp = sp;
+    if(!function_unwind(fn)) {
+        del_function(fn);
+    } else if(last) {
+        last->parent = fn;
+    }
+}
+
+static void unwind_libunwind(pst_handler* h, void* caller)
+{
+    unw_getcontext(&h->ctx.context);
+    unw_init_local(&h->ctx.cursor, &h->ctx.context);
+    for(int i = 0, skip = 1; unw_step(&h->ctx.cursor) > 0; ++i) {
+        Dwarf_Addr pc, sp;
+        if(unw_get_reg(&h->ctx.cursor, UNW_REG_IP,  &pc)) {
+            pst_log(SEVERITY_DEBUG, "Failed to get IP value");
+            continue;
+        }
+
+        if(unw_get_reg(&h->ctx.cursor, UNW_REG_SP,  &sp)) {
+            pst_log(SEVERITY_DEBUG, "Failed to get SP value");
+            continue;
+        }
+
+        if(caller) {
+            if(pc == (uint64_t)caller) {
+                skip = 0;
+            } else if(skip) {
+                pst_log(SEVERITY_DEBUG, "Skipping frame #%d: PC = %#lX, SP = %#lX", i, pc, sp);
+                continue;
+            }
+        }
+
+        pst_log(SEVERITY_DEBUG, "Analyze frame #%d: PC = %#lX, SP = %#lX", i, pc, sp);
+        add_frame(h, pc, sp);
+    }
+}
+
+// stack bounds should be already determined by pst_thread_prepare() outside of signal handler, otherwise RBP chain isn't trusted
+static bool unwind_frame_pointer(pst_handler* h)
+{
+    int count = pst_unwind_fp(h->ctx.hcontext, h->frames, PST_MAX_FRAMES);
+    for(int i = 0; i < count; ++i) {
+        pst_log(SEVERITY_DEBUG, "Analyze frame #%d: PC = %#lX, SP = %#lX", i, h->frames[i].pc, h->frames[i].sp);
+        add_frame(h, h->frames[i].pc, h->frames[i].sp);
+    }
+
+    return count > 0;
+}
+
+static bool handler_unwind(pst_handler* h, pst_unwinder unwinder)
 {
     void* caller = NULL;     // pointer to the function which requested to unwind stack
 
@@ -229,63 +412,56 @@ bool pst_handler_unwind_simple(pst_handler* h)
         pst_log(SEVERITY_INFO, "Process address information: PC address: %p, base address: %p, object name: %s", caller, info.dli_fbase, info.dli_fname);
     }
 
-	if(!h->ctx.dwfl) {
-	    h->ctx.dwfl = dwfl_begin(&callbacks);
-	    if(h->ctx.dwfl == NULL) {
-	        pst_log(SEVERITY_ERROR, "Failed to initialize libdw session to parse stack frames");
-	        return false;
-	    }
-
-	    if(dwfl_linux_proc_report(h->ctx.dwfl, getpid()) != 0 || dwfl_report_end(h->ctx.dwfl, NULL, NULL) !=0) {
-	        pst_log(SEVERITY_ERROR, "Failed to parse debug section of executable");
-	        dwfl_end(h->ctx.dwfl);
-	        h->ctx.dwfl = NULL;
-	        return false;
-	    }
-	}
+    // borrow libdw session shared by all handlers instead of parsing modules of the process on each capture
+    if(!h->session) {
+        h->session = pst_session_acquire(h->ctx.signal);
+        if(!h->session) {
+            pst_log(SEVERITY_WARNING, "Failed to get libdw session to parse stack frames, only addresses are available");
+        }
+    }
     pst_log(SEVERITY_INFO, "Stack trace: caller = %p\n", caller);
 
-    unw_getcontext(&h->ctx.context);
-    unw_init_local(&h->ctx.cursor, &h->ctx.context);
-    for(int i = 0, skip = 1; unw_step(&h->ctx.cursor) > 0; ++i) {
-        Dwarf_Addr pc, sp;
-        if(unw_get_reg(&h->ctx.cursor, UNW_REG_IP,  &pc)) {
-            pst_log(SEVERITY_DEBUG, "Failed to get IP value");
-            continue;
-        }
+    // session may be held by the code interrupted by signal or by another crashed thread, then frames are added with raw PCs only
+    bool locked = h->session && pst_session_lock(h->session, h->ctx.signal);
+    h->ctx.dwfl = locked ? h->session->dwfl : NULL;
+    h->ctx.session = locked ? h->session : NULL;
 
-        if(unw_get_reg(&h->ctx.cursor, UNW_REG_SP,  &sp)) {
-            pst_log(SEVERITY_DEBUG, "Failed to get SP value");
-            continue;
-        }
+    if(unwinder != UNWINDER_FRAME_POINTER || !unwind_frame_pointer(h)) {
+        unwind_libunwind(h, caller);
+    }
 
-        if(caller) {
-            if(pc == (uint64_t)caller) {
-                skip = 0;
-            } else if(skip) {
-                pst_log(SEVERITY_DEBUG, "Skipping frame #%d: PC = %#lX, SP = %#lX", i, pc, sp);
-                continue;
-            }
-        }
+    if(locked) {
+        pst_session_unlock(h->session);
+    }
 
-        pst_log(SEVERITY_DEBUG, "Analyze frame #%d: PC = %#lX, SP = %#lX", i, pc, sp);
-        pst_function* last = last_function(h);
-        pst_function* fn = add_function(h, NULL);
-        fn->info.pc = pc; fn->info.sp = sp;
-        if(!function_unwind(fn)) {
-            del_function(fn);
-        } else if(last) {
-            last->parent = fn;
+   return true;
+}
+
+bool pst_handler_unwind_simple(pst_handler* h)
+{
+    return handler_unwind(h, h->unwinder);
+}
+
+// get ID of unwound stack trace in process-wide registry
+uint32_t pst_handler_stack_id(pst_handler* h)
+{
+    uintptr_t pcs[PST_MAX_FRAMES];
+    uint32_t depth = 0;
+    for(pst_function* fn = pst_handler_next_function(h, NULL); fn && depth < PST_MAX_FRAMES; fn = pst_handler_next_function(h, fn)) {
+        if(!(fn->info.flags & IS_INLINED)) {
+            pcs[depth++] = fn->info.pc;
         }
     }
 
-   return true;
+    return pst_registry_intern(pcs, depth);
 }
 
 void pst_handler_init(pst_handler* h, ucontext_t* hctx)
 {
     pst_context_init(&h->ctx, hctx);
     list_head_init(&h->functions);
+    h->session = NULL;
+    h->unwinder = UNWINDER_LIBUNWIND;
     h->allocated = false;
 }
 
@@ -305,5 +481,10 @@ void pst_handler_fini(pst_handler* h)
 {
     clear(h);
     pst_context_fini(&h->ctx);
+
+    if(h->session) {
+        pst_session_release(h->session, h->ctx.signal);
+        h->session = NULL;
+    }
 }
 
@@ -15,10 +15,16 @@
 #include "common.h"
 #include "context.h"
 #include "dwarf_function.h"
+#include "session.h"
+#include "utils/sink.h"
+#include "arch/unwind_fp.h"
 
 typedef struct pst_handler {
 	pst_context	    ctx;		// context of unwinding
 	list_head	    functions;	// list of functions in stack frame
+	pst_session*    session;    // borrowed libdw session shared by all handlers
+	pst_unwinder    unwinder;   // unwinding method of pst_unwind_simple()
+	pst_frame       frames[PST_MAX_FRAMES]; // PC & SP of frames unwound by frame pointers
 	bool            allocated;  // whether this object was allocated or not
 } pst_handler;
 
@@ -29,5 +35,7 @@ void pst_handler_fini(pst_handler* h);
 bool pst_handler_handle_dwarf(pst_handler* h);
 bool pst_handler_unwind_simple(pst_handler* h);
 pst_function* pst_handler_next_function(pst_handler* h, pst_function* fn);
+uint32_t pst_handler_stack_id(pst_handler* h);
+bool pst_handler_print(pst_handler* h, pst_sink* sink, bool pretty);
 
 #endif /* __PST_DWARF_HANDLER_H__ */
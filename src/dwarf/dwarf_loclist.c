@@ -0,0 +1,150 @@
+/*
+ * dwarf_loclist.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "context.h"
+#include "dwarf_loclist.h"
+
+static int compare_locs(const void* a, const void* b)
+{
+    const pst_dwarf_loc* l = (const pst_dwarf_loc*)a;
+    const pst_dwarf_loc* r = (const pst_dwarf_loc*)b;
+
+    if(l->start != r->start) {
+        return l->start < r->start ? -1 : 1;
+    }
+
+    return 0;
+}
+
+// decode location list of the attribute and compile expressions of its entries
+pst_dwarf_loclist* pst_dwarf_loclist_new(pst_allocator* alloc, Dwarf_Attribute* attr)
+{
+    Dwarf_Addr base, start, end;
+    Dwarf_Op* expr;
+    size_t exprlen;
+    ptrdiff_t off = 0;
+
+    uint32_t count = 0;
+    while((off = dwarf_getlocations(attr, off, &base, &start, &end, &expr, &exprlen)) > 0) {
+        count++;
+    }
+
+    pst_dwarf_loclist* l = (pst_dwarf_loclist*)alloc->alloc(alloc, sizeof(pst_dwarf_loclist) + count * sizeof(pst_dwarf_loc));
+    if(!l) {
+        pst_log(SEVERITY_ERROR, "Failed to allocate location list of %u entries", count);
+        return NULL;
+    }
+
+    l->key = attr->valp;
+    l->count = 0;
+
+    off = 0;
+    while(l->count < count && (off = dwarf_getlocations(attr, off, &base, &start, &end, &expr, &exprlen)) > 0) {
+        pst_dwarf_loc* loc = &l->locs[l->count++];
+        loc->start = start;
+        loc->end = end;
+        loc->exprs = expr;
+        loc->expr_len = exprlen;
+
+        // expression which can't be compiled is kept to report that location is known but can't be calculated
+        loc->program = pst_dwarf_program_new(alloc, expr, exprlen, attr);
+    }
+
+    qsort(l->locs, l->count, sizeof(pst_dwarf_loc), compare_locs);
+
+    return l;
+}
+
+void pst_dwarf_loclist_del(pst_allocator* alloc, pst_dwarf_loclist* l)
+{
+    for(uint32_t i = 0; i < l->count; ++i) {
+        if(l->locs[i].program) {
+            pst_dwarf_program_del(alloc, l->locs[i].program);
+        }
+    }
+
+    alloc->free(alloc, l);
+}
+
+// location at PC offset, NULL if there is none. end of range is included, as it was always treated by location handling
+const pst_dwarf_loc* pst_dwarf_loclist_find(const pst_dwarf_loclist* l, Dwarf_Addr offset)
+{
+    // the last location which starts at or before 'offset'
+    uint32_t lo = 0, hi = l->count;
+    while(lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if(l->locs[mid].start <= offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if(lo && offset <= l->locs[lo - 1].end) {
+        return &l->locs[lo - 1];
+    }
+
+    return NULL;
+}
+
+static inline uint32_t hash_key(const unsigned char* key)
+{
+    return (uint32_t)(((uintptr_t)key * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+bool pst_dwarf_loclist_cache_init(pst_dwarf_loclist_cache* c, pst_allocator* alloc)
+{
+    c->alloc = alloc;
+    c->lists = (pst_dwarf_loclist**)alloc->alloc(alloc, PST_DWARF_LOCLIST_CACHE * sizeof(pst_dwarf_loclist*));
+    if(!c->lists) {
+        pst_log(SEVERITY_ERROR, "Failed to allocate location lists cache");
+        return false;
+    }
+    memset(c->lists, 0, PST_DWARF_LOCLIST_CACHE * sizeof(pst_dwarf_loclist*));
+
+    return true;
+}
+
+void pst_dwarf_loclist_cache_fini(pst_dwarf_loclist_cache* c)
+{
+    if(c->lists) {
+        for(uint32_t i = 0; i < PST_DWARF_LOCLIST_CACHE; ++i) {
+            if(c->lists[i]) {
+                pst_dwarf_loclist_del(c->alloc, c->lists[i]);
+            }
+        }
+
+        c->alloc->free(c->alloc, c->lists);
+        c->lists = NULL;
+    }
+}
+
+// get decoded location list of the attribute, decode and cache it in case of miss. list is valid till the next call
+const pst_dwarf_loclist* pst_dwarf_loclist_cache_get(pst_dwarf_loclist_cache* c, Dwarf_Attribute* attr)
+{
+    if(!c->lists) {
+        return NULL;
+    }
+
+    pst_dwarf_loclist** slot = &c->lists[hash_key(attr->valp) & (PST_DWARF_LOCLIST_CACHE - 1)];
+    if(*slot && (*slot)->key == attr->valp) {
+        return *slot;
+    }
+
+    pst_dwarf_loclist* l = pst_dwarf_loclist_new(c->alloc, attr);
+    if(l) {
+        if(*slot) {
+            pst_dwarf_loclist_del(c->alloc, *slot);
+        }
+        *slot = l;
+    }
+
+    return l;
+}
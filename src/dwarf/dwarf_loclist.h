@@ -0,0 +1,60 @@
+/*
+ * dwarf_loclist.h
+ *
+ * Location lists decoded into sorted arrays of compiled expressions
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_DWARF_LOCLIST_H__
+#define __PST_DWARF_LOCLIST_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <elfutils/libdw.h>
+
+#include "utils/allocator.h"
+#include "dwarf_program.h"
+
+#define PST_DWARF_LOCLIST_CACHE (1024)  // number of cached location lists, power of two
+
+// location expression valid for the range of PC offsets
+typedef struct pst_dwarf_loc {
+    Dwarf_Addr              start;      // start of the range
+    Dwarf_Addr              end;        // end of the range
+    Dwarf_Op*               exprs;      // location expression
+    uint32_t                expr_len;   // number of operations in 'exprs'
+    pst_dwarf_program*      program;    // compiled 'exprs', NULL if expression can't be compiled
+} pst_dwarf_loc;
+
+// -----------------------------------------------------------------------------------
+// pst_dwarf_loclist
+// -----------------------------------------------------------------------------------
+// Location list of DW_FORM_sec_offset attribute decoded once with expressions of all entries compiled and sorted by start of range,
+// so location at PC is found by binary search instead of iteration over dwarf_getlocations().
+typedef struct pst_dwarf_loclist {
+    const unsigned char*    key;        // address of attribute's value in debug information, identifies the attribute
+    uint32_t                count;      // number of items in 'locs'
+    pst_dwarf_loc           locs[];     // locations sorted by start of range
+} pst_dwarf_loclist;
+
+pst_dwarf_loclist* pst_dwarf_loclist_new(pst_allocator* alloc, Dwarf_Attribute* attr);
+void pst_dwarf_loclist_del(pst_allocator* alloc, pst_dwarf_loclist* l);
+const pst_dwarf_loc* pst_dwarf_loclist_find(const pst_dwarf_loclist* l, Dwarf_Addr offset);
+
+// -----------------------------------------------------------------------------------
+// pst_dwarf_loclist_cache
+// -----------------------------------------------------------------------------------
+// Direct mapped cache of decoded location lists. Caller must hold session lock.
+typedef struct pst_dwarf_loclist_cache {
+    pst_allocator*          alloc;      // allocator for location lists and their programs
+    pst_dwarf_loclist**     lists;      // location lists indexed by hash of attribute's key
+} pst_dwarf_loclist_cache;
+
+bool pst_dwarf_loclist_cache_init(pst_dwarf_loclist_cache* c, pst_allocator* alloc);
+void pst_dwarf_loclist_cache_fini(pst_dwarf_loclist_cache* c);
+
+const pst_dwarf_loclist* pst_dwarf_loclist_cache_get(pst_dwarf_loclist_cache* c, Dwarf_Attribute* attr);
+
+#endif /* __PST_DWARF_LOCLIST_H__ */
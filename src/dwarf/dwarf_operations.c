@@ -10,7 +10,9 @@
 #include <inttypes.h>
 
 #include "common.h"
+#include "utils/safe_read.h"
 #include "registers.h"
+#include "tls.h"
 #include "dwarf_operations.h"
 
 // not implemented operations
@@ -28,6 +30,24 @@ static bool dw_op_addr(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Wo
 	return true;
 }
 
+// read 'size' bytes at the address, zero extended to the size of generic type. address is taken from registers and memory of the
+// crashed process, so it may be garbage. failure is counted by the stack to mark the value as invalid instead of faulting once again
+static bool read_memory(pst_dwarf_stack* stack, uint64_t addr, uint32_t size, uint64_t* value)
+{
+    if(!size || size > sizeof(*value)) {
+        return false;
+    }
+
+    *value = 0;
+    if(!pst_safe_read(value, addr, size)) {
+        pst_log(SEVERITY_WARNING, "Failed to read %u bytes at address 0x%lX", size, addr);
+        stack->faults++;
+        return false;
+    }
+
+    return true;
+}
+
 // The DW_OP_deref_size operation behaves like the DW_OP_deref operation. In the DW_OP_deref_size operation, however, the size
 // in bytes of the data retrieved from the dereferenced address is specified by the single operand. This operand is a 1-byte unsigned integral constant
 // whose value may not be larger than the size of the generic type. The data
@@ -38,24 +58,9 @@ static bool dw_op_deref_size(pst_dwarf_stack* stack, const dwarf_op_map* map, Dw
 {
     pst_dwarf_value* value = pst_dwarf_stack_pop(stack);
     if(value) {
-        uint64_t addr = value->value.uint64;
         uint64_t res = 0;
-        switch(op1) {
-            case 1:
-                res = *((uint8_t*)addr);
-                break;
-            case 2:
-                res = *((uint16_t*)addr);
-                break;
-            case 4:
-                res = *((uint32_t*)addr);
-                break;
-            case 8:
-                res = *((uint64_t*)addr);
-                break;
-            default:
-                return false;
-                break;
+        if(!read_memory(stack, value->value.uint64, op1, &res)) {
+            return false;
         }
         pst_dwarf_stack_push(stack, &res, sizeof(res), DWARF_TYPE_GENERIC);
         return true;
@@ -143,7 +148,7 @@ static bool dw_op_const_x_s(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwa
 // The single operand of the DW_OP_constu operation provides an unsigned LEB128 integer constant.
 static bool dw_op_constu(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
 {
-	uint64_t value = decode_uleb128((unsigned char*)&op1);
+	uint64_t value = op1;
 	pst_dwarf_stack_push(stack, &value, sizeof(value), DWARF_TYPE_LONG | DWARF_TYPE_UNSIGNED | DWARF_TYPE_CONST | DWARF_TYPE_GENERIC);
 	return true;
 }
@@ -151,7 +156,7 @@ static bool dw_op_constu(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_
 static bool dw_op_consts(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
 {
 	// The single operand of the DW_OP_consts operation provides a signed LEB128 integer constant.
-	int64_t value = decode_sleb128((unsigned char*)&op1);
+	int64_t value = (int64_t)op1;
 	pst_dwarf_stack_push(stack, &value, sizeof(value),  DWARF_TYPE_LONG | DWARF_TYPE_SIGNED | DWARF_TYPE_CONST | DWARF_TYPE_GENERIC);
 	return true;
 }
@@ -168,10 +173,7 @@ static bool dw_op_dup(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Wor
 // The DW_OP_drop operation pops the value (including its type identifier) at the top of the stack.
 static bool dw_op_drop(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
 {
-	pst_dwarf_value* value = pst_dwarf_stack_pop(stack);
-	pst_dwarf_value_fini(value);
-
-	return true;
+	return pst_dwarf_stack_pop(stack) != NULL;
 }
 
 // The DW_OP_over operation duplicates the entry currently second in the stack at the top of the stack.
@@ -201,21 +203,15 @@ static bool dw_op_pick(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Wo
 // entry, and the second entry (including its type identifier) becomes the top of the stack.
 static bool dw_op_swap(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
 {
-	pst_dwarf_value* value1 = pst_dwarf_stack_pop(stack);
-	pst_dwarf_value* value2 = pst_dwarf_stack_pop(stack);
+	pst_dwarf_value* value1 = pst_dwarf_stack_get(stack, 0);
+	pst_dwarf_value* value2 = pst_dwarf_stack_get(stack, 1);
 	if(value1 && value2) {
-	    pst_dwarf_stack_push_value(stack, value1);
-	    pst_dwarf_stack_push_value(stack, value2);
+	    pst_dwarf_value tmp = *value1;
+	    *value1 = *value2;
+	    *value2 = tmp;
 		return true;
 	}
 
-	if(value1) {
-	    pst_dwarf_value_fini(value1);
-	}
-	if(value2) {
-	    pst_dwarf_value_fini(value2);
-	}
-
 	return false;
 }
 
@@ -225,26 +221,17 @@ static bool dw_op_swap(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Wo
 // and the third entry (including its type identifier) becomes the second entry
 static bool dw_op_rot(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
 {
-	pst_dwarf_value* value1 = pst_dwarf_stack_pop(stack);
-	pst_dwarf_value* value2 = pst_dwarf_stack_pop(stack);
-	pst_dwarf_value* value3 = pst_dwarf_stack_pop(stack);
+	pst_dwarf_value* value1 = pst_dwarf_stack_get(stack, 0);
+	pst_dwarf_value* value2 = pst_dwarf_stack_get(stack, 1);
+	pst_dwarf_value* value3 = pst_dwarf_stack_get(stack, 2);
 	if(value1 && value2 && value3) {
-	    pst_dwarf_stack_push_value(stack, value1);
-	    pst_dwarf_stack_push_value(stack, value3);
-	    pst_dwarf_stack_push_value(stack, value2);
+	    pst_dwarf_value tmp = *value1;
+	    *value1 = *value2;
+	    *value2 = *value3;
+	    *value3 = tmp;
 		return true;
 	}
 
-    if(value1) {
-        pst_dwarf_value_fini(value1);
-    }
-    if(value2) {
-        pst_dwarf_value_fini(value2);
-    }
-    if(value3) {
-        pst_dwarf_value_fini(value3);
-    }
-
 	return false;
 }
 
@@ -275,8 +262,6 @@ static bool dw_op_and(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Wor
 		pst_dwarf_stack_pop(stack); pst_dwarf_stack_pop(stack);
 		pst_dwarf_stack_push(stack, &res, sizeof(res), DWARF_TYPE_GENERIC);
 
-		pst_dwarf_value_fini(value1);
-		pst_dwarf_value_fini(value2);
 		return true;
 	}
 
@@ -474,11 +459,9 @@ static bool dw_op_or(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word
 		}
 
 		uint64_t res = value2->value.uint64 | value1->value.uint64;
+		int type = value1->type;
         pst_dwarf_stack_pop(stack); pst_dwarf_stack_pop(stack);
-		pst_dwarf_stack_push(stack, &res, sizeof(res), value1->type);
-
-		pst_dwarf_value_fini(value1);
-		pst_dwarf_value_fini(value2);
+		pst_dwarf_stack_push(stack, &res, sizeof(res), type);
 
 		return true;
 	}
@@ -496,19 +479,19 @@ static bool dw_op_plus(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Wo
 			return false;
 		}
 
+		// operands are replaced by the result
+		pst_sized_value res;
+		int type = value1->type;
 		if((value1->type & DWARF_TYPE_SIGNED) && (value2->type & DWARF_TYPE_SIGNED)) {
-		        int64_t res = value2->value.int64 + value1->value.int64;
-		        pst_dwarf_stack_push(stack, &res, sizeof(res), value1->type);
+		        res.int64 = value2->value.int64 + value1->value.int64;
 		} else {
 		    // if in arithmetic expression even one operand is unsigned then result is unsigned as well
-		    int type = (value1->type & (~DWARF_TYPE_SIGNED)) | DWARF_TYPE_UNSIGNED;
-		    uint64_t res = value2->value.uint64 + value1->value.uint64;
-		    pst_dwarf_stack_push(stack, &res, sizeof(res), type);
+		    type = (value1->type & (~DWARF_TYPE_SIGNED)) | DWARF_TYPE_UNSIGNED;
+		    res.uint64 = value2->value.uint64 + value1->value.uint64;
 		}
 
         pst_dwarf_stack_pop(stack); pst_dwarf_stack_pop(stack);
-        pst_dwarf_value_fini(value1);
-        pst_dwarf_value_fini(value2);
+        pst_dwarf_stack_push(stack, &res, sizeof(res), type);
 
         return true;
 	}
@@ -524,8 +507,7 @@ static bool dw_op_plus_uconst(pst_dwarf_stack* stack, const dwarf_op_map* map, D
 {
 	pst_dwarf_value* value = pst_dwarf_stack_get(stack, 0);
 	if(value) {
-	    uint64_t op = decode_uleb128((unsigned char*)&op1);
-	    value->value.uint64 += op;
+	    value->value.uint64 += op1;
 
 		return true;
 	}
@@ -544,7 +526,7 @@ static bool dw_op_reg_x(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_W
 
 	uint64_t regno = 0;
 	if(map->op_num == DW_OP_regx) {
-		regno = decode_uleb128((unsigned char*)&op1);
+		regno = op1;
 	} else {
 		regno = map->op_num - DW_OP_reg0;
 	}
@@ -565,11 +547,11 @@ static bool dw_op_breg_x(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_
 
 	int regno = -1; int64_t off = 0;
 	if(map->op_num == DW_OP_bregx) {
-		regno = decode_uleb128((unsigned char*)&op1);
-		off = decode_sleb128((unsigned char*)&op2);
+		regno = op1;
+		off = (int64_t)op2;
 	} else {
 		regno = find_regnum(map->op_num);
-		off = decode_sleb128((unsigned char*)&op1);
+		off = (int64_t)op1;
 	}
 
 	unw_word_t val = 0;
@@ -642,7 +624,7 @@ static bool dw_op_fbreg(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_W
 //    }
 
     sp = stack->ctx->cfa;
-    int64_t off = decode_sleb128((unsigned char*)&op1);
+    int64_t off = (int64_t)op1;
     sp += off;
 
     pst_dwarf_stack_push(stack, &sp, sizeof(sp), DWARF_TYPE_MEMORY_LOC | DWARF_TYPE_GENERIC);
@@ -650,191 +632,485 @@ static bool dw_op_fbreg(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_W
     return true;
 }
 
-// DWARF Operations to code & name mapping
-dwarf_op_map op_map[] = {
-		{DW_OP_addr, 		"DW_OP_addr", 		dw_op_addr},
-		{DW_OP_deref, 		"DW_OP_deref", 		dw_op_deref},
-		// Constant operations
-		{DW_OP_const1u, 	"DW_OP_const1u", 	dw_op_const_x_u},
-		{DW_OP_const1s, 	"DW_OP_const1s", 	dw_op_const_x_s},
-		{DW_OP_const2u, 	"DW_OP_const2u", 	dw_op_const_x_u},
-		{DW_OP_const2s, 	"DW_OP_const2s", 	dw_op_const_x_s},
-		{DW_OP_const4u, 	"DW_OP_const4u", 	dw_op_const_x_u},
-		{DW_OP_const4s, 	"DW_OP_const4s", 	dw_op_const_x_s},
-		{DW_OP_const8u, 	"DW_OP_const8u", 	dw_op_const_x_u},
-		{DW_OP_const8s, 	"DW_OP_const8s", 	dw_op_const_x_s},
-		{DW_OP_constu,  	"DW_OP_constu",  	dw_op_constu},
-		{DW_OP_consts,  	"DW_OP_consts",  	dw_op_consts},
-		// DWARF expression stack operations
-		{DW_OP_dup,     	"DW_OP_dup",     	dw_op_dup},
-		{DW_OP_drop,    	"DW_OP_drop",    	dw_op_drop},
-		{DW_OP_over,    	"DW_OP_over",    	dw_op_over},
-		{DW_OP_pick,		"DW_OP_pick",		dw_op_pick},
-		{DW_OP_swap,		"DW_OP_swap",		dw_op_swap},
-		{DW_OP_rot,			"DW_OP_rot",		dw_op_rot},
-		{DW_OP_xderef, 		"DW_OP_xderef",		dw_op_notimpl},
-		// Arithmetic and Logical Operations
-		{DW_OP_abs,			"DW_OP_abs",		dw_op_abs},
-		{DW_OP_and, 		"DW_OP_and",		dw_op_and},
-		{DW_OP_div,			"DW_OP_div",		dw_op_div},
-		{DW_OP_minus,		"DW_OP_minus",		dw_op_minus},
-		{DW_OP_mod,			"DW_OP_mod",		dw_op_mod},
-		{DW_OP_mul,			"DW_OP_mul",		dw_op_mul},
-		{DW_OP_neg, 		"DW_OP_neg",		dw_op_neg},
-		{DW_OP_not,			"DW_OP_not", 		dw_op_not},
-		{DW_OP_or,			"DW_OP_or",			dw_op_or},
-		{DW_OP_plus,		"DW_OP_plus",		dw_op_plus},
-		{DW_OP_plus_uconst, "DW_OP_plus_uconst",dw_op_plus_uconst},
-		// not implemented for now
-		{DW_OP_shl,			"DW_OP_shl",		dw_op_notimpl},
-		{DW_OP_shr,			"DW_OP_shr", 		dw_op_notimpl},
-		{DW_OP_shra,		"DW_OP_shra",		dw_op_notimpl},
-		{DW_OP_xor,			"DW_OP_xor",		dw_op_notimpl},
-		{DW_OP_bra,			"DW_OP_bra",		dw_op_notimpl},
-		{DW_OP_eq,			"DW_OP_eq",			dw_op_notimpl},
-		{DW_OP_ge,			"DW_OP_ge",			dw_op_notimpl},
-		{DW_OP_gt, 			"DW_OP_gt",			dw_op_notimpl},
-		{DW_OP_le,			"DW_OP_le",			dw_op_notimpl},
-		{DW_OP_lt,			"DW_OP_lt",			dw_op_notimpl},
-		{DW_OP_ne,			"DW_OP_ne",			dw_op_notimpl},
-		{DW_OP_skip,		"DW_OP_skip",		dw_op_notimpl},
-		// DWARF5 2.5.1.1 Literal Encodings
-		{DW_OP_lit0,		"DW_OP_lit0",		dw_op_lit_x},
-		{DW_OP_lit1,		"DW_OP_lit1",		dw_op_lit_x},
-		{DW_OP_lit2,		"DW_OP_lit2",		dw_op_lit_x},
-		{DW_OP_lit3,		"DW_OP_lit3",		dw_op_lit_x},
-		{DW_OP_lit4,		"DW_OP_lit4",		dw_op_lit_x},
-		{DW_OP_lit5,		"DW_OP_lit5",		dw_op_lit_x},
-		{DW_OP_lit6,		"DW_OP_lit6",		dw_op_lit_x},
-		{DW_OP_lit7,		"DW_OP_lit7",		dw_op_lit_x},
-		{DW_OP_lit8,		"DW_OP_lit8",		dw_op_lit_x},
-		{DW_OP_lit9,		"DW_OP_lit9",		dw_op_lit_x},
-		{DW_OP_lit10,		"DW_OP_lit10",		dw_op_lit_x},
-		{DW_OP_lit11,		"DW_OP_lit11",		dw_op_lit_x},
-		{DW_OP_lit12,		"DW_OP_lit12",		dw_op_lit_x},
-		{DW_OP_lit13,		"DW_OP_lit13",		dw_op_lit_x},
-		{DW_OP_lit14,		"DW_OP_lit14",		dw_op_lit_x},
-		{DW_OP_lit15,		"DW_OP_lit15",		dw_op_lit_x},
-		{DW_OP_lit16,		"DW_OP_lit16",		dw_op_lit_x},
-		{DW_OP_lit17,		"DW_OP_lit17",		dw_op_lit_x},
-		{DW_OP_lit18,		"DW_OP_lit18",		dw_op_lit_x},
-		{DW_OP_lit19,		"DW_OP_lit19",		dw_op_lit_x},
-		{DW_OP_lit20,		"DW_OP_lit20",		dw_op_lit_x},
-		{DW_OP_lit21,		"DW_OP_lit21",		dw_op_lit_x},
-		{DW_OP_lit22,		"DW_OP_lit22",		dw_op_lit_x},
-		{DW_OP_lit23,		"DW_OP_lit23",		dw_op_lit_x},
-		{DW_OP_lit24,		"DW_OP_lit24",		dw_op_lit_x},
-		{DW_OP_lit25,		"DW_OP_lit25",		dw_op_lit_x},
-		{DW_OP_lit26,		"DW_OP_lit26",		dw_op_lit_x},
-		{DW_OP_lit27,		"DW_OP_lit27",		dw_op_lit_x},
-		{DW_OP_lit28,		"DW_OP_lit28",		dw_op_lit_x},
-		{DW_OP_lit29,		"DW_OP_lit29",		dw_op_lit_x},
-		{DW_OP_lit30,		"DW_OP_lit30",		dw_op_lit_x},
-		{DW_OP_lit31,		"DW_OP_lit31",		dw_op_lit_x},
-		// Register location descriptions. I.e. register containing the value
-		// GP Registers
-		{DW_OP_reg0, 		"DW_OP_reg0",		dw_op_reg_x},
-		{DW_OP_reg1, 		"DW_OP_reg1",		dw_op_reg_x},
-		{DW_OP_reg2, 		"DW_OP_reg2",		dw_op_reg_x},
-		{DW_OP_reg3, 		"DW_OP_reg3",		dw_op_reg_x},
-		{DW_OP_reg4, 		"DW_OP_reg4",		dw_op_reg_x},
-		{DW_OP_reg5, 		"DW_OP_reg5",		dw_op_reg_x},
-		{DW_OP_reg6, 		"DW_OP_reg6",		dw_op_reg_x},
-		{DW_OP_reg7, 		"DW_OP_reg7",		dw_op_reg_x},
-		// Extended GP Registers
-		{DW_OP_reg8, 		"DW_OP_reg8",		dw_op_reg_x},
-		{DW_OP_reg9, 		"DW_OP_reg9",		dw_op_reg_x},
-		{DW_OP_reg10, 		"DW_OP_reg10",		dw_op_reg_x},
-		{DW_OP_reg11, 		"DW_OP_reg11",		dw_op_reg_x},
-		{DW_OP_reg12, 		"DW_OP_reg12",		dw_op_reg_x},
-		{DW_OP_reg13, 		"DW_OP_reg13",		dw_op_reg_x},
-		{DW_OP_reg14, 		"DW_OP_reg14",		dw_op_reg_x},
-		{DW_OP_reg15, 		"DW_OP_reg15",		dw_op_reg_x},
-		{DW_OP_reg16, 		"DW_OP_reg16",		dw_op_reg_x}, // Return Address (RA) mapped to RIP
-		// SSE Vector Registers
-		{DW_OP_reg17, 		"DW_OP_reg17",		dw_op_reg_x},
-		{DW_OP_reg18, 		"DW_OP_reg18",		dw_op_reg_x},
-		{DW_OP_reg19, 		"DW_OP_reg19",		dw_op_reg_x},
-		{DW_OP_reg20, 		"DW_OP_reg20",		dw_op_reg_x},
-		{DW_OP_reg21, 		"DW_OP_reg21",		dw_op_reg_x},
-		{DW_OP_reg22, 		"DW_OP_reg22",		dw_op_reg_x},
-		{DW_OP_reg23, 		"DW_OP_reg23",		dw_op_reg_x},
-		{DW_OP_reg24, 		"DW_OP_reg24",		dw_op_reg_x},
-		{DW_OP_reg25, 		"DW_OP_reg25",		dw_op_reg_x},
-		{DW_OP_reg26, 		"DW_OP_reg26",		dw_op_reg_x},
-		{DW_OP_reg27, 		"DW_OP_reg27",		dw_op_reg_x},
-		{DW_OP_reg28, 		"DW_OP_reg28",		dw_op_reg_x},
-		{DW_OP_reg29, 		"DW_OP_reg29",		dw_op_reg_x},
-		{DW_OP_reg30, 		"DW_OP_reg30",		dw_op_reg_x},
-		{DW_OP_reg31, 		"DW_OP_reg31",		dw_op_reg_x},
-		// Register values. I.e. appropriate register value + offset of operation is pushed onto the stack
-		// GP Registers
-		{DW_OP_breg0,		"DW_OP_breg0", 		dw_op_breg_x},
-		{DW_OP_breg1,		"DW_OP_breg1", 		dw_op_breg_x},
-		{DW_OP_breg2, 		"DW_OP_breg2", 		dw_op_breg_x},
-		{DW_OP_breg3, 		"DW_OP_breg3", 		dw_op_breg_x},
-		{DW_OP_breg4, 		"DW_OP_breg4", 		dw_op_breg_x},
-		{DW_OP_breg5, 		"DW_OP_breg5", 		dw_op_breg_x},
-		{DW_OP_breg6, 		"DW_OP_breg6", 		dw_op_breg_x},
-		{DW_OP_breg7, 		"DW_OP_breg7", 		dw_op_breg_x},
-		// Extended GP Registers
-		{DW_OP_breg8, 		"DW_OP_breg8", 		dw_op_breg_x},
-		{DW_OP_breg9, 		"DW_OP_breg9", 		dw_op_breg_x},
-		{DW_OP_breg10, 		"DW_OP_breg10", 	dw_op_breg_x},
-		{DW_OP_breg11, 		"DW_OP_breg11", 	dw_op_breg_x},
-		{DW_OP_breg12, 		"DW_OP_breg12", 	dw_op_breg_x},
-		{DW_OP_breg13, 		"DW_OP_breg13", 	dw_op_breg_x},
-		{DW_OP_breg14, 		"DW_OP_breg14", 	dw_op_breg_x},
-		{DW_OP_breg15, 		"DW_OP_breg15", 	dw_op_breg_x},
-		{DW_OP_breg16, 		"DW_OP_breg16", 	dw_op_breg_x}, // Return Address (RA) mapped to RIP
-		// SSE Vector Registers
-		{DW_OP_breg17, 		"DW_OP_breg17", 	dw_op_breg_x},
-		{DW_OP_breg18, 		"DW_OP_breg18", 	dw_op_breg_x},
-		{DW_OP_breg19, 		"DW_OP_breg19", 	dw_op_breg_x},
-		{DW_OP_breg20, 		"DW_OP_breg20", 	dw_op_breg_x},
-		{DW_OP_breg21, 		"DW_OP_breg21", 	dw_op_breg_x},
-		{DW_OP_breg22, 		"DW_OP_breg22", 	dw_op_breg_x},
-		{DW_OP_breg23, 		"DW_OP_breg23", 	dw_op_breg_x},
-		{DW_OP_breg24, 		"DW_OP_breg24", 	dw_op_breg_x},
-		{DW_OP_breg25, 		"DW_OP_breg25", 	dw_op_breg_x},
-		{DW_OP_breg26, 		"DW_OP_breg26", 	dw_op_breg_x},
-		{DW_OP_breg27, 		"DW_OP_breg27", 	dw_op_breg_x},
-		{DW_OP_breg28, 		"DW_OP_breg28", 	dw_op_breg_x},
-		{DW_OP_breg29, 		"DW_OP_breg29", 	dw_op_breg_x},
-		{DW_OP_breg30, 		"DW_OP_breg30", 	dw_op_breg_x},
-		{DW_OP_breg31, 		"DW_OP_breg31", 	dw_op_breg_x},
-		// special register-related commands
-		{DW_OP_regx, 		"DW_OP_regx",		dw_op_reg_x},   // 1st operand register name
-		{DW_OP_fbreg, 		"DW_OP_fbreg", 		dw_op_fbreg},   // base is Frame base register there
-		{DW_OP_bregx,		"DW_OP_bregx", 		dw_op_breg_x},  // base is value of 1st operand's register
-
-		// not implemented
-		{DW_OP_piece,               "DW_OP_piece",              dw_op_notimpl},
-		{DW_OP_deref_size,          "DW_OP_deref_size",         dw_op_deref_size},
-		{DW_OP_xderef_size,         "DW_OP_xderef_size",        dw_op_notimpl},
-		{DW_OP_nop,                 "DW_OP_nop",                dw_op_notimpl},
-		{DW_OP_push_object_address, "DW_OP_push_object_address",dw_op_notimpl},
-		{DW_OP_call2,               "DW_OP_call2",              dw_op_notimpl},
-		{DW_OP_call4,               "DW_OP_call4",              dw_op_notimpl},
-		{DW_OP_call_ref,            "DW_OP_call_ref",           dw_op_notimpl},
-		{DW_OP_form_tls_address,    "DW_OP_form_tls_address",   dw_op_notimpl},
-		{DW_OP_call_frame_cfa,      "DW_OP_call_frame_cfa",     dw_op_call_frame_cfa},
-		{DW_OP_bit_piece,           "DW_OP_bit_piece",          dw_op_notimpl},
-		{DW_OP_implicit_value,      "DW_OP_implicit_value",     dw_op_notimpl},
-		{DW_OP_stack_value,         "DW_OP_stack_value",        dw_op_stack_value},
-
-		// GNU extensions
-		// in fact, implementation is at upper layer since this operation contains sub-expression
-		{DW_OP_GNU_entry_value, "DW_OP_GNU_entry_value",        dw_op_notimpl}, // seems that it's equal to DW_OP_entry_value from DWARF 5
+// size in bytes of the value of the type
+static uint32_t type_size(int type)
+{
+    if(type & DWARF_TYPE_CHAR) {
+        return 1;
+    } else if(type & DWARF_TYPE_SHORT) {
+        return 2;
+    } else if(type & DWARF_TYPE_INT) {
+        return 4;
+    }
+
+    return 8;
+}
+
+// DW_OP_shl, DW_OP_shr, DW_OP_shra and DW_OP_xor pop the top two stack entries and push the result of shift of the former second entry
+// by the number of bits specified by the former top of the stack (or bitwise exclusive-or of them). DW_OP_shr fills vacated bits with zero,
+// DW_OP_shra with the sign bit of the former second entry.
+static bool dw_op_bitwise(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
+{
+    pst_dwarf_value* value1 = pst_dwarf_stack_get(stack, 0);
+    pst_dwarf_value* value2 = pst_dwarf_stack_get(stack, 1);
+    if(!value1 || !value2) {
+        return false;
+    }
+
+    uint64_t shift = value1->value.uint64;
+    uint64_t res = 0;
+    switch(map->op_num) {
+        case DW_OP_shl:
+            res = (shift < 64) ? value2->value.uint64 << shift : 0;
+            break;
+        case DW_OP_shr:
+            res = (shift < 64) ? value2->value.uint64 >> shift : 0;
+            break;
+        case DW_OP_shra:
+            res = (uint64_t)(value2->value.int64 >> (shift < 64 ? shift : 63));
+            break;
+        case DW_OP_xor:
+            res = value2->value.uint64 ^ value1->value.uint64;
+            break;
+        default:
+            return false;
+    }
+
+    int type = value2->type;
+    pst_dwarf_stack_pop(stack); pst_dwarf_stack_pop(stack);
+
+    return pst_dwarf_stack_push(stack, &res, sizeof(res), type);
+}
+
+// DW_OP_eq, DW_OP_ge, DW_OP_gt, DW_OP_le, DW_OP_lt and DW_OP_ne pop the top two stack values, compare the former second entry with the
+// former top of the stack and push 1 if the result is true or 0 otherwise. Comparisons are signed unless both values are unsigned.
+static bool dw_op_compare(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
+{
+    pst_dwarf_value* value1 = pst_dwarf_stack_get(stack, 0);
+    pst_dwarf_value* value2 = pst_dwarf_stack_get(stack, 1);
+    if(!value1 || !value2) {
+        return false;
+    }
+
+    int cmp;
+    if((value1->type & DWARF_TYPE_UNSIGNED) && (value2->type & DWARF_TYPE_UNSIGNED)) {
+        cmp = (value2->value.uint64 > value1->value.uint64) - (value2->value.uint64 < value1->value.uint64);
+    } else {
+        cmp = (value2->value.int64 > value1->value.int64) - (value2->value.int64 < value1->value.int64);
+    }
+
+    uint64_t res = 0;
+    switch(map->op_num) {
+        case DW_OP_eq: res = (cmp == 0); break;
+        case DW_OP_ge: res = (cmp >= 0); break;
+        case DW_OP_gt: res = (cmp > 0);  break;
+        case DW_OP_le: res = (cmp <= 0); break;
+        case DW_OP_lt: res = (cmp < 0);  break;
+        case DW_OP_ne: res = (cmp != 0); break;
+        default:
+            return false;
+    }
+
+    pst_dwarf_stack_pop(stack); pst_dwarf_stack_pop(stack);
+
+    return pst_dwarf_stack_push(stack, &res, sizeof(res), DWARF_TYPE_GENERIC);
+}
+
+// The DW_OP_skip operation is an unconditional branch. Its operand is index of the target operation, resolved at compile time.
+static bool dw_op_skip(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
+{
+    stack->next = op1;
+
+    return true;
+}
+
+// The DW_OP_bra operation is a conditional branch. It pops the top of the stack and branches to the target operation
+// if the popped value is not zero.
+static bool dw_op_bra(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
+{
+    pst_dwarf_value* value = pst_dwarf_stack_pop(stack);
+    if(!value) {
+        return false;
+    }
+
+    if(value->value.uint64) {
+        stack->next = op1;
+    }
+
+    return true;
+}
+
+// The DW_OP_nop operation is a place holder. It has no effect on the location stack or any of its values.
+static bool dw_op_nop(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
+{
+    return true;
+}
+
+// The DW_OP_xderef, DW_OP_xderef_size and DW_OP_xderef_type operations behave like their DW_OP_deref counterparts, but pop address space
+// identifier as the second stack entry. Process has the only address space, so identifier is ignored.
+static bool dw_op_xderef(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
+{
+    pst_dwarf_value* value = pst_dwarf_stack_pop(stack);
+    if(!value || !pst_dwarf_stack_pop(stack)) {
+        return false;
+    }
+
+    int type = DWARF_TYPE_GENERIC;
+    uint32_t size = sizeof(uint64_t);
+    if(map->op_num == DW_OP_xderef_size) {
+        size = op1;
+    } else if(map->op_num == DW_OP_xderef_type) {
+        size = op1;
+        type = op2;
+    }
+
+    uint64_t res = 0;
+    if(!read_memory(stack, value->value.uint64, size, &res)) {
+        return false;
+    }
+
+    return pst_dwarf_stack_push(stack, &res, sizeof(res), type);
+}
+
+// The DW_OP_piece and DW_OP_bit_piece operations describe which part of the object is located at the location on the top of the stack.
+// Pieces are assembled into the composite value which is pushed on the stack at the end of the expression.
+// An empty stack means that the piece is optimized out.
+static bool dw_op_piece(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
+{
+    uint32_t bits = (map->op_num == DW_OP_piece) ? op1 * 8 : op1;
+    uint32_t offset = (map->op_num == DW_OP_bit_piece) ? op2 : 0;
+
+    uint64_t value = 0;
+    pst_dwarf_value* v = pst_dwarf_stack_pop(stack);
+    if(v) {
+        if(v->type & DWARF_TYPE_MEMORY_LOC) {
+            uint32_t size = (bits + offset + 7) / 8;
+            if(!read_memory(stack, v->value.uint64, size > sizeof(value) ? sizeof(value) : size, &value)) {
+                return false;
+            }
+        } else {
+            value = v->value.uint64;
+        }
+    }
+
+    value = (offset < 64) ? value >> offset : 0;
+    if(bits < 64) {
+        value &= (1ULL << bits) - 1;
+    }
+    if(stack->piece_bits < 64) {
+        stack->pieces.uint64 |= value << stack->piece_bits;
+    }
+    stack->piece_bits += bits;
+
+    return true;
+}
+
+// The DW_OP_implicit_value operation specifies an immediate value using two operands: length of the value and the block containing it.
+// The operation terminates the expression.
+static bool dw_op_implicit_value(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
+{
+    uint64_t value = 0;
+    memcpy(&value, (void*)op2, op1 > sizeof(value) ? sizeof(value) : op1);
+
+    return pst_dwarf_stack_push(stack, &value, sizeof(value), DWARF_TYPE_GENERIC);
+}
+
+// The DW_OP_form_tls_address (and DW_OP_GNU_push_tls_address) operation pops a value from the stack, which must have an integral type identifier,
+// translates this value into an address in the thread-local storage for a thread, and pushes the address onto the stack.
+// Storage of the current thread of the object containing the function is used. TLS module ID of the object is taken from index built
+// outside of signal handler and storage is found in DTV of the thread, so dynamic loader isn't called
+static bool dw_op_form_tls_address(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
+{
+    pst_dwarf_value* value = pst_dwarf_stack_pop(stack);
+    if(!value) {
+        return false;
+    }
+    uint64_t offset = value->value.uint64;
+
+    unw_word_t pc = 0;
+    if(unw_get_reg(stack->ctx->curr_frame, UNW_REG_IP, &pc)) {
+        return false;
+    }
+
+    uintptr_t addr = 0;
+    if(!pst_tls_address(pc, offset, &addr)) {
+        return false;
+    }
+
+    return pst_dwarf_stack_push(stack, &addr, sizeof(addr), DWARF_TYPE_MEMORY_LOC | DWARF_TYPE_GENERIC);
+}
+
+// The DW_OP_const_type operation pushes a constant of the base type. Value and the type are resolved at compile time.
+static bool dw_op_const_type(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
+{
+    return pst_dwarf_stack_push(stack, &op1, type_size(op2), op2 | DWARF_TYPE_CONST);
+}
+
+// The DW_OP_regval_type operation pushes the contents of the register interpreted as a value of the base type
+static bool dw_op_regval_type(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
+{
+    unw_word_t val = 0;
+    if(unw_get_reg(stack->ctx->curr_frame, op1, &val)) {
+        return false;
+    }
+
+    return pst_dwarf_stack_push(stack, &val, type_size(op2), op2);
+}
+
+// The DW_OP_deref_type operation behaves like the DW_OP_deref_size operation, but pushes a value of the base type
+static bool dw_op_deref_type(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
+{
+    pst_dwarf_value* value = pst_dwarf_stack_pop(stack);
+    if(!value) {
+        return false;
+    }
+
+    uint64_t res = 0;
+    if(!read_memory(stack, value->value.uint64, op1, &res)) {
+        return false;
+    }
+
+    return pst_dwarf_stack_push(stack, &res, type_size(op2), op2);
+}
+
+// The DW_OP_convert operation converts the value on the top of the stack to the base type (the generic type if type is 0),
+// while DW_OP_reinterpret only changes the type without changing the bits
+static bool dw_op_convert(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
+{
+    pst_dwarf_value* value = pst_dwarf_stack_get(stack, 0);
+    if(!value) {
+        return false;
+    }
+
+    int type = op1 ? (int)op1 : DWARF_TYPE_GENERIC;
+    if(map->op_num == DW_OP_reinterpret || map->op_num == DW_OP_GNU_reinterpret) {
+        value->type = type;
+    } else {
+        pst_sized_value v = value->value;
+        pst_dwarf_value_set(value, &v, type_size(type), type);
+    }
+
+    return true;
+}
+
+// operations that refer to other DIEs (DW_OP_call2, DW_OP_implicit_pointer etc.) or to the object being evaluated (DW_OP_push_object_address)
+static bool dw_op_unsupported(pst_dwarf_stack* stack, const dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2)
+{
+    pst_log(SEVERITY_WARNING, "DWARF operation %s(0x%X) cannot be evaluated without debugger's context", map->op_name, map->op_num);
+    return false;
+}
+
+#define OP(NUM, HANDLER) [NUM] = {NUM, #NUM, HANDLER}
+
+// DWARF Operations to code & name mapping, indexed by operation code
+static const dwarf_op_map op_map[256] = {
+        OP(DW_OP_addr,                 dw_op_addr),
+        OP(DW_OP_deref,                dw_op_deref),
+        // Constant operations
+        OP(DW_OP_const1u,              dw_op_const_x_u),
+        OP(DW_OP_const1s,              dw_op_const_x_s),
+        OP(DW_OP_const2u,              dw_op_const_x_u),
+        OP(DW_OP_const2s,              dw_op_const_x_s),
+        OP(DW_OP_const4u,              dw_op_const_x_u),
+        OP(DW_OP_const4s,              dw_op_const_x_s),
+        OP(DW_OP_const8u,              dw_op_const_x_u),
+        OP(DW_OP_const8s,              dw_op_const_x_s),
+        OP(DW_OP_constu,               dw_op_constu),
+        OP(DW_OP_consts,               dw_op_consts),
+        OP(DW_OP_constx,               dw_op_addr),             // index is resolved to value at compile time
+        OP(DW_OP_addrx,                dw_op_addr),             // index is resolved to address at compile time
+        OP(DW_OP_const_type,           dw_op_const_type),
+        // DWARF expression stack operations
+        OP(DW_OP_dup,                  dw_op_dup),
+        OP(DW_OP_drop,                 dw_op_drop),
+        OP(DW_OP_over,                 dw_op_over),
+        OP(DW_OP_pick,                 dw_op_pick),
+        OP(DW_OP_swap,                 dw_op_swap),
+        OP(DW_OP_rot,                  dw_op_rot),
+        OP(DW_OP_deref_size,           dw_op_deref_size),
+        OP(DW_OP_deref_type,           dw_op_deref_type),
+        OP(DW_OP_xderef,               dw_op_xderef),
+        OP(DW_OP_xderef_size,          dw_op_xderef),
+        OP(DW_OP_xderef_type,          dw_op_xderef),
+        OP(DW_OP_push_object_address,  dw_op_unsupported),
+        OP(DW_OP_form_tls_address,     dw_op_form_tls_address),
+        OP(DW_OP_call_frame_cfa,       dw_op_call_frame_cfa),
+        // Arithmetic and Logical Operations
+        OP(DW_OP_abs,                  dw_op_abs),
+        OP(DW_OP_and,                  dw_op_and),
+        OP(DW_OP_div,                  dw_op_div),
+        OP(DW_OP_minus,                dw_op_minus),
+        OP(DW_OP_mod,                  dw_op_mod),
+        OP(DW_OP_mul,                  dw_op_mul),
+        OP(DW_OP_neg,                  dw_op_neg),
+        OP(DW_OP_not,                  dw_op_not),
+        OP(DW_OP_or,                   dw_op_or),
+        OP(DW_OP_plus,                 dw_op_plus),
+        OP(DW_OP_plus_uconst,          dw_op_plus_uconst),
+        OP(DW_OP_shl,                  dw_op_bitwise),
+        OP(DW_OP_shr,                  dw_op_bitwise),
+        OP(DW_OP_shra,                 dw_op_bitwise),
+        OP(DW_OP_xor,                  dw_op_bitwise),
+        // Control Flow Operations
+        OP(DW_OP_eq,                   dw_op_compare),
+        OP(DW_OP_ge,                   dw_op_compare),
+        OP(DW_OP_gt,                   dw_op_compare),
+        OP(DW_OP_le,                   dw_op_compare),
+        OP(DW_OP_lt,                   dw_op_compare),
+        OP(DW_OP_ne,                   dw_op_compare),
+        OP(DW_OP_skip,                 dw_op_skip),
+        OP(DW_OP_bra,                  dw_op_bra),
+        OP(DW_OP_call2,                dw_op_unsupported),
+        OP(DW_OP_call4,                dw_op_unsupported),
+        OP(DW_OP_call_ref,             dw_op_unsupported),
+        // Type Conversions
+        OP(DW_OP_convert,              dw_op_convert),
+        OP(DW_OP_reinterpret,          dw_op_convert),
+        // Special Operations
+        OP(DW_OP_nop,                  dw_op_nop),
+        // in fact, implementation is at upper layer since this operation contains sub-expression
+        OP(DW_OP_entry_value,          dw_op_notimpl),
+        // DWARF5 2.5.1.1 Literal Encodings
+        OP(DW_OP_lit0,                 dw_op_lit_x),
+        OP(DW_OP_lit1,                 dw_op_lit_x),
+        OP(DW_OP_lit2,                 dw_op_lit_x),
+        OP(DW_OP_lit3,                 dw_op_lit_x),
+        OP(DW_OP_lit4,                 dw_op_lit_x),
+        OP(DW_OP_lit5,                 dw_op_lit_x),
+        OP(DW_OP_lit6,                 dw_op_lit_x),
+        OP(DW_OP_lit7,                 dw_op_lit_x),
+        OP(DW_OP_lit8,                 dw_op_lit_x),
+        OP(DW_OP_lit9,                 dw_op_lit_x),
+        OP(DW_OP_lit10,                dw_op_lit_x),
+        OP(DW_OP_lit11,                dw_op_lit_x),
+        OP(DW_OP_lit12,                dw_op_lit_x),
+        OP(DW_OP_lit13,                dw_op_lit_x),
+        OP(DW_OP_lit14,                dw_op_lit_x),
+        OP(DW_OP_lit15,                dw_op_lit_x),
+        OP(DW_OP_lit16,                dw_op_lit_x),
+        OP(DW_OP_lit17,                dw_op_lit_x),
+        OP(DW_OP_lit18,                dw_op_lit_x),
+        OP(DW_OP_lit19,                dw_op_lit_x),
+        OP(DW_OP_lit20,                dw_op_lit_x),
+        OP(DW_OP_lit21,                dw_op_lit_x),
+        OP(DW_OP_lit22,                dw_op_lit_x),
+        OP(DW_OP_lit23,                dw_op_lit_x),
+        OP(DW_OP_lit24,                dw_op_lit_x),
+        OP(DW_OP_lit25,                dw_op_lit_x),
+        OP(DW_OP_lit26,                dw_op_lit_x),
+        OP(DW_OP_lit27,                dw_op_lit_x),
+        OP(DW_OP_lit28,                dw_op_lit_x),
+        OP(DW_OP_lit29,                dw_op_lit_x),
+        OP(DW_OP_lit30,                dw_op_lit_x),
+        OP(DW_OP_lit31,                dw_op_lit_x),
+        // Register location descriptions. I.e. register containing the value
+        // GP Registers
+        OP(DW_OP_reg0,                 dw_op_reg_x),
+        OP(DW_OP_reg1,                 dw_op_reg_x),
+        OP(DW_OP_reg2,                 dw_op_reg_x),
+        OP(DW_OP_reg3,                 dw_op_reg_x),
+        OP(DW_OP_reg4,                 dw_op_reg_x),
+        OP(DW_OP_reg5,                 dw_op_reg_x),
+        OP(DW_OP_reg6,                 dw_op_reg_x),
+        OP(DW_OP_reg7,                 dw_op_reg_x),
+        // Extended GP Registers
+        OP(DW_OP_reg8,                 dw_op_reg_x),
+        OP(DW_OP_reg9,                 dw_op_reg_x),
+        OP(DW_OP_reg10,                dw_op_reg_x),
+        OP(DW_OP_reg11,                dw_op_reg_x),
+        OP(DW_OP_reg12,                dw_op_reg_x),
+        OP(DW_OP_reg13,                dw_op_reg_x),
+        OP(DW_OP_reg14,                dw_op_reg_x),
+        OP(DW_OP_reg15,                dw_op_reg_x),
+        OP(DW_OP_reg16,                dw_op_reg_x),            // Return Address (RA) mapped to RIP
+        // SSE Vector Registers
+        OP(DW_OP_reg17,                dw_op_reg_x),
+        OP(DW_OP_reg18,                dw_op_reg_x),
+        OP(DW_OP_reg19,                dw_op_reg_x),
+        OP(DW_OP_reg20,                dw_op_reg_x),
+        OP(DW_OP_reg21,                dw_op_reg_x),
+        OP(DW_OP_reg22,                dw_op_reg_x),
+        OP(DW_OP_reg23,                dw_op_reg_x),
+        OP(DW_OP_reg24,                dw_op_reg_x),
+        OP(DW_OP_reg25,                dw_op_reg_x),
+        OP(DW_OP_reg26,                dw_op_reg_x),
+        OP(DW_OP_reg27,                dw_op_reg_x),
+        OP(DW_OP_reg28,                dw_op_reg_x),
+        OP(DW_OP_reg29,                dw_op_reg_x),
+        OP(DW_OP_reg30,                dw_op_reg_x),
+        OP(DW_OP_reg31,                dw_op_reg_x),
+        // Register values. I.e. appropriate register value + offset of operation is pushed onto the stack
+        // GP Registers
+        OP(DW_OP_breg0,                dw_op_breg_x),
+        OP(DW_OP_breg1,                dw_op_breg_x),
+        OP(DW_OP_breg2,                dw_op_breg_x),
+        OP(DW_OP_breg3,                dw_op_breg_x),
+        OP(DW_OP_breg4,                dw_op_breg_x),
+        OP(DW_OP_breg5,                dw_op_breg_x),
+        OP(DW_OP_breg6,                dw_op_breg_x),
+        OP(DW_OP_breg7,                dw_op_breg_x),
+        // Extended GP Registers
+        OP(DW_OP_breg8,                dw_op_breg_x),
+        OP(DW_OP_breg9,                dw_op_breg_x),
+        OP(DW_OP_breg10,               dw_op_breg_x),
+        OP(DW_OP_breg11,               dw_op_breg_x),
+        OP(DW_OP_breg12,               dw_op_breg_x),
+        OP(DW_OP_breg13,               dw_op_breg_x),
+        OP(DW_OP_breg14,               dw_op_breg_x),
+        OP(DW_OP_breg15,               dw_op_breg_x),
+        OP(DW_OP_breg16,               dw_op_breg_x),           // Return Address (RA) mapped to RIP
+        // SSE Vector Registers
+        OP(DW_OP_breg17,               dw_op_breg_x),
+        OP(DW_OP_breg18,               dw_op_breg_x),
+        OP(DW_OP_breg19,               dw_op_breg_x),
+        OP(DW_OP_breg20,               dw_op_breg_x),
+        OP(DW_OP_breg21,               dw_op_breg_x),
+        OP(DW_OP_breg22,               dw_op_breg_x),
+        OP(DW_OP_breg23,               dw_op_breg_x),
+        OP(DW_OP_breg24,               dw_op_breg_x),
+        OP(DW_OP_breg25,               dw_op_breg_x),
+        OP(DW_OP_breg26,               dw_op_breg_x),
+        OP(DW_OP_breg27,               dw_op_breg_x),
+        OP(DW_OP_breg28,               dw_op_breg_x),
+        OP(DW_OP_breg29,               dw_op_breg_x),
+        OP(DW_OP_breg30,               dw_op_breg_x),
+        OP(DW_OP_breg31,               dw_op_breg_x),
+        // special register-related commands
+        OP(DW_OP_regx,                 dw_op_reg_x),            // 1st operand register name
+        OP(DW_OP_fbreg,                dw_op_fbreg),            // base is Frame base register there
+        OP(DW_OP_bregx,                dw_op_breg_x),           // base is value of 1st operand's register
+        OP(DW_OP_regval_type,          dw_op_regval_type),
+        // Implicit Location Descriptions
+        OP(DW_OP_implicit_value,       dw_op_implicit_value),
+        OP(DW_OP_stack_value,          dw_op_stack_value),
+        OP(DW_OP_implicit_pointer,     dw_op_unsupported),
+        // Composite Location Descriptions
+        OP(DW_OP_piece,                dw_op_piece),
+        OP(DW_OP_bit_piece,            dw_op_piece),
+
+        // GNU extensions
+        // in fact, implementation is at upper layer since this operation contains sub-expression
+        OP(DW_OP_GNU_entry_value,      dw_op_notimpl),          // seems that it's equal to DW_OP_entry_value from DWARF 5
+        OP(DW_OP_GNU_push_tls_address, dw_op_form_tls_address),
+        OP(DW_OP_GNU_uninit,           dw_op_nop),
+        OP(DW_OP_GNU_encoded_addr,     dw_op_unsupported),
+        OP(DW_OP_GNU_implicit_pointer, dw_op_unsupported),
+        OP(DW_OP_GNU_const_type,       dw_op_const_type),
+        OP(DW_OP_GNU_regval_type,      dw_op_regval_type),
+        OP(DW_OP_GNU_deref_type,       dw_op_deref_type),
+        OP(DW_OP_GNU_convert,          dw_op_convert),
+        OP(DW_OP_GNU_reinterpret,      dw_op_convert),
+        OP(DW_OP_GNU_parameter_ref,    dw_op_unsupported),
+        OP(DW_OP_GNU_addr_index,       dw_op_addr),
+        OP(DW_OP_GNU_const_index,      dw_op_addr),
+        OP(DW_OP_GNU_variable_value,   dw_op_unsupported),
 };
 
 const dwarf_op_map* find_op_map(int op)
 {
-	for(uint32_t i = 0; i < sizeof(op_map) / sizeof(dwarf_op_map); ++i) {
-		if(op_map[i].op_num == op) {
-			return &op_map[i];
-		}
-	}
+    if(op < 0 || op >= (int)(sizeof(op_map) / sizeof(dwarf_op_map)) || !op_map[op].operation) {
+        return NULL;
+    }
 
-	return NULL;
+    return &op_map[op];
 }
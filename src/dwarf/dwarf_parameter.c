@@ -13,87 +13,37 @@
 #include "dwarf_utils.h"
 #include "context.h"
 #include "dwarf_parameter.h"
-
-//
-// pst_type
-//
-void pst_type_init(pst_type* t, const char* name, pst_param_flags type)
-{
-    list_node_init(&t->node);
-    if(name) {
-        t->name = pst_strdup(name);
-    } else {
-        t->name = NULL;
-    }
-    t->type = type;
-    t->allocated = false;
-}
-
-pst_type* pst_type_new(const char* name, pst_param_flags type)
-{
-    pst_type* nt = pst_alloc(pst_type);
-    if(nt) {
-        pst_type_init(nt, name, type);
-        nt->allocated = true;
-    }
-
-    return nt;
-}
-
-void pst_type_fini(pst_type* t)
-{
-    if(t->name) {
-        pst_free(t->name);
-    }
-    if(t->allocated) {
-        pst_free(t);
-    }
-}
+#include "session.h"
+#include "utils/safe_read.h"
 
 //
 // pst_parameter
 //
 static void clear(pst_parameter* param)
 {
-    // clean up parameter's types
-    pst_type* t = NULL;
-    struct list_node  *pos, *tn;
-    list_for_each_entry_safe(t, pos, tn, &param->types, node) {
-        list_del(&t->node);
-        pst_type_fini(t);
-    }
-
     // clean up children parameters
     pst_parameter* p = NULL;
+    struct list_node  *pos, *tn;
     list_for_each_entry_safe(p, pos, tn, &param->children, node) {
         list_del(&p->node);
         pst_parameter_fini(p);
     }
 
+    // type name belongs to type descriptor
     if(param->info.name) {
         pst_free(param->info.name);
     }
-
-    if(param->info.type_name) {
-        pst_free(param->info.type_name);
-    }
 }
 
-static pst_type* next_type(pst_parameter* param, pst_type* t)
+static void parameter_print_type(pst_parameter* param)
 {
-    list_node* n = (t == NULL) ? list_first(&param->types) : list_next(&t->node);
-    pst_type* ret = NULL;
-    if(n) {
-        ret = list_entry(n, pst_type, node);
+    if(!param->type) {
+        return;
     }
 
-    return ret;
-}
-
-static void parameter_print_type(pst_parameter* param)
-{
     bool is_1st = true;
-    for(pst_type* t = next_type(param, NULL); t; t = next_type(param, t)) {
+    for(uint32_t i = 0; i < param->type->count; ++i) {
+        const pst_type* t = &param->type->levels[i];
         if(is_1st) {
             switch(t->type) {
                 case PARAM_CONST:
@@ -143,6 +93,49 @@ static void parameter_print_type(pst_parameter* param)
     }
 }
 
+// whether children of parameter are members of composite type, rather than arguments of pointed function
+static bool has_members(pst_parameter* param)
+{
+    return (param->info.flags & (PARAM_TYPE_STRUCT | PARAM_TYPE_UNION | PARAM_TYPE_CLASS)) && !(param->info.flags & PARAM_TYPE_FUNCPTR)
+            && parameter_next_child(param, NULL);
+}
+
+static void parameter_print_value(pst_parameter* param)
+{
+    if(param->info.flags & PARAM_HAS_VALUE) {
+        param->ctx->print(param->ctx, "0x%lX", param->info.value);
+
+        // don't take care on NULL pointer since obviously it's invalid
+        if((param->info.flags & PARAM_INVALID) && param->info.value != 0) {
+            param->ctx->print(param->ctx, " <invalid>");
+        }
+    } else if(param->info.flags & PARAM_INVALID) {
+        param->ctx->print(param->ctx, "<invalid>");
+    } else {
+        param->ctx->print(param->ctx, "<undefined>");
+    }
+}
+
+static void parameter_print_members(pst_parameter* param)
+{
+    param->ctx->print(param->ctx, "{");
+    for(pst_parameter* p = parameter_next_child(param, NULL); p; p = parameter_next_child(param, p)) {
+        if(p->info.flags & PARAM_TYPE_UNSPEC) {
+            // the rest of members is beyond read part of object
+            param->ctx->print(param->ctx, "...");
+        } else {
+            param->ctx->print(param->ctx, "%s = ", p->info.name ? p->info.name : "<anonymous>");
+            if(has_members(p)) {
+                parameter_print_members(p);
+            } else {
+                parameter_print_value(p);
+            }
+        }
+        param->ctx->print(param->ctx, "%s", (parameter_next_child(param, p) != NULL) ? ", " : "");
+    }
+    param->ctx->print(param->ctx, "}");
+}
+
 void parameter_print(pst_parameter* param)
 {
     parameter_print_type(param);
@@ -165,28 +158,26 @@ void parameter_print(pst_parameter* param)
         param->ctx->print(param->ctx, " %s = ", param->info.name);
     }
 
-    if(param->info.flags & PARAM_HAS_VALUE) {
-        param->ctx->print(param->ctx, "0x%lX", param->info.value);
-        
-        // don't take care on NULL pointer since obviously it's invalid
-        if((param->info.flags & PARAM_INVALID) && param->info.value != 0) {
-            param->ctx->print(param->ctx, " <invalid>");
-        }
+    if(!has_members(param)) {
+        parameter_print_value(param);
+    } else if(param->info.flags & (PARAM_TYPE_POINTER | PARAM_TYPE_REF | PARAM_TYPE_RREF)) {
+        parameter_print_value(param);
+        param->ctx->print(param->ctx, " ");
+        parameter_print_members(param);
     } else {
-        param->ctx->print(param->ctx, "<undefined>");
+        parameter_print_members(param);
     }
 }
 
-pst_type* parameter_add_type(pst_parameter* param, const char* name, pst_param_flags type)
+// set type of parameter. type name and size of value are the ones of the type
+void parameter_set_type(pst_parameter* param, const pst_type_desc* type)
 {
-    pst_new(pst_type, t, name, type);
-    list_add_bottom(&param->types, &t->node);
-    param->info.flags |= type;
-    if(name && !param->info.type_name) {
-        param->info.type_name = pst_strdup(name);
+    param->type = type;
+    param->info.flags |= type->flags;
+    param->info.size = type->size;
+    if(type->name && !param->info.type_name) {
+        param->info.type_name = (char*)type->name;
     }
-
-    return t;
 }
 
 pst_parameter* parameter_next_child(pst_parameter* param, pst_parameter* p)
@@ -201,13 +192,23 @@ pst_parameter* parameter_next_child(pst_parameter* param, pst_parameter* p)
     return ret;
 }
 
-static bool handle_subroutine(pst_parameter* param, Dwarf_Die* die)
+// add return value and arguments of pointed function as children of parameter of pointer to function type
+static bool handle_subroutine(pst_parameter* param, const pst_type_desc* type)
 {
+    Dwarf_Die die;
+    if(!dwarf_offdie(type->dwarf, type->subroutine, &die)) {
+        pst_log(SEVERITY_ERROR, "Failed to get subroutine type DIE");
+        return false;
+    }
+
 	// return value
     pst_new(pst_parameter, p, param->ctx);
+    if(!p) {
+        return false;
+    }
     list_add_bottom(&param->children, &p->node);
     Dwarf_Attribute attr_mem;
-    Dwarf_Attribute* attr = dwarf_attr(die, DW_AT_name, &attr_mem);
+    Dwarf_Attribute* attr = dwarf_attr(&die, DW_AT_name, &attr_mem);
     if(attr) {
         const char *name = dwarf_formstring(attr);
         if(name) {
@@ -215,17 +216,15 @@ static bool handle_subroutine(pst_parameter* param, Dwarf_Die* die)
         }
     }
 
-    parameter_handle_type(param, die);
-
     // hack since DWARF has no ability to determine 'void' another way
-    if(!p->info.type_name) {
-        p->info.type_name = pst_strdup("void");
+    if(!dwarf_hasattr(&die, DW_AT_type) || !parameter_handle_type(p, &die)) {
+        parameter_set_type(p, &pst_type_void);
     }
 
     p->info.flags |= PARAM_RETURN;
 
     Dwarf_Die result;
-    if(dwarf_child(die, &result) != 0) {
+    if(dwarf_child(&die, &result) != 0) {
         // no parameters defined for subroutine
         return true;
     }
@@ -236,6 +235,9 @@ static bool handle_subroutine(pst_parameter* param, Dwarf_Die* die)
             case DW_TAG_formal_parameter:
             {
                 pst_new(pst_parameter, p1, param->ctx);
+                if(!p1) {
+                    break;
+                }
                 list_add_bottom(&param->children, &p1->node);
 
                 attr = dwarf_attr(&result, DW_AT_name, &attr_mem);
@@ -246,11 +248,9 @@ static bool handle_subroutine(pst_parameter* param, Dwarf_Die* die)
                     }
                 }
 
-                parameter_handle_type(p1, &result);
-
                 // hack since DWARF has no ability to determine 'void' it another way
-                if(!p1->info.type_name) {
-                    p1->info.type_name = pst_strdup("void");
+                if(!parameter_handle_type(p1, &result)) {
+                    parameter_set_type(p1, &pst_type_void);
                 }
 
                 break;
@@ -258,6 +258,9 @@ static bool handle_subroutine(pst_parameter* param, Dwarf_Die* die)
             case DW_TAG_unspecified_parameters:
             {
                 pst_new(pst_parameter, p1, param->ctx);
+                if(!p1) {
+                    break;
+                }
                 list_add_bottom(&param->children, &p1->node);
                 p1->info.flags |= PARAM_TYPE_UNSPEC;
                 p1->info.name = pst_strdup("...");
@@ -272,6 +275,7 @@ static bool handle_subroutine(pst_parameter* param, Dwarf_Die* die)
     return true;
 }
 
+// set type of parameter from DW_AT_type of DIE. descriptions of types are built once per session and shared by parameters
 bool parameter_handle_type(pst_parameter* param, Dwarf_Die* result)
 {
     Dwarf_Attribute attr_mem;
@@ -292,126 +296,179 @@ bool parameter_handle_type(pst_parameter* param, Dwarf_Die* result)
         return false;
     }
 
-    // get Size attribute and it's value
-    param->info.size = 8;
-    attr = dwarf_attr(&ret_die, DW_AT_byte_size, &attr_mem);
-    if(attr) {
-        dwarf_formudata(attr, &param->info.size);
-    }
-
-    switch (dwarf_tag(&ret_die)) {
-        // base types
-        case DW_TAG_base_type: {
-            const char* type_name = dwarf_diename(&ret_die);
-            attr = dwarf_attr(&ret_die, DW_AT_encoding, &attr_mem);
-            if(attr) {
-                Dwarf_Word enc_type = 0;
-                dwarf_formudata(attr, &enc_type);
-                switch (enc_type) {
-                    case DW_ATE_boolean:
-                        parameter_add_type(param, type_name, PARAM_TYPE_BOOL);
-                        break;
-                    case DW_ATE_address:
-                        parameter_add_type(param, NULL, PARAM_TYPE_POINTER);
-                        break;
-                    case DW_ATE_signed:
-                        parameter_add_type(param, type_name, PARAM_TYPE_INT);
-                        break;
-                    case DW_ATE_unsigned:
-                        parameter_add_type(param, type_name, PARAM_TYPE_UINT);
-                        break;
-                    case DW_ATE_signed_char:
-                        parameter_add_type(param, type_name, PARAM_TYPE_CHAR);
-                        break;
-                    case DW_ATE_unsigned_char:
-                        parameter_add_type(param, type_name, PARAM_TYPE_UCHAR);
-                        break;
-                    case DW_ATE_float:
-                    case DW_ATE_complex_float:
-                    case DW_ATE_imaginary_float:
-                    case DW_ATE_decimal_float:
-                        parameter_add_type(param, type_name, PARAM_TYPE_FLOAT);
-                        break;
-                    default:
-                        pst_log(SEVERITY_WARNING, "Unknown parameter base type encodings 0x%lX", enc_type);
-                }
+    if(!param->ctx->session) {
+        pst_log(SEVERITY_ERROR, "Cannot describe parameter type without session");
+        return false;
+    }
 
-            }
-            break;
+    const pst_type_desc* type = pst_type_cache_get(&param->ctx->session->types, &ret_die);
+    if(!type) {
+        return false;
+    }
+
+    parameter_set_type(param, type);
+    if(type->subroutine) {
+        handle_subroutine(param, type);
+    }
+
+    return true;
+}
+
+static void add_members(pst_parameter* param, const pst_type_desc* type, const uint8_t* data, uint32_t size, uint32_t depth);
+
+// get value of scalar member from bytes of object
+static void set_member_value(pst_parameter* p, const pst_type_member* m, const uint8_t* data, uint32_t size)
+{
+    if(p->info.flags & PARAM_TYPE_ARRAY) {
+        return;
+    }
+
+    uint32_t bytes = m->bit_size ? (m->bit_offset + m->bit_size + 7) / 8 : m->type->size;
+    if(!bytes || bytes > sizeof(p->info.value) || m->offset + bytes > size) {
+        return;
+    }
+
+    p->info.value = 0;
+    memcpy(&p->info.value, data + m->offset, bytes);
+    p->info.flags |= PARAM_HAS_VALUE;
+
+    if(m->bit_size) {
+        p->info.value >>= m->bit_offset;
+        if(m->bit_size < 64) {
+            p->info.value &= (1ULL << m->bit_size) - 1;
         }
-        // complex types
-        case DW_TAG_array_type:
-            parameter_add_type(param, NULL, PARAM_TYPE_ARRAY);
-            break;
-        case DW_TAG_structure_type:
-            parameter_add_type(param, NULL, PARAM_TYPE_STRUCT);
-            break;
-        case DW_TAG_union_type:
-            parameter_add_type(param, NULL, PARAM_TYPE_UNION);
-            break;
-        case DW_TAG_class_type:
-            parameter_add_type(param, NULL, PARAM_TYPE_CLASS);
-            break;
-        case DW_TAG_pointer_type:
-            parameter_add_type(param, NULL, PARAM_TYPE_POINTER);
-            break;
-        case DW_TAG_enumeration_type:
-            parameter_add_type(param, NULL, PARAM_TYPE_ENUM);
-            break;
-        case DW_TAG_const_type:
-            parameter_add_type(param, NULL, PARAM_CONST);
-            break;
-        case DW_TAG_subroutine_type:
-            handle_subroutine(param, &ret_die);
-            parameter_add_type(param, NULL, PARAM_TYPE_FUNCPTR);
-            break;
-        case DW_TAG_typedef: {
-            parameter_add_type(param, dwarf_diename(&ret_die), PARAM_TYPE_TYPEDEF);
+    } else if(!(p->info.flags & (PARAM_TYPE_POINTER | PARAM_TYPE_FUNCPTR))) {
+        p->info.value &= 0xFFFFFFFFFFFFFFFF >> (64 - ((p->info.size * 8) & 0x3F));
+    } else if(pst_pointer_valid((void*)p->info.value, sizeof(void*))) {
+        p->info.flags |= PARAM_INVALID;
+    }
+}
+
+// add members of composite type as children of parameter. 'data' is a copy of the first 'size' bytes of object, members beyond
+// it are replaced by '...'
+static void add_members(pst_parameter* param, const pst_type_desc* type, const uint8_t* data, uint32_t size, uint32_t depth)
+{
+    const pst_type_layout* l = pst_type_cache_layout(&param->ctx->session->types, type);
+    if(!l) {
+        return;
+    }
+
+    for(uint32_t i = 0; i < l->count; ++i) {
+        const pst_type_member* m = &l->members[i];
+        pst_new(pst_parameter, p, param->ctx);
+        if(!p) {
             break;
         }
-        case DW_TAG_unspecified_type:
-            parameter_add_type(param, "void", PARAM_TYPE_VOID);
-            break;
-        case DW_TAG_reference_type:
-            parameter_add_type(param, NULL, PARAM_TYPE_REF);
-            break;
-        case DW_TAG_rvalue_reference_type:
-            parameter_add_type(param, NULL, PARAM_TYPE_RREF);
-            break;
-        case DW_TAG_volatile_type:
-            parameter_add_type(param, NULL, PARAM_VOLATILE);
-            break;
-        case DW_TAG_string_type:
-            pst_log(SEVERITY_DEBUG, "String type, skipping");
-            break;
-        default:
-            pst_log(SEVERITY_WARNING, "Unknown 0x%X tag type", dwarf_tag(&ret_die));
+        list_add_bottom(&param->children, &p->node);
+
+        if(m->offset >= size) {
+            p->info.flags |= PARAM_TYPE_UNSPEC;
+            p->info.name = pst_strdup("...");
             break;
+        }
+
+        // base class is named by its type
+        const char* name = m->base ? m->type->name : m->name;
+        if(name) {
+            p->info.name = pst_strdup(name);
+        }
+        parameter_set_type(p, m->type);
+
+        if(m->type->composite && !(m->type->flags & (PARAM_TYPE_POINTER | PARAM_TYPE_REF | PARAM_TYPE_RREF | PARAM_TYPE_ARRAY))) {
+            // nested object is already read as part of enclosing one
+            if(depth < PST_MEMBERS_DEPTH) {
+                uint32_t left = size - m->offset;
+                add_members(p, m->type, data + m->offset, m->type->size < left ? m->type->size : left, depth + 1);
+            }
+            continue;
+        }
+
+        if(m->type->subroutine) {
+            handle_subroutine(p, m->type);
+        }
+        set_member_value(p, m, data, size);
     }
+}
 
-    pst_log(SEVERITY_DEBUG, "%s: Parameter type '%s'(%lu) flags = 0x%X", __FUNCTION__, dwarf_diename(&ret_die), param->info.size, param->info.flags);
+// read object of composite parameter, passed by value or by pointer, and add its members. number of read bytes is limited both per
+// object and per stack trace, so large objects don't slow down capture and don't flood output
+static void handle_members(pst_parameter* param)
+{
+    const pst_type_desc* type = param->type;
+    if(!type || !type->composite || (param->info.flags & (PARAM_TYPE_ARRAY | PARAM_TYPE_FUNCPTR))) {
+        return;
+    }
 
-    if(dwarf_hasattr(&ret_die, DW_AT_type)) {
-        // handle parameter's sub-type
-        return parameter_handle_type(param, &ret_die);
+    // only the outermost pointer or reference is followed, pointers to pointers are printed as is
+    uint32_t indirections = 0;
+    for(uint32_t i = 0; i < type->count; ++i) {
+        if(type->levels[i].type & (PARAM_TYPE_POINTER | PARAM_TYPE_REF | PARAM_TYPE_RREF)) {
+            indirections++;
+        }
+    }
+    if(indirections > 1) {
+        return;
     }
 
-    return true;
+    uint64_t addr = 0;
+    const uint8_t* data = NULL;
+    uint32_t size = type->size < PST_MEMBERS_OBJECT ? type->size : PST_MEMBERS_OBJECT;
+    if(indirections) {
+        if(!(param->info.flags & PARAM_HAS_VALUE) || (param->info.flags & PARAM_INVALID) || !param->info.value) {
+            return;
+        }
+        addr = param->info.value;
+    } else if(param->location.address) {
+        addr = param->location.address;
+    } else if(param->location.in_value && (param->info.flags & PARAM_HAS_VALUE) && type->size <= sizeof(param->info.value)) {
+        // small object in registers
+        data = (const uint8_t*)&param->info.value;
+    } else {
+        return;
+    }
+
+    uint8_t buff[PST_MEMBERS_OBJECT];
+    if(!data) {
+        if(size > param->ctx->budget) {
+            size = param->ctx->budget;
+        }
+        if(!size) {
+            pst_log(SEVERITY_DEBUG, "No budget left to read members of '%s'", param->info.name);
+            return;
+        }
+        if(!pst_safe_read(buff, addr, size)) {
+            pst_log(SEVERITY_WARNING, "Failed to read %u bytes of '%s' at address 0x%lX", size, param->info.name, addr);
+            param->info.flags |= PARAM_INVALID;
+            return;
+        }
+        param->ctx->budget -= size;
+        data = buff;
+    }
+
+    add_members(param, type, data, size, 1);
 }
 
 bool parameter_handle_dwarf(pst_parameter* param, Dwarf_Die* result, pst_function* fun)
 {
     param->die = result;
+    param->offset = dwarf_dieoffset(result);
 
     Dwarf_Attribute attr_mem;
     Dwarf_Attribute* attr;
 
-    param->info.name = pst_strdup(dwarf_diename(result));
+    // parameter of inlined function has name, type and declaration line in its abstract origin
+    Dwarf_Die origin;
+    Dwarf_Die* decl = result;
+    if(dwarf_formref_die(dwarf_attr(result, DW_AT_abstract_origin, &attr_mem), &origin)) {
+        decl = &origin;
+    }
+
+    param->info.name = pst_strdup(dwarf_diename(decl));
     param->info.flags |= (dwarf_tag(result) == DW_TAG_variable) ? PARAM_VARIABLE : 0;
 
-    dwarf_decl_line(result, (int*)&param->info.line);
+    dwarf_decl_line(decl, (int*)&param->info.line);
     pst_log(SEVERITY_DEBUG, "---> Handle '%s' %s", param->info.name, dwarf_tag(result) == DW_TAG_formal_parameter ? "parameter" : "variable");
-    parameter_handle_type(param, result);
+    parameter_handle_type(param, decl);
 
     if(dwarf_hasattr(result, DW_AT_location)) {
         // determine location of parameter in stack/heap or CPU registers
@@ -422,6 +479,10 @@ bool parameter_handle_dwarf(pst_parameter* param, Dwarf_Die* result, pst_functio
         if(handle_location(param->ctx, attr, &param->location, pc, fun)) {
             param->info.value = param->location.value;
             param->info.flags |= PARAM_HAS_VALUE;
+        } else if(param->location.faulted) {
+            // location points to unreadable memory (i.e. stale register value), so value is known to be wrong
+            param->info.flags |= PARAM_INVALID;
+            pst_log(SEVERITY_WARNING, "Location of '%s' isn't readable: %s", param->info.name, param->ctx->buff);
         } else {
             pst_log(SEVERITY_WARNING, "Failed to calculate DW_AT_location expression: %s", param->ctx->buff);
         }
@@ -462,9 +523,12 @@ bool parameter_handle_dwarf(pst_parameter* param, Dwarf_Die* result, pst_functio
         param->info.value &= 0xFFFFFFFFFFFFFFFF >> (64 - ((param->info.size * 8) & 0x3F));
     }
 
+    // get values of members of structure, union or class
+    handle_members(param);
+
     // hack since DWARF has no ability to determine 'void' it another way
     if(!param->info.type_name) {
-        param->info.type_name = pst_strdup("void");
+        param->info.type_name = (char*)pst_type_void.name;
     }
 
     // Additionally handle these attributes:
@@ -492,6 +556,7 @@ void pst_parameter_init(pst_parameter* param, pst_context* ctx)
 {
     list_node_init(&param->node);
     param->die = NULL;
+    param->offset = 0;
     // info field
     param->info.name = NULL;
     param->info.type_name = NULL;
@@ -499,7 +564,7 @@ void pst_parameter_init(pst_parameter* param, pst_context* ctx)
     param->info.size = 0;
     param->info.flags = 0;
 
-    list_head_init(&param->types);
+    param->type = NULL;
     list_head_init(&param->children);
     param->ctx = ctx;
     pst_dwarf_expr_init(&param->location);
@@ -12,19 +12,13 @@
 #include <elfutils/libdwfl.h>
 
 #include "dwarf_expression.h"
+#include "dwarf_type.h"
 #include "utils/list_head.h"
 #include "context.h"
 
-typedef struct __pst_type {
-    list_node       node;       // uplink
-
-    char*           name;       // type name
-    pst_param_flags type;       // type bit
-    bool            allocated;  // whether this struct was allocated or not
-} pst_type;
-void pst_type_init(pst_type* t, const char* name, pst_param_flags type);
-pst_type* pst_type_new(const char* name, pst_param_flags type);
-void pst_type_fini(pst_type* t);
+#define PST_MEMBERS_DEPTH   (3)             // maximum nesting level of members of composite parameters
+#define PST_MEMBERS_OBJECT  (512)           // maximum number of bytes of object read to get values of its members
+#define PST_MEMBERS_BUDGET  (16 * 1024)     // maximum number of bytes of objects read per stack trace
 
 typedef struct pst_function pst_function;
 
@@ -33,11 +27,12 @@ typedef struct pst_parameter{
 
     // fields
     Dwarf_Die*          die;            // DWARF DIE containing parameter's definition
+    Dwarf_Off           offset;         // offset of 'die', identifies parameter in binary record
     pst_parameter_info  info;
-    list_head           types;          // list of parameter's definitions i.e. 'typedef', 'uint32_t'
+    const pst_type_desc* type;         // parameter's definitions i.e. 'typedef', 'uint32_t'. owned by session's type cache
     pst_context*        ctx;
     pst_dwarf_expr      location;
-    list_head           children;       // sub parameters. used in case of complex types (array, pointer to function etc)
+    list_head           children;       // sub parameters. used in case of complex types (members of structure, pointer to function etc)
 
     bool                allocated;
 } pst_parameter;
@@ -48,7 +43,7 @@ void pst_parameter_fini(pst_parameter* param);
 bool parameter_handle_dwarf(pst_parameter* param, Dwarf_Die* result, pst_function* fun);
 void parameter_print(pst_parameter* param);
 bool parameter_handle_type(pst_parameter* param, Dwarf_Die* result);
-pst_type* parameter_add_type(pst_parameter* param, const char* name, pst_param_flags type);
+void parameter_set_type(pst_parameter* param, const pst_type_desc* type);
 pst_parameter* parameter_next_child(pst_parameter* param, pst_parameter* p);
 
 #endif /* __PST_DWARF_PARAMETER_H__ */
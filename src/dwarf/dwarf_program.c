@@ -0,0 +1,345 @@
+/*
+ * dwarf_program.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <string.h>
+#include <dwarf.h>
+
+#include "context.h"
+#include "dwarf_operations.h"
+#include "dwarf_stack.h"
+#include "dwarf_program.h"
+
+// number of values the operation requires on the stack and change of the stack depth after it
+static void stack_effect(const Dwarf_Op* op, uint32_t* need, int32_t* delta)
+{
+    *need = 0; *delta = 0;
+
+    if((op->atom >= DW_OP_lit0 && op->atom <= DW_OP_lit31) || (op->atom >= DW_OP_reg0 && op->atom <= DW_OP_reg31) ||
+       (op->atom >= DW_OP_breg0 && op->atom <= DW_OP_breg31)) {
+        *delta = 1;
+        return;
+    }
+
+    switch(op->atom) {
+        case DW_OP_addr: case DW_OP_addrx: case DW_OP_constx: case DW_OP_GNU_addr_index: case DW_OP_GNU_const_index:
+        case DW_OP_const1u: case DW_OP_const1s: case DW_OP_const2u: case DW_OP_const2s:
+        case DW_OP_const4u: case DW_OP_const4s: case DW_OP_const8u: case DW_OP_const8s:
+        case DW_OP_constu: case DW_OP_consts: case DW_OP_const_type: case DW_OP_GNU_const_type:
+        case DW_OP_regx: case DW_OP_bregx: case DW_OP_fbreg: case DW_OP_regval_type: case DW_OP_GNU_regval_type:
+        case DW_OP_call_frame_cfa: case DW_OP_push_object_address:
+        case DW_OP_implicit_value: case DW_OP_implicit_pointer: case DW_OP_GNU_implicit_pointer:
+        case DW_OP_entry_value: case DW_OP_GNU_entry_value:
+        case DW_OP_GNU_parameter_ref: case DW_OP_GNU_variable_value:
+            *delta = 1;
+            break;
+        case DW_OP_dup:
+            *need = 1; *delta = 1;
+            break;
+        case DW_OP_over:
+            *need = 2; *delta = 1;
+            break;
+        case DW_OP_pick:
+            *need = (uint32_t)op->number + 1; *delta = 1;
+            break;
+        case DW_OP_drop:
+        case DW_OP_bra:
+            *need = 1; *delta = -1;
+            break;
+        case DW_OP_deref: case DW_OP_deref_size: case DW_OP_deref_type: case DW_OP_GNU_deref_type:
+        case DW_OP_abs: case DW_OP_neg: case DW_OP_not:
+        case DW_OP_plus_uconst:
+        case DW_OP_convert: case DW_OP_GNU_convert: case DW_OP_reinterpret: case DW_OP_GNU_reinterpret:
+        case DW_OP_form_tls_address: case DW_OP_GNU_push_tls_address:
+        case DW_OP_stack_value:
+            *need = 1;
+            break;
+        case DW_OP_swap:
+            *need = 2;
+            break;
+        case DW_OP_rot:
+            *need = 3;
+            break;
+        case DW_OP_and: case DW_OP_div: case DW_OP_minus: case DW_OP_mod: case DW_OP_mul: case DW_OP_or: case DW_OP_plus:
+        case DW_OP_shl: case DW_OP_shr: case DW_OP_shra: case DW_OP_xor:
+        case DW_OP_eq: case DW_OP_ge: case DW_OP_gt: case DW_OP_le: case DW_OP_lt: case DW_OP_ne:
+        case DW_OP_xderef: case DW_OP_xderef_size: case DW_OP_xderef_type:
+            *need = 2; *delta = -1;
+            break;
+        default:
+            break;
+    }
+}
+
+// value type (bitmask of DWARF_TYPE_XXX) of the base type DIE referenced by the operation
+static bool base_type(Dwarf_Attribute* attr, Dwarf_Op* op, Dwarf_Word offset, Dwarf_Word* type)
+{
+    if(!offset) {
+        // the generic type
+        *type = 0;
+        return true;
+    }
+
+    Dwarf_Die die;
+    if(!attr || dwarf_getlocation_die(attr, op, &die)) {
+        return false;
+    }
+
+    Dwarf_Attribute attr_mem;
+    Dwarf_Word encoding = 0;
+    dwarf_formudata(dwarf_attr(&die, DW_AT_encoding, &attr_mem), &encoding);
+    switch(encoding) {
+        case DW_ATE_signed:
+        case DW_ATE_signed_char:
+            *type = DWARF_TYPE_SIGNED;
+            break;
+        case DW_ATE_float:
+            *type = DWARF_TYPE_FLOAT;
+            break;
+        default:
+            *type = DWARF_TYPE_UNSIGNED;
+            break;
+    }
+
+    switch(dwarf_bytesize(&die)) {
+        case 1:  *type |= DWARF_TYPE_CHAR;  break;
+        case 2:  *type |= DWARF_TYPE_SHORT; break;
+        case 4:  *type |= DWARF_TYPE_INT;   break;
+        default: *type |= DWARF_TYPE_LONG;  break;
+    }
+
+    return true;
+}
+
+// resolve operands which refer to other parts of debug information
+static bool resolve(pst_dwarf_insn* insn, Dwarf_Op* exprs, uint32_t expr_len, uint32_t idx, Dwarf_Attribute* attr)
+{
+    Dwarf_Op* op = &exprs[idx];
+    Dwarf_Attribute result;
+    Dwarf_Block block;
+
+    switch(op->atom) {
+        case DW_OP_skip:
+        case DW_OP_bra: {
+            // operand is signed offset in bytes from the end of the operation (1 byte of opcode plus 2 bytes of operand)
+            Dwarf_Word target = op->offset + 3 + (int16_t)op->number;
+            for(uint32_t i = 0; i < expr_len; ++i) {
+                if(exprs[i].offset == target) {
+                    insn->op1 = i;
+                    return true;
+                }
+            }
+
+            // branch to the end of expression terminates it
+            insn->op1 = expr_len;
+            return target > exprs[expr_len - 1].offset;
+        }
+        case DW_OP_addrx:
+        case DW_OP_GNU_addr_index:
+            return attr && !dwarf_getlocation_attr(attr, op, &result) && !dwarf_formaddr(&result, &insn->op1);
+        case DW_OP_constx:
+        case DW_OP_GNU_const_index:
+            return attr && !dwarf_getlocation_attr(attr, op, &result) && !dwarf_formudata(&result, &insn->op1);
+        case DW_OP_implicit_value:
+            if(!attr || dwarf_getlocation_implicit_value(attr, op, &block)) {
+                return false;
+            }
+            insn->op1 = block.length;
+            insn->op2 = (Dwarf_Word)block.data;
+            return true;
+        case DW_OP_const_type:
+        case DW_OP_GNU_const_type:
+            if(!attr || dwarf_getlocation_attr(attr, op, &result) || dwarf_formblock(&result, &block) || !base_type(attr, op, op->number, &insn->op2)) {
+                return false;
+            }
+            insn->op1 = 0;
+            memcpy(&insn->op1, block.data, block.length > sizeof(insn->op1) ? sizeof(insn->op1) : block.length);
+            return true;
+        case DW_OP_regval_type:
+        case DW_OP_GNU_regval_type:
+        case DW_OP_deref_type:
+        case DW_OP_GNU_deref_type:
+        case DW_OP_xderef_type:
+            return base_type(attr, op, op->number2, &insn->op2);
+        case DW_OP_convert:
+        case DW_OP_GNU_convert:
+        case DW_OP_reinterpret:
+        case DW_OP_GNU_reinterpret:
+            return base_type(attr, op, op->number, &insn->op1);
+        default:
+            break;
+    }
+
+    return true;
+}
+
+// 'copy' makes program independent of lifetime of source expression
+static pst_dwarf_program* compile(pst_allocator* alloc, Dwarf_Op* exprs, uint32_t expr_len, Dwarf_Attribute* attr, bool copy)
+{
+    uint32_t size = sizeof(pst_dwarf_program) + expr_len * sizeof(pst_dwarf_insn) + (copy ? expr_len * sizeof(Dwarf_Op) : 0);
+    pst_dwarf_program* p = (pst_dwarf_program*)alloc->alloc(alloc, size);
+    if(!p) {
+        pst_log(SEVERITY_ERROR, "Failed to allocate DWARF program");
+        return NULL;
+    }
+
+    if(copy) {
+        Dwarf_Op* own = (Dwarf_Op*)&p->insns[expr_len];
+        memcpy(own, exprs, expr_len * sizeof(Dwarf_Op));
+        exprs = own;
+    }
+
+    p->exprs = exprs;
+    p->count = expr_len;
+    p->max_depth = 0;
+    p->copied = copy;
+
+    // depth is tracked along the linear order of operations, branches are checked at run time
+    bool linear = true;
+    uint32_t depth = 0;
+    for(uint32_t i = 0; i < expr_len; ++i) {
+        const dwarf_op_map* map = find_op_map(exprs[i].atom);
+        if(!map) {
+            pst_log(SEVERITY_ERROR, "Unknown operation type 0x%hhX(0x%lX, 0x%lX)", exprs[i].atom, exprs[i].number, exprs[i].number2);
+            alloc->free(alloc, p);
+            return NULL;
+        }
+
+        uint32_t need; int32_t delta;
+        stack_effect(&exprs[i], &need, &delta);
+        if(depth < need && linear) {
+            pst_log(SEVERITY_ERROR, "DWARF stack underflow at %s operation", map->op_name);
+            alloc->free(alloc, p);
+            return NULL;
+        }
+
+        if(exprs[i].atom == DW_OP_piece || exprs[i].atom == DW_OP_bit_piece) {
+            // piece pops its location if any
+            delta = depth ? -1 : 0;
+        } else if(exprs[i].atom == DW_OP_skip || exprs[i].atom == DW_OP_bra) {
+            linear = false;
+        }
+        depth = ((int32_t)depth + delta > 0) ? depth + delta : 0;
+        if(depth > p->max_depth) {
+            p->max_depth = depth;
+        }
+
+        // libdw already decoded LEB128 operands of the operation
+        pst_dwarf_insn* insn = &p->insns[i];
+        insn->operation = map->operation;
+        insn->map = map;
+        insn->op1 = exprs[i].number;
+        insn->op2 = exprs[i].number2;
+        insn->need = need;
+        insn->src = &exprs[i];
+
+        if(!resolve(insn, exprs, expr_len, i, attr)) {
+            pst_log(SEVERITY_ERROR, "Failed to resolve operands of %s operation", map->op_name);
+            alloc->free(alloc, p);
+            return NULL;
+        }
+    }
+
+    return p;
+}
+
+// compile DWARF expression. returns NULL if expression contains unknown operations, underflows the stack or its operands can't be resolved.
+// 'attr' is the attribute containing expression, required by operations referring to other DIEs
+pst_dwarf_program* pst_dwarf_program_new(pst_allocator* alloc, Dwarf_Op* exprs, uint32_t expr_len, Dwarf_Attribute* attr)
+{
+    return compile(alloc, exprs, expr_len, attr, false);
+}
+
+void pst_dwarf_program_del(pst_allocator* alloc, pst_dwarf_program* p)
+{
+    alloc->free(alloc, p);
+}
+
+static inline uint32_t hash_expr(Dwarf_Op* exprs)
+{
+    return (uint32_t)(((uintptr_t)exprs * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+static uint32_t hash_ops(Dwarf_Op* exprs, uint32_t expr_len)
+{
+    // FNV-1a over operations and their operands
+    uint64_t hash = 14695981039346656037ULL;
+    for(uint32_t i = 0; i < expr_len; ++i) {
+        hash = (hash ^ exprs[i].atom) * 1099511628211ULL;
+        hash = (hash ^ exprs[i].number) * 1099511628211ULL;
+        hash = (hash ^ exprs[i].number2) * 1099511628211ULL;
+        hash = (hash ^ exprs[i].offset) * 1099511628211ULL;
+    }
+
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+// fields are compared one by one, since padding of Dwarf_Op isn't initialized
+static bool same_ops(const pst_dwarf_program* p, Dwarf_Op* exprs, uint32_t expr_len)
+{
+    if(!p->copied || p->count != expr_len) {
+        return false;
+    }
+
+    for(uint32_t i = 0; i < expr_len; ++i) {
+        if(p->exprs[i].atom != exprs[i].atom || p->exprs[i].number != exprs[i].number || p->exprs[i].number2 != exprs[i].number2 ||
+           p->exprs[i].offset != exprs[i].offset) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool pst_dwarf_program_cache_init(pst_dwarf_program_cache* c, pst_allocator* alloc)
+{
+    c->alloc = alloc;
+    c->programs = (pst_dwarf_program**)alloc->alloc(alloc, PST_DWARF_PROGRAM_CACHE * sizeof(pst_dwarf_program*));
+    if(!c->programs) {
+        pst_log(SEVERITY_ERROR, "Failed to allocate DWARF program cache");
+        return false;
+    }
+    memset(c->programs, 0, PST_DWARF_PROGRAM_CACHE * sizeof(pst_dwarf_program*));
+
+    return true;
+}
+
+void pst_dwarf_program_cache_fini(pst_dwarf_program_cache* c)
+{
+    if(c->programs) {
+        for(uint32_t i = 0; i < PST_DWARF_PROGRAM_CACHE; ++i) {
+            if(c->programs[i]) {
+                pst_dwarf_program_del(c->alloc, c->programs[i]);
+            }
+        }
+
+        c->alloc->free(c->alloc, c->programs);
+        c->programs = NULL;
+    }
+}
+
+// get compiled program of the expression, compile and cache it in case of miss. expression without attribute is looked up by its operations
+const pst_dwarf_program* pst_dwarf_program_cache_get(pst_dwarf_program_cache* c, Dwarf_Op* exprs, uint32_t expr_len, Dwarf_Attribute* attr)
+{
+    if(!c->programs) {
+        return NULL;
+    }
+
+    pst_dwarf_program** slot = &c->programs[(attr ? hash_expr(exprs) : hash_ops(exprs, expr_len)) & (PST_DWARF_PROGRAM_CACHE - 1)];
+    if(*slot && (attr ? (!(*slot)->copied && (*slot)->exprs == exprs && (*slot)->count == expr_len) : same_ops(*slot, exprs, expr_len))) {
+        return *slot;
+    }
+
+    pst_dwarf_program* p = compile(c->alloc, exprs, expr_len, attr, !attr);
+    if(p) {
+        if(*slot) {
+            pst_dwarf_program_del(c->alloc, *slot);
+        }
+        *slot = p;
+    }
+
+    return p;
+}
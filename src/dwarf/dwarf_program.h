@@ -0,0 +1,68 @@
+/*
+ * dwarf_program.h
+ *
+ * DWARF expressions compiled for repeated evaluation
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_DWARF_PROGRAM_H__
+#define __PST_DWARF_PROGRAM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <elfutils/libdw.h>
+
+#include "utils/allocator.h"
+
+#define PST_DWARF_PROGRAM_CACHE     (1024)  // number of cached programs, power of two
+#define PST_DWARF_PROGRAM_SCRATCH   (4096)  // size of arena on the stack for program compiled without cache
+
+struct __pst_dwarf_stack;
+struct __dwarf_op_map;
+
+// operation of compiled DWARF expression
+typedef struct pst_dwarf_insn {
+    bool (*operation)(struct __pst_dwarf_stack* stack, const struct __dwarf_op_map* map, Dwarf_Word op1, Dwarf_Word op2); // handler of the operation
+    const struct __dwarf_op_map*    map;    // description of the operation
+    Dwarf_Word                      op1;    // decoded first operand
+    Dwarf_Word                      op2;    // decoded second operand
+    uint32_t                        need;   // number of values the operation requires on the stack
+    Dwarf_Op*                       src;    // source operation, required by operations with sub-expression
+} pst_dwarf_insn;
+
+// -----------------------------------------------------------------------------------
+// pst_dwarf_program
+// -----------------------------------------------------------------------------------
+// Flat array of operations with handlers looked up and stack usage validated once, at compile time. Operands which refer to other parts
+// of debug information (branch targets, base types, indexes of addresses and constants, blocks of implicit values) are resolved at compile
+// time as well, so handlers get them ready to use.
+typedef struct pst_dwarf_program {
+    Dwarf_Op*           exprs;      // source expression
+    uint32_t            count;      // number of operations in 'insns'
+    bool                copied;     // whether 'exprs' is program's own copy of source expression placed after 'insns'
+    uint32_t            max_depth;  // maximum number of values on the stack during evaluation
+    pst_dwarf_insn      insns[];    // operations
+} pst_dwarf_program;
+
+pst_dwarf_program* pst_dwarf_program_new(pst_allocator* alloc, Dwarf_Op* exprs, uint32_t expr_len, Dwarf_Attribute* attr);
+void pst_dwarf_program_del(pst_allocator* alloc, pst_dwarf_program* p);
+
+// -----------------------------------------------------------------------------------
+// pst_dwarf_program_cache
+// -----------------------------------------------------------------------------------
+// Direct mapped cache of compiled programs. libdw keeps decoded location expressions of attributes for the life of the session, so
+// address of such expression identifies its module, attribute and PC range. Expressions without attribute (i.e. CFA rules) live only as
+// long as their frame rules, so they are identified by their operations and programs keep copies of them. Caller must hold session lock.
+typedef struct pst_dwarf_program_cache {
+    pst_allocator*          alloc;      // allocator for programs
+    pst_dwarf_program**     programs;   // programs indexed by hash of address of source expression
+} pst_dwarf_program_cache;
+
+bool pst_dwarf_program_cache_init(pst_dwarf_program_cache* c, pst_allocator* alloc);
+void pst_dwarf_program_cache_fini(pst_dwarf_program_cache* c);
+
+const pst_dwarf_program* pst_dwarf_program_cache_get(pst_dwarf_program_cache* c, Dwarf_Op* exprs, uint32_t expr_len, Dwarf_Attribute* attr);
+
+#endif /* __PST_DWARF_PROGRAM_H__ */
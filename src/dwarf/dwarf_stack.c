@@ -12,9 +12,12 @@
 
 #include "utils/allocator.h"
 #include "utils/list_head.h"
+#include "utils/safe_read.h"
 #include "dwarf_operations.h"
 #include "dwarf_handler.h"
+#include "dwarf_program.h"
 #include "dwarf_stack.h"
+#include "session.h"
 
 // -----------------------------------------------------------------------------------
 // DWARF Stack value
@@ -63,86 +66,46 @@ void pst_dwarf_value_set(pst_dwarf_value* value, void* v, uint32_t s, int t)
     }
 }
 
-void pst_dwarf_value_init(pst_dwarf_value* dv, char* v, uint32_t s, int t)
-{
-    pst_assert(dv && s <= sizeof(dv->value));
-
-    list_node_init(&dv->node);
-    dv->type = t;
-    dv->allocated = false;
-    pst_dwarf_value_set(dv, v, s, t);
-}
-
-pst_dwarf_value* pst_dwarf_value_new(char* v, uint32_t s, int t)
-{
-    pst_assert(v);
-
-    pst_dwarf_value* nv = pst_alloc(pst_dwarf_value);
-    if(nv) {
-        pst_dwarf_value_init(nv, v, s, t);
-        nv->allocated = true;
-    }
-
-
-    return nv;
-}
-
-void pst_dwarf_value_fini(pst_dwarf_value* value)
-{
-    pst_assert(value);
-
-    if(value->allocated) {
-        pst_free(value);
-    } else {
-        value->type = DWARF_TYPE_INVALID;
-        value->value.uint64 = 0;
-    }
-}
-
 
 // -----------------------------------------------------------------------------------
 // DWARF stack
 // -----------------------------------------------------------------------------------
-void pst_dwarf_stack_push(pst_dwarf_stack* st, void* v, uint32_t s, int t)
+bool pst_dwarf_stack_push(pst_dwarf_stack* st, void* v, uint32_t s, int t)
 {
-    pst_new(pst_dwarf_value, value, (char*)v, s, t);
-    list_add_head(&st->values, &value->node);
-}
+    if(st->count == PST_DWARF_STACK_SIZE) {
+        pst_log(SEVERITY_ERROR, "DWARF stack overflow");
+        return false;
+    }
 
-void pst_dwarf_stack_push_value(pst_dwarf_stack* st, pst_dwarf_value* value)
-{
-    list_add_head(&st->values, &value->node);
+    pst_dwarf_value_set(&st->values[st->count++], v, s, t);
+
+    return true;
 }
 
 pst_dwarf_value* pst_dwarf_stack_pop(pst_dwarf_stack* st)
 {
-    pst_dwarf_value* value = (pst_dwarf_value*)list_first(&st->values);
-    if(value) {
-        list_del(&value->node);
+    if(!st->count) {
+        return NULL;
     }
 
-    return value;
+    return &st->values[--st->count];
 }
 
+// get value by index from the top of the stack
 pst_dwarf_value* pst_dwarf_stack_get(pst_dwarf_stack* st, uint32_t idx)
 {
-    pst_dwarf_value* value = NULL;
-    struct list_node  *pos;
-    list_for_each_entry(value, pos, &st->values, node) {
-        if(!idx) {
-            break;
-        }
-        idx--;
+    if(idx >= st->count) {
+        return NULL;
     }
 
-    return value;
+    return &st->values[st->count - idx - 1];
 }
 
 bool pst_dwarf_stack_get_value(pst_dwarf_stack* st, uint64_t* value)
 {
     assert(st && value);
 
-    if(!list_count(&st->values)) {
+    if(!st->count) {
         return false;
     }
 
@@ -155,8 +118,12 @@ bool pst_dwarf_stack_get_value(pst_dwarf_stack* st, uint64_t* value)
             return false;
         }
     } else if(v->type & DWARF_TYPE_MEMORY_LOC) {
-        // dereference memory location
-        *value = *((uint64_t*)v->value.uint64);
+        // dereference memory location, address may be garbage
+        if(!pst_safe_read(value, v->value.uint64, sizeof(*value))) {
+            pst_log(SEVERITY_WARNING, "Failed to read memory location at address 0x%lX", v->value.uint64);
+            st->faults++;
+            return false;
+        }
     } else {
         *value = v->value.uint64;
     }
@@ -166,39 +133,37 @@ bool pst_dwarf_stack_get_value(pst_dwarf_stack* st, uint64_t* value)
 
 void pst_dwarf_stack_clear(pst_dwarf_stack* st)
 {
-    pst_dwarf_value*  value = NULL;
-    struct list_node  *pos, *tn;
-    list_for_each_entry_safe(value, pos, tn, &st->values, node) {
-        list_del(&value->node);
-        pst_dwarf_value_fini(value);
-    }
-
-    pst_dwarf_op* op = NULL;
-    list_for_each_entry_safe(op, pos, tn, &st->expr, node) {
-        list_del(&op->node);
-        pst_dwarf_op_fini(op);
-    }
+    st->count = 0;
+    st->next = 0;
+    st->pieces.uint64 = 0;
+    st->piece_bits = 0;
+    st->faults = 0;
 }
 
-bool pst_dwarf_stack_calc(pst_dwarf_stack* st, Dwarf_Op *exprs, int expr_len, Dwarf_Attribute* attr, pst_function* fun)
+static bool run(pst_dwarf_stack* st, const pst_dwarf_program* prog, Dwarf_Attribute* attr, pst_function* fun)
 {
-    pst_dwarf_stack_clear(st);
+    if(prog->max_depth > PST_DWARF_STACK_SIZE) {
+        pst_log(SEVERITY_ERROR, "DWARF expression requires %u values on the stack", prog->max_depth);
+        return false;
+    }
 
-    for (int i = 0; i < expr_len; i++) {
-        const dwarf_op_map* map = find_op_map(exprs[i].atom);
-        if(!map) {
-            pst_log(SEVERITY_ERROR, "Unknown operation type 0x%hhX(0x%lX, 0x%lX)", exprs[i].atom, exprs[i].number, exprs[i].number2);
+    for(uint32_t steps = 0; st->next < prog->count; ++steps) {
+        if(steps == PST_DWARF_STACK_STEPS) {
+            pst_log(SEVERITY_ERROR, "DWARF expression doesn't terminate");
             return false;
         }
 
-        pst_new(pst_dwarf_op, op, exprs[i].atom, exprs[i].number, exprs[i].number2);
-        list_add_bottom(&st->expr, &op->node);
+        const pst_dwarf_insn* insn = &prog->insns[st->next++];
+        if(st->count < insn->need) {
+            pst_log(SEVERITY_ERROR, "DWARF stack underflow at %s operation", insn->map->op_name);
+            return false;
+        }
 
         pst_dwarf_value* v = pst_dwarf_stack_get(st, 0);
         // dereference register location there if it is not last in stack
         if(v && (v->type & DWARF_TYPE_REGISTER_LOC)) {
             unw_word_t value = 0;
-            uint64_t regno = *((uint64_t*)v->value.uint64);
+            uint64_t regno = v->value.uint64;
             int ret = unw_get_reg(st->ctx->curr_frame, regno, &value);
             if(ret) {
                 pst_log(SEVERITY_ERROR, "Failed to ger value of register 0x%X. Error: %d", regno, ret);
@@ -208,7 +173,7 @@ bool pst_dwarf_stack_calc(pst_dwarf_stack* st, Dwarf_Op *exprs, int expr_len, Dw
         }
 
         // handle there because it contains sub-expression of a Location in caller's frame
-        if(map->op_num == DW_OP_GNU_entry_value) {
+        if(insn->map->op_num == DW_OP_GNU_entry_value || insn->map->op_num == DW_OP_entry_value) {
             if(!fun || !fun->parent) {
                 pst_log(SEVERITY_ERROR, "Cannot calculate DW_OP_GNU_entry_value expression while function and it's caller is undefined");
                 return false;
@@ -217,7 +182,7 @@ bool pst_dwarf_stack_calc(pst_dwarf_stack* st, Dwarf_Op *exprs, int expr_len, Dw
             // This opcode has two operands, the first one is uleb128 length and the second is block of that length, containing either a
             // simple register or DWARF expression
             Dwarf_Attribute attr_mem;
-            if(!dwarf_getlocation_attr(attr, exprs, &attr_mem)) {
+            if(!dwarf_getlocation_attr(attr, insn->src, &attr_mem)) {
                 Dwarf_Op *expr;
                 size_t exprlen;
                 if (dwarf_getlocation(&attr_mem, &expr, &exprlen) == 0) {
@@ -249,22 +214,57 @@ bool pst_dwarf_stack_calc(pst_dwarf_stack* st, Dwarf_Op *exprs, int expr_len, Dw
             }
         }
 
-        if(!map->operation(st, map, exprs[i].number, exprs[i].number2)) {
-            pst_log(SEVERITY_ERROR, "Failed to calculate %s(0x%lX, 0x%lX) operation", map->op_name, exprs[i].number, exprs[i].number2);
+        if(!insn->operation(st, insn->map, insn->op1, insn->op2)) {
+            pst_log(SEVERITY_ERROR, "Failed to calculate %s(0x%lX, 0x%lX) operation", insn->map->op_name, insn->op1, insn->op2);
             return false;
         }
 
     }
 
+    // value described by pieces replaces their locations
+    if(st->piece_bits) {
+        st->count = 0;
+        return pst_dwarf_stack_push(st, &st->pieces, sizeof(st->pieces), DWARF_TYPE_GENERIC);
+    }
+
     return true;
 }
 
+bool pst_dwarf_stack_calc(pst_dwarf_stack* st, Dwarf_Op *exprs, int expr_len, Dwarf_Attribute* attr, pst_function* fun)
+{
+    pst_dwarf_stack_clear(st);
+
+    // expressions are compiled once per session, CFA rules included
+    if(st->ctx->session) {
+        const pst_dwarf_program* prog = pst_dwarf_program_cache_get(&st->ctx->session->programs, exprs, expr_len, attr);
+        return prog ? run(st, prog, attr, fun) : false;
+    }
+
+    // without session program is compiled into arena on the stack, so it neither allocates memory nor depends on size of custom arena
+    char scratch[PST_DWARF_PROGRAM_SCRATCH];
+    pst_allocator arena;
+    pst_alloc_init_custom(&arena, scratch, sizeof(scratch));
+
+    pst_dwarf_program* prog = pst_dwarf_program_new(&arena, exprs, expr_len, attr);
+    bool ret = prog && run(st, prog, attr, fun);
+    pst_alloc_fini(&arena);
+
+    return ret;
+}
+
+// evaluate already compiled expression
+bool pst_dwarf_stack_run(pst_dwarf_stack* st, const pst_dwarf_program* prog, Dwarf_Attribute* attr, pst_function* fun)
+{
+    pst_dwarf_stack_clear(st);
+
+    return run(st, prog, attr, fun);
+}
+
 void pst_dwarf_stack_init(pst_dwarf_stack* st, pst_context* ctx)
 {
     pst_assert(st && ctx);
 
-    list_head_init(&st->expr);
-    list_head_init(&st->values);
+    pst_dwarf_stack_clear(st);
     st->ctx = ctx;
     st->allocated = false;
 }
@@ -15,6 +15,7 @@
 #include "context.h"
 #include "utils/allocator.h"
 #include "dwarf/dwarf_function.h"
+#include "dwarf/dwarf_program.h"
 
 // -----------------------------------------------------------------------------------
 // DWARF Stack value
@@ -58,27 +59,30 @@ typedef union {
     void*       ptr;
 } pst_sized_value;
 
+// typed slot of DWARF stack
 typedef struct {
-    list_node            node;       // uplink
-
-    // fields
     pst_sized_value     value;      // value itself
     int                 type;       // value type. bitmask of DWARF_TYPE_XXX
-    bool                allocated;
 } pst_dwarf_value;
 
-void pst_dwarf_value_init(pst_dwarf_value* value, char* v, uint32_t s, int t);
-pst_dwarf_value* pst_dwarf_value_new(char* v, uint32_t s, int t);
-void pst_dwarf_value_fini(pst_dwarf_value* value);
 void pst_dwarf_value_set(pst_dwarf_value* value, void* v, uint32_t s, int t);
 
 // -----------------------------------------------------------------------------------
 // DWARF stack
 // -----------------------------------------------------------------------------------
 
+#define PST_DWARF_STACK_SIZE    (32)    // maximum number of values on DWARF stack
+#define PST_DWARF_STACK_STEPS   (4096)  // maximum number of operations executed by one evaluation, guards against loops
+
+// Values are kept in the array inside of the stack object, so evaluation of expression doesn't allocate memory.
+// Pointers returned by pst_dwarf_stack_get() and pst_dwarf_stack_pop() are valid till the next push.
 typedef struct __pst_dwarf_stack {
-    list_head                   expr;       // DWARF expression
-    list_head                   values;     // list of values on the stack
+    pst_dwarf_value             values[PST_DWARF_STACK_SIZE]; // values on the stack, the last one is the top
+    uint32_t                    count;      // number of values on the stack
+    uint32_t                    next;       // index of the next operation of evaluated program, changed by branches
+    pst_sized_value             pieces;     // composite value assembled by DW_OP_piece and DW_OP_bit_piece
+    uint32_t                    piece_bits; // number of bits described by pieces so far
+    uint32_t                    faults;     // number of failed reads of memory during evaluation
     pst_context*                ctx;        // context of execution
     bool                        allocated;  // whether this object was allocated or not
 } pst_dwarf_stack;
@@ -88,11 +92,11 @@ pst_dwarf_stack* pst_dwarf_stack_new(pst_context* ctx);
 void pst_dwarf_stack_fini(pst_dwarf_stack* st);
 
 bool pst_dwarf_stack_calc(pst_dwarf_stack* st, Dwarf_Op *exprs, int expr_len, Dwarf_Attribute* attr, pst_function* fun);
+bool pst_dwarf_stack_run(pst_dwarf_stack* st, const pst_dwarf_program* prog, Dwarf_Attribute* attr, pst_function* fun);
 void pst_dwarf_stack_clear(pst_dwarf_stack* st);
 bool pst_dwarf_stack_get_value(pst_dwarf_stack* st, uint64_t* value);
 pst_dwarf_value* pst_dwarf_stack_get(pst_dwarf_stack* st, uint32_t idx);
 pst_dwarf_value* pst_dwarf_stack_pop(pst_dwarf_stack* st);
-void pst_dwarf_stack_push_value(pst_dwarf_stack* st, pst_dwarf_value* value);
-void pst_dwarf_stack_push(pst_dwarf_stack* st, void* v, uint32_t s, int t);
+bool pst_dwarf_stack_push(pst_dwarf_stack* st, void* v, uint32_t s, int t);
 
 #endif /* __PST_DWARF_STACK_H__ */
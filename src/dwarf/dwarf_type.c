@@ -0,0 +1,437 @@
+/*
+ * dwarf_type.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <string.h>
+#include <dwarf.h>
+
+#include "context.h"
+#include "dwarf_type.h"
+
+static const pst_type void_level = { "void", PARAM_TYPE_VOID };
+const pst_type_desc pst_type_void = {
+        .dwarf      = NULL,
+        .offset     = 0,
+        .name       = "void",
+        .size       = 0,
+        .flags      = PARAM_TYPE_VOID,
+        .subroutine = 0,
+        .composite  = 0,
+        .count      = 1,
+        .levels     = &void_level,
+        .layout     = NULL,
+};
+
+static inline uint32_t hash_key(Dwarf* dwarf, Dwarf_Off offset)
+{
+    return (uint32_t)(((((uintptr_t)dwarf >> 4) ^ offset) * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+bool pst_type_cache_init(pst_type_cache* c, pst_allocator* alloc)
+{
+    c->alloc = alloc;
+    c->types = NULL;
+    c->size = 0;
+    c->count = 0;
+
+    return true;
+}
+
+void pst_type_cache_fini(pst_type_cache* c)
+{
+    if(c->types) {
+        for(uint32_t i = 0; i < c->size; ++i) {
+            if(c->types[i]) {
+                if(c->types[i]->layout) {
+                    c->alloc->free(c->alloc, (void*)c->types[i]->layout);
+                }
+                c->alloc->free(c->alloc, c->types[i]);
+            }
+        }
+
+        c->alloc->free(c->alloc, c->types);
+        c->types = NULL;
+    }
+
+    c->size = 0;
+    c->count = 0;
+}
+
+static bool grow(pst_type_cache* c)
+{
+    if(c->types && (c->count + 1) * 2 < c->size) {
+        return true;
+    }
+
+    uint32_t size = c->size ? c->size * 2 : 1024;
+    pst_type_desc** types = (pst_type_desc**)c->alloc->alloc(c->alloc, size * sizeof(pst_type_desc*));
+    if(!types) {
+        pst_log(SEVERITY_ERROR, "Failed to allocate %u slots of type cache", size);
+        return false;
+    }
+    memset(types, 0, size * sizeof(pst_type_desc*));
+
+    for(uint32_t i = 0; i < c->size; ++i) {
+        if(c->types[i]) {
+            uint32_t idx = hash_key(c->types[i]->dwarf, c->types[i]->offset) & (size - 1);
+            while(types[idx]) {
+                idx = (idx + 1) & (size - 1);
+            }
+            types[idx] = c->types[i];
+        }
+    }
+
+    if(c->types) {
+        c->alloc->free(c->alloc, c->types);
+    }
+    c->types = types;
+    c->size = size;
+
+    return true;
+}
+
+// level of type definition described by DIE, returns false if DIE doesn't add anything to the type
+static bool describe_level(Dwarf_Die* die, pst_type* level)
+{
+    level->name = NULL;
+    level->type = 0;
+
+    switch(dwarf_tag(die)) {
+        // base types
+        case DW_TAG_base_type: {
+            level->name = dwarf_diename(die);
+            Dwarf_Attribute attr_mem;
+            Dwarf_Word enc_type = 0;
+            if(dwarf_formudata(dwarf_attr(die, DW_AT_encoding, &attr_mem), &enc_type)) {
+                break;
+            }
+            switch (enc_type) {
+                case DW_ATE_boolean:
+                    level->type = PARAM_TYPE_BOOL;
+                    break;
+                case DW_ATE_address:
+                    level->name = NULL;
+                    level->type = PARAM_TYPE_POINTER;
+                    break;
+                case DW_ATE_signed:
+                    level->type = PARAM_TYPE_INT;
+                    break;
+                case DW_ATE_unsigned:
+                    level->type = PARAM_TYPE_UINT;
+                    break;
+                case DW_ATE_signed_char:
+                    level->type = PARAM_TYPE_CHAR;
+                    break;
+                case DW_ATE_unsigned_char:
+                    level->type = PARAM_TYPE_UCHAR;
+                    break;
+                case DW_ATE_float:
+                case DW_ATE_complex_float:
+                case DW_ATE_imaginary_float:
+                case DW_ATE_decimal_float:
+                    level->type = PARAM_TYPE_FLOAT;
+                    break;
+                default:
+                    pst_log(SEVERITY_WARNING, "Unknown parameter base type encodings 0x%lX", enc_type);
+                    break;
+            }
+            break;
+        }
+        // complex types
+        case DW_TAG_array_type:
+            level->type = PARAM_TYPE_ARRAY;
+            break;
+        case DW_TAG_structure_type:
+            level->type = PARAM_TYPE_STRUCT;
+            break;
+        case DW_TAG_union_type:
+            level->type = PARAM_TYPE_UNION;
+            break;
+        case DW_TAG_class_type:
+            level->type = PARAM_TYPE_CLASS;
+            break;
+        case DW_TAG_pointer_type:
+            level->type = PARAM_TYPE_POINTER;
+            break;
+        case DW_TAG_enumeration_type:
+            level->type = PARAM_TYPE_ENUM;
+            break;
+        case DW_TAG_const_type:
+            level->type = PARAM_CONST;
+            break;
+        case DW_TAG_subroutine_type:
+            level->type = PARAM_TYPE_FUNCPTR;
+            break;
+        case DW_TAG_typedef:
+            level->name = dwarf_diename(die);
+            level->type = PARAM_TYPE_TYPEDEF;
+            break;
+        case DW_TAG_unspecified_type:
+            level->name = "void";
+            level->type = PARAM_TYPE_VOID;
+            break;
+        case DW_TAG_reference_type:
+            level->type = PARAM_TYPE_REF;
+            break;
+        case DW_TAG_rvalue_reference_type:
+            level->type = PARAM_TYPE_RREF;
+            break;
+        case DW_TAG_volatile_type:
+            level->type = PARAM_VOLATILE;
+            break;
+        case DW_TAG_string_type:
+            pst_log(SEVERITY_DEBUG, "String type, skipping");
+            break;
+        default:
+            pst_log(SEVERITY_WARNING, "Unknown 0x%X tag type", dwarf_tag(die));
+            break;
+    }
+
+    return level->type != 0;
+}
+
+// walk chain of DW_AT_type references starting at type DIE and flatten it into the new descriptor
+static pst_type_desc* describe(pst_type_cache* c, Dwarf_Die* die, Dwarf* dwarf, Dwarf_Off offset)
+{
+    pst_type levels[PST_TYPE_DEPTH];
+    uint32_t count = 0;
+    const char* name = NULL;
+    Dwarf_Word size = 8;
+    pst_param_flags flags = 0;
+    Dwarf_Off subroutine = 0;
+    Dwarf_Off composite = 0;
+
+    Dwarf_Die type = *die;
+    for(uint32_t depth = 0; depth < PST_TYPE_DEPTH; ++depth) {
+        // size of the innermost level wins
+        Dwarf_Attribute attr_mem;
+        size = 8;
+        Dwarf_Attribute* attr = dwarf_attr(&type, DW_AT_byte_size, &attr_mem);
+        if(attr) {
+            dwarf_formudata(attr, &size);
+        }
+
+        if(describe_level(&type, &levels[count])) {
+            flags |= levels[count].type;
+            if(!name) {
+                name = levels[count].name;
+            }
+            if(levels[count].type == PARAM_TYPE_FUNCPTR && !subroutine) {
+                subroutine = dwarf_dieoffset(&type);
+            }
+            if((levels[count].type & (PARAM_TYPE_STRUCT | PARAM_TYPE_UNION | PARAM_TYPE_CLASS)) && !composite) {
+                composite = dwarf_dieoffset(&type);
+            }
+            count++;
+        }
+
+        attr = dwarf_attr(&type, DW_AT_type, &attr_mem);
+        if(!attr) {
+            break;
+        }
+
+        if(!dwarf_formref_die(attr, &type)) {
+            pst_log(SEVERITY_ERROR, "Failed to get parameter type DIE");
+            break;
+        }
+    }
+
+    pst_type_desc* d = (pst_type_desc*)c->alloc->alloc(c->alloc, sizeof(pst_type_desc) + count * sizeof(pst_type));
+    if(!d) {
+        pst_log(SEVERITY_ERROR, "Failed to allocate type descriptor");
+        return NULL;
+    }
+
+    pst_type* copy = (pst_type*)(d + 1);
+    memcpy(copy, levels, count * sizeof(pst_type));
+
+    d->dwarf = dwarf;
+    d->offset = offset;
+    d->name = name;
+    d->size = size;
+    d->flags = flags;
+    d->subroutine = subroutine;
+    d->composite = composite;
+    d->count = count;
+    d->levels = copy;
+    d->layout = NULL;
+
+    pst_log(SEVERITY_DEBUG, "Type '%s'(%lu) flags = 0x%X, %u levels", name ? name : "", size, flags, count);
+
+    return d;
+}
+
+// get descriptor of the type DIE, describe and cache it in case of miss
+const pst_type_desc* pst_type_cache_get(pst_type_cache* c, Dwarf_Die* die)
+{
+    if(!grow(c)) {
+        return NULL;
+    }
+
+    Dwarf* dwarf = dwarf_cu_getdwarf(die->cu);
+    Dwarf_Off offset = dwarf_dieoffset(die);
+
+    uint32_t idx = hash_key(dwarf, offset) & (c->size - 1);
+    for(; c->types[idx]; idx = (idx + 1) & (c->size - 1)) {
+        if(c->types[idx]->dwarf == dwarf && c->types[idx]->offset == offset) {
+            return c->types[idx];
+        }
+    }
+
+    pst_type_desc* d = describe(c, die, dwarf, offset);
+    if(d) {
+        c->types[idx] = d;
+        c->count++;
+    }
+
+    return d;
+}
+
+// offset of member from DW_AT_data_member_location, which is either a constant or DW_OP_plus_uconst expression (DWARF 2).
+// returns false for location which depends on object, i.e. of virtual base class
+static bool member_offset(Dwarf_Die* die, Dwarf_Word* offset)
+{
+    *offset = 0;
+
+    Dwarf_Attribute attr_mem;
+    Dwarf_Attribute* attr = dwarf_attr(die, DW_AT_data_member_location, &attr_mem);
+    if(!attr) {
+        // members of union and bitfields of DWARF 4 have no location
+        return true;
+    }
+
+    if(dwarf_formudata(attr, offset) == 0) {
+        return true;
+    }
+
+    Dwarf_Op* expr;
+    size_t exprlen;
+    if(dwarf_getlocation(attr, &expr, &exprlen) == 0 && exprlen == 1 && expr[0].atom == DW_OP_plus_uconst) {
+        *offset = expr[0].number;
+        return true;
+    }
+
+    return false;
+}
+
+// position of bitfield. DWARF 4 counts DW_AT_data_bit_offset from the start of object, while DWARF 2 counts DW_AT_bit_offset
+// from the most significant bit of storage unit of DW_AT_byte_size bytes
+static void member_bits(Dwarf_Die* die, pst_type_member* m)
+{
+    Dwarf_Attribute attr_mem;
+    Dwarf_Word bit_size = 0;
+    if(dwarf_formudata(dwarf_attr(die, DW_AT_bit_size, &attr_mem), &bit_size) || !bit_size || bit_size > 64) {
+        return;
+    }
+
+    Dwarf_Word bit_offset = 0;
+    if(dwarf_formudata(dwarf_attr(die, DW_AT_data_bit_offset, &attr_mem), &bit_offset) == 0) {
+        m->offset += bit_offset / 8;
+        m->bit_offset = bit_offset % 8;
+        m->bit_size = bit_size;
+    } else if(dwarf_formudata(dwarf_attr(die, DW_AT_bit_offset, &attr_mem), &bit_offset) == 0) {
+        Dwarf_Word storage = m->type->size;
+        dwarf_formudata(dwarf_attr(die, DW_AT_byte_size, &attr_mem), &storage);
+        if(bit_offset + bit_size > storage * 8) {
+            return;
+        }
+        Dwarf_Word lsb = storage * 8 - bit_offset - bit_size;
+        m->offset += lsb / 8;
+        m->bit_offset = lsb % 8;
+        m->bit_size = bit_size;
+    }
+}
+
+// whether child DIE of composite type is member stored in object or its base class
+static bool is_member(Dwarf_Die* child)
+{
+    int tag = dwarf_tag(child);
+    if(tag != DW_TAG_member && tag != DW_TAG_inheritance) {
+        return false;
+    }
+
+    // static members of DWARF 4 are declarations, their values aren't in object
+    return !dwarf_hasattr(child, DW_AT_declaration) && !dwarf_hasattr(child, DW_AT_external);
+}
+
+// describe members of composite type DIE. members are counted first and built right in the layout, which is allocated at once
+static pst_type_layout* describe_layout(pst_type_cache* c, Dwarf_Die* die)
+{
+    uint32_t max = 0;
+    Dwarf_Die child;
+    if(dwarf_child(die, &child) == 0) {
+        do {
+            if(is_member(&child)) {
+                max++;
+            }
+        } while(dwarf_siblingof(&child, &child) == 0);
+    }
+
+    if(max > PST_TYPE_MEMBERS) {
+        pst_log(SEVERITY_WARNING, "Type '%s' has more than %u members", dwarf_diename(die), PST_TYPE_MEMBERS);
+        max = PST_TYPE_MEMBERS;
+    }
+
+    pst_type_layout* l = (pst_type_layout*)c->alloc->alloc(c->alloc, sizeof(pst_type_layout) + max * sizeof(pst_type_member));
+    if(!l) {
+        pst_log(SEVERITY_ERROR, "Failed to allocate layout of type");
+        return NULL;
+    }
+
+    pst_type_member* members = (pst_type_member*)(l + 1);
+    uint32_t count = 0;
+    if(max && dwarf_child(die, &child) == 0) {
+        do {
+            if(!is_member(&child)) {
+                continue;
+            }
+
+            Dwarf_Attribute attr_mem;
+            Dwarf_Die type;
+            if(!dwarf_formref_die(dwarf_attr(&child, DW_AT_type, &attr_mem), &type)) {
+                continue;
+            }
+
+            pst_type_member* m = &members[count];
+            m->name = dwarf_diename(&child);
+            m->base = (dwarf_tag(&child) == DW_TAG_inheritance);
+            m->bit_offset = 0;
+            m->bit_size = 0;
+            m->type = pst_type_cache_get(c, &type);
+            if(!m->type || !member_offset(&child, &m->offset)) {
+                continue;
+            }
+            member_bits(&child, m);
+            count++;
+        } while(count < max && dwarf_siblingof(&child, &child) == 0);
+    }
+
+    l->count = count;
+    l->members = members;
+
+    pst_log(SEVERITY_DEBUG, "Layout of type '%s': %u members", dwarf_diename(die), count);
+
+    return l;
+}
+
+// get members of composite type, describe them on first use. layout is attached to descriptor, so it's built once per type DIE
+const pst_type_layout* pst_type_cache_layout(pst_type_cache* c, const pst_type_desc* type)
+{
+    if(type->layout || !type->composite) {
+        return type->layout;
+    }
+
+    Dwarf_Die die;
+    if(!dwarf_offdie(type->dwarf, type->composite, &die)) {
+        pst_log(SEVERITY_ERROR, "Failed to get composite type DIE");
+        return NULL;
+    }
+
+    // descriptors are owned by the cache, so the only place which modifies them is there
+    ((pst_type_desc*)type)->layout = describe_layout(c, &die);
+
+    return type->layout;
+}
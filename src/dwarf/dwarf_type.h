@@ -0,0 +1,85 @@
+/*
+ * dwarf_type.h
+ *
+ * Interned descriptions of types of parameters and variables
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_DWARF_TYPE_H__
+#define __PST_DWARF_TYPE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <elfutils/libdw.h>
+
+#include "libpst-types.h"
+#include "utils/allocator.h"
+
+#define PST_TYPE_DEPTH      (32)    // maximum number of levels of type definition
+#define PST_TYPE_MEMBERS    (256)   // maximum number of members of structure, union or class in layout
+
+// level of type definition, i.e. 'const', 'typedef uint32_t', 'unsigned int'
+typedef struct pst_type {
+    const char*         name;       // type name, NULL if level has no name. owned by libdw
+    pst_param_flags     type;       // type bit
+} pst_type;
+
+struct pst_type_layout;
+
+// -----------------------------------------------------------------------------------
+// pst_type_desc
+// -----------------------------------------------------------------------------------
+// Chain of DW_AT_type references starting at type DIE, flattened into array of levels. Descriptors are immutable (except for layout,
+// which is attached once on first use) and shared by all parameters of the type.
+typedef struct pst_type_desc {
+    Dwarf*              dwarf;      // debug information containing type DIE
+    Dwarf_Off           offset;     // offset of type DIE
+    const char*         name;       // name of the first named level, NULL if there is none
+    Dwarf_Word          size;       // size of value of the innermost level in bytes
+    pst_param_flags     flags;      // bitmask of types of all levels
+    Dwarf_Off           subroutine; // offset of DW_TAG_subroutine_type DIE of the chain, 0 if there is none
+    Dwarf_Off           composite;  // offset of structure, union or class DIE of the chain, 0 if there is none
+    uint32_t            count;      // number of items in 'levels'
+    const pst_type*     levels;     // levels from the outermost one
+    const struct pst_type_layout* layout; // members of composite type, built by pst_type_cache_layout() on first use
+} pst_type_desc;
+
+// member of structure, union or class, or its base class
+typedef struct pst_type_member {
+    const char*             name;       // member name, NULL for anonymous member and base class. owned by libdw
+    const pst_type_desc*    type;       // type of member
+    Dwarf_Word              offset;     // offset of the first byte of member from the start of object
+    uint32_t                bit_offset; // offset of bitfield from the least significant bit of the first byte
+    uint32_t                bit_size;   // size of bitfield in bits, 0 if member isn't bitfield
+    bool                    base;       // whether member is base class (DW_TAG_inheritance)
+} pst_type_member;
+
+// layout of composite type, shared by all parameters of the type like its descriptor
+typedef struct pst_type_layout {
+    uint32_t                count;      // number of items in 'members'
+    const pst_type_member*  members;    // members in order of declaration, base classes first
+} pst_type_layout;
+
+extern const pst_type_desc pst_type_void;   // 'void' type, which DWARF represents by absence of DW_AT_type
+
+// -----------------------------------------------------------------------------------
+// pst_type_cache
+// -----------------------------------------------------------------------------------
+// Open addressing set of type descriptors keyed by (debug information, DIE offset). Descriptors are never evicted, so parameters
+// point at them while handler holds the session. Caller must hold session lock.
+typedef struct pst_type_cache {
+    pst_allocator*      alloc;      // allocator for descriptors
+    pst_type_desc**     types;      // descriptors indexed by hash of key
+    uint32_t            size;       // number of slots in 'types', power of two
+    uint32_t            count;      // number of used slots in 'types'
+} pst_type_cache;
+
+bool pst_type_cache_init(pst_type_cache* c, pst_allocator* alloc);
+void pst_type_cache_fini(pst_type_cache* c);
+
+const pst_type_desc* pst_type_cache_get(pst_type_cache* c, Dwarf_Die* die);
+const pst_type_layout* pst_type_cache_layout(pst_type_cache* c, const pst_type_desc* type);
+
+#endif /* __PST_DWARF_TYPE_H__ */
@@ -10,6 +10,8 @@
 #include "dwarf_utils.h"
 #include "dwarf_stack.h"
 #include "dwarf_function.h"
+#include "dwarf_loclist.h"
+#include "session.h"
 
 
 bool is_location_form(int form)
@@ -45,32 +47,42 @@ bool handle_location(pst_context* ctx, Dwarf_Attribute* attr, pst_dwarf_expr* lo
         if(dwarf_getlocation(attr, &expr, &exprlen) == 0) {
             pst_dwarf_expr_setup(loc, expr, exprlen);
             ctx->print_expr(ctx, expr, exprlen, attr);
-            ret = pst_dwarf_stack_calc(&stack, expr, exprlen, attr, fun);
-            pst_dwarf_stack_get_value(&stack, &loc->value);
+            ret = pst_dwarf_stack_calc(&stack, expr, exprlen, attr, fun) && pst_dwarf_stack_get_value(&stack, &loc->value);
         }
     } else if(dwarf_hasform(attr, DW_FORM_sec_offset)) {
-        // Location list (loclist class of location in DWARF terms)
-        Dwarf_Addr base, start, end;
-        ptrdiff_t off = 0;
+        // Location list (loclist class of location in DWARF terms). it's decoded and compiled once per session, so just find the location
+        // of current PC offset. without session the list is decoded for this call only
+        pst_dwarf_loclist* own = NULL;
+        const pst_dwarf_loclist* list = NULL;
+        if(ctx->session) {
+            list = pst_dwarf_loclist_cache_get(&ctx->session->loclists, attr);
+        } else {
+            list = own = pst_dwarf_loclist_new(&allocator, attr);
+        }
 
-        // handle list of possible locations of parameter
-        for(int i = 0; (off = dwarf_getlocations (attr, off, &base, &start, &end, &expr, &exprlen)) > 0; ++i) {
-            ctx->print_expr(ctx, expr, exprlen, attr);
-            if(offset >= start && offset <= end) {
-                pst_dwarf_expr_setup(loc, expr, exprlen);
-                // actual location, try to calculate Location expression
-                ret = pst_dwarf_stack_calc(&stack, expr, exprlen, attr, fun);
-                pst_dwarf_stack_get_value(&stack, &loc->value);
-            } else {
-                // Location skipped due to don't match current PC offset
-                pst_log(SEVERITY_DEBUG, "Skip Location list expression: [%d] (low_offset: 0x%" PRIx64 ", high_offset: 0x%" PRIx64 "), \"%s\"", i, start, end, ctx->buff);
+        const pst_dwarf_loc* l = list ? pst_dwarf_loclist_find(list, offset) : NULL;
+        if(l) {
+            pst_dwarf_expr_setup(loc, l->exprs, l->expr_len);
+            ctx->print_expr(ctx, l->exprs, l->expr_len, attr);
+            if(l->program) {
+                ret = pst_dwarf_stack_run(&stack, l->program, attr, fun) && pst_dwarf_stack_get_value(&stack, &loc->value);
             }
+        } else {
+            pst_log(SEVERITY_DEBUG, "No location of PC offset 0x%" PRIx64 " in location list", offset);
         }
 
+        if(own) {
+            pst_dwarf_loclist_del(&allocator, own);
+        }
     } else {
         pst_log(SEVERITY_WARNING, "Unknown location attribute form = 0x%X, code = 0x%X, ", attr->form, attr->code);
     }
 
+    // value of object which doesn't fit into generic type is read by the caller
+    pst_dwarf_value* top = pst_dwarf_stack_get(&stack, 0);
+    loc->address = (ret && top && (top->type & DWARF_TYPE_MEMORY_LOC)) ? top->value.uint64 : 0;
+    loc->in_value = ret && top && ((top->type & DWARF_TYPE_REGISTER_LOC) || stack.piece_bits);
+    loc->faulted = (stack.faults != 0);
     pst_dwarf_stack_fini(&stack);
 
     return ret;
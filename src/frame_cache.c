@@ -0,0 +1,204 @@
+/*
+ * frame_cache.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <dwarf.h>
+
+#include "context.h"
+#include "frame_cache.h"
+
+bool pst_frame_cache_init(pst_frame_cache* c, pst_allocator* alloc)
+{
+    c->alloc = alloc;
+    c->modules_count = 0;
+    c->rules_count = 0;
+    c->clock = 0;
+
+    c->rules = (pst_frame_rule*)alloc->alloc(alloc, PST_FRAME_CACHE_SIZE * sizeof(pst_frame_rule));
+    if(!c->rules) {
+        pst_log(SEVERITY_ERROR, "Failed to allocate frame cache");
+        return false;
+    }
+
+    return true;
+}
+
+void pst_frame_cache_fini(pst_frame_cache* c)
+{
+    if(c->rules) {
+        for(uint32_t i = 0; i < c->rules_count; ++i) {
+            // use free() here because it was allocated out of our control by libdw
+            free(c->rules[i].frame);
+        }
+
+        c->alloc->free(c->alloc, c->rules);
+        c->rules = NULL;
+    }
+
+    // CFI handles are owned by libdwfl's modules
+    c->modules_count = 0;
+    c->rules_count = 0;
+}
+
+// get CFI of the module, .eh_frame is preferred over .debug_frame
+Dwarf_CFI* pst_frame_cache_cfi(pst_frame_cache* c, Dwfl_Module* module, Dwarf_Addr* bias)
+{
+    for(uint32_t i = 0; i < c->modules_count; ++i) {
+        if(c->modules[i].module == module) {
+            *bias = c->modules[i].bias;
+            return c->modules[i].cfi;
+        }
+    }
+
+    *bias = 0;
+    Dwarf_CFI* cfi = dwfl_module_eh_cfi(module, bias);
+    if(!cfi) {
+        cfi = dwfl_module_dwarf_cfi(module, bias);
+    }
+
+    // modules without CFI are remembered too, so that they aren't searched for it again
+    if(c->modules_count < PST_FRAME_CACHE_MODULES) {
+        pst_module_cfi* m = &c->modules[c->modules_count++];
+        m->module = module;
+        m->cfi = cfi;
+        m->bias = *bias;
+    }
+
+    return cfi;
+}
+
+// index of the first rule which starts after 'pc'
+static uint32_t upper_bound(pst_frame_cache* c, Dwarf_Addr pc)
+{
+    uint32_t lo = 0, hi = c->rules_count;
+    while(lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if(c->rules[mid].start <= pc) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+static void evict(pst_frame_cache* c)
+{
+    uint32_t victim = 0;
+    for(uint32_t i = 1; i < c->rules_count; ++i) {
+        if(c->rules[i].used < c->rules[victim].used) {
+            victim = i;
+        }
+    }
+
+    free(c->rules[victim].frame);
+    memmove(&c->rules[victim], &c->rules[victim + 1], (c->rules_count - victim - 1) * sizeof(pst_frame_rule));
+    c->rules_count--;
+}
+
+// decode frame rules of the address
+static bool decode(pst_frame_cache* c, Dwfl_Module* module, Dwarf_Addr pc, pst_frame_rule* r)
+{
+    Dwarf_Addr bias = 0;
+    Dwarf_CFI* cfi = pst_frame_cache_cfi(c, module, &bias);
+    if(!cfi) {
+        pst_log(SEVERITY_ERROR, "Cannot find CFI for module");
+        return false;
+    }
+
+    if(dwarf_cfi_addrframe(cfi, pc - bias, &r->frame)) {
+        pst_log(SEVERITY_ERROR, "Failed to find CFI frame for module");
+        return false;
+    }
+
+    r->module = module;
+    r->start = pc - bias;
+    r->end = pc - bias;
+    r->ra_regno = dwarf_frame_info(r->frame, &r->start, &r->end, &r->signalp);
+    if(r->ra_regno < 0) {
+        // rules are known for this address only
+        r->start = pc - bias;
+        r->end = pc - bias + 1;
+        r->signalp = false;
+    }
+    r->start += bias;
+    r->end += bias;
+
+    // the most of CFA rules are DW_CFA_def_cfa(register, offset), which libdw represents as single DW_OP_bregx
+    r->cfa_regno = -1;
+    r->cfa_offset = 0;
+
+    Dwarf_Op dummy;
+    Dwarf_Op* ops = &dummy;
+    size_t nops = 0;
+    if(!dwarf_frame_cfa(r->frame, &ops, &nops) && nops == 1) {
+        if(ops[0].atom == DW_OP_bregx) {
+            r->cfa_regno = (int)ops[0].number;
+            r->cfa_offset = (int64_t)ops[0].number2;
+        } else if(ops[0].atom >= DW_OP_breg0 && ops[0].atom <= DW_OP_breg31) {
+            r->cfa_regno = ops[0].atom - DW_OP_breg0;
+            r->cfa_offset = (int64_t)ops[0].number;
+        }
+    }
+
+    return true;
+}
+
+// find frame rules of the address, decode and cache them in case of miss
+pst_frame_rule* pst_frame_cache_lookup(pst_frame_cache* c, Dwfl_Module* module, Dwarf_Addr pc)
+{
+    if(!c->rules || !module) {
+        return NULL;
+    }
+
+    c->clock++;
+
+    uint32_t idx = upper_bound(c, pc);
+    if(idx) {
+        pst_frame_rule* r = &c->rules[idx - 1];
+        if(r->module == module && pc < r->end) {
+            r->used = c->clock;
+            return r;
+        }
+    }
+
+    pst_frame_rule rule;
+    if(!decode(c, module, pc, &rule)) {
+        return NULL;
+    }
+    rule.used = c->clock;
+
+    if(c->rules_count == PST_FRAME_CACHE_SIZE) {
+        evict(c);
+    }
+
+    idx = upper_bound(c, rule.start);
+    memmove(&c->rules[idx + 1], &c->rules[idx], (c->rules_count - idx) * sizeof(pst_frame_rule));
+    c->rules[idx] = rule;
+    c->rules_count++;
+
+    return &c->rules[idx];
+}
+
+// calculate CFA of the frame without evaluation of DWARF expression. returns false if CFA rule isn't "register + offset" one
+bool pst_frame_rule_cfa(const pst_frame_rule* r, unw_cursor_t* cursor, Dwarf_Addr* cfa)
+{
+    if(r->cfa_regno < 0) {
+        return false;
+    }
+
+    unw_word_t val = 0;
+    if(unw_get_reg(cursor, r->cfa_regno, &val)) {
+        return false;
+    }
+
+    *cfa = val + r->cfa_offset;
+
+    return true;
+}
@@ -0,0 +1,65 @@
+/*
+ * frame_cache.h
+ *
+ * Cache of Call Frame Information of modules and decoded frame rules
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_FRAME_CACHE_H__
+#define __PST_FRAME_CACHE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libunwind.h>
+#include <elfutils/libdwfl.h>
+
+#include "utils/allocator.h"
+
+#define PST_FRAME_CACHE_MODULES (64)    // maximum number of modules which CFI handles are cached
+#define PST_FRAME_CACHE_SIZE    (256)   // maximum number of cached frame rules
+
+// CFI handle of the module
+typedef struct pst_module_cfi {
+    Dwfl_Module*    module;     // module
+    Dwarf_CFI*      cfi;        // .eh_frame or .debug_frame CFI of the module, NULL if module has none
+    Dwarf_Addr      bias;       // difference between addresses in CFI and in the process
+} pst_module_cfi;
+
+// decoded frame rules for the range of code addresses
+typedef struct pst_frame_rule {
+    Dwfl_Module*    module;     // module containing the range
+    Dwarf_Addr      start;      // start of the range in the process
+    Dwarf_Addr      end;        // end of the range (not included) in the process
+    Dwarf_Frame*    frame;      // frame rules, allocated by libdw and owned by the cache
+    int             ra_regno;   // number of register containing return address, -1 if unknown
+    bool            signalp;    // whether the frame is the one of signal trampoline
+    int             cfa_regno;  // register of "register + offset" CFA rule, -1 if CFA rule is an expression
+    int64_t         cfa_offset; // offset of "register + offset" CFA rule
+    uint64_t        used;       // value of cache's clock at the last access, used to evict least recently used rule
+} pst_frame_rule;
+
+// -----------------------------------------------------------------------------------
+// pst_frame_cache
+// -----------------------------------------------------------------------------------
+// Keeps CFI handle per module and least recently used frame rules sorted by PC range, so unwinding of recurring frames
+// doesn't search and decode FDE/CIE each time, and CFA of the most of frames is calculated by reading of a single register.
+// Rules are valid till they are evicted, i.e. till the next lookup. Caller must hold session lock.
+typedef struct pst_frame_cache {
+    pst_allocator*      alloc;          // allocator for rules
+    pst_module_cfi      modules[PST_FRAME_CACHE_MODULES];
+    uint32_t            modules_count;  // number of used items of 'modules'
+    pst_frame_rule*     rules;          // cached rules sorted by start of PC range
+    uint32_t            rules_count;    // number of used items of 'rules'
+    uint64_t            clock;          // incremented on each lookup
+} pst_frame_cache;
+
+bool pst_frame_cache_init(pst_frame_cache* c, pst_allocator* alloc);
+void pst_frame_cache_fini(pst_frame_cache* c);
+
+Dwarf_CFI* pst_frame_cache_cfi(pst_frame_cache* c, Dwfl_Module* module, Dwarf_Addr* bias);
+pst_frame_rule* pst_frame_cache_lookup(pst_frame_cache* c, Dwfl_Module* module, Dwarf_Addr pc);
+bool pst_frame_rule_cfa(const pst_frame_rule* r, unw_cursor_t* cursor, Dwarf_Addr* cfa);
+
+#endif /* __PST_FRAME_CACHE_H__ */
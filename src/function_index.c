@@ -0,0 +1,253 @@
+/*
+ * function_index.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <dwarf.h>
+
+#include "context.h"
+#include "function_index.h"
+
+bool pst_function_index_init(pst_function_index* idx, pst_allocator* alloc)
+{
+    idx->alloc = alloc;
+    idx->units_count = 0;
+    idx->clock = 0;
+
+    return true;
+}
+
+static void unit_fini(pst_function_index* idx, pst_unit_index* u)
+{
+    if(u->ranges) {
+        idx->alloc->free(idx->alloc, u->ranges);
+        u->ranges = NULL;
+    }
+    u->count = 0;
+}
+
+void pst_function_index_fini(pst_function_index* idx)
+{
+    for(uint32_t i = 0; i < idx->units_count; ++i) {
+        unit_fini(idx, &idx->units[i]);
+    }
+    idx->units_count = 0;
+}
+
+// index of the innermost range containing 'pc', -1 if there is none
+int32_t pst_unit_index_find(const pst_unit_index* u, Dwarf_Addr pc)
+{
+    // the last range which starts at or before 'pc'
+    uint32_t lo = 0, hi = u->count;
+    while(lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if(u->ranges[mid].start <= pc) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // any range containing 'pc' encloses the found one, so go up till the first of them
+    int32_t i = (int32_t)lo - 1;
+    while(i >= 0 && u->ranges[i].end <= pc) {
+        i = u->ranges[i].parent;
+    }
+
+    return i;
+}
+
+static int compare_ranges(const void* a, const void* b)
+{
+    const pst_function_range* l = (const pst_function_range*)a;
+    const pst_function_range* r = (const pst_function_range*)b;
+
+    if(l->start != r->start) {
+        return l->start < r->start ? -1 : 1;
+    }
+
+    // enclosing range first
+    if(l->end != r->end) {
+        return l->end > r->end ? -1 : 1;
+    }
+
+    // DIE of enclosing function goes before DIEs of its children
+    return l->offset < r->offset ? -1 : (l->offset > r->offset);
+}
+
+static bool add_ranges(pst_function_index* idx, pst_unit_index* u, uint32_t* size, Dwarf_Die* d, bool inlined, Dwarf_Files* files)
+{
+    // inlined function has name and declaration in its abstract origin and location of the call in itself. strings are owned by libdw
+    const char* name = NULL;
+    const char* call_file = NULL;
+    int call_line = -1;
+    if(inlined) {
+        Dwarf_Attribute attr_mem;
+        Dwarf_Word value;
+        name = dwarf_formstring(dwarf_attr_integrate(d, DW_AT_name, &attr_mem));
+        if(files && !dwarf_formudata(dwarf_attr(d, DW_AT_call_file, &attr_mem), &value)) {
+            call_file = dwarf_filesrc(files, value, NULL, NULL);
+            if(call_file) {
+                const char* slash = strrchr(call_file, '/');
+                call_file = slash ? slash + 1 : call_file;
+            }
+        }
+        if(!dwarf_formudata(dwarf_attr(d, DW_AT_call_line, &attr_mem), &value)) {
+            call_line = (int)value;
+        }
+    }
+
+    Dwarf_Addr base, start, end;
+    for(ptrdiff_t off = dwarf_ranges(d, 0, &base, &start, &end); off > 0; off = dwarf_ranges(d, off, &base, &start, &end)) {
+        if(start >= end) {
+            continue;
+        }
+
+        if(u->count == *size) {
+            uint32_t new_size = *size ? *size * 2 : 64;
+            pst_function_range* ranges = (pst_function_range*)idx->alloc->realloc(idx->alloc, u->ranges, new_size * sizeof(pst_function_range));
+            if(!ranges) {
+                pst_log(SEVERITY_ERROR, "Failed to allocate %u ranges of functions index", new_size);
+                return false;
+            }
+            u->ranges = ranges;
+            *size = new_size;
+        }
+
+        pst_function_range* r = &u->ranges[u->count++];
+        r->start = start;
+        r->end = end;
+        r->offset = dwarf_dieoffset(d);
+        r->parent = -1;
+        r->inlined = inlined;
+        r->name = name;
+        r->call_file = call_file;
+        r->call_line = call_line;
+    }
+
+    return true;
+}
+
+// whether DIE of the tag may have functions among its children
+static bool has_functions(int tag)
+{
+    switch(tag) {
+        case DW_TAG_namespace:
+        case DW_TAG_module:
+        case DW_TAG_class_type:
+        case DW_TAG_structure_type:
+        case DW_TAG_union_type:
+        case DW_TAG_interface_type:
+        case DW_TAG_subprogram:
+        case DW_TAG_entry_point:
+        case DW_TAG_inlined_subroutine:
+        case DW_TAG_lexical_block:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// collect ranges of all functions of the unit, sort them and link each one to the enclosing one
+static bool build(pst_function_index* idx, Dwarf_Die* cu, pst_unit_index* u)
+{
+    uint32_t size = 0;
+    Dwarf_Die dies[PST_FUNCTION_INDEX_DEPTH];
+    int depth = dwarf_child(cu, &dies[0]) ? -1 : 0;
+    bool ret = true;
+
+    // source files of the unit, referred by DW_AT_call_file of inlined functions
+    Dwarf_Files* files = NULL;
+    size_t nfiles = 0;
+    if(dwarf_getsrcfiles(cu, &files, &nfiles)) {
+        files = NULL;
+    }
+
+    while(depth >= 0) {
+        Dwarf_Die* d = &dies[depth];
+        int tag = dwarf_tag(d);
+        if(tag == DW_TAG_subprogram || tag == DW_TAG_entry_point || tag == DW_TAG_inlined_subroutine) {
+            if(!add_ranges(idx, u, &size, d, tag == DW_TAG_inlined_subroutine, files)) {
+                // index ranges found so far
+                ret = false;
+                break;
+            }
+        }
+
+        if(has_functions(tag) && depth + 1 < PST_FUNCTION_INDEX_DEPTH && !dwarf_child(d, &dies[depth + 1])) {
+            depth++;
+            continue;
+        }
+
+        // next sibling of the DIE or of the nearest of its parents which has one
+        while(depth >= 0 && dwarf_siblingof(&dies[depth], &dies[depth])) {
+            depth--;
+        }
+    }
+
+    if(u->count) {
+        qsort(u->ranges, u->count, sizeof(pst_function_range), compare_ranges);
+    }
+
+    // enclosing range of each one is the previous range or one of its enclosing ranges
+    for(uint32_t i = 1; i < u->count; ++i) {
+        int32_t p = i - 1;
+        while(p >= 0 && u->ranges[p].end < u->ranges[i].end) {
+            p = u->ranges[p].parent;
+        }
+        u->ranges[i].parent = p;
+    }
+
+    return ret;
+}
+
+static pst_unit_index* evict(pst_function_index* idx)
+{
+    pst_unit_index* victim = &idx->units[0];
+    for(uint32_t i = 1; i < idx->units_count; ++i) {
+        if(idx->units[i].used < victim->used) {
+            victim = &idx->units[i];
+        }
+    }
+
+    unit_fini(idx, victim);
+
+    return victim;
+}
+
+// get index of compilation unit, build it in case of miss
+const pst_unit_index* pst_function_index_unit(pst_function_index* idx, Dwarf_Die* cu)
+{
+    Dwarf* dwarf = dwarf_cu_getdwarf(cu->cu);
+    Dwarf_Off offset = dwarf_dieoffset(cu);
+
+    idx->clock++;
+
+    for(uint32_t i = 0; i < idx->units_count; ++i) {
+        pst_unit_index* u = &idx->units[i];
+        if(u->dwarf == dwarf && u->offset == offset) {
+            u->used = idx->clock;
+            return u;
+        }
+    }
+
+    pst_unit_index* u = (idx->units_count < PST_FUNCTION_INDEX_UNITS) ? &idx->units[idx->units_count++] : evict(idx);
+    u->dwarf = dwarf;
+    u->offset = offset;
+    u->ranges = NULL;
+    u->count = 0;
+    u->used = idx->clock;
+
+    if(!build(idx, cu, u)) {
+        // keep the unit with ranges found so far, so it isn't walked on each lookup
+        pst_log(SEVERITY_WARNING, "Functions index of compilation unit %s is incomplete", dwarf_diename(cu));
+    }
+
+    pst_log(SEVERITY_DEBUG, "Indexed %u ranges of functions of compilation unit %s", u->count, dwarf_diename(cu));
+
+    return u;
+}
@@ -0,0 +1,64 @@
+/*
+ * function_index.h
+ *
+ * Index of PC ranges of functions per compilation unit
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_FUNCTION_INDEX_H__
+#define __PST_FUNCTION_INDEX_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <elfutils/libdw.h>
+
+#include "utils/allocator.h"
+
+#define PST_FUNCTION_INDEX_UNITS    (64)    // maximum number of indexed compilation units
+#define PST_FUNCTION_INDEX_DEPTH    (64)    // maximum nesting level of DIEs walked while building index
+
+// PC range of subprogram or inlined subroutine. function with DW_AT_ranges (i.e. split into hot and cold parts) has one range per part
+typedef struct pst_function_range {
+    Dwarf_Addr      start;      // start of the range as in debug information (i.e. without module's bias)
+    Dwarf_Addr      end;        // end of the range (not included)
+    Dwarf_Off       offset;     // offset of DIE of the function
+    int32_t         parent;     // index of the innermost range enclosing this one, -1 if there is none
+    bool            inlined;    // whether DIE is DW_TAG_inlined_subroutine
+    const char*     name;       // name of inlined function from its abstract origin, NULL if unknown or function isn't inlined
+    const char*     call_file;  // source file name without path of the call of inlined function, NULL if unknown
+    int             call_line;  // source line of the call of inlined function, -1 if unknown
+} pst_function_range;
+
+// ranges of all functions of compilation unit
+typedef struct pst_unit_index {
+    Dwarf*                  dwarf;      // debug information containing the unit
+    Dwarf_Off               offset;     // offset of DIE of the unit
+    pst_function_range*     ranges;     // ranges sorted by start, enclosing range goes before enclosed one
+    uint32_t                count;      // number of items in 'ranges'
+    uint64_t                used;       // value of index's clock at the last access, used to evict least recently used unit
+} pst_unit_index;
+
+int32_t pst_unit_index_find(const pst_unit_index* u, Dwarf_Addr pc);
+
+// -----------------------------------------------------------------------------------
+// pst_function_index
+// -----------------------------------------------------------------------------------
+// Sorted interval indexes of compilation units, built once per unit on the first lookup in it. Whole tree of unit's DIEs is walked,
+// so functions nested into namespaces, classes and other functions are found as well as inlined ones. Since ranges of DIEs are nested
+// but never overlap partially, the innermost function containing PC is found by binary search followed by walk up 'parent' links,
+// which also give chain of functions inlined at PC with their names and call locations. Caller must hold session lock.
+typedef struct pst_function_index {
+    pst_allocator*      alloc;          // allocator for ranges
+    pst_unit_index      units[PST_FUNCTION_INDEX_UNITS];
+    uint32_t            units_count;    // number of used items of 'units'
+    uint64_t            clock;          // incremented on each lookup
+} pst_function_index;
+
+bool pst_function_index_init(pst_function_index* idx, pst_allocator* alloc);
+void pst_function_index_fini(pst_function_index* idx);
+
+const pst_unit_index* pst_function_index_unit(pst_function_index* idx, Dwarf_Die* cu);
+
+#endif /* __PST_FUNCTION_INDEX_H__ */
@@ -0,0 +1,434 @@
+/*
+ * helper.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include "context.h"
+#include "helper.h"
+#include "symbol_cache.h"
+#include "utils/sink.h"
+#include "arch/unwind_fp.h"
+
+#ifndef PR_SET_PTRACER
+#define PR_SET_PTRACER 0x59616d61
+#endif
+
+static pid_t                helper_pid = 0;     // helper process, 0 if it isn't started
+static pid_t                owner_pid = 0;      // process served by the helper
+static int                  helper_sock = -1;   // process end of socket connected to the helper
+static pst_helper_request   request;            // request of crashed thread, too big for signal stack
+static pid_t                request_tid = 0;    // thread which fills 'request', 0 if it's free
+
+//
+// Helper process
+//
+
+// state of the helper process
+typedef struct pst_helper {
+    pid_t                   pid;        // served process
+    Dwfl*                   dwfl;       // warm libdwfl session of served process
+    pst_allocator           alloc;      // allocator for symbol cache
+    pst_symbol_cache        symbols;    // function names and source lines of code addresses
+    pst_helper_request*     req;        // request being handled
+    pst_sink                sink;       // output of request being handled
+    uint32_t                idx;        // index of the next printed frame
+} pst_helper;
+
+static char *debuginfo_path = NULL;
+static Dwfl_Callbacks callbacks = {
+        .find_elf           = dwfl_linux_proc_find_elf,
+        .find_debuginfo     = dwfl_standard_find_debuginfo,
+        .section_address    = dwfl_offline_section_address,
+        .debuginfo_path     = &debuginfo_path,
+};
+
+static pid_t next_thread(Dwfl* dwfl, void* arg, void** thread_arg)
+{
+    // the only thread known to the helper is the one of the request
+    pst_helper* h = (pst_helper*)arg;
+    if(*thread_arg) {
+        return 0;
+    }
+    *thread_arg = h;
+
+    return h->req->tid;
+}
+
+static bool memory_read(Dwfl* dwfl, Dwarf_Addr addr, Dwarf_Word* result, void* arg)
+{
+    pst_helper* h = (pst_helper*)arg;
+    pst_helper_request* req = h->req;
+    if(addr >= req->stack_start && addr + sizeof(Dwarf_Word) <= req->stack_start + req->stack_size) {
+        memcpy(result, req->stack + (addr - req->stack_start), sizeof(Dwarf_Word));
+        return true;
+    }
+
+    // stack of served thread is intact while it waits for the reply
+    struct iovec local = { result, sizeof(Dwarf_Word) };
+    struct iovec remote = { (void*)addr, sizeof(Dwarf_Word) };
+    return process_vm_readv(req->pid, &local, 1, &remote, 1, 0) == sizeof(Dwarf_Word);
+}
+
+static bool set_initial_registers(Dwfl_Thread* thread, void* arg)
+{
+    pst_helper* h = (pst_helper*)arg;
+    dwfl_thread_state_register_pc(thread, h->req->regs[PST_HELPER_REGS - 1]);
+
+    return dwfl_thread_state_registers(thread, 0, PST_HELPER_REGS, (const Dwarf_Word*)h->req->regs);
+}
+
+static const Dwfl_Thread_Callbacks thread_callbacks = {
+        .next_thread            = next_thread,
+        .get_thread             = NULL,
+        .memory_read            = memory_read,
+        .set_initial_registers  = set_initial_registers,
+        .detach                 = NULL,
+        .thread_detach          = NULL,
+};
+
+// make libdwfl open ELF and debug files of the module now, instead of at crash time
+static int warm_module(Dwfl_Module* mod, void** userdata, const char* name, Dwarf_Addr start, void* arg)
+{
+    Dwarf_Addr bias;
+    dwfl_module_getdwarf(mod, &bias);
+
+    return DWARF_CB_OK;
+}
+
+static bool report_modules(pst_helper* h, pid_t pid)
+{
+    dwfl_report_begin(h->dwfl);
+    if(dwfl_linux_proc_report(h->dwfl, pid) != 0 || dwfl_report_end(h->dwfl, NULL, NULL) != 0) {
+        pst_log(SEVERITY_ERROR, "Failed to report modules of process %d to helper", pid);
+        return false;
+    }
+    dwfl_getmodules(h->dwfl, warm_module, NULL, 0);
+
+    return true;
+}
+
+static int print_frame(Dwfl_Frame* frame, void* arg)
+{
+    pst_helper* h = (pst_helper*)arg;
+
+    Dwarf_Addr pc;
+    bool activation = false;
+    if(!dwfl_frame_pc(frame, &pc, &activation)) {
+        return DWARF_CB_ABORT;
+    }
+
+    pst_symbol sym;
+    pst_symbol_cache_resolve(&h->symbols, h->dwfl, pc, &sym, false);
+    pst_sink_printf(&h->sink, "[%-2u] %s() ", h->idx, sym.name ? sym.name : "");
+    if(sym.file) {
+        pst_sink_printf(&h->sink, "at %s:%d, %p\n", sym.file, sym.line, (void*)pc);
+    } else {
+        pst_sink_printf(&h->sink, "at %p\n", (void*)pc);
+    }
+
+    return (++h->idx < PST_MAX_FRAMES) ? DWARF_CB_OK : DWARF_CB_ABORT;
+}
+
+static bool handle_request(pst_helper* h, int fd)
+{
+    if(h->req->pid != h->pid) {
+        pst_log(SEVERITY_ERROR, "Helper serves process %d only, request of process %d is rejected", h->pid, h->req->pid);
+        return false;
+    }
+
+    // modules loaded after the start of the helper are reported once they appear in stack trace
+    if(!dwfl_addrmodule(h->dwfl, h->req->regs[PST_HELPER_REGS - 1])) {
+        report_modules(h, h->req->pid);
+    }
+
+    pst_sink_init_fd(&h->sink, fd);
+    h->idx = 0;
+    dwfl_getthread_frames(h->dwfl, h->req->tid, print_frame, h);
+    pst_sink_fini(&h->sink);
+
+    return h->idx && !h->sink.failed;
+}
+
+// entry of getdents64() output
+typedef struct pst_dirent {
+    uint64_t        ino;
+    int64_t         off;
+    unsigned short  reclen;
+    unsigned char   type;
+    char            name[];
+} pst_dirent;
+
+// close descriptors of /proc/self/fd above 2 except 'keep'. directory is read from the start again after closing, since closing
+// descriptors changes its entries
+static void close_listed_fds(int keep)
+{
+    int dir = open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(dir < 0) {
+        return;
+    }
+
+    char buff[4096];
+    long size;
+    bool closed;
+    do {
+        closed = false;
+        while((size = syscall(SYS_getdents64, dir, buff, sizeof(buff))) > 0) {
+            for(long pos = 0; pos < size; ) {
+                pst_dirent* d = (pst_dirent*)(buff + pos);
+                pos += d->reclen;
+
+                char* end;
+                long fd = strtol(d->name, &end, 10);
+                if(*end || end == d->name || fd <= STDERR_FILENO || fd == keep || fd == dir) {
+                    continue;
+                }
+                close(fd);
+                closed = true;
+            }
+        }
+    } while(closed && lseek(dir, 0, SEEK_SET) == 0);
+
+    close(dir);
+}
+
+// close descriptors inherited from the served process except standard ones and 'keep', so sockets and pipes of the process get EOF
+// and its file locks are released when the process closes them, not when the helper exits
+static void close_fds(int keep)
+{
+#ifdef SYS_close_range
+    if((keep <= STDERR_FILENO + 1 || !syscall(SYS_close_range, STDERR_FILENO + 1, keep - 1, 0)) &&
+       !syscall(SYS_close_range, keep + 1, ~0U, 0)) {
+        return;
+    }
+#endif
+    // kernel older than 5.9
+    close_listed_fds(keep);
+}
+
+static void helper_main(int sock, pid_t pid)
+{
+    // PR_SET_PDEATHSIG isn't used, since it fires when the forking thread exits, not the process. helper exits when served process
+    // closes its end of socket, and checks its parent while idle in case the socket is inherited by a child of the process
+    if(getppid() != pid) {
+        _exit(0);
+    }
+    close_fds(sock);
+
+    pst_helper h;
+    h.pid = pid;
+    pst_alloc_init(&h.alloc);
+    h.req = (pst_helper_request*)malloc(sizeof(pst_helper_request));
+    h.dwfl = dwfl_begin(&callbacks);
+    if(!h.req || !h.dwfl || !pst_symbol_cache_init(&h.symbols, &h.alloc) || !report_modules(&h, pid) ||
+       !dwfl_attach_state(h.dwfl, NULL, pid, &thread_callbacks, &h)) {
+        pst_log(SEVERITY_ERROR, "Failed to initialize helper of process %d", pid);
+        _exit(1);
+    }
+
+    for(;;) {
+        char cmsg[CMSG_SPACE(sizeof(int))];
+        struct iovec iov = { h.req, sizeof(pst_helper_request) };
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = cmsg;
+        msg.msg_controllen = sizeof(cmsg);
+
+        struct pollfd pfd = { sock, POLLIN, 0 };
+        int ready = poll(&pfd, 1, PST_HELPER_PARENT_CHECK);
+        if(ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if(ready == 0) {
+            if(getppid() != pid) {
+                // served process is gone, helper is reparented
+                break;
+            }
+            continue;
+        }
+
+        ssize_t size = recvmsg(sock, &msg, 0);
+        if(size < 0 && errno == EINTR) {
+            continue;
+        }
+        if(size <= 0) {
+            // served process closed its end
+            break;
+        }
+
+        int fd = -1;
+        struct cmsghdr* c = CMSG_FIRSTHDR(&msg);
+        if(c && c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+            memcpy(&fd, CMSG_DATA(c), sizeof(int));
+        }
+
+        char status = 0;
+        if(fd >= 0 && size >= (ssize_t)offsetof(pst_helper_request, stack) && size >= (ssize_t)(offsetof(pst_helper_request, stack) + h.req->stack_size)) {
+            status = handle_request(&h, fd);
+        }
+        if(fd >= 0) {
+            close(fd);
+        }
+
+        send(sock, &status, sizeof(status), MSG_NOSIGNAL);
+    }
+
+    _exit(0);
+}
+
+//
+// Served process
+//
+
+// fork helper process, which parses modules of the process now and prints stack traces later
+bool pst_helper_start()
+{
+    if(helper_pid) {
+        return true;
+    }
+
+    int socks[2];
+    if(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, socks)) {
+        pst_log(SEVERITY_ERROR, "Failed to create socket to helper. errno = %d", errno);
+        return false;
+    }
+
+    pid_t pid = getpid();
+    pid_t child = fork();
+    if(child < 0) {
+        pst_log(SEVERITY_ERROR, "Failed to fork helper. errno = %d", errno);
+        close(socks[0]);
+        close(socks[1]);
+        return false;
+    }
+
+    if(child == 0) {
+        close(socks[0]);
+        helper_main(socks[1], pid);
+    }
+
+    close(socks[1]);
+    helper_sock = socks[0];
+    helper_pid = child;
+    owner_pid = pid;
+
+    // let the helper read memory of the process when ptrace is restricted to descendants (Yama)
+    prctl(PR_SET_PTRACER, child, 0, 0, 0);
+
+    return true;
+}
+
+void pst_helper_stop()
+{
+    if(!helper_pid) {
+        return;
+    }
+
+    close(helper_sock);
+    helper_sock = -1;
+    waitpid(helper_pid, NULL, 0);
+    helper_pid = 0;
+    owner_pid = 0;
+}
+
+static void fill_registers(pst_helper_request* req, ucontext_t* hctx)
+{
+    static const int gregs[PST_HELPER_REGS] = {
+        REG_RAX, REG_RDX, REG_RCX, REG_RBX, REG_RSI, REG_RDI, REG_RBP, REG_RSP,
+        REG_R8, REG_R9, REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15, REG_RIP
+    };
+
+    for(int i = 0; i < PST_HELPER_REGS; ++i) {
+        req->regs[i] = hctx->uc_mcontext.gregs[gregs[i]];
+    }
+}
+
+// print stack trace of calling thread to the file descriptor by the helper. calling thread only copies registers and top of the stack,
+// so it's async-signal-safe and doesn't touch heap or debug information of the process
+bool pst_helper_unwind(ucontext_t* hctx, int fd)
+{
+    if(!helper_pid || getpid() != owner_pid) {
+        return false;
+    }
+
+    ucontext_t uc;
+    if(!hctx) {
+        getcontext(&uc);
+        hctx = &uc;
+    }
+
+    // 'request' is shared by all threads. the one which crashed while it fills the request gives up
+    pid_t tid = syscall(SYS_gettid);
+    pid_t owner = 0;
+    while(!__atomic_compare_exchange_n(&request_tid, &owner, tid, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        if(owner == tid) {
+            return false;
+        }
+        owner = 0;
+        sched_yield();
+    }
+
+    request.pid = owner_pid;
+    request.tid = tid;
+    fill_registers(&request, hctx);
+
+    // copy the stack via kernel, so that unmapped end of the stack only shortens the copy
+    request.stack_start = request.regs[7] - PST_HELPER_REDZONE;
+    struct iovec local = { request.stack, PST_HELPER_STACK };
+    struct iovec remote = { (void*)request.stack_start, PST_HELPER_STACK };
+    ssize_t size = process_vm_readv(owner_pid, &local, 1, &remote, 1, 0);
+    request.stack_size = size > 0 ? size : 0;
+
+    char cmsg[CMSG_SPACE(sizeof(int))];
+    memset(cmsg, 0, sizeof(cmsg));
+    struct iovec iov = { &request, offsetof(pst_helper_request, stack) + request.stack_size };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmsg;
+    msg.msg_controllen = sizeof(cmsg);
+
+    struct cmsghdr* c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(c), &fd, sizeof(int));
+
+    // drop late reply to the request which timed out before
+    char status = 0;
+    while(recv(helper_sock, &status, sizeof(status), MSG_DONTWAIT) > 0);
+
+    status = 0;
+    if(sendmsg(helper_sock, &msg, MSG_NOSIGNAL) > 0) {
+        // thread must stay in place while the helper reads its stack
+        struct pollfd p = { helper_sock, POLLIN, 0 };
+        int ret;
+        while((ret = poll(&p, 1, PST_HELPER_TIMEOUT)) < 0 && errno == EINTR);
+        if(ret > 0 && recv(helper_sock, &status, sizeof(status), 0) != sizeof(status)) {
+            status = 0;
+        }
+    }
+
+    __atomic_store_n(&request_tid, 0, __ATOMIC_RELEASE);
+
+    return status;
+}
@@ -0,0 +1,42 @@
+/*
+ * helper.h
+ *
+ * Helper process which unwinds stack traces on behalf of the process
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_HELPER_H__
+#define __PST_HELPER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ucontext.h>
+#include <sys/types.h>
+
+#define PST_HELPER_REGS     (17)            // number of passed registers, DWARF registers RAX...RIP of x86_64
+#define PST_HELPER_STACK    (64 * 1024)     // maximum size of copied stack
+#define PST_HELPER_REDZONE  (128)           // size of red zone below SP, which is used by leaf functions
+#define PST_HELPER_TIMEOUT  (10000)         // time to wait for the helper to print stack trace in milliseconds
+#define PST_HELPER_PARENT_CHECK (1000)      // period in milliseconds the idle helper checks whether served process is alive
+
+// -----------------------------------------------------------------------------------
+// pst_helper_request
+// -----------------------------------------------------------------------------------
+// State of the thread passed to the helper. Anything not in 'stack' is read by the helper from the process memory, which stays
+// intact while the thread waits for the reply.
+typedef struct pst_helper_request {
+    pid_t           pid;                        // process of the thread
+    pid_t           tid;                        // thread to unwind
+    uint64_t        regs[PST_HELPER_REGS];      // registers of the innermost frame
+    uint64_t        stack_start;                // address of the first byte of 'stack'
+    uint32_t        stack_size;                 // number of copied bytes of 'stack'
+    uint8_t         stack[PST_HELPER_STACK];    // copy of the stack starting a bit below SP
+} pst_helper_request;
+
+bool pst_helper_start();
+void pst_helper_stop();
+bool pst_helper_unwind(ucontext_t* hctx, int fd);
+
+#endif /* __PST_HELPER_H__ */
@@ -12,10 +12,37 @@
 #include "utils/allocator.h"
 #include "dwarf/dwarf_handler.h"
 #include "dwarf/dwarf_parameter.h"
+#include "session.h"
+#include "profiler.h"
+#include "registry.h"
+#include "record.h"
+#include "helper.h"
+#include "dump.h"
+#include "maps.h"
+#include "arch/tls.h"
+
+// collect what can't be collected in signal handler once, when library is loaded, since pst_lib_init() may be called by signal handler
+__attribute__((constructor)) static void lib_load()
+{
+#ifdef PST_DEBUG
+    pst_log_init_console(&pstlogger, 0);
+#endif
+    pst_tls_refresh();
+}
+
+#ifdef PST_DEBUG
+__attribute__((destructor)) static void lib_unload()
+{
+    pst_log_fini(&pstlogger);
+}
+#endif
 
 // allocate and initialize libpst library
 pst_handler* pst_lib_init(ucontext_t* hctx, void* buff, uint32_t size)
 {
+    // stack traces are interned and symbolized without memory allocation, so the registry is mapped in advance
+    pst_registry_init();
+
     // global
     if(!buff || !size) {
         pst_alloc_init(&allocator);
@@ -23,8 +50,6 @@ pst_handler* pst_lib_init(ucontext_t* hctx, void* buff, uint32_t size)
         pst_alloc_init_custom(&allocator, buff, size);
     }
 
-    pst_log_init_console(&pstlogger);
-
     pst_new(pst_handler, handler, hctx);
 
     return handler;
@@ -37,16 +62,75 @@ void pst_lib_fini(pst_handler* h)
     pst_free(h);
 
     // global
-    pst_log_fini(&pstlogger);
     pst_alloc_fini(&allocator);
 }
 
+// drop shared libdw session, next handler will create new one
+void pst_lib_invalidate()
+{
+    pst_session_invalidate();
+    pst_maps_refresh();
+    pst_tls_refresh();
+}
+
+uint32_t pst_lib_alloc_failures()
+{
+    return __atomic_load_n(&allocator.failures, __ATOMIC_RELAXED);
+}
+
+uint64_t pst_lib_log_dropped()
+{
+    return pst_log_dropped(&pstlogger) + pst_log_skipped(&pstlogger) + pst_log_deferred_dropped(&pstlogger);
+}
+
+void pst_lib_log_deferred(int enable)
+{
+    pst_log_set_deferred(&pstlogger, enable);
+}
+
 // save stack trace information to provided buffer in RAM
 int pst_unwind_simple(pst_handler* h)
 {
     return pst_handler_unwind_simple(h);
 }
 
+uint32_t pst_stack_id(pst_handler* h)
+{
+    return pst_handler_stack_id(h);
+}
+
+const char* pst_stack_print(uint32_t id)
+{
+    pst_registry_entry* e = pst_registry_symbolize(id, false);
+
+    return e ? e->text : NULL;
+}
+
+void pst_set_unwinder(pst_handler* h, pst_unwinder unwinder)
+{
+    h->unwinder = unwinder;
+}
+
+void pst_set_signal(pst_handler* h, int signal)
+{
+    h->ctx.signal = signal;
+}
+
+int pst_thread_prepare()
+{
+    return pst_unwind_fp_prepare();
+}
+
+int pst_print_to_sink(pst_handler* h, pst_sink* sink, int pretty)
+{
+    return pst_handler_print(h, sink, pretty);
+}
+
+int pst_record_to_sink(pst_handler* h, pst_sink* sink)
+{
+    return pst_record_write(h, sink);
+}
+
 // save stack trace information to provided buffer in RAM
 int pst_unwind_pretty(pst_handler* h)
 {
@@ -88,3 +172,48 @@ pst_parameter* pst_parameter_next_child(pst_parameter* parent, pst_parameter* cu
 {
     return parameter_next_child(parent, current);
 }
+
+int pst_helper_init()
+{
+    return pst_helper_start();
+}
+
+void pst_helper_fini()
+{
+    pst_helper_stop();
+}
+
+int pst_helper_print(ucontext_t* hctx, int fd)
+{
+    return pst_helper_unwind(hctx, fd);
+}
+
+int pst_dump_set_signal(int signal)
+{
+    return pst_dump_use_signal(signal);
+}
+
+int pst_dump_all_threads(ucontext_t* hctx, int fd)
+{
+    return pst_dump_threads(hctx, fd);
+}
+
+int pst_profiler_start(uint32_t hz, pst_profiler_mode mode)
+{
+    return profiler_start(hz, mode);
+}
+
+void pst_profiler_stop()
+{
+    profiler_stop();
+}
+
+int pst_profiler_register_thread()
+{
+    return profiler_register_thread();
+}
+
+int pst_profiler_report(int fd)
+{
+    return profiler_report(fd);
+}
@@ -0,0 +1,209 @@
+/*
+ * maps.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "context.h"
+#include "maps.h"
+
+// both are preallocated, since index may be refreshed in signal handler
+static pst_maps         maps;                           // published index
+static pst_maps_range   staging[PST_MAPS_MAX];          // index being parsed, not visible to readers
+static uint32_t         refreshing = 0;                 // non-zero while some thread rebuilds index
+
+static uintptr_t parse_hex(const char** str)
+{
+    uintptr_t val = 0;
+    for(const char* s = *str; ; ++s) {
+        char c = *s;
+        if(c >= '0' && c <= '9') {
+            val = (val << 4) | (c - '0');
+        } else if(c >= 'a' && c <= 'f') {
+            val = (val << 4) | (c - 'a' + 10);
+        } else {
+            *str = s;
+            break;
+        }
+    }
+
+    return val;
+}
+
+// parse 'start-end perms ...' line of /proc/<pid>/maps
+static bool parse_line(const char* line, pst_maps_range* r)
+{
+    const char* s = line;
+    r->start = parse_hex(&s);
+    if(*s++ != '-') {
+        return false;
+    }
+    r->end = parse_hex(&s);
+    if(*s++ != ' ' || r->end <= r->start) {
+        return false;
+    }
+
+    r->prot = 0;
+    if(s[0] == 'r') r->prot |= MAP_READ;
+    if(s[1] == 'w') r->prot |= MAP_WRITE;
+    if(s[2] == 'x') r->prot |= MAP_EXEC;
+
+    return true;
+}
+
+// read /proc/self/maps into 'staging' without stdio, since it allocates memory. returns number of parsed mappings
+static uint32_t read_maps()
+{
+    int fd = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        pst_log(SEVERITY_ERROR, "Failed to open /proc/self/maps. Error: %s", strerror(errno));
+        return 0;
+    }
+
+    // only the beginning of line is needed, the rest (path of mapped file) is skipped
+    char line[64];
+    uint32_t len = 0;
+    uint32_t count = 0;
+    char buff[4096];
+    ssize_t size;
+    while((size = read(fd, buff, sizeof(buff))) != 0) {
+        if(size < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            pst_log(SEVERITY_ERROR, "Failed to read /proc/self/maps. Error: %s", strerror(errno));
+            break;
+        }
+
+        for(ssize_t i = 0; i < size; ++i) {
+            if(buff[i] != '\n') {
+                if(len < sizeof(line) - 1) {
+                    line[len++] = buff[i];
+                }
+                continue;
+            }
+
+            line[len] = 0;
+            len = 0;
+            if(count == PST_MAPS_MAX) {
+                pst_log(SEVERITY_WARNING, "Too many memory mappings, only the first %u are indexed", PST_MAPS_MAX);
+                close(fd);
+                return count;
+            }
+            if(parse_line(line, &staging[count])) {
+                count++;
+            }
+        }
+    }
+    close(fd);
+
+    return count;
+}
+
+// rebuild index of mappings of the process. should be called before capture and after the process maps or unmaps memory (dlopen(), etc.)
+bool pst_maps_refresh()
+{
+    uint32_t expected = 0;
+    if(!__atomic_compare_exchange_n(&refreshing, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        // another thread is reading the same /proc/self/maps right now
+        return true;
+    }
+
+    uint32_t count = read_maps();
+    if(!count) {
+        __atomic_store_n(&refreshing, 0, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    // kernel lists mappings sorted by address, so staging is copied as is
+    __atomic_add_fetch(&maps.seq, 1, __ATOMIC_ACQ_REL);
+    memcpy(maps.ranges, staging, count * sizeof(pst_maps_range));
+    maps.count = count;
+    maps.built = true;
+    __atomic_add_fetch(&maps.seq, 1, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&refreshing, 0, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+// find the last mapping which starts at or below 'addr'
+static int32_t find_range(uintptr_t addr, uint32_t count)
+{
+    int32_t lo = 0, hi = (int32_t)count - 1, found = -1;
+    while(lo <= hi) {
+        int32_t mid = lo + (hi - lo) / 2;
+        if(maps.ranges[mid].start <= addr) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return found;
+}
+
+// range [addr, addr + size) may span several adjacent mappings, all of them must be readable
+static int lookup(uintptr_t addr, uint32_t size)
+{
+    uint32_t count = maps.count;
+    if(count > PST_MAPS_MAX) {
+        // torn read, seqlock check rejects it anyway
+        return EINVAL;
+    }
+
+    uintptr_t end = addr + (size ? size : 1);
+    if(end < addr) {
+        return EINVAL;
+    }
+
+    int32_t idx = find_range(addr, count);
+    if(idx < 0) {
+        return EINVAL;
+    }
+
+    for(uint32_t i = idx; i < count && addr < end; ++i) {
+        const pst_maps_range* r = &maps.ranges[i];
+        if(r->start > addr || r->end <= addr) {
+            return EINVAL;
+        }
+        if(!(r->prot & MAP_READ)) {
+            return EFAULT;
+        }
+        addr = r->end;
+    }
+
+    return addr < end ? EINVAL : 0;
+}
+
+// check that memory range is mapped and readable. returns zero if it's valid, EINVAL if part of range isn't mapped, EFAULT if it isn't
+// readable (i.e. guard page) and -1 if index can't be used (isn't built yet or is being updated for too long)
+int pst_maps_check(uintptr_t addr, uint32_t size)
+{
+    if(!__atomic_load_n(&maps.built, __ATOMIC_ACQUIRE) && !pst_maps_refresh()) {
+        return -1;
+    }
+
+    for(uint32_t attempt = 0; attempt < PST_MAPS_RETRIES; ++attempt) {
+        uint32_t seq = __atomic_load_n(&maps.seq, __ATOMIC_ACQUIRE);
+        if(seq & 1) {
+            continue;
+        }
+
+        int ret = lookup(addr, size);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&maps.seq, __ATOMIC_RELAXED) == seq) {
+            return ret;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,49 @@
+/*
+ * maps.h
+ *
+ * Index of memory mappings of the process used to check pointers without syscalls
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_MAPS_H__
+#define __PST_MAPS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PST_MAPS_MAX        (8192)  // maximum number of indexed mappings
+#define PST_MAPS_RETRIES    (64)    // maximum number of attempts to read index while it's being updated
+
+// access rights of mapping
+typedef enum {
+    MAP_READ    = 1,
+    MAP_WRITE   = 2,
+    MAP_EXEC    = 4,
+} pst_maps_prot;
+
+// mapped range [start, end)
+typedef struct pst_maps_range {
+    uintptr_t   start;  // first address of mapping
+    uintptr_t   end;    // address after the last byte of mapping
+    uint32_t    prot;   // set of pst_maps_prot
+} pst_maps_range;
+
+// -----------------------------------------------------------------------------------
+// pst_maps
+// -----------------------------------------------------------------------------------
+// Copy of /proc/self/maps sorted by address. It's rebuilt from scratch by pst_maps_refresh() once per capture and after dlopen(),
+// so any number of pointer checks are binary searches in memory. Index is published under seqlock: writer makes 'seq' odd while it
+// copies new ranges to 'ranges', readers retry if 'seq' was odd or has changed during lookup.
+typedef struct pst_maps {
+    pst_maps_range  ranges[PST_MAPS_MAX];   // mappings sorted by start address
+    uint32_t        count;                  // number of valid entries in 'ranges'
+    uint32_t        seq;                    // sequence counter of seqlock, odd while index is being updated
+    bool            built;                  // whether index was built at least once
+} pst_maps;
+
+bool pst_maps_refresh();
+int pst_maps_check(uintptr_t addr, uint32_t size);
+
+#endif /* __PST_MAPS_H__ */
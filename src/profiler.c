@@ -0,0 +1,439 @@
+/*
+ * profiler.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include "context.h"
+#include "registry.h"
+#include "maps.h"
+#include "profiler.h"
+#include "arch/unwind_fp.h"
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+// clock ID measuring CPU time of arbitrary thread of the process (see CPUCLOCK_* in linux/posix-timers.h)
+#define THREAD_CPU_CLOCK(tid)   ((~(clockid_t)(tid) << 3) | 6)
+
+static pst_profiler_thread  threads[PST_PROFILER_THREADS];  // profiled threads, indexed by hash of TID
+static pthread_mutex_t      lock = PTHREAD_MUTEX_INITIALIZER; // serializes start/stop/registration of threads
+static pthread_mutex_t      agg_lock = PTHREAD_MUTEX_INITIALIZER; // serializes consumers of rings and access to profile
+static pthread_t            aggregator;
+static bool                 handler_installed = false;
+static uint32_t             running = 0;            // non-zero while profiler is started
+static uint32_t             period_ns = 0;          // sampling period
+static pst_profiler_mode    clock_mode = PROFILER_CPU;
+static uint64_t*            counts = NULL;          // number of samples per stack trace ID of the registry
+static uint64_t             dropped = 0;            // total number of lost samples
+
+static pid_t gettid_safe()
+{
+    return (pid_t)syscall(SYS_gettid);
+}
+
+// find thread's slot without locks. safe to be called from signal handler
+static pst_profiler_thread* find_thread(pid_t tid)
+{
+    for(uint32_t i = 0; i < PST_PROFILER_THREADS; ++i) {
+        pst_profiler_thread* t = &threads[(tid + i) & (PST_PROFILER_THREADS - 1)];
+        pid_t cur = __atomic_load_n(&t->tid, __ATOMIC_ACQUIRE);
+        if(cur == tid) {
+            return t;
+        }
+        if(cur == PROFILER_FREE) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static void profiler_signal(int sig, siginfo_t* si, void* uctx)
+{
+    if(!__atomic_load_n(&running, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    int err = errno;
+    pst_profiler_thread* t = find_thread(gettid_safe());
+    pst_sample_ring* r = t ? __atomic_load_n(&t->ring, __ATOMIC_ACQUIRE) : NULL;
+    if(r) {
+        uint32_t head = r->head;
+        if(head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >= PST_PROFILER_RING) {
+            __atomic_add_fetch(&r->dropped, 1, __ATOMIC_RELAXED);
+        } else {
+            pst_frame frames[PST_PROFILER_DEPTH];
+            pst_sample* s = &r->samples[head & (PST_PROFILER_RING - 1)];
+            s->depth = pst_unwind_fp((ucontext_t*)uctx, frames, PST_PROFILER_DEPTH);
+            for(uint32_t i = 0; i < s->depth; ++i) {
+                s->pcs[i] = frames[i].pc;
+            }
+            __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+        }
+    }
+    errno = err;
+}
+
+// release slots of exited threads. slot is marked as deleted instead of free, so that probing for other threads isn't broken by it.
+// ring is kept with not yet aggregated samples, the next thread taking the slot reuses it. caller must hold 'lock'
+static void reap_threads()
+{
+    pid_t pid = getpid();
+    for(uint32_t i = 0; i < PST_PROFILER_THREADS; ++i) {
+        pst_profiler_thread* t = &threads[i];
+        if(t->tid <= 0 || !syscall(SYS_tgkill, pid, t->tid, 0) || errno != ESRCH) {
+            continue;
+        }
+
+        if(t->has_timer) {
+            timer_delete(t->timer);
+            t->has_timer = false;
+        }
+        __atomic_store_n(&t->tid, PROFILER_DELETED, __ATOMIC_RELEASE);
+    }
+}
+
+// find free or deleted slot for the thread. caller must hold 'lock'
+static pst_profiler_thread* new_thread(pid_t tid)
+{
+    for(uint32_t i = 0; i < PST_PROFILER_THREADS; ++i) {
+        pst_profiler_thread* slot = &threads[(tid + i) & (PST_PROFILER_THREADS - 1)];
+        if(slot->tid == PROFILER_FREE || slot->tid == PROFILER_DELETED) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+// create and arm timer of the thread. caller must hold 'lock'
+static bool arm_thread(pid_t tid)
+{
+    pst_profiler_thread* t = find_thread(tid);
+    if(!t) {
+        t = new_thread(tid);
+        if(!t) {
+            // table is full of threads which may have exited already
+            reap_threads();
+            t = new_thread(tid);
+        }
+
+        if(!t) {
+            pst_log(SEVERITY_ERROR, "Too many threads to profile, thread %d is skipped", tid);
+            return false;
+        }
+    }
+
+    if(!t->ring) {
+        pst_sample_ring* r = (pst_sample_ring*)calloc(1, sizeof(pst_sample_ring));
+        if(!r) {
+            pst_log(SEVERITY_ERROR, "Failed to allocate samples buffer for thread %d", tid);
+            return false;
+        }
+        __atomic_store_n(&t->ring, r, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&t->tid, tid, __ATOMIC_RELEASE);
+
+    if(t->has_timer) {
+        return true;
+    }
+
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+    sev.sigev_notify_thread_id = tid;
+
+    clockid_t clock = (clock_mode == PROFILER_CPU) ? THREAD_CPU_CLOCK(tid) : CLOCK_MONOTONIC;
+    if(timer_create(clock, &sev, &t->timer)) {
+        pst_log(SEVERITY_ERROR, "Failed to create timer for thread %d. errno = %d", tid, errno);
+        return false;
+    }
+
+    struct itimerspec its;
+    its.it_interval.tv_sec = period_ns / 1000000000;
+    its.it_interval.tv_nsec = period_ns % 1000000000;
+    its.it_value = its.it_interval;
+    if(timer_settime(t->timer, 0, &its, NULL)) {
+        pst_log(SEVERITY_ERROR, "Failed to arm timer for thread %d. errno = %d", tid, errno);
+        timer_delete(t->timer);
+        return false;
+    }
+    t->has_timer = true;
+
+    return true;
+}
+
+// account sample in the profile. caller must hold 'agg_lock'
+static void add_sample(pst_sample* s)
+{
+    if(!counts) {
+        counts = (uint64_t*)calloc(PST_REGISTRY_SIZE + 1, sizeof(uint64_t));
+        if(!counts) {
+            return;
+        }
+    }
+
+    uint32_t id = pst_registry_intern(s->pcs, s->depth);
+    if(!id) {
+        dropped++;
+        return;
+    }
+
+    if(!counts[id]++) {
+        // symbolize new stack trace right now, so that report doesn't need to touch debug information
+        pst_registry_symbolize(id, false);
+    }
+}
+
+// move samples from rings of all threads to the profile. caller must hold 'agg_lock'
+static void drain()
+{
+    for(uint32_t i = 0; i < PST_PROFILER_THREADS; ++i) {
+        pst_sample_ring* r = __atomic_load_n(&threads[i].ring, __ATOMIC_ACQUIRE);
+        if(!r) {
+            continue;
+        }
+
+        uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        for(uint32_t tail = r->tail; tail != head; ++tail) {
+            add_sample(&r->samples[tail & (PST_PROFILER_RING - 1)]);
+            __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+        }
+
+        uint32_t lost = __atomic_exchange_n(&r->dropped, 0, __ATOMIC_RELAXED);
+        dropped += lost;
+    }
+}
+
+static void* aggregator_routine(void* arg)
+{
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = PST_PROFILER_PERIOD * 1000000 };
+    while(__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        nanosleep(&ts, NULL);
+
+        pthread_mutex_lock(&agg_lock);
+        drain();
+        pthread_mutex_unlock(&agg_lock);
+    }
+
+    return NULL;
+}
+
+static void clear_profile()
+{
+    if(counts) {
+        memset(counts, 0, (PST_REGISTRY_SIZE + 1) * sizeof(uint64_t));
+    }
+
+    dropped = 0;
+}
+
+// arm timers for all threads existing at the moment. caller must hold 'lock'
+static void arm_all_threads()
+{
+    reap_threads();
+
+    // frame pointers of threads which didn't call pst_unwind_fp_prepare() are checked against index of mappings, so index should
+    // contain their stacks
+    pst_maps_refresh();
+
+    DIR* dir = opendir("/proc/self/task");
+    if(!dir) {
+        pst_log(SEVERITY_ERROR, "Failed to list threads of the process");
+        return;
+    }
+
+    struct dirent* entry;
+    while((entry = readdir(dir)) != NULL) {
+        pid_t tid = atoi(entry->d_name);
+        if(tid > 0) {
+            arm_thread(tid);
+        }
+    }
+    closedir(dir);
+}
+
+// delete timers of all threads. caller must hold 'lock'
+static void disarm_all_threads()
+{
+    for(uint32_t i = 0; i < PST_PROFILER_THREADS; ++i) {
+        if(threads[i].has_timer) {
+            timer_delete(threads[i].timer);
+            threads[i].has_timer = false;
+        }
+    }
+}
+
+bool profiler_start(uint32_t hz, pst_profiler_mode mode)
+{
+    if(!hz || hz > 10000) {
+        pst_log(SEVERITY_ERROR, "Invalid sampling frequency %u", hz);
+        return false;
+    }
+
+    if(!pst_registry_init()) {
+        return false;
+    }
+
+    pthread_mutex_lock(&lock);
+    if(running) {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+
+    // handler is never removed, since timers may have pending signals even after they are deleted
+    if(!handler_installed) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = profiler_signal;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        if(sigaction(SIGPROF, &sa, NULL)) {
+            pst_log(SEVERITY_ERROR, "Failed to install SIGPROF handler");
+            pthread_mutex_unlock(&lock);
+            return false;
+        }
+        handler_installed = true;
+    }
+
+    pthread_mutex_lock(&agg_lock);
+    clear_profile();
+    pthread_mutex_unlock(&agg_lock);
+
+    period_ns = 1000000000 / hz;
+    clock_mode = mode;
+    __atomic_store_n(&running, 1, __ATOMIC_RELEASE);
+
+    pst_unwind_fp_prepare();
+    arm_all_threads();
+
+    if(pthread_create(&aggregator, NULL, aggregator_routine, NULL)) {
+        // aggregator doesn't exist, so there is nothing to join
+        pst_log(SEVERITY_ERROR, "Failed to start aggregator thread");
+        __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+        disarm_all_threads();
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+    pthread_mutex_unlock(&lock);
+
+    return true;
+}
+
+void profiler_stop()
+{
+    pthread_mutex_lock(&lock);
+    if(!__atomic_exchange_n(&running, 0, __ATOMIC_ACQ_REL)) {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+
+    disarm_all_threads();
+    pthread_join(aggregator, NULL);
+    pthread_mutex_unlock(&lock);
+}
+
+// should be called by threads created after profiler_start(). called by any thread, makes frame pointer unwinding of the thread faster
+bool profiler_register_thread()
+{
+    pst_unwind_fp_prepare();
+
+    pthread_mutex_lock(&lock);
+    bool ret = false;
+    if(__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        // index of mappings is used for the thread's stack if its bounds weren't determined
+        pst_maps_refresh();
+        ret = arm_thread(gettid_safe());
+    }
+    pthread_mutex_unlock(&lock);
+
+    return ret;
+}
+
+static bool write_all(int fd, const char* buff, size_t size)
+{
+    while(size) {
+        ssize_t ret = write(fd, buff, size);
+        if(ret < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        buff += ret;
+        size -= ret;
+    }
+
+    return true;
+}
+
+// write collected profile in folded stacks format, i.e. line per stack trace: "outermost;...;innermost count"
+bool profiler_report(int fd)
+{
+    pthread_mutex_lock(&agg_lock);
+    drain();
+
+    bool ret = true;
+    char line[8192];
+    for(uint32_t id = 1; counts && id <= PST_REGISTRY_SIZE && ret; ++id) {
+        if(!counts[id]) {
+            continue;
+        }
+
+        // stack trace being symbolized by another thread right now is printed by addresses
+        pst_registry_entry* e = pst_registry_symbolize(id, false);
+        const char** names = e ? e->names : NULL;
+        e = e ? e : pst_registry_get(id);
+        if(!e) {
+            continue;
+        }
+
+        size_t len = 0;
+        for(int j = e->depth - 1; j >= 0 && len < sizeof(line) - 1; --j) {
+            char addr[32];
+            const char* name = names ? names[j] : addr;
+            if(!names) {
+                snprintf(addr, sizeof(addr), "%#lx", e->pcs[j]);
+            }
+
+            // folded format uses ';' and ' ' as separators, so replace them in names
+            for(const char* str = name; *str && len < sizeof(line) - 1; ++str) {
+                line[len++] = (*str == ';' || *str == ' ') ? '_' : *str;
+            }
+            if(j && len < sizeof(line) - 1) {
+                line[len++] = ';';
+            }
+        }
+        if(len < sizeof(line)) {
+            len += snprintf(line + len, sizeof(line) - len, " %lu\n", counts[id]);
+        }
+        if(len >= sizeof(line)) {
+            // too deep stack trace, truncate it
+            len = sizeof(line) - 1;
+            line[len - 1] = '\n';
+        }
+
+        ret = write_all(fd, line, len);
+    }
+
+    if(dropped) {
+        pst_log(SEVERITY_WARNING, "%lu samples were dropped", dropped);
+    }
+    pthread_mutex_unlock(&agg_lock);
+
+    return ret;
+}
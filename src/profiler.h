@@ -0,0 +1,57 @@
+/*
+ * profiler.h
+ *
+ * Timer driven in-process sampling profiler
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_PROFILER_H__
+#define __PST_PROFILER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "libpst-types.h"
+
+#define PST_PROFILER_THREADS    (256)   // maximum number of profiled threads, power of two
+#define PST_PROFILER_DEPTH      (64)    // maximum number of frames in a sample
+#define PST_PROFILER_RING       (64)    // number of samples in per-thread ring, power of two
+#define PST_PROFILER_PERIOD     (10)    // period of aggregation of samples in milliseconds
+
+// PC-only stack trace taken in SIGPROF handler
+typedef struct pst_sample {
+    uint32_t    depth;                      // number of valid entries in 'pcs'
+    uintptr_t   pcs[PST_PROFILER_DEPTH];    // PC of interrupted instruction followed by return addresses of callers
+} pst_sample;
+
+// single producer (signal handler of the thread), single consumer (aggregator) ring of samples
+typedef struct pst_sample_ring {
+    uint32_t    head;                       // index of next sample to write, updated by producer
+    uint32_t    tail;                       // index of next sample to read, updated by consumer
+    uint32_t    dropped;                    // number of samples lost since ring was full
+    pst_sample  samples[PST_PROFILER_RING];
+} pst_sample_ring;
+
+// special values of thread ID of slot
+typedef enum {
+    PROFILER_FREE       = 0,    // slot was never used, probing for a thread stops there
+    PROFILER_DELETED    = -1,   // thread has exited, slot may be reused, but probing continues past it
+} pst_profiler_slot;
+
+typedef struct pst_profiler_thread {
+    pid_t               tid;        // kernel thread ID or one of pst_profiler_slot
+    timer_t             timer;      // POSIX timer delivering SIGPROF to this thread
+    bool                has_timer;  // whether 'timer' is armed
+    pst_sample_ring*    ring;       // samples of the thread
+} pst_profiler_thread;
+
+bool profiler_start(uint32_t hz, pst_profiler_mode mode);
+void profiler_stop();
+bool profiler_register_thread();
+bool profiler_report(int fd);
+
+#endif /* __PST_PROFILER_H__ */
@@ -0,0 +1,161 @@
+/*
+ * record.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "context.h"
+#include "record.h"
+#include "utils/sink.h"
+#include "dwarf/dwarf_handler.h"
+
+// modules referenced by frames of the record
+typedef struct pst_record_modules {
+    Dwfl_Module*    mods[PST_RECORD_MODULES];
+    Dwarf_Addr      starts[PST_RECORD_MODULES];
+    uint32_t        count;
+} pst_record_modules;
+
+static bool put_varint(pst_sink* sink, uint64_t value)
+{
+    uint8_t buff[PST_VARINT_MAX];
+    return pst_sink_write(sink, (const char*)buff, pst_varint_encode(buff, value));
+}
+
+static bool put_bytes(pst_sink* sink, const void* data, uint32_t size)
+{
+    return put_varint(sink, size) && (!size || pst_sink_write(sink, (const char*)data, size));
+}
+
+// index of module of PC plus one, 0 if module is unknown or there are too many modules
+static uint32_t find_module(pst_record_modules* m, Dwfl* dwfl, Dwarf_Addr pc)
+{
+    Dwfl_Module* mod = dwfl_addrmodule(dwfl, pc);
+    if(!mod) {
+        return 0;
+    }
+
+    for(uint32_t i = 0; i < m->count; ++i) {
+        if(m->mods[i] == mod) {
+            return i + 1;
+        }
+    }
+
+    if(m->count == PST_RECORD_MODULES) {
+        return 0;
+    }
+
+    dwfl_module_info(mod, NULL, &m->starts[m->count], NULL, NULL, NULL, NULL, NULL);
+    m->mods[m->count++] = mod;
+
+    return m->count;
+}
+
+static bool put_module(pst_sink* sink, Dwfl_Module* mod, Dwarf_Addr start)
+{
+    const unsigned char* id = NULL;
+    Dwarf_Addr vaddr;
+    int id_len = dwfl_module_build_id(mod, &id, &vaddr);
+    if(id_len < 0) {
+        id_len = 0;
+    }
+
+    const char* path = dwfl_module_info(mod, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    if(!path) {
+        path = "";
+    }
+
+    return put_varint(sink, start) && put_bytes(sink, id, id_len) && put_bytes(sink, path, strlen(path));
+}
+
+static bool put_frame(pst_sink* sink, pst_function* fn, uint32_t module, Dwarf_Addr start, bool regs)
+{
+    bool ret = put_varint(sink, fn->info.flags) && put_varint(sink, module) && put_varint(sink, fn->info.pc - start) &&
+               put_varint(sink, fn->info.sp) && put_varint(sink, fn->offset);
+
+    if(regs) {
+        // virtual frames of inlined functions share registers with the physical one, so they have none
+        unw_word_t values[PST_RECORD_REGS];
+        uint64_t mask = 0;
+        for(int i = 0; !(fn->info.flags & IS_INLINED) && i < PST_RECORD_REGS; ++i) {
+            if(!unw_get_reg(&fn->context, i, &values[i])) {
+                mask |= 1ULL << i;
+            }
+        }
+
+        ret = ret && put_varint(sink, mask);
+        for(int i = 0; i < PST_RECORD_REGS; ++i) {
+            if(mask & (1ULL << i)) {
+                ret = ret && put_varint(sink, values[i]);
+            }
+        }
+    }
+
+    uint32_t count = 0;
+    for(pst_parameter* p = function_next_parameter(fn, NULL); p; p = function_next_parameter(fn, p)) {
+        count++;
+    }
+
+    ret = ret && put_varint(sink, count);
+    for(pst_parameter* p = function_next_parameter(fn, NULL); ret && p; p = function_next_parameter(fn, p)) {
+        ret = put_varint(sink, p->info.flags) && put_varint(sink, p->offset) && put_varint(sink, p->info.size) &&
+              put_varint(sink, p->info.value);
+    }
+
+    return ret;
+}
+
+// write binary record of unwound stack trace to the sink. only raw values are written, names are resolved by decoder from debug files
+bool pst_record_write(pst_handler* h, pst_sink* sink)
+{
+    if(!h->functions.count) {
+        pst_log(SEVERITY_ERROR, "Stack trace should be unwound before writing its record");
+        return false;
+    }
+
+    pst_record_modules mods;
+    mods.count = 0;
+    uint32_t modules[PST_MAX_FRAMES * 2];
+
+    uint8_t flags = 0;
+    uint32_t count = 0;
+
+    // without session lock frames are written without modules, i.e. as absolute addresses
+    bool locked = h->session && pst_session_lock(h->session, h->ctx.signal);
+    for(pst_function* fn = pst_handler_next_function(h, NULL); fn && count < PST_MAX_FRAMES * 2; fn = pst_handler_next_function(h, fn)) {
+        modules[count++] = locked ? find_module(&mods, h->session->dwfl, fn->info.pc) : 0;
+        if(fn->offset) {
+            flags |= RECORD_DWARF;
+        }
+    }
+
+    // registers of frames unwound by frame pointers are unknown
+    if(h->unwinder == UNWINDER_LIBUNWIND) {
+        flags |= RECORD_REGISTERS;
+    }
+
+    uint8_t header[6] = { PST_RECORD_MAGIC[0], PST_RECORD_MAGIC[1], PST_RECORD_MAGIC[2], PST_RECORD_MAGIC[3], PST_RECORD_VERSION, flags };
+    bool ret = pst_sink_write(sink, (const char*)header, sizeof(header)) && put_varint(sink, getpid()) &&
+               put_varint(sink, syscall(SYS_gettid));
+
+    ret = ret && put_varint(sink, mods.count);
+    for(uint32_t i = 0; ret && i < mods.count; ++i) {
+        ret = put_module(sink, mods.mods[i], mods.starts[i]);
+    }
+
+    ret = ret && put_varint(sink, count);
+    uint32_t idx = 0;
+    for(pst_function* fn = pst_handler_next_function(h, NULL); ret && idx < count; fn = pst_handler_next_function(h, fn), ++idx) {
+        Dwarf_Addr start = modules[idx] ? mods.starts[modules[idx] - 1] : 0;
+        ret = put_frame(sink, fn, modules[idx], start, flags & RECORD_REGISTERS);
+    }
+    if(locked) {
+        pst_session_unlock(h->session);
+    }
+
+    return pst_sink_flush(sink) && ret;
+}
@@ -0,0 +1,72 @@
+/*
+ * record.h
+ *
+ * Compact binary record of unwound stack trace, decoded offline by pst-decode
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_RECORD_H__
+#define __PST_RECORD_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PST_RECORD_MAGIC    "PSTR"  // the first bytes of the record
+#define PST_RECORD_VERSION  (1)     // version of record format, incremented on incompatible change
+#define PST_RECORD_MODULES  (256)   // maximum number of modules in the record, frames of other modules keep absolute PC
+#define PST_RECORD_REGS     (17)    // number of recorded registers per frame, DWARF registers RAX...RIP of x86_64
+#define PST_VARINT_MAX      (10)    // maximum size of encoded 64-bit varint
+
+// Record layout. All integers except 'version' and 'flags' are unsigned LEB128 varints, strings and build IDs are prefixed by length
+//
+//  header:     magic[4] version:u8 flags:u8 pid tid
+//  modules:    count, per module: start build_id_len build_id[] path_len path[]
+//  frames:     count, per frame (the innermost one first):
+//                  flags (pst_fun_flags) module (index + 1, 0 if unknown) pc (offset from module start or absolute) sp die
+//                  if RECORD_REGISTERS: mask (bit per register) value per set bit
+//                  params count, per param: flags (pst_param_flags) die size value
+//
+// 'die' is offset of DIE of the function or parameter in debug information of the module, 0 if it's unknown
+
+// bitmask of record options
+typedef enum {
+    RECORD_REGISTERS    = 0x01, // frames contain registers
+    RECORD_DWARF        = 0x02, // frames contain parameters and variables
+} pst_record_flags;
+
+struct pst_handler;
+struct pst_sink;
+
+bool pst_record_write(struct pst_handler* h, struct pst_sink* sink);
+
+// encode value to 'buff' of at least PST_VARINT_MAX bytes, returns number of used bytes
+static inline uint32_t pst_varint_encode(uint8_t* buff, uint64_t value)
+{
+    uint32_t len = 0;
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        buff[len++] = byte | (value ? 0x80 : 0);
+    } while(value);
+
+    return len;
+}
+
+// decode value from 'buff' of 'size' bytes, returns number of used bytes or 0 if value is malformed or truncated
+static inline uint32_t pst_varint_decode(const uint8_t* buff, uint32_t size, uint64_t* value)
+{
+    uint64_t v = 0;
+    for(uint32_t i = 0; i < size && i < PST_VARINT_MAX; ++i) {
+        v |= (uint64_t)(buff[i] & 0x7F) << (7 * i);
+        if(!(buff[i] & 0x80)) {
+            *value = v;
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+#endif /* __PST_RECORD_H__ */
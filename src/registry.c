@@ -0,0 +1,229 @@
+/*
+ * registry.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "context.h"
+#include "session.h"
+#include "registry.h"
+
+// Open addressing table filled without locks: a thread claims free slot by CAS of its hash, fills it and publishes by 'state'.
+// ID of the stack trace is index of its slot plus one, so zero is never a valid ID. PCs, names and texts are placed to the storage
+// by bumping its offset, since they are never freed
+typedef struct pst_registry {
+    pst_registry_entry  entries[PST_REGISTRY_SIZE];
+    uint64_t            used;                       // number of used bytes of 'store'
+    char                store[PST_REGISTRY_STORE];  // PCs, names and texts of stack traces
+} pst_registry;
+
+static pst_registry* registry = NULL;
+
+// map the registry once. only mmap() is used, so it may be called by signal handler. pages are committed on first touch
+bool pst_registry_init()
+{
+    if(__atomic_load_n(&registry, __ATOMIC_ACQUIRE)) {
+        return true;
+    }
+
+    void* p = mmap(NULL, sizeof(pst_registry), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(p == MAP_FAILED) {
+        pst_log(SEVERITY_ERROR, "Failed to allocate stack trace registry");
+        return false;
+    }
+
+    pst_registry* expected = NULL;
+    if(!__atomic_compare_exchange_n(&registry, &expected, (pst_registry*)p, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        // another thread mapped it first
+        munmap(p, sizeof(pst_registry));
+    }
+
+    return true;
+}
+
+// take aligned block of the storage, NULL if storage is exhausted
+static void* reserve(pst_registry* r, uint64_t size, uint64_t align)
+{
+    uint64_t used = __atomic_load_n(&r->used, __ATOMIC_RELAXED);
+    uint64_t start;
+    do {
+        start = (used + align - 1) & ~(align - 1);
+        if(start + size > sizeof(r->store)) {
+            pst_log(SEVERITY_WARNING, "Storage of stack trace registry is exhausted");
+            return NULL;
+        }
+    } while(!__atomic_compare_exchange_n(&r->used, &used, start + size, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    return r->store + start;
+}
+
+static uint64_t hash_pcs(const uintptr_t* pcs, uint32_t depth)
+{
+    // FNV-1a over addresses
+    uint64_t hash = 14695981039346656037ULL;
+    for(uint32_t i = 0; i < depth; ++i) {
+        hash = (hash ^ pcs[i]) * 1099511628211ULL;
+    }
+
+    // zero is reserved for free slot
+    return hash ? hash : 1;
+}
+
+// get ID of stack trace, add it to the registry if it's new. returns zero if registry isn't initialized, is full or its storage is exhausted.
+// slot which is still being filled by another thread is skipped instead of waiting for it, so the same stack trace added by two threads
+// at once may get two IDs
+uint32_t pst_registry_intern(const uintptr_t* pcs, uint32_t depth)
+{
+    pst_registry* r = __atomic_load_n(&registry, __ATOMIC_ACQUIRE);
+    if(!r || !depth) {
+        return 0;
+    }
+
+    depth = depth < PST_REGISTRY_DEPTH ? depth : PST_REGISTRY_DEPTH;
+    uint64_t hash = hash_pcs(pcs, depth);
+    for(uint32_t i = 0; i < PST_REGISTRY_PROBES; ++i) {
+        uint32_t idx = (hash + i) & (PST_REGISTRY_SIZE - 1);
+        pst_registry_entry* e = &r->entries[idx];
+
+        uint64_t h = __atomic_load_n(&e->hash, __ATOMIC_ACQUIRE);
+        if(h == 0 && __atomic_compare_exchange_n(&e->hash, &h, hash, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            uintptr_t* copy = (uintptr_t*)reserve(r, depth * sizeof(uintptr_t), sizeof(uintptr_t));
+            if(copy) {
+                memcpy(copy, pcs, depth * sizeof(uintptr_t));
+                e->depth = depth;
+            }
+            // slot without PCs never matches, but it's still published to not look torn
+            e->pcs = copy;
+            __atomic_store_n(&e->state, REGISTRY_READY, __ATOMIC_RELEASE);
+
+            return copy ? idx + 1 : 0;
+        }
+
+        // PCs are written before slot is published and never change after, so published slot is compared without lock
+        if(h == hash && __atomic_load_n(&e->state, __ATOMIC_ACQUIRE) != REGISTRY_FREE &&
+           e->depth == depth && e->pcs && !memcmp(e->pcs, pcs, depth * sizeof(uintptr_t))) {
+            return idx + 1;
+        }
+    }
+
+    pst_log(SEVERITY_WARNING, "Stack trace registry is full");
+
+    return 0;
+}
+
+pst_registry_entry* pst_registry_get(uint32_t id)
+{
+    pst_registry* r = __atomic_load_n(&registry, __ATOMIC_ACQUIRE);
+    if(!r || id == 0 || id > PST_REGISTRY_SIZE) {
+        return NULL;
+    }
+
+    pst_registry_entry* e = &r->entries[id - 1];
+    if(__atomic_load_n(&e->state, __ATOMIC_ACQUIRE) == REGISTRY_FREE || !e->pcs) {
+        return NULL;
+    }
+
+    return e;
+}
+
+// length of text of the frame, name of unknown function is its address
+static int frame_name(const pst_symbol* sym, uintptr_t pc, char* buff, size_t size)
+{
+    return sym->name ? snprintf(buff, size, "%s", sym->name) : snprintf(buff, size, "%#lx", pc);
+}
+
+static int frame_line(const pst_symbol* sym, uint32_t idx, uintptr_t pc, char* buff, size_t size)
+{
+    if(sym->file) {
+        return snprintf(buff, size, "[%-2u] %s() at %s:%d, %p\n", idx, sym->name ? sym->name : "??", sym->file, sym->line, (void*)pc);
+    }
+
+    return snprintf(buff, size, "[%-2u] %s() at %p\n", idx, sym->name ? sym->name : "??", (void*)pc);
+}
+
+// format names and text of the stack trace right into the storage, since the registry outlives the session which interned the names
+static void format_entry(pst_registry* r, pst_registry_entry* e, const pst_symbol* syms)
+{
+    uint64_t size = e->depth * sizeof(char*) + 1;
+    for(uint32_t i = 0; i < e->depth; ++i) {
+        size += frame_name(&syms[i], e->pcs[i], NULL, 0) + 1;
+        size += frame_line(&syms[i], i, e->pcs[i], NULL, 0);
+    }
+
+    const char** names = (const char**)reserve(r, size, sizeof(char*));
+    if(!names) {
+        e->names = NULL;
+        e->text = NULL;
+        return;
+    }
+
+    char* str = (char*)(names + e->depth);
+    char* end = (char*)names + size;
+    for(uint32_t i = 0; i < e->depth; ++i) {
+        names[i] = str;
+        str += frame_name(&syms[i], e->pcs[i], str, end - str) + 1;
+    }
+
+    char* text = str;
+    text[0] = 0;
+    for(uint32_t i = 0; i < e->depth; ++i) {
+        str += frame_line(&syms[i], i, e->pcs[i], str, end - str);
+    }
+
+    e->names = names;
+    e->text = text;
+}
+
+// resolve names of the functions of the stack trace. done once per stack trace, the next calls return already resolved names.
+// 'signal' tells that caller is signal handler, which doesn't wait for busy session and leaves names unresolved then.
+// returns NULL if stack trace is unknown, is being symbolized by another thread or session is busy, so the caller never waits
+pst_registry_entry* pst_registry_symbolize(uint32_t id, bool signal)
+{
+    pst_registry_entry* e = pst_registry_get(id);
+    if(!e) {
+        return NULL;
+    }
+
+    uint32_t state = REGISTRY_READY;
+    if(!__atomic_compare_exchange_n(&e->state, &state, REGISTRY_BUSY, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return state == REGISTRY_SYMBOLIZED ? e : NULL;
+    }
+
+    // signal handler can't create session, so names are left for the next call instead of being resolved to addresses forever
+    pst_session* session = pst_session_acquire(signal);
+    if((!session && signal) || (session && !pst_session_lock(session, signal))) {
+        pst_session_release(session, signal);
+        __atomic_store_n(&e->state, REGISTRY_READY, __ATOMIC_RELEASE);
+        return NULL;
+    }
+
+    pst_symbol syms[PST_REGISTRY_DEPTH];
+    for(uint32_t i = 0; i < e->depth; ++i) {
+        // return address points to the next instruction after the call, which may belong to another function or line
+        uintptr_t addr = i ? e->pcs[i] - 1 : e->pcs[i];
+        syms[i].name = NULL;
+        syms[i].file = NULL;
+        syms[i].line = -1;
+        if(session) {
+            pst_symbol_cache_resolve(&session->symbols, session->dwfl, addr, &syms[i], signal);
+        }
+    }
+
+    // names are interned by the session, so they are copied while it's locked
+    pst_registry* r = __atomic_load_n(&registry, __ATOMIC_ACQUIRE);
+    format_entry(r, e, syms);
+
+    if(session) {
+        pst_session_unlock(session);
+        pst_session_release(session, signal);
+    }
+
+    __atomic_store_n(&e->state, REGISTRY_SYMBOLIZED, __ATOMIC_RELEASE);
+
+    return e;
+}
@@ -0,0 +1,49 @@
+/*
+ * registry.h
+ *
+ * Process-wide table of unique stack traces identified by compact IDs
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_REGISTRY_H__
+#define __PST_REGISTRY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PST_REGISTRY_SIZE   (65536) // maximum number of unique stack traces, power of two
+#define PST_REGISTRY_PROBES (128)   // maximum number of slots checked to find a stack trace
+#define PST_REGISTRY_DEPTH  (128)   // maximum number of frames of stack trace, deeper ones are truncated
+#define PST_REGISTRY_STORE  (64 * 1024 * 1024) // size of preallocated storage of PCs, names and texts of stack traces
+
+// state of registry entry
+typedef enum {
+    REGISTRY_FREE       = 0,    // slot isn't used or is being filled
+    REGISTRY_READY      = 1,    // PCs are available
+    REGISTRY_BUSY       = 2,    // stack trace is being symbolized
+    REGISTRY_SYMBOLIZED = 3,    // names and text are available
+} pst_registry_state;
+
+// -----------------------------------------------------------------------------------
+// pst_registry_entry
+// -----------------------------------------------------------------------------------
+// Entries are never removed, so pointers to PCs, names and text stay valid till the end of the process. Entries and storage of their
+// data are preallocated by pst_registry_init(), so neither interning nor symbolization allocates memory and both may be used by signal
+// handlers
+typedef struct pst_registry_entry {
+    uint64_t            hash;       // hash of 'pcs', never zero for used slot
+    uint32_t            state;      // one of pst_registry_state
+    uint32_t            depth;      // number of frames
+    uintptr_t*          pcs;        // PC of the innermost frame followed by return addresses of callers
+    const char**        names;      // function name per frame, for unknown functions it is address. NULL if storage is exhausted
+    const char*         text;       // printable stack trace, line per frame. NULL if storage is exhausted
+} pst_registry_entry;
+
+bool pst_registry_init();
+uint32_t pst_registry_intern(const uintptr_t* pcs, uint32_t depth);
+pst_registry_entry* pst_registry_get(uint32_t id);
+pst_registry_entry* pst_registry_symbolize(uint32_t id, bool signal);
+
+#endif /* __PST_REGISTRY_H__ */
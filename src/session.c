@@ -0,0 +1,234 @@
+/*
+ * session.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+
+#include "context.h"
+#include "session.h"
+
+static char *debuginfo_path = NULL;
+static Dwfl_Callbacks callbacks = {
+        .find_elf           = dwfl_linux_proc_find_elf,
+        .find_debuginfo     = dwfl_standard_find_debuginfo,
+        .section_address    = dwfl_offline_section_address,
+        .debuginfo_path     = &debuginfo_path,
+};
+
+static pst_session*     current = NULL;     // session shared by all handlers of the process
+static pst_session*     retired = NULL;     // sessions released by signal handlers, destroyed by the next caller outside of them
+static uint32_t         generation = 0;     // sequence number of the last created session
+static uint32_t         acquiring = 0;      // number of threads between reading 'current' and taking reference to it
+
+bool pst_session_init(pst_session* s)
+{
+    s->dwfl = NULL;
+    s->refs = 1;
+    s->next = NULL;
+    s->generation = 0;
+    s->allocated = false;
+    pst_alloc_init(&s->alloc);
+    pthread_mutex_init(&s->lock, NULL);
+
+    // all caches are initialized anyway, since pst_session_fini() is called on failure
+    bool caches = pst_symbol_cache_init(&s->symbols, &s->alloc);
+    caches = pst_frame_cache_init(&s->frames, &s->alloc) && caches;
+    caches = pst_function_index_init(&s->functions, &s->alloc) && caches;
+    caches = pst_dwarf_program_cache_init(&s->programs, &s->alloc) && caches;
+    caches = pst_dwarf_loclist_cache_init(&s->loclists, &s->alloc) && caches;
+    caches = pst_type_cache_init(&s->types, &s->alloc) && caches;
+    if(!caches) {
+        return false;
+    }
+
+    s->dwfl = dwfl_begin(&callbacks);
+    if(s->dwfl == NULL) {
+        pst_log(SEVERITY_ERROR, "Failed to initialize libdw session to parse stack frames");
+        return false;
+    }
+
+    if(dwfl_linux_proc_report(s->dwfl, getpid()) != 0 || dwfl_report_end(s->dwfl, NULL, NULL) !=0) {
+        pst_log(SEVERITY_ERROR, "Failed to parse debug section of executable");
+        dwfl_end(s->dwfl);
+        s->dwfl = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+pst_session* pst_session_new()
+{
+    // session outlives any handler, so don't use handler's allocator there (it may be custom one and reset at pst_lib_fini())
+    pst_session* s = (pst_session*)malloc(sizeof(pst_session));
+    if(s) {
+        if(!pst_session_init(s)) {
+            pst_session_fini(s);
+            free(s);
+            return NULL;
+        }
+        s->allocated = true;
+    }
+
+    return s;
+}
+
+void pst_session_fini(pst_session* s)
+{
+    // frame rules are allocated by libdw, so free them before the session
+    pst_frame_cache_fini(&s->frames);
+
+    if(s->dwfl) {
+        dwfl_end(s->dwfl);
+        s->dwfl = NULL;
+    }
+
+    pthread_mutex_destroy(&s->lock);
+    pst_symbol_cache_fini(&s->symbols);
+    pst_function_index_fini(&s->functions);
+    pst_dwarf_program_cache_fini(&s->programs);
+    pst_dwarf_loclist_cache_fini(&s->loclists);
+    pst_type_cache_fini(&s->types);
+    pst_alloc_fini(&s->alloc);
+
+    if(s->allocated) {
+        free(s);
+    }
+}
+
+static void session_destroy(pst_session* s)
+{
+    pst_log(SEVERITY_DEBUG, "Destroy libdw session #%u", s->generation);
+    pst_session_fini(s);
+}
+
+// destroy sessions whose last reference was dropped by signal handler. must be called outside of signal handler
+static void destroy_retired()
+{
+    pst_session* s = __atomic_exchange_n(&retired, NULL, __ATOMIC_ACQ_REL);
+    while(s) {
+        pst_session* next = s->next;
+        session_destroy(s);
+        s = next;
+    }
+}
+
+// libdwfl and allocator aren't async-signal-safe, so session which lost its last reference in signal handler is only queued
+static void session_unref(pst_session* s, bool signal)
+{
+    if(__atomic_sub_fetch(&s->refs, 1, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+
+    if(!signal) {
+        session_destroy(s);
+        return;
+    }
+
+    s->next = __atomic_load_n(&retired, __ATOMIC_RELAXED);
+    while(!__atomic_compare_exchange_n(&retired, &s->next, s, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// take reference to the shared session. while the thread is counted in 'acquiring', session can't be detached and destroyed
+static pst_session* session_ref()
+{
+    __atomic_add_fetch(&acquiring, 1, __ATOMIC_SEQ_CST);
+    pst_session* s = __atomic_load_n(&current, __ATOMIC_SEQ_CST);
+    if(s) {
+        __atomic_add_fetch(&s->refs, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_sub_fetch(&acquiring, 1, __ATOMIC_RELEASE);
+
+    return s;
+}
+
+// get the shared session, create it on first use. signal handler never creates session, since it parses modules and allocates
+// memory, so it gets NULL if no session was created outside of signal handler yet
+pst_session* pst_session_acquire(bool signal)
+{
+    pst_session* s = session_ref();
+    if(s || signal) {
+        return s;
+    }
+
+    destroy_retired();
+
+    // session is created without any lock, if another thread published its session first, then ours is dropped
+    pst_session* created = pst_session_new();
+    if(!created) {
+        return NULL;
+    }
+    created->refs = 2;
+    created->generation = __atomic_add_fetch(&generation, 1, __ATOMIC_RELAXED);
+
+    pst_session* expected = NULL;
+    if(__atomic_compare_exchange_n(&current, &expected, created, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        pst_log(SEVERITY_DEBUG, "Created libdw session #%u", created->generation);
+        return created;
+    }
+
+    pst_session_fini(created);
+
+    return session_ref();
+}
+
+void pst_session_release(pst_session* s, bool signal)
+{
+    if(!s) {
+        return;
+    }
+
+    session_unref(s, signal);
+}
+
+// detach current session (for example, after dlopen()/dlclose()). handlers which still borrow it, continue to use it till release,
+// all the next ones will get a new session with actual list of modules. must be called outside of signal handler
+void pst_session_invalidate()
+{
+    pst_session* s = __atomic_exchange_n(&current, NULL, __ATOMIC_SEQ_CST);
+    if(s) {
+        pst_log(SEVERITY_DEBUG, "Invalidate libdw session #%u", s->generation);
+
+        // threads which have read the old pointer take their reference in a few instructions
+        while(__atomic_load_n(&acquiring, __ATOMIC_SEQ_CST)) {
+            sched_yield();
+        }
+        session_unref(s, false);
+    }
+
+    destroy_retired();
+}
+
+// lock the session. in signal handler the lock may be held by the interrupted code or by another thread which crashed while holding
+// it, so there it's only tried for a bounded time. returns false if the lock wasn't taken
+bool pst_session_lock(pst_session* s, bool signal)
+{
+    if(!signal) {
+        pthread_mutex_lock(&s->lock);
+        return true;
+    }
+
+    for(uint32_t i = 0; i < PST_SESSION_LOCK_TRIES; ++i) {
+        if(!pthread_mutex_trylock(&s->lock)) {
+            return true;
+        }
+
+        struct timespec ts = { 0, PST_SESSION_LOCK_WAIT * 1000 };
+        nanosleep(&ts, NULL);
+    }
+
+    pst_log(SEVERITY_WARNING, "Failed to lock libdw session #%u in signal handler", s->generation);
+
+    return false;
+}
+
+void pst_session_unlock(pst_session* s)
+{
+    pthread_mutex_unlock(&s->lock);
+}
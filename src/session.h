@@ -0,0 +1,65 @@
+/*
+ * session.h
+ *
+ * Process-wide libdwfl session shared by all libpst handlers
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_SESSION_H__
+#define __PST_SESSION_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <elfutils/libdwfl.h>
+
+#include "utils/allocator.h"
+#include "symbol_cache.h"
+#include "frame_cache.h"
+#include "function_index.h"
+#include "dwarf/dwarf_program.h"
+#include "dwarf/dwarf_loclist.h"
+#include "dwarf/dwarf_type.h"
+
+#define PST_SESSION_LOCK_TRIES  (100)   // number of attempts to lock the session in signal handler
+#define PST_SESSION_LOCK_WAIT   (1000)  // pause between attempts to lock the session in signal handler in microseconds
+
+// -----------------------------------------------------------------------------------
+// pst_session
+// -----------------------------------------------------------------------------------
+// Owns libdwfl session of the process (i.e. list of reported modules, opened ELF and debug files) and all caches derived from it.
+// Handlers borrow the session via pst_session_acquire() and give it back via pst_session_release(), so only the first capture pays
+// for parsing /proc/self/maps and opening ELF/DWARF files. Since libdwfl isn't thread-safe, borrower must hold the session lock
+// while it works with 'dwfl' or with any of the caches. Signal handlers wait for the lock for a bounded time only and fall back to
+// raw addresses if they don't get it. Shared session is published and referenced by atomics only, so signal handler never blocks on
+// it. Session is created outside of signal handlers only, signal handler which finds no shared session gets none.
+typedef struct pst_session {
+    Dwfl*                   dwfl;       // DWARF context of the process
+    pst_allocator           alloc;      // allocator for session-lifetime data (caches), independent of per-handler allocator
+    pst_symbol_cache        symbols;    // function names and source lines of code addresses
+    pst_frame_cache         frames;     // CFI of modules and decoded frame rules
+    pst_function_index      functions;  // PC ranges of functions per compilation unit
+    pst_dwarf_program_cache programs;   // compiled DWARF expressions of attributes
+    pst_dwarf_loclist_cache loclists;   // decoded location lists of attributes
+    pst_type_cache          types;      // descriptions of types of parameters and variables
+    pthread_mutex_t         lock;       // serializes access to 'dwfl' and caches
+    uint32_t                refs;       // number of references: global one plus one per borrowing handler, atomic
+    struct pst_session*     next;       // next session released by signal handler, which is destroyed outside of it
+    uint32_t                generation; // sequence number of the session, changes on every invalidation
+    bool                    allocated;  // whether this object was allocated or not
+} pst_session;
+
+bool pst_session_init(pst_session* s);
+pst_session* pst_session_new();
+void pst_session_fini(pst_session* s);
+
+pst_session* pst_session_acquire(bool signal);
+void pst_session_release(pst_session* s, bool signal);
+void pst_session_invalidate();
+
+bool pst_session_lock(pst_session* s, bool signal);
+void pst_session_unlock(pst_session* s);
+
+#endif /* __PST_SESSION_H__ */
@@ -0,0 +1,246 @@
+/*
+ * symbol_cache.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <libiberty/demangle.h>
+
+#include "context.h"
+#include "symbol_cache.h"
+#include "utils/demangle.h"
+
+static inline uint32_t hash_pc(uintptr_t pc)
+{
+    return (uint32_t)((pc * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+static uint32_t hash_str(const char* str, uint32_t len)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+    for(uint32_t i = 0; i < len; ++i) {
+        hash = (hash ^ (uint8_t)str[i]) * 16777619U;
+    }
+
+    return hash;
+}
+
+bool pst_symbol_cache_init(pst_symbol_cache* c, pst_allocator* alloc)
+{
+    c->alloc = alloc;
+    c->chunks = NULL;
+    c->strings = NULL;
+    c->strings_size = 0;
+    c->strings_count = 0;
+
+    c->entries = (pst_symbol*)alloc->alloc(alloc, PST_SYMBOL_CACHE_SIZE * sizeof(pst_symbol));
+    if(!c->entries) {
+        pst_log(SEVERITY_ERROR, "Failed to allocate symbol cache");
+        return false;
+    }
+    memset(c->entries, 0, PST_SYMBOL_CACHE_SIZE * sizeof(pst_symbol));
+
+    return true;
+}
+
+void pst_symbol_cache_fini(pst_symbol_cache* c)
+{
+    if(c->entries) {
+        c->alloc->free(c->alloc, c->entries);
+        c->entries = NULL;
+    }
+
+    if(c->strings) {
+        c->alloc->free(c->alloc, c->strings);
+        c->strings = NULL;
+    }
+
+    while(c->chunks) {
+        pst_string_chunk* next = c->chunks->next;
+        c->alloc->free(c->alloc, c->chunks);
+        c->chunks = next;
+    }
+
+    c->strings_size = 0;
+    c->strings_count = 0;
+}
+
+// find cached information about the address. doesn't take any locks
+bool pst_symbol_cache_lookup(pst_symbol_cache* c, uintptr_t pc, pst_symbol* sym)
+{
+    if(!c->entries) {
+        return false;
+    }
+
+    pst_symbol* e = &c->entries[hash_pc(pc) & (PST_SYMBOL_CACHE_SIZE - 1)];
+    uint32_t seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+    if(seq == 0 || (seq & 1)) {
+        // never filled or is being written
+        return false;
+    }
+
+    sym->pc     = __atomic_load_n(&e->pc, __ATOMIC_RELAXED);
+    sym->module = __atomic_load_n(&e->module, __ATOMIC_RELAXED);
+    sym->name   = __atomic_load_n(&e->name, __ATOMIC_RELAXED);
+    sym->file   = __atomic_load_n(&e->file, __ATOMIC_RELAXED);
+    sym->line   = __atomic_load_n(&e->line, __ATOMIC_RELAXED);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != seq) {
+        return false;
+    }
+
+    return sym->pc == pc;
+}
+
+void pst_symbol_cache_store(pst_symbol_cache* c, const pst_symbol* sym)
+{
+    if(!c->entries) {
+        return;
+    }
+
+    pst_symbol* e = &c->entries[hash_pc(sym->pc) & (PST_SYMBOL_CACHE_SIZE - 1)];
+    uint32_t seq = __atomic_load_n(&e->seq, __ATOMIC_RELAXED);
+    if((seq & 1) || !__atomic_compare_exchange_n(&e->seq, &seq, seq + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        // slot is being updated by someone else, it's just a cache
+        return;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    __atomic_store_n(&e->pc, sym->pc, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->module, sym->module, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->name, sym->name, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->file, sym->file, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->line, sym->line, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&e->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static bool strings_grow(pst_symbol_cache* c)
+{
+    if(c->strings && (c->strings_count + 1) * 2 < c->strings_size) {
+        return true;
+    }
+
+    uint32_t size = c->strings_size ? c->strings_size * 2 : 1024;
+    const char** strings = (const char**)c->alloc->alloc(c->alloc, size * sizeof(char*));
+    if(!strings) {
+        return false;
+    }
+    memset(strings, 0, size * sizeof(char*));
+
+    for(uint32_t i = 0; i < c->strings_size; ++i) {
+        if(c->strings[i]) {
+            uint32_t idx = hash_str(c->strings[i], strlen(c->strings[i])) & (size - 1);
+            while(strings[idx]) {
+                idx = (idx + 1) & (size - 1);
+            }
+            strings[idx] = c->strings[i];
+        }
+    }
+
+    if(c->strings) {
+        c->alloc->free(c->alloc, c->strings);
+    }
+    c->strings = strings;
+    c->strings_size = size;
+
+    return true;
+}
+
+// get copy of first 'len' characters of 'str' living as long as the cache. the same strings share the same copy. caller must hold session lock
+const char* pst_symbol_cache_intern(pst_symbol_cache* c, const char* str, uint32_t len)
+{
+    if(!strings_grow(c)) {
+        return NULL;
+    }
+
+    uint32_t idx = hash_str(str, len) & (c->strings_size - 1);
+    for(; c->strings[idx]; idx = (idx + 1) & (c->strings_size - 1)) {
+        if(!strncmp(c->strings[idx], str, len) && c->strings[idx][len] == 0) {
+            return c->strings[idx];
+        }
+    }
+
+    if(!c->chunks || c->chunks->size - c->chunks->used < len + 1) {
+        uint32_t size = (len + 1 > PST_STRING_CHUNK_SIZE) ? len + 1 : PST_STRING_CHUNK_SIZE;
+        pst_string_chunk* chunk = (pst_string_chunk*)c->alloc->alloc(c->alloc, sizeof(pst_string_chunk) + size);
+        if(!chunk) {
+            return NULL;
+        }
+        chunk->size = size;
+        chunk->used = 0;
+        chunk->next = c->chunks;
+        c->chunks = chunk;
+    }
+
+    char* copy = c->chunks->data + c->chunks->used;
+    memcpy(copy, str, len);
+    copy[len] = 0;
+    c->chunks->used += len + 1;
+
+    c->strings[idx] = copy;
+    c->strings_count++;
+
+    return copy;
+}
+
+// get information about the address from the cache, resolve and cache it in case of miss. caller must hold session lock.
+// 'signal_safe' forbids memory allocation by demangler, so names not supported by pst_demangle() are left mangled
+bool pst_symbol_cache_resolve(pst_symbol_cache* c, Dwfl* dwfl, uintptr_t pc, pst_symbol* sym, bool signal_safe)
+{
+    if(pst_symbol_cache_lookup(c, pc, sym)) {
+        return true;
+    }
+
+    sym->pc = pc;
+    sym->module = dwfl_addrmodule(dwfl, pc);
+    sym->name = NULL;
+    sym->file = NULL;
+    sym->line = -1;
+
+    Dwfl_Line *dwline = dwfl_getsrc(dwfl, pc);
+    if(dwline != NULL) {
+        const char* filename = dwfl_lineinfo(dwline, NULL, &sym->line, NULL, NULL, NULL);
+        if(filename) {
+            const char* file = strrchr(filename, '/');
+            if(file && *file != 0) {
+                file++;
+            } else {
+                file = filename;
+            }
+            sym->file = pst_symbol_cache_intern(c, file, strlen(file));
+        }
+    }
+
+    const char* addrname = sym->module ? dwfl_module_addrname(sym->module, pc) : NULL;
+    if(addrname) {
+        char buff[PST_DEMANGLE_NAME_MAX];
+        if(pst_demangle(addrname, buff, sizeof(buff), DEMANGLE_NAME_ONLY)) {
+            sym->name = pst_symbol_cache_intern(c, buff, strlen(buff));
+        } else if(!signal_safe) {
+            // libiberty supports more of the mangling, but allocates memory
+            char* demangle_name = cplus_demangle(addrname, 0);
+            const char* name = demangle_name ? demangle_name : addrname;
+
+            // strip parameters of the function
+            const char* str = strchr(name, '(');
+            sym->name = pst_symbol_cache_intern(c, name, str ? (uint32_t)(str - name) : strlen(name));
+
+            if(demangle_name) {
+                free(demangle_name);
+            }
+        } else {
+            sym->name = pst_symbol_cache_intern(c, addrname, strlen(addrname));
+        }
+    }
+
+    // negative results are cached too, so unknown addresses are resolved only once
+    pst_symbol_cache_store(c, sym);
+
+    return true;
+}
@@ -0,0 +1,64 @@
+/*
+ * symbol_cache.h
+ *
+ * Cache of function names and source lines of code addresses
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_SYMBOL_CACHE_H__
+#define __PST_SYMBOL_CACHE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <elfutils/libdwfl.h>
+
+#include "utils/allocator.h"
+
+#define PST_SYMBOL_CACHE_SIZE   (4096)          // number of cached addresses, power of two
+#define PST_STRING_CHUNK_SIZE   (64 * 1024)     // size of chunk of interned strings storage
+#define PST_DEMANGLE_NAME_MAX   (1024)          // maximum length of demangled function name
+
+// function name and source line of the code address
+typedef struct pst_symbol {
+    uint32_t        seq;        // sequence counter of the slot, odd while slot is being written
+    uintptr_t       pc;         // code address
+    Dwfl_Module*    module;     // module containing 'pc'
+    const char*     name;       // demangled function name without parameters, NULL if unknown
+    const char*     file;       // source file name without path, NULL if unknown
+    int             line;       // source line, -1 if unknown
+} pst_symbol;
+
+// chunk of storage of interned strings
+typedef struct pst_string_chunk {
+    struct pst_string_chunk*    next;   // previously allocated chunk
+    uint32_t                    size;   // size of 'data'
+    uint32_t                    used;   // number of used bytes of 'data'
+    char                        data[]; // strings
+} pst_string_chunk;
+
+// -----------------------------------------------------------------------------------
+// pst_symbol_cache
+// -----------------------------------------------------------------------------------
+// Direct mapped (module, PC) -> {name, file, line} cache. Each slot is protected by its own sequence lock, so lookups don't take any lock
+// and writer just skips the slot if another one updates it right now. Names are interned for the life of the cache, so repeated stack traces
+// neither touch DWARF nor allocate memory. Resolving of missed addresses and interning of strings requires session lock.
+typedef struct pst_symbol_cache {
+    pst_allocator*      alloc;          // allocator for entries and strings
+    pst_symbol*         entries;        // slots indexed by hash of PC
+    pst_string_chunk*   chunks;         // storage of interned strings
+    const char**        strings;        // open addressing set of interned strings
+    uint32_t            strings_size;   // number of slots in 'strings', power of two
+    uint32_t            strings_count;  // number of used slots in 'strings'
+} pst_symbol_cache;
+
+bool pst_symbol_cache_init(pst_symbol_cache* c, pst_allocator* alloc);
+void pst_symbol_cache_fini(pst_symbol_cache* c);
+
+bool pst_symbol_cache_lookup(pst_symbol_cache* c, uintptr_t pc, pst_symbol* sym);
+void pst_symbol_cache_store(pst_symbol_cache* c, const pst_symbol* sym);
+const char* pst_symbol_cache_intern(pst_symbol_cache* c, const char* str, uint32_t len);
+bool pst_symbol_cache_resolve(pst_symbol_cache* c, Dwfl* dwfl, uintptr_t pc, pst_symbol* sym, bool signal_safe);
+
+#endif /* __PST_SYMBOL_CACHE_H__ */
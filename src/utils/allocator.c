@@ -1,5 +1,5 @@
 /*
- * allocator.cpp
+ * allocator.c
  *
  *  Created on: Jan 28, 2020
  *      Author: nnosov
@@ -9,34 +9,391 @@
 #include <stdlib.h>
 #include <malloc.h>
 #include <string.h>
+#include <stdbool.h>
 
 #include "allocator.h"
 
-void heap_free(pst_allocator* alloc, void* buff)
+// -----------------------------------------------------------------------------------
+// heap allocator
+// -----------------------------------------------------------------------------------
+// Each thread has its own cache of freed blocks per power of two size class, so most of allocations and deallocations don't
+// touch any shared data. Block freed by a thread other than its owner is pushed to owner's lock-free list of remote blocks, which
+// owner takes back at once when its local cache of the class runs out. Caches of exited threads are kept in the registry and adopted
+// by new threads. Blocks larger than the biggest class and blocks above cache limit go directly to libc.
+
+#define HEAP_ALIGN      (16)        // alignment of blocks, the same as malloc() has on x86_64
+#define HEAP_CLASSES    (9)         // number of size classes of per-thread cache: 16 bytes ... 4Kb
+#define HEAP_CACHE_MAX  (64)        // maximum number of cached blocks per size class
+#define HEAP_LARGE      (0xFFFF)    // size class of blocks which aren't cached
+
+struct __pst_heap_cache;
+
+// header of each block allocated by heap allocator
+typedef struct __pst_heap_block {
+    struct __pst_heap_cache*    owner;  // cache of the thread which allocated the block
+    uint32_t                    cls;    // size class of the block or HEAP_LARGE
+    uint32_t                    size;   // size requested by user
+} pst_heap_block;
+
+// link of freed block in the cache, placed at the start of block's payload
+typedef struct __pst_heap_free {
+    struct __pst_heap_free*     next;
+} pst_heap_free;
+
+typedef struct __pst_heap_cache {
+    pst_heap_free*              lists[HEAP_CLASSES];    // freed blocks owned by this cache
+    uint32_t                    counts[HEAP_CLASSES];   // number of blocks in 'lists'
+    pst_heap_free*              remote;                 // blocks freed by other threads, pushed lock-free
+    int64_t                     bytes;                  // bytes allocated minus bytes freed by owner thread (may be negative)
+    uint32_t                    alive;                  // non-zero while cache is owned by a thread
+    struct __pst_heap_cache*    next;                   // next cache in the registry
+} pst_heap_cache;
+
+static pst_heap_cache*  registry = NULL;        // all caches ever created, never freed
+static pthread_key_t    cache_key;              // used only to be notified about exit of thread
+static pthread_once_t   cache_once = PTHREAD_ONCE_INIT;
+static __thread pst_heap_cache* cache __attribute__((tls_model("initial-exec"))) = NULL;
+
+static inline uint32_t heap_class_size(uint32_t cls)
+{
+    return HEAP_ALIGN << cls;
+}
+
+static inline uint32_t heap_size_class(uint32_t size)
+{
+    if(size <= HEAP_ALIGN) {
+        return 0;
+    }
+
+    uint32_t cls = 32 - __builtin_clz((size - 1) / HEAP_ALIGN);
+
+    return cls < HEAP_CLASSES ? cls : HEAP_LARGE;
+}
+
+static void heap_thread_exit(void* arg)
+{
+    // keep cached blocks, the next adopter of the cache will use them. the cache may be adopted by another thread right after it's
+    // marked dead, so forget it first: allocations from later TLS destructors of this thread take the slow path and adopt a cache
+    // again, which sets the key and gets this destructor called once more
+    pst_heap_cache* c = (pst_heap_cache*)arg;
+    cache = NULL;
+    __atomic_store_n(&c->alive, 0, __ATOMIC_RELEASE);
+}
+
+static void heap_once()
+{
+    pthread_key_create(&cache_key, heap_thread_exit);
+}
+
+// get cache of the calling thread. first call in the thread adopts cache of exited thread or creates a new one
+static pst_heap_cache* heap_cache()
+{
+    if(cache) {
+        return cache;
+    }
+
+    pthread_once(&cache_once, heap_once);
+
+    pst_heap_cache* c = NULL;
+    for(pst_heap_cache* it = __atomic_load_n(&registry, __ATOMIC_ACQUIRE); it; it = it->next) {
+        uint32_t dead = 0;
+        if(!__atomic_load_n(&it->alive, __ATOMIC_RELAXED) &&
+           __atomic_compare_exchange_n(&it->alive, &dead, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            c = it;
+            break;
+        }
+    }
+
+    if(!c) {
+        c = (pst_heap_cache*)calloc(1, sizeof(pst_heap_cache));
+        if(!c) {
+            return NULL;
+        }
+        c->alive = 1;
+
+        c->next = __atomic_load_n(&registry, __ATOMIC_RELAXED);
+        while(!__atomic_compare_exchange_n(&registry, &c->next, c, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+
+    pthread_setspecific(cache_key, c);
+    cache = c;
+
+    return c;
+}
+
+// move blocks freed by other threads to local lists
+static void heap_drain_remote(pst_heap_cache* c)
+{
+    pst_heap_free* f = __atomic_exchange_n(&c->remote, NULL, __ATOMIC_ACQUIRE);
+    while(f) {
+        pst_heap_free* next = f->next;
+        pst_heap_block* block = (pst_heap_block*)f - 1;
+        if(c->counts[block->cls] < HEAP_CACHE_MAX) {
+            f->next = c->lists[block->cls];
+            c->lists[block->cls] = f;
+            c->counts[block->cls]++;
+        } else {
+            free(block);
+        }
+        f = next;
+    }
+}
+
+static inline void heap_account(pst_heap_cache* c, int64_t delta)
 {
-    pthread_mutex_lock(&alloc->lock);
-    alloc->size -= malloc_usable_size(buff);
-    pthread_mutex_unlock(&alloc->lock);
-    free(buff);
+    // only owner thread writes the counter, pst_alloc_used() may read it concurrently
+    __atomic_store_n(&c->bytes, c->bytes + delta, __ATOMIC_RELAXED);
 }
 
 void* heap_alloc(pst_allocator* alloc, uint32_t size)
 {
-    void* buff = malloc(size);
-    pthread_mutex_lock(&alloc->lock);
-    alloc->size += malloc_usable_size(buff);
-    pthread_mutex_unlock(&alloc->lock);
+    pst_heap_cache* c = heap_cache();
+    if(!c) {
+        __atomic_add_fetch(&alloc->failures, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    uint32_t cls = heap_size_class(size);
+    pst_heap_block* block = NULL;
+    if(cls != HEAP_LARGE) {
+        if(!c->lists[cls] && __atomic_load_n(&c->remote, __ATOMIC_RELAXED)) {
+            heap_drain_remote(c);
+        }
+
+        pst_heap_free* f = c->lists[cls];
+        if(f) {
+            c->lists[cls] = f->next;
+            c->counts[cls]--;
+            block = (pst_heap_block*)f - 1;
+        } else {
+            block = (pst_heap_block*)malloc(sizeof(pst_heap_block) + heap_class_size(cls));
+        }
+    } else {
+        block = (pst_heap_block*)malloc(sizeof(pst_heap_block) + (uint64_t)size);
+    }
+
+    if(!block) {
+        __atomic_add_fetch(&alloc->failures, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    block->owner = c;
+    block->cls = cls;
+    block->size = size;
+    heap_account(c, cls != HEAP_LARGE ? heap_class_size(cls) : size);
+
+    return block + 1;
+}
+
+void heap_free(pst_allocator* alloc, void* buff)
+{
+    if(!buff) {
+        return;
+    }
+
+    pst_heap_block* block = (pst_heap_block*)buff - 1;
+    pst_heap_cache* c = heap_cache();
+    if(c) {
+        heap_account(c, -(int64_t)(block->cls != HEAP_LARGE ? heap_class_size(block->cls) : block->size));
+    }
 
-    return buff;
+    if(block->cls == HEAP_LARGE) {
+        free(block);
+        return;
+    }
+
+    pst_heap_free* f = (pst_heap_free*)buff;
+    if(block->owner == c) {
+        if(c->counts[block->cls] < HEAP_CACHE_MAX) {
+            f->next = c->lists[block->cls];
+            c->lists[block->cls] = f;
+            c->counts[block->cls]++;
+        } else {
+            free(block);
+        }
+        return;
+    }
+
+    // only owner takes whole remote list at once, so there is no ABA problem there
+    pst_heap_cache* owner = block->owner;
+    f->next = __atomic_load_n(&owner->remote, __ATOMIC_RELAXED);
+    while(!__atomic_compare_exchange_n(&owner->remote, &f->next, f, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
 }
 
 void* heap_realloc(pst_allocator* alloc, void* buff, uint32_t new_size)
 {
-    pthread_mutex_lock(&alloc->lock);
-    alloc->size -= malloc_usable_size(buff);
-    void* new_buff = realloc(buff, new_size);
-    alloc->size += malloc_usable_size(new_buff);
-    pthread_mutex_unlock(&alloc->lock);
+    if(!buff) {
+        return heap_alloc(alloc, new_size);
+    }
+
+    pst_heap_block* block = (pst_heap_block*)buff - 1;
+    if(block->cls != HEAP_LARGE && new_size <= heap_class_size(block->cls)) {
+        block->size = new_size;
+        return buff;
+    }
+
+    void* new_buff = heap_alloc(alloc, new_size);
+    if(new_buff) {
+        memcpy(new_buff, buff, block->size < new_size ? block->size : new_size);
+        heap_free(alloc, buff);
+    }
+
+    return new_buff;
+}
+
+// -----------------------------------------------------------------------------------
+// custom allocator
+// -----------------------------------------------------------------------------------
+// Arena over caller's buffer. Blocks are carved from the arena by atomic bump of 'top' and rounded up to power of two size class,
+// freed blocks are kept in per-class lock-free lists and reused by the next allocations of the same class. Neither locks nor
+// syscalls are used, so it is safe to use it inside signal handler. All blocks are dropped at once by pst_alloc_reset().
+
+#define ARENA_ALIGN     (16)        // alignment of blocks, the same as malloc() has on x86_64
+#define ARENA_MAGIC     (0x50535442)
+
+// header of each block in the arena
+typedef struct __pst_arena_block {
+    uint32_t    cls;        // size class of the block
+    uint32_t    next;       // offset of the next freed block of the same class, valid only while block is in the free list
+    uint32_t    size;       // size requested by user
+    uint32_t    magic;      // ARENA_MAGIC for blocks allocated from the arena
+} pst_arena_block;
+
+static inline uint32_t class_size(uint32_t cls)
+{
+    return ARENA_ALIGN << cls;
+}
+
+// find the smallest size class which fits 'size' bytes
+static inline int size_class(uint32_t size)
+{
+    if(size <= ARENA_ALIGN) {
+        return 0;
+    }
+
+    int cls = 32 - __builtin_clz((size - 1) / ARENA_ALIGN);
+
+    return cls < PST_ALLOC_CLASSES ? cls : -1;
+}
+
+static inline pst_arena_block* arena_block(pst_allocator* alloc, uint32_t offset)
+{
+    return (pst_arena_block*)((char*)alloc->base + offset);
+}
+
+// get block from the list of freed blocks of given size class
+static pst_arena_block* arena_pop(pst_allocator* alloc, uint32_t cls)
+{
+    uint64_t head = __atomic_load_n(&alloc->heads[cls], __ATOMIC_ACQUIRE);
+    while((uint32_t)head) {
+        pst_arena_block* block = arena_block(alloc, (uint32_t)head);
+        // tag in upper half of the head protects from ABA if block was popped and pushed back in between
+        uint64_t next = (((head >> 32) + 1) << 32) | __atomic_load_n(&block->next, __ATOMIC_RELAXED);
+        if(__atomic_compare_exchange_n(&alloc->heads[cls], &head, next, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            return block;
+        }
+    }
+
+    return NULL;
+}
+
+static void arena_push(pst_allocator* alloc, pst_arena_block* block)
+{
+    uint32_t offset = (char*)block - (char*)alloc->base;
+    uint64_t head = __atomic_load_n(&alloc->heads[block->cls], __ATOMIC_RELAXED);
+    uint64_t next;
+    do {
+        __atomic_store_n(&block->next, (uint32_t)head, __ATOMIC_RELAXED);
+        next = (((head >> 32) + 1) << 32) | offset;
+    } while(!__atomic_compare_exchange_n(&alloc->heads[block->cls], &head, next, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// carve new block from not yet used part of the arena
+static pst_arena_block* arena_bump(pst_allocator* alloc, uint32_t cls)
+{
+    uint64_t need = sizeof(pst_arena_block) + class_size(cls);
+    uint32_t top = __atomic_load_n(&alloc->top, __ATOMIC_RELAXED);
+    do {
+        if(top + need > alloc->size) {
+            return NULL;
+        }
+    } while(!__atomic_compare_exchange_n(&alloc->top, &top, top + need, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    pst_arena_block* block = arena_block(alloc, top);
+    block->cls = cls;
+    block->magic = ARENA_MAGIC;
+
+    return block;
+}
+
+static pst_arena_block* arena_header(pst_allocator* alloc, void* buff)
+{
+    if((char*)buff < (char*)alloc->base + ARENA_ALIGN + sizeof(pst_arena_block) || (char*)buff >= (char*)alloc->base + alloc->size) {
+        return NULL;
+    }
+
+    pst_arena_block* block = (pst_arena_block*)buff - 1;
+    if(block->magic != ARENA_MAGIC) {
+        return NULL;
+    }
+
+    return block;
+}
+
+void* arena_alloc(pst_allocator* alloc, uint32_t size)
+{
+    int cls = size_class(size);
+    pst_arena_block* block = NULL;
+    if(cls >= 0) {
+        block = arena_pop(alloc, cls);
+        if(!block) {
+            block = arena_bump(alloc, cls);
+        }
+    }
+
+    if(!block) {
+        __atomic_add_fetch(&alloc->failures, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    block->size = size;
+
+    return block + 1;
+}
+
+void arena_free(pst_allocator* alloc, void* buff)
+{
+    if(!buff) {
+        return;
+    }
+
+    pst_arena_block* block = arena_header(alloc, buff);
+    if(block) {
+        arena_push(alloc, block);
+    }
+}
+
+void* arena_realloc(pst_allocator* alloc, void* buff, uint32_t new_size)
+{
+    if(!buff) {
+        return arena_alloc(alloc, new_size);
+    }
+
+    pst_arena_block* block = arena_header(alloc, buff);
+    if(!block) {
+        return NULL;
+    }
+
+    if(new_size <= class_size(block->cls)) {
+        block->size = new_size;
+        return buff;
+    }
+
+    void* new_buff = arena_alloc(alloc, new_size);
+    if(new_buff) {
+        memcpy(new_buff, buff, block->size);
+        arena_push(alloc, block);
+    }
 
     return new_buff;
 }
@@ -46,30 +403,73 @@ void pst_alloc_init(pst_allocator* alloc)
     alloc->type = ALLOC_HEAP;
     alloc->base = NULL;
     alloc->size = 0;
+    alloc->top = 0;
+    alloc->failures = 0;
+    memset(alloc->heads, 0, sizeof(alloc->heads));
 
     alloc->alloc = heap_alloc;
     alloc->free = heap_free;
     alloc->realloc = heap_realloc;
 
-    pthread_mutex_init(&alloc->lock, NULL);
-
     return;
 }
 
 void pst_alloc_init_custom(pst_allocator* alloc, void* buff, uint32_t size)
 {
-    // TBD to implement custom allocator
     pst_alloc_init(alloc);
-    return;
+
+    // align start of the arena, so that all blocks are aligned too
+    uintptr_t start = ((uintptr_t)buff + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1);
+    if(start - (uintptr_t)buff >= size) {
+        // buffer is too small, so every allocation will fail and be counted
+        size = (uint32_t)(start - (uintptr_t)buff);
+    }
+
+    alloc->type = ALLOC_CUSTOM;
+    alloc->base = (void*)start;
+    alloc->size = size - (uint32_t)(start - (uintptr_t)buff);
+
+    alloc->alloc = arena_alloc;
+    alloc->free = arena_free;
+    alloc->realloc = arena_realloc;
+
+    pst_alloc_reset(alloc);
+}
+
+// drop all blocks allocated by custom allocator at once. caller is responsible that none of them is used anymore
+void pst_alloc_reset(pst_allocator* alloc)
+{
+    if(alloc->type != ALLOC_CUSTOM) {
+        return;
+    }
+
+    // zero offset is used as end of free lists, so don't give out the first bytes of the arena
+    alloc->top = ARENA_ALIGN;
+    memset(alloc->heads, 0, sizeof(alloc->heads));
 }
 
 void pst_alloc_fini(pst_allocator* alloc)
 {
+    pst_alloc_reset(alloc);
+
     if(alloc->type == ALLOC_HEAP || alloc->type == ALLOC_CUSTOM) {
         alloc->type = ALLOC_NONE;
         alloc->base = NULL;
         alloc->size = 0;
     }
+}
+
+// get number of bytes in use. for heap allocator it is summed over caches of all threads and includes all heap allocators
+uint64_t pst_alloc_used(pst_allocator* alloc)
+{
+    if(alloc->type == ALLOC_CUSTOM) {
+        return __atomic_load_n(&alloc->top, __ATOMIC_RELAXED);
+    }
+
+    int64_t bytes = 0;
+    for(pst_heap_cache* c = __atomic_load_n(&registry, __ATOMIC_ACQUIRE); c; c = c->next) {
+        bytes += __atomic_load_n(&c->bytes, __ATOMIC_RELAXED);
+    }
 
-    pthread_mutex_destroy(&alloc->lock);
+    return bytes > 0 ? bytes : 0;
 }
@@ -38,6 +38,8 @@ typedef enum {
     ALLOC_CUSTOM = 2    // use custom allocator in predefined range of memory
 } pst_alloc_type;
 
+#define PST_ALLOC_CLASSES   (28)    // number of size classes of custom allocator: 16 bytes ... 2Gb
+
 typedef struct __pst_allocator {
     // methods
     void* (*alloc)(struct __pst_allocator* alloc, uint32_t size);
@@ -46,14 +48,18 @@ typedef struct __pst_allocator {
 
     // fields
     int             type;
-    void*           base;
-    uint32_t        size;
-    pthread_mutex_t lock;
+    void*           base;       // start of arena (custom allocator only)
+    uint32_t        size;       // size of arena (custom allocator only)
+    uint32_t        top;        // offset of not yet used part of arena
+    uint32_t        failures;   // number of allocation requests which weren't satisfied
+    uint64_t        heads[PST_ALLOC_CLASSES]; // lists of freed blocks per size class as (ABA tag << 32 | offset)
 
 } pst_allocator;
 
 void pst_alloc_init(pst_allocator* alloc);
 void pst_alloc_init_custom(pst_allocator* alloc, void* buff, uint32_t size);
+void pst_alloc_reset(pst_allocator* alloc);
 void pst_alloc_fini(pst_allocator* alloc);
+uint64_t pst_alloc_used(pst_allocator* alloc);
 
 #endif /* __PST_ALLOCATOR_H__ */
@@ -0,0 +1,408 @@
+/*
+ * binlog.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "binlog.h"
+
+// class of argument of conversion specification
+typedef enum {
+    ARG_NONE    = 0,    // '%%' or unknown conversion, takes no argument
+    ARG_INT,            // integer promoted to int
+    ARG_LONG,           // integer with 'l', 'll', 'z', 'j' or 't' length modifier
+    ARG_DOUBLE,         // floating point
+    ARG_LDOUBLE,        // floating point with 'L' length modifier, stored as double
+    ARG_STRING,         // zero terminated string, copied to record
+    ARG_POINTER,        // pointer
+    ARG_SKIP,           // '%n', argument is taken but nothing is rendered
+} pst_binlog_arg;
+
+// conversion specification of format string
+typedef struct pst_binlog_spec {
+    const char*         start;      // '%' of specification
+    const char*         end;        // the first character after specification
+    uint32_t            stars;      // number of '*' in width and precision, each of them takes int argument
+    pst_binlog_arg      arg;        // class of argument
+} pst_binlog_spec;
+
+static __thread pst_binlog_buffer*  own = NULL;         // buffer of calling thread
+static __thread uint32_t            own_generation = 0; // generation of binlog the buffer belongs to
+static uint32_t                     generations = 0;    // the last generation of binlog
+
+static const char* parse_spec(const char* p, pst_binlog_spec* s)
+{
+    s->start = p++;
+    s->stars = 0;
+
+    while(*p && strchr("-+ #0'", *p)) {
+        p++;
+    }
+    if(*p == '*') {
+        s->stars++;
+        p++;
+    } else {
+        while(*p >= '0' && *p <= '9') p++;
+    }
+    if(*p == '.') {
+        p++;
+        if(*p == '*') {
+            s->stars++;
+            p++;
+        } else {
+            while(*p >= '0' && *p <= '9') p++;
+        }
+    }
+
+    uint32_t longs = 0;
+    bool ldouble = false;
+    for(; *p && strchr("hlLqjzt", *p); ++p) {
+        longs += (*p != 'h');
+        ldouble |= (*p == 'L');
+    }
+
+    switch(*p) {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+            s->arg = longs ? ARG_LONG : ARG_INT;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            s->arg = ldouble ? ARG_LDOUBLE : ARG_DOUBLE;
+            break;
+        case 's':
+            s->arg = ARG_STRING;
+            break;
+        case 'p':
+            s->arg = ARG_POINTER;
+            break;
+        case 'n':
+            s->arg = ARG_SKIP;
+            break;
+        default:
+            s->arg = ARG_NONE;
+            break;
+    }
+
+    s->end = *p ? p + 1 : p;
+
+    return s->end;
+}
+
+bool pst_binlog_init(pst_binlog* b)
+{
+    memset(b->buffers, 0, sizeof(b->buffers));
+    b->generation = __atomic_add_fetch(&generations, 1, __ATOMIC_RELAXED);
+    b->drains = 0;
+
+    struct timespec real, mono;
+    clock_gettime(CLOCK_REALTIME, &real);
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &mono);
+    b->realtime = (real.tv_sec - mono.tv_sec) * 1000000000LL + (real.tv_nsec - mono.tv_nsec);
+
+    return true;
+}
+
+void pst_binlog_fini(pst_binlog* b)
+{
+    for(uint32_t i = 0; i < PST_BINLOG_THREADS; ++i) {
+        if(b->buffers[i].data) {
+            munmap(b->buffers[i].data, PST_BINLOG_BUFFER);
+            b->buffers[i].data = NULL;
+        }
+        b->buffers[i].tid = 0;
+    }
+}
+
+// get buffer of calling thread, claim free one on the first call. memory is mapped by mmap(), since it's async-signal-safe
+static pst_binlog_buffer* own_buffer(pst_binlog* b)
+{
+    if(own && own_generation == b->generation) {
+        return own;
+    }
+
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    for(uint32_t i = 0; i < PST_BINLOG_THREADS; ++i) {
+        pst_binlog_buffer* buf = &b->buffers[i];
+        pid_t expected = 0;
+        if(!__atomic_compare_exchange_n(&buf->tid, &expected, tid, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            continue;
+        }
+
+        // buffer of exited thread keeps its memory
+        if(!__atomic_load_n(&buf->data, __ATOMIC_ACQUIRE)) {
+            void* data = mmap(NULL, PST_BINLOG_BUFFER, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(data == MAP_FAILED) {
+                __atomic_store_n(&buf->tid, 0, __ATOMIC_RELEASE);
+                return NULL;
+            }
+            __atomic_store_n(&buf->data, (uint8_t*)data, __ATOMIC_RELEASE);
+        }
+
+        own = buf;
+        own_generation = b->generation;
+
+        return buf;
+    }
+
+    return NULL;
+}
+
+// copy record to buffer. record which doesn't fit into the end of buffer is preceded by padding up to the end
+static bool buffer_write(pst_binlog_buffer* buf, const pst_binlog_record* r)
+{
+    uint64_t head = buf->head;
+    uint64_t tail = __atomic_load_n(&buf->tail, __ATOMIC_ACQUIRE);
+    uint32_t off = head & (PST_BINLOG_BUFFER - 1);
+    uint32_t pad = (PST_BINLOG_BUFFER - off < r->size) ? PST_BINLOG_BUFFER - off : 0;
+    if(head + pad + r->size - tail > PST_BINLOG_BUFFER) {
+        return false;
+    }
+
+    // too short tail of buffer is skipped by reader without padding record
+    if(pad >= sizeof(pst_binlog_record)) {
+        pst_binlog_record* p = (pst_binlog_record*)(buf->data + off);
+        p->fmt = NULL;
+        p->size = pad;
+    }
+    head += pad;
+
+    memcpy(buf->data + (head & (PST_BINLOG_BUFFER - 1)), r, r->size);
+    __atomic_store_n(&buf->head, head + r->size, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+// store time, format string and raw arguments of message. returns false if message is dropped
+bool pst_binlog_write(pst_binlog* b, int severity, const char* fmt, va_list args)
+{
+    pst_binlog_buffer* buf = own_buffer(b);
+    if(!buf || __atomic_load_n(&buf->busy, __ATOMIC_RELAXED)) {
+        return false;
+    }
+    __atomic_store_n(&buf->busy, 1, __ATOMIC_RELAXED);
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+    uint64_t mem[(sizeof(pst_binlog_record) + PST_BINLOG_ARGS * (sizeof(uint64_t) + PST_BINLOG_STRING)) / sizeof(uint64_t) + 1];
+    pst_binlog_record* r = (pst_binlog_record*)mem;
+    const char* strings[PST_BINLOG_ARGS];
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    r->time = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    r->fmt = fmt;
+    r->severity = severity;
+    r->reserved = 0;
+
+    // arguments are taken by classes of conversions, so va_list stays in sync with format
+    uint32_t nargs = 0;
+    for(const char* p = strchr(fmt, '%'); p; p = strchr(p, '%')) {
+        pst_binlog_spec s;
+        p = parse_spec(p, &s);
+        if(s.arg == ARG_NONE) {
+            continue;
+        }
+        if(nargs + s.stars + 1 > PST_BINLOG_ARGS) {
+            break;
+        }
+
+        for(uint32_t i = 0; i < s.stars; ++i) {
+            strings[nargs] = NULL;
+            r->args[nargs++] = (uint64_t)va_arg(args, int);
+        }
+
+        strings[nargs] = NULL;
+        switch(s.arg) {
+            case ARG_INT:
+                r->args[nargs] = (uint64_t)va_arg(args, int);
+                break;
+            case ARG_LONG:
+                r->args[nargs] = (uint64_t)va_arg(args, long);
+                break;
+            case ARG_DOUBLE: {
+                double d = va_arg(args, double);
+                memcpy(&r->args[nargs], &d, sizeof(d));
+                break;
+            }
+            case ARG_LDOUBLE: {
+                double d = (double)va_arg(args, long double);
+                memcpy(&r->args[nargs], &d, sizeof(d));
+                break;
+            }
+            case ARG_STRING:
+                strings[nargs] = va_arg(args, const char*);
+                r->args[nargs] = 0;
+                break;
+            default:
+                r->args[nargs] = (uint64_t)va_arg(args, void*);
+                break;
+        }
+        nargs++;
+    }
+    r->nargs = nargs;
+
+    // strings may be freed right after the call, so they are copied behind arguments. NULL string keeps zero offset
+    uint32_t size = sizeof(pst_binlog_record) + nargs * sizeof(uint64_t);
+    for(uint32_t i = 0; i < nargs; ++i) {
+        if(strings[i]) {
+            uint32_t len = strnlen(strings[i], PST_BINLOG_STRING - 1);
+            memcpy((uint8_t*)r + size, strings[i], len);
+            ((uint8_t*)r)[size + len] = 0;
+            r->args[i] = size;
+            size += len + 1;
+        }
+    }
+    r->size = (size + 7) & ~7U;
+
+    bool ret = buffer_write(buf, r);
+
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    __atomic_store_n(&buf->busy, 0, __ATOMIC_RELAXED);
+
+    return ret;
+}
+
+#define RENDER(VALUE) \
+    (s.stars == 0 ? snprintf(dst, size, spec, VALUE) : \
+     s.stars == 1 ? snprintf(dst, size, spec, w[0], VALUE) : snprintf(dst, size, spec, w[0], w[1], VALUE))
+
+// render record to text by format string, each conversion is printed separately with its stored argument
+static uint32_t render(const pst_binlog_record* r, char* text, uint32_t max)
+{
+    uint32_t len = 0;
+    uint32_t next = 0;
+    const char* p = r->fmt;
+    while(*p && len < max - 1) {
+        if(*p != '%') {
+            text[len++] = *p++;
+            continue;
+        }
+
+        pst_binlog_spec s;
+        const char* end = parse_spec(p, &s);
+        uint32_t need = (s.arg == ARG_NONE) ? 0 : s.stars + 1;
+        if(s.arg == ARG_NONE || next + need > r->nargs || end - p >= 32) {
+            // '%%', unknown conversion or arguments which weren't stored are printed as is
+            if(s.arg == ARG_NONE && end - p == 2 && p[1] == '%') {
+                text[len++] = '%';
+                p = end;
+                continue;
+            }
+            for(; p < end && len < max - 1; ++p) {
+                text[len++] = *p;
+            }
+            continue;
+        }
+
+        // long double was stored as double
+        char spec[32];
+        uint32_t spec_len = 0;
+        for(const char* c = p; c < end; ++c) {
+            if(!(s.arg == ARG_LDOUBLE && *c == 'L')) {
+                spec[spec_len++] = *c;
+            }
+        }
+        spec[spec_len] = 0;
+
+        int w[2] = { 0, 0 };
+        for(uint32_t i = 0; i < s.stars; ++i) {
+            w[i] = (int)r->args[next++];
+        }
+        uint64_t v = r->args[next++];
+
+        char* dst = text + len;
+        uint32_t size = max - len;
+        int n = 0;
+        double d;
+        switch(s.arg) {
+            case ARG_INT:
+                n = RENDER((int)v);
+                break;
+            case ARG_LONG:
+                n = RENDER((long)v);
+                break;
+            case ARG_DOUBLE:
+            case ARG_LDOUBLE:
+                memcpy(&d, &v, sizeof(d));
+                n = RENDER(d);
+                break;
+            case ARG_STRING:
+                n = RENDER(v ? (const char*)r + v : "(null)");
+                break;
+            case ARG_POINTER:
+                n = RENDER((void*)v);
+                break;
+            default:
+                break;
+        }
+        if(n > 0) {
+            len += ((uint32_t)n < size) ? (uint32_t)n : size - 1;
+        }
+        p = end;
+    }
+
+    return len;
+}
+
+// buffers of exited threads are given back. buffer is checked only when it's empty, so no record of exited thread is lost
+static void reclaim(pst_binlog* b)
+{
+    pid_t pid = getpid();
+    for(uint32_t i = 0; i < PST_BINLOG_THREADS; ++i) {
+        pst_binlog_buffer* buf = &b->buffers[i];
+        pid_t tid = __atomic_load_n(&buf->tid, __ATOMIC_ACQUIRE);
+        if(!tid || __atomic_load_n(&buf->head, __ATOMIC_ACQUIRE) != buf->tail) {
+            continue;
+        }
+        if(syscall(SYS_tgkill, pid, tid, 0) && errno == ESRCH) {
+            __atomic_store_n(&buf->tid, 0, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+// render all stored records and pass them to 'out'. records of single thread keep their order. returns false if there was nothing to render
+bool pst_binlog_drain(pst_binlog* b, pst_binlog_output out, void* arg)
+{
+    bool rendered = false;
+    char text[PST_BINLOG_TEXT];
+    for(uint32_t i = 0; i < PST_BINLOG_THREADS; ++i) {
+        pst_binlog_buffer* buf = &b->buffers[i];
+        uint8_t* data = __atomic_load_n(&buf->data, __ATOMIC_ACQUIRE);
+        if(!data) {
+            continue;
+        }
+
+        uint64_t head = __atomic_load_n(&buf->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = buf->tail;
+        while(tail < head) {
+            uint32_t off = tail & (PST_BINLOG_BUFFER - 1);
+            if(PST_BINLOG_BUFFER - off < sizeof(pst_binlog_record)) {
+                tail += PST_BINLOG_BUFFER - off;
+                continue;
+            }
+
+            const pst_binlog_record* r = (const pst_binlog_record*)(data + off);
+            if(r->fmt) {
+                uint64_t time = r->time + b->realtime;
+                struct timespec ts = { (time_t)(time / 1000000000ULL), (long)(time % 1000000000ULL) };
+                out(arg, r->severity, &ts, text, render(r, text, sizeof(text)));
+                rendered = true;
+            }
+            tail += r->size;
+        }
+        __atomic_store_n(&buf->tail, tail, __ATOMIC_RELEASE);
+    }
+
+    if(++b->drains >= PST_BINLOG_RECLAIM) {
+        b->drains = 0;
+        reclaim(b);
+    }
+
+    return rendered;
+}
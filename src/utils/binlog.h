@@ -0,0 +1,67 @@
+/*
+ * binlog.h
+ *
+ * Deferred logging: call sites store raw arguments, text is rendered later by the writer thread
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_BINLOG_H__
+#define __PST_BINLOG_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <time.h>
+#include <sys/types.h>
+
+#define PST_BINLOG_THREADS  (64)            // maximum number of threads with own buffer
+#define PST_BINLOG_BUFFER   (64 * 1024)     // size of buffer of thread in bytes, power of two
+#define PST_BINLOG_ARGS     (8)             // maximum number of stored argument words, the rest of format is rendered as is
+#define PST_BINLOG_STRING   (128)           // maximum number of stored bytes of string argument
+#define PST_BINLOG_TEXT     (1024)          // maximum length of rendered message
+#define PST_BINLOG_RECLAIM  (256)           // number of drains between checks for buffers of exited threads
+
+// record of deferred message. followed by argument words and copies of string arguments
+typedef struct pst_binlog_record {
+    uint64_t            time;       // CLOCK_MONOTONIC_COARSE time of the call in nanoseconds
+    const char*         fmt;        // format string, identifies call site
+    uint32_t            size;       // size of record including arguments and strings, multiple of 8
+    uint8_t             severity;   // severity of message
+    uint8_t             nargs;      // number of items in 'args'
+    uint16_t            reserved;
+    uint64_t            args[];     // raw argument words. string argument is offset of its copy from the start of record
+} pst_binlog_record;
+
+// buffer of single thread. owner thread writes records at 'head', the writer thread reads them at 'tail'
+typedef struct pst_binlog_buffer {
+    pid_t               tid;        // owner thread, 0 if buffer is free
+    uint64_t            head;       // offset of the next record to write, changed by owner only
+    uint64_t            tail;       // offset of the next record to read, changed by the writer only
+    uint32_t            busy;       // non-zero while owner writes a record, so write from nested signal handler is dropped
+    uint8_t*            data;       // PST_BINLOG_BUFFER bytes, mapped on first use
+} pst_binlog_buffer;
+
+// -----------------------------------------------------------------------------------
+// pst_binlog
+// -----------------------------------------------------------------------------------
+// Call site pays only for scan of format string and copy of arguments to buffer of its thread. Format string identifies call site,
+// since it's a literal, so it's rendered together with stored arguments by the writer thread of the logger.
+typedef struct pst_binlog {
+    pst_binlog_buffer   buffers[PST_BINLOG_THREADS];
+    uint32_t            generation; // distinguishes instances, since threads cache their buffers
+    int64_t             realtime;   // difference between CLOCK_REALTIME and CLOCK_MONOTONIC_COARSE in nanoseconds
+    uint32_t            drains;     // number of drains since the last check for buffers of exited threads
+} pst_binlog;
+
+// receives rendered message, 'time' is wall clock time of the call
+typedef void (*pst_binlog_output)(void* arg, int severity, const struct timespec* time, const char* text, uint32_t len);
+
+bool pst_binlog_init(pst_binlog* b);
+void pst_binlog_fini(pst_binlog* b);
+
+bool pst_binlog_write(pst_binlog* b, int severity, const char* fmt, va_list args);
+bool pst_binlog_drain(pst_binlog* b, pst_binlog_output out, void* arg);
+
+#endif /* __PST_BINLOG_H__ */
@@ -0,0 +1,1664 @@
+/*
+ * demangle.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <string.h>
+
+#include "demangle.h"
+
+// what production the span should be parsed as
+enum {
+    SPAN_TYPE   = 0,
+    SPAN_PREFIX = 1,
+    SPAN_TARG   = 2,
+};
+
+// no place for declarator in output
+#define NO_HOLE     UINT32_MAX
+
+// cv-qualifiers
+enum {
+    CV_RESTRICT = 1,
+    CV_VOLATILE = 2,
+    CV_CONST    = 4,
+};
+
+// pointers, references and cv-qualifiers applied to a type, outermost first
+typedef struct pst_demangle_mods {
+    char                        kind[PST_DEMANGLE_MODS];    // 'P', 'R', 'O' or 'Q' for cv-qualifiers
+    uint8_t                     cv[PST_DEMANGLE_MODS];      // cv-qualifiers for 'Q'
+    uint16_t                    start[PST_DEMANGLE_MODS];   // offset of modifier in mangled name
+    bool                        rec[PST_DEMANGLE_MODS];     // whether modified type is substitution candidate
+    uint32_t                    count;
+    bool                        printed;                    // whether modifiers were already printed
+    bool                        member;                     // type is pointed by pointer to member
+    uint32_t                    cls_start;                  // output offset of class name of pointer to member
+    uint32_t                    cls_end;
+    struct pst_demangle_mods*   outer;                      // modifiers of pointer to member itself
+} pst_demangle_mods;
+
+typedef struct {
+    const char  code[3];
+    const char* name;
+} pst_demangle_op;
+
+static const pst_demangle_op operators[] = {
+    {"nw", "new"},  {"na", "new[]"}, {"dl", "delete"}, {"da", "delete[]"}, {"aw", "co_await"},
+    {"ps", "+"},    {"ng", "-"},    {"ad", "&"},    {"de", "*"},    {"co", "~"},
+    {"pl", "+"},    {"mi", "-"},    {"ml", "*"},    {"dv", "/"},    {"rm", "%"},
+    {"an", "&"},    {"or", "|"},    {"eo", "^"},    {"aS", "="},    {"pL", "+="},
+    {"mI", "-="},   {"mL", "*="},   {"dV", "/="},   {"rM", "%="},   {"aN", "&="},
+    {"oR", "|="},   {"eO", "^="},   {"ls", "<<"},   {"rs", ">>"},   {"lS", "<<="},
+    {"rS", ">>="},  {"eq", "=="},   {"ne", "!="},   {"lt", "<"},    {"gt", ">"},
+    {"le", "<="},   {"ge", ">="},   {"ss", "<=>"},  {"nt", "!"},    {"aa", "&&"},
+    {"oo", "||"},   {"pp", "++"},   {"mm", "--"},   {"cm", ","},    {"pm", "->*"},
+    {"pt", "->"},   {"cl", "()"},   {"ix", "[]"},   {"qu", "?"},
+};
+
+static const char* builtin(char c)
+{
+    switch(c) {
+        case 'v': return "void";
+        case 'w': return "wchar_t";
+        case 'b': return "bool";
+        case 'c': return "char";
+        case 'a': return "signed char";
+        case 'h': return "unsigned char";
+        case 's': return "short";
+        case 't': return "unsigned short";
+        case 'i': return "int";
+        case 'j': return "unsigned int";
+        case 'l': return "long";
+        case 'm': return "unsigned long";
+        case 'x': return "long long";
+        case 'y': return "unsigned long long";
+        case 'n': return "__int128";
+        case 'o': return "unsigned __int128";
+        case 'f': return "float";
+        case 'd': return "double";
+        case 'e': return "long double";
+        case 'g': return "__float128";
+        case 'z': return "...";
+        default: return NULL;
+    }
+}
+
+static const char* builtin_d(char c)
+{
+    switch(c) {
+        case 'd': return "decimal64";
+        case 'e': return "decimal128";
+        case 'f': return "decimal32";
+        case 'h': return "half";
+        case 'i': return "char32_t";
+        case 's': return "char16_t";
+        case 'u': return "char8_t";
+        case 'a': return "auto";
+        case 'c': return "decltype(auto)";
+        case 'n': return "decltype(nullptr)";
+        default: return NULL;
+    }
+}
+
+static void parse_encoding(pst_demangler* d, bool local);
+static void parse_name(pst_demangler* d);
+static void parse_type(pst_demangler* d);
+static void parse_type_mods(pst_demangler* d, pst_demangle_mods* m);
+static void parse_template_arg(pst_demangler* d);
+static void parse_components(pst_demangler* d);
+
+// -----------------------------------------------------------------------------------
+// input & output
+// -----------------------------------------------------------------------------------
+static inline char peek(pst_demangler* d)
+{
+    return d->pos < d->end ? *d->pos : 0;
+}
+
+static inline char peek_at(pst_demangler* d, uint32_t n)
+{
+    return d->pos + n < d->end ? d->pos[n] : 0;
+}
+
+static inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline bool is_upper(char c)
+{
+    return c >= 'A' && c <= 'Z';
+}
+
+static inline bool is_lower(char c)
+{
+    return c >= 'a' && c <= 'z';
+}
+
+static inline void fail(pst_demangler* d)
+{
+    d->ok = false;
+}
+
+static void expect(pst_demangler* d, char c)
+{
+    if(peek(d) != c) {
+        fail(d);
+        return;
+    }
+    d->pos++;
+}
+
+static void out(pst_demangler* d, const char* str, uint32_t len)
+{
+    if(d->suppress || !d->ok) {
+        return;
+    }
+
+    if(d->len + len + 1 > d->size) {
+        fail(d);
+        return;
+    }
+
+    memcpy(d->out + d->len, str, len);
+    d->len += len;
+}
+
+static void outs(pst_demangler* d, const char* str)
+{
+    out(d, str, strlen(str));
+}
+
+// print decimal number without snprintf(), which isn't async-signal-safe
+static void out_number(pst_demangler* d, uint64_t n)
+{
+    char num[24];
+    uint32_t len = 0;
+    do {
+        num[sizeof(num) - 1 - len++] = '0' + n % 10;
+        n /= 10;
+    } while(n);
+    out(d, num + sizeof(num) - len, len);
+}
+
+static char last_char(pst_demangler* d)
+{
+    return d->len ? d->out[d->len - 1] : 0;
+}
+
+static void reverse(char* start, char* end)
+{
+    while(start < end) {
+        char c = *start;
+        *start++ = *--end;
+        *end = c;
+    }
+}
+
+// swap [a, b) and [b, c) parts of output
+static void rotate(pst_demangler* d, uint32_t a, uint32_t b, uint32_t c)
+{
+    if(d->suppress || !d->ok || a >= b || b >= c) {
+        return;
+    }
+
+    reverse(d->out + a, d->out + b);
+    reverse(d->out + b, d->out + c);
+    reverse(d->out + a, d->out + c);
+}
+
+static void insert(pst_demangler* d, uint32_t offset, const char* str)
+{
+    uint32_t len = strlen(str);
+    if(d->suppress || !d->ok) {
+        return;
+    }
+
+    if(d->len + len + 1 > d->size) {
+        fail(d);
+        return;
+    }
+
+    memmove(d->out + offset + len, d->out + offset, d->len - offset);
+    memcpy(d->out + offset, str, len);
+    d->len += len;
+}
+
+// libiberty prints qualifiers in reverse order of mangling
+static void print_cv(pst_demangler* d, uint32_t cv)
+{
+    if(cv & CV_CONST) {
+        outs(d, " const");
+    }
+    if(cv & CV_VOLATILE) {
+        outs(d, " volatile");
+    }
+    if(cv & CV_RESTRICT) {
+        outs(d, " restrict");
+    }
+}
+
+static void print_ref(pst_demangler* d, char ref)
+{
+    if(ref == 'R') {
+        outs(d, " &");
+    } else if(ref == 'O') {
+        outs(d, " &&");
+    }
+}
+
+// print modifiers [from, to) from innermost to outermost one
+static void print_mods(pst_demangler* d, pst_demangle_mods* m, uint32_t from, uint32_t to)
+{
+    for(uint32_t i = to; i > from; --i) {
+        switch(m->kind[i - 1]) {
+            case 'Q': {
+                // cv-qualifiers of type obtained from template parameter are merged with the ones applied to it
+                uint32_t cv = 0;
+                for(; i > from && m->kind[i - 1] == 'Q'; --i) {
+                    cv |= m->cv[i - 1];
+                }
+                i++;
+                print_cv(d, cv);
+                break;
+            }
+            case 'P':
+                outs(d, "*");
+                break;
+            case 'R':
+            case 'O': {
+                // reference to reference (obtained from template parameter) collapses to lvalue one, unless both are rvalue ones
+                bool rvalue = true;
+                for(; i > from && (m->kind[i - 1] == 'R' || m->kind[i - 1] == 'O'); --i) {
+                    rvalue = rvalue && m->kind[i - 1] == 'O';
+                }
+                i++;
+                outs(d, rvalue ? "&&" : "&");
+                break;
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// substitutions & template arguments
+// -----------------------------------------------------------------------------------
+static void record(pst_demangler* d, const char* start, uint8_t kind)
+{
+    if(d->nosub || !d->ok) {
+        return;
+    }
+
+    if(d->nsubs >= PST_DEMANGLE_SUBS) {
+        fail(d);
+        return;
+    }
+
+    pst_demangle_span* s = &d->subs[d->nsubs++];
+    s->start = start - d->str;
+    s->end = d->pos - d->str;
+    s->kind = kind;
+}
+
+// parse span of mangled name once again
+static void reparse(pst_demangler* d, const pst_demangle_span* span, pst_demangle_mods* m)
+{
+    const char* pos = d->pos;
+    const char* end = d->end;
+    d->pos = d->str + span->start;
+    d->end = d->str + span->end;
+    d->nosub++;
+
+    switch(span->kind) {
+        case SPAN_TYPE:
+            if(m) {
+                parse_type_mods(d, m);
+            } else {
+                parse_type(d);
+            }
+            break;
+        case SPAN_PREFIX:
+            parse_components(d);
+            break;
+        case SPAN_TARG:
+            if(m && peek(d) != 'L' && peek(d) != 'J' && peek(d) != 'X') {
+                parse_type_mods(d, m);
+            } else {
+                parse_template_arg(d);
+            }
+            break;
+    }
+
+    if(d->pos != d->end) {
+        fail(d);
+    }
+
+    d->nosub--;
+    d->pos = pos;
+    d->end = end;
+}
+
+static uint64_t parse_number(pst_demangler* d, bool* negative)
+{
+    if(negative) {
+        *negative = false;
+        if(peek(d) == 'n') {
+            *negative = true;
+            d->pos++;
+        }
+    }
+
+    if(!is_digit(peek(d))) {
+        fail(d);
+        return 0;
+    }
+
+    uint64_t value = 0;
+    while(is_digit(peek(d))) {
+        value = value * 10 + (*d->pos++ - '0');
+    }
+
+    return value;
+}
+
+// <seq-id> _ or _ alone. returns index of substitution or template parameter
+static uint32_t parse_seq_id(pst_demangler* d)
+{
+    uint32_t idx = 0;
+    if(peek(d) != '_') {
+        while(is_digit(peek(d)) || is_upper(peek(d))) {
+            char c = *d->pos++;
+            idx = idx * 36 + (is_digit(c) ? c - '0' : c - 'A' + 10);
+        }
+        idx++;
+    }
+    expect(d, '_');
+
+    return idx;
+}
+
+// S_, S<seq-id>_ or abbreviations of std:: names. 'prefix' means that name is a prefix of constructor or destructor
+static void parse_substitution(pst_demangler* d, bool prefix)
+{
+    d->pos++;
+    char c = peek(d);
+    if(c == '_' || is_digit(c) || is_upper(c)) {
+        uint32_t idx = parse_seq_id(d);
+        if(idx >= d->nsubs) {
+            fail(d);
+            return;
+        }
+        reparse(d, &d->subs[idx], NULL);
+        return;
+    }
+
+    d->pos++;
+    bool full = prefix && (peek(d) == 'C' || peek(d) == 'D');
+    const char* name = NULL;
+    switch(c) {
+        case 'a':
+            outs(d, "std::allocator");
+            name = "allocator";
+            break;
+        case 'b':
+            outs(d, "std::basic_string");
+            name = "basic_string";
+            break;
+        case 's':
+            outs(d, full ? "std::basic_string<char, std::char_traits<char>, std::allocator<char> >" : "std::string");
+            name = "basic_string";
+            break;
+        case 'i':
+            outs(d, full ? "std::basic_istream<char, std::char_traits<char> >" : "std::istream");
+            name = "basic_istream";
+            break;
+        case 'o':
+            outs(d, full ? "std::basic_ostream<char, std::char_traits<char> >" : "std::ostream");
+            name = "basic_ostream";
+            break;
+        case 'd':
+            outs(d, full ? "std::basic_iostream<char, std::char_traits<char> >" : "std::iostream");
+            name = "basic_iostream";
+            break;
+        default:
+            fail(d);
+            return;
+    }
+
+    d->last_name = name;
+    d->last_len = strlen(name);
+}
+
+// walk elements of template argument pack, find 'n'-th one. returns number of elements
+static uint32_t pack_elements(pst_demangler* d, const pst_demangle_span* pack, uint32_t n, pst_demangle_span* elem)
+{
+    const char* pos = d->pos;
+    const char* end = d->end;
+    d->pos = d->str + pack->start + 1;
+    d->end = d->str + pack->end;
+    d->suppress++;
+    d->nosub++;
+
+    uint32_t count = 0;
+    while(d->ok && peek(d) != 'E') {
+        if(!peek(d)) {
+            fail(d);
+            break;
+        }
+
+        const char* start = d->pos;
+        parse_template_arg(d);
+        if(count++ == n) {
+            elem->start = start - d->str;
+            elem->end = d->pos - d->str;
+            elem->kind = SPAN_TARG;
+        }
+    }
+
+    d->nosub--;
+    d->suppress--;
+    d->pos = pos;
+    d->end = end;
+
+    return count;
+}
+
+static void parse_template_param(pst_demangler* d, pst_demangle_mods* m)
+{
+    d->pos++;
+    uint32_t idx = parse_seq_id(d);
+
+    // parameters of generic lambda are referenced as template parameters in its signature
+    if(d->lambda) {
+        outs(d, "auto:");
+        out_number(d, idx + 1);
+        return;
+    }
+
+    idx += d->targ_base;
+    if(idx >= d->ntargs) {
+        fail(d);
+        return;
+    }
+
+    const pst_demangle_span* targ = &d->targs[idx];
+    if(d->str[targ->start] == 'J') {
+        if(d->pack_found < 0) {
+            d->pack_found = idx;
+        }
+
+        // inside of pack expansion parameter pack stands for its current element
+        if(d->pack == (int32_t)idx) {
+            pst_demangle_span elem;
+            if(pack_elements(d, targ, d->pack_elem, &elem) <= d->pack_elem) {
+                fail(d);
+                return;
+            }
+            reparse(d, &elem, m);
+            return;
+        }
+    }
+
+    reparse(d, targ, m);
+}
+
+// pattern of pack expansion is printed for each element of parameter pack it refers to
+static void parse_pack_expansion(pst_demangler* d)
+{
+    // parse pattern once to record substitutions, find its end and parameter pack
+    const char* start = d->pos;
+    int32_t found = d->pack_found;
+    d->pack_found = -1;
+    d->suppress++;
+    parse_type(d);
+    d->suppress--;
+    int32_t idx = d->pack_found;
+    d->pack_found = found;
+
+    pst_demangle_span pattern;
+    pattern.start = start - d->str;
+    pattern.end = d->pos - d->str;
+    pattern.kind = SPAN_TYPE;
+
+    if(idx < 0) {
+        reparse(d, &pattern, NULL);
+        outs(d, "...");
+        return;
+    }
+
+    int32_t pack = d->pack;
+    uint32_t elem = d->pack_elem;
+    uint32_t count = pack_elements(d, &d->targs[idx], UINT32_MAX, NULL);
+    for(uint32_t i = 0; i < count && d->ok; ++i) {
+        if(i) {
+            outs(d, ", ");
+        }
+        d->pack = idx;
+        d->pack_elem = i;
+        reparse(d, &pattern, NULL);
+    }
+    d->pack = pack;
+    d->pack_elem = elem;
+}
+
+static void parse_template_args(pst_demangler* d)
+{
+    d->pos++;
+
+    // name of constructor is the name of the class template, not the last name in its arguments
+    const char* last_name = d->last_name;
+    uint32_t last_len = d->last_len;
+
+    // only arguments of the name of the function are referenced by template parameters
+    bool capture = d->capture;
+    d->capture = false;
+    if(capture) {
+        d->ntargs = d->targ_base;
+    }
+
+    if(last_char(d) == '<') {
+        outs(d, " ");
+    }
+    outs(d, "<");
+
+    bool first = true;
+    uint32_t tail = d->len;     // end of the last non-empty argument
+    while(d->ok && peek(d) != 'E') {
+        if(!peek(d)) {
+            fail(d);
+            return;
+        }
+
+        if(!first) {
+            outs(d, ", ");
+        }
+
+        uint32_t arg = d->len;
+        const char* start = d->pos;
+        parse_template_arg(d);
+        if(d->len != arg) {
+            tail = d->len;
+        }
+        first = false;
+
+        if(capture) {
+            if(d->ntargs >= PST_DEMANGLE_TARGS) {
+                fail(d);
+                return;
+            }
+            pst_demangle_span* s = &d->targs[d->ntargs++];
+            s->start = start - d->str;
+            s->end = d->pos - d->str;
+            s->kind = SPAN_TARG;
+        }
+    }
+    expect(d, 'E');
+
+    // trailing empty argument packs are omitted together with their separators, the other ones leave separators as libiberty does
+    bool empty = d->len != tail;
+    d->len = tail;
+
+    if(last_char(d) == '>' && !empty) {
+        outs(d, " ");
+    }
+    outs(d, ">");
+
+    d->capture = capture;
+    d->last_name = last_name;
+    d->last_len = last_len;
+}
+
+static void parse_literal(pst_demangler* d)
+{
+    d->pos++;
+
+    if(peek(d) == '_' && peek_at(d, 1) == 'Z') {
+        d->pos += 2;
+        parse_encoding(d, false);
+        expect(d, 'E');
+        return;
+    }
+
+    if(peek(d) == 'Z') {
+        d->pos++;
+        parse_encoding(d, false);
+        expect(d, 'E');
+        return;
+    }
+
+    char c = peek(d);
+    const char* suffix = NULL;
+    switch(c) {
+        case 'b':
+            d->pos++;
+            if(peek(d) == '0' || peek(d) == '1') {
+                outs(d, *d->pos++ == '0' ? "false" : "true");
+                expect(d, 'E');
+                return;
+            }
+            fail(d);
+            return;
+        case 'i': suffix = ""; break;
+        case 'j': suffix = "u"; break;
+        case 'l': suffix = "l"; break;
+        case 'm': suffix = "ul"; break;
+        case 'x': suffix = "ll"; break;
+        case 'y': suffix = "ull"; break;
+    }
+
+    if(suffix) {
+        d->pos++;
+    } else {
+        outs(d, "(");
+        parse_type(d);
+        outs(d, ")");
+    }
+
+    if(peek(d) == 'n') {
+        outs(d, "-");
+        d->pos++;
+    }
+
+    const char* start = d->pos;
+    while(peek(d) && peek(d) != 'E') {
+        d->pos++;
+    }
+    out(d, start, d->pos - start);
+    if(suffix) {
+        outs(d, suffix);
+    }
+    expect(d, 'E');
+}
+
+static void parse_template_arg(pst_demangler* d)
+{
+    switch(peek(d)) {
+        case 'L':
+            parse_literal(d);
+            break;
+        case 'J':
+            d->pos++;
+            for(bool first = true; d->ok && peek(d) != 'E'; first = false) {
+                if(!peek(d)) {
+                    fail(d);
+                    return;
+                }
+                if(!first) {
+                    outs(d, ", ");
+                }
+                parse_template_arg(d);
+            }
+            expect(d, 'E');
+            break;
+        case 'X':
+            // only template parameters and literals are supported as expressions
+            d->pos++;
+            if(peek(d) == 'T') {
+                parse_template_param(d, NULL);
+            } else if(peek(d) == 'L') {
+                parse_literal(d);
+            } else {
+                fail(d);
+                return;
+            }
+            expect(d, 'E');
+            break;
+        default:
+            parse_type(d);
+            break;
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// names
+// -----------------------------------------------------------------------------------
+static void parse_source_name(pst_demangler* d)
+{
+    uint64_t len = parse_number(d, NULL);
+    if(!d->ok || len == 0 || len > (uint64_t)(d->end - d->pos)) {
+        fail(d);
+        return;
+    }
+
+    if(len >= 10 && !strncmp(d->pos, "_GLOBAL_", 8) && (d->pos[8] == '.' || d->pos[8] == '_' || d->pos[8] == '$') && d->pos[9] == 'N') {
+        outs(d, "(anonymous namespace)");
+    } else {
+        out(d, d->pos, len);
+    }
+
+    d->last_name = d->pos;
+    d->last_len = len;
+    d->pos += len;
+}
+
+static void parse_abi_tags(pst_demangler* d)
+{
+    const char* name = d->last_name;
+    uint32_t len = d->last_len;
+    while(d->ok && peek(d) == 'B') {
+        d->pos++;
+        outs(d, "[abi:");
+        parse_source_name(d);
+        outs(d, "]");
+    }
+    d->last_name = name;
+    d->last_len = len;
+}
+
+static void parse_operator(pst_demangler* d)
+{
+    char c1 = peek(d);
+    char c2 = peek_at(d, 1);
+
+    if(c1 == 'c' && c2 == 'v') {
+        // conversion operator
+        d->pos += 2;
+        outs(d, "operator ");
+        parse_type(d);
+        d->ctor = true;
+        return;
+    }
+
+    if(c1 == 'l' && c2 == 'i') {
+        d->pos += 2;
+        outs(d, "operator\"\" ");
+        parse_source_name(d);
+        return;
+    }
+
+    if(c1 == 'v' && is_digit(c2)) {
+        d->pos += 2;
+        outs(d, "operator ");
+        parse_source_name(d);
+        return;
+    }
+
+    for(uint32_t i = 0; i < sizeof(operators) / sizeof(operators[0]); ++i) {
+        if(operators[i].code[0] == c1 && operators[i].code[1] == c2) {
+            d->pos += 2;
+            outs(d, "operator");
+            if(is_lower(operators[i].name[0])) {
+                outs(d, " ");
+            }
+            outs(d, operators[i].name);
+            return;
+        }
+    }
+
+    fail(d);
+}
+
+// parameters of function type or of the function itself, i.e. types up to 'E' or end of the name
+static void parse_params(pst_demangler* d)
+{
+    outs(d, "(");
+    if(peek(d) == 'v' && (peek_at(d, 1) == 0 || peek_at(d, 1) == 'E' || peek_at(d, 1) == '.' || ((peek_at(d, 1) == 'R' || peek_at(d, 1) == 'O') && peek_at(d, 2) == 'E'))) {
+        d->pos++;
+    } else {
+        bool first = true;
+        uint32_t tail = d->len;     // end of the last non-empty parameter
+        while(d->ok) {
+            char c = peek(d);
+            if(c == 0 || c == 'E' || c == '.' || ((c == 'R' || c == 'O') && peek_at(d, 1) == 'E')) {
+                break;
+            }
+
+            if(!first) {
+                outs(d, ", ");
+            }
+            uint32_t arg = d->len;
+            parse_type(d);
+            if(d->len != arg) {
+                tail = d->len;
+            }
+            first = false;
+        }
+
+        // trailing expansions of empty packs are omitted together with their separators, the other ones leave separators
+        d->len = tail;
+    }
+    outs(d, ")");
+}
+
+// unnamed types and closures
+static void parse_unnamed(pst_demangler* d)
+{
+    d->pos++;
+    char c = peek(d);
+    d->pos++;
+    if(c == 't') {
+        outs(d, "{unnamed type#");
+    } else if(c == 'l') {
+        outs(d, "{lambda");
+        d->lambda++;
+        parse_params(d);
+        d->lambda--;
+        expect(d, 'E');
+        outs(d, "#");
+    } else {
+        fail(d);
+        return;
+    }
+
+    uint64_t n = 1;
+    if(peek(d) != '_') {
+        n = parse_number(d, NULL) + 2;
+    }
+    expect(d, '_');
+
+    out_number(d, n);
+    outs(d, "}");
+}
+
+static void parse_unqualified(pst_demangler* d)
+{
+    char c = peek(d);
+    d->ctor = false;
+    if(is_digit(c)) {
+        parse_source_name(d);
+    } else if(c == 'U') {
+        parse_unnamed(d);
+    } else if(is_lower(c)) {
+        parse_operator(d);
+    } else {
+        fail(d);
+        return;
+    }
+
+    bool ctor = d->ctor;
+    parse_abi_tags(d);
+    d->ctor = ctor;
+}
+
+static void parse_ctor_dtor(pst_demangler* d)
+{
+    char c = *d->pos++;
+    if(c == 'C' && peek(d) == 'I') {
+        // inheriting constructor
+        d->pos++;
+        if(!is_digit(peek(d))) {
+            fail(d);
+            return;
+        }
+        d->pos++;
+        d->suppress++;
+        parse_type(d);
+        d->suppress--;
+    } else {
+        if(!is_digit(peek(d))) {
+            fail(d);
+            return;
+        }
+        d->pos++;
+    }
+
+    if(!d->last_name) {
+        fail(d);
+        return;
+    }
+
+    if(c == 'D') {
+        outs(d, "~");
+    }
+    out(d, d->last_name, d->last_len);
+    parse_abi_tags(d);
+}
+
+// components of nested name or of prefix up to 'E'
+static void parse_components(pst_demangler* d)
+{
+    const char* start = d->pos;
+    bool templated = false;
+    bool ctor = false;
+
+    for(bool first = true; d->ok; first = false) {
+        char c = peek(d);
+        if(c == 0 || c == 'E') {
+            break;
+        }
+
+        if(c == 'I') {
+            if(first) {
+                fail(d);
+                return;
+            }
+            parse_template_args(d);
+            templated = true;
+        } else {
+            if(!first) {
+                outs(d, "::");
+            }
+            templated = false;
+            ctor = false;
+
+            if(c == 'S' && peek_at(d, 1) == 't') {
+                // std:: isn't substitution candidate
+                d->pos += 2;
+                outs(d, "std");
+                continue;
+            } else if(c == 'S') {
+                // substitution isn't recorded once again, unless it's followed by template arguments
+                parse_substitution(d, true);
+                continue;
+            } else if(c == 'T') {
+                parse_template_param(d, NULL);
+            } else if(c == 'C' || (c == 'D' && is_digit(peek_at(d, 1)))) {
+                parse_ctor_dtor(d);
+                ctor = true;
+            } else if(c == 'L') {
+                // name with internal linkage
+                d->pos++;
+                parse_unqualified(d);
+                ctor = d->ctor;
+            } else {
+                parse_unqualified(d);
+                ctor = d->ctor;
+            }
+        }
+
+        c = peek(d);
+        if(c != 'E' && c != 0) {
+            record(d, start, SPAN_PREFIX);
+        }
+    }
+
+    d->templated = templated;
+    d->ctor = ctor;
+}
+
+static void parse_cv(pst_demangler* d, uint32_t* cv)
+{
+    *cv = 0;
+    if(peek(d) == 'r') {
+        *cv |= CV_RESTRICT;
+        d->pos++;
+    }
+    if(peek(d) == 'V') {
+        *cv |= CV_VOLATILE;
+        d->pos++;
+    }
+    if(peek(d) == 'K') {
+        *cv |= CV_CONST;
+        d->pos++;
+    }
+}
+
+static void parse_nested(pst_demangler* d)
+{
+    d->pos++;
+
+    uint32_t cv;
+    parse_cv(d, &cv);
+    char ref = 0;
+    if(peek(d) == 'R' || peek(d) == 'O') {
+        ref = *d->pos++;
+    }
+
+    parse_components(d);
+    expect(d, 'E');
+
+    d->cv = cv;
+    d->ref = ref;
+}
+
+static void parse_discriminator(pst_demangler* d)
+{
+    if(peek(d) != '_') {
+        return;
+    }
+
+    d->pos++;
+    if(peek(d) == '_') {
+        d->pos++;
+        parse_number(d, NULL);
+        expect(d, '_');
+    } else if(is_digit(peek(d))) {
+        d->pos++;
+    } else {
+        fail(d);
+    }
+}
+
+static void parse_local(pst_demangler* d)
+{
+    d->pos++;
+    parse_encoding(d, true);
+    expect(d, 'E');
+    outs(d, "::");
+
+    if(peek(d) == 's') {
+        d->pos++;
+        outs(d, "string literal");
+        d->templated = false;
+        d->ctor = false;
+        d->cv = 0;
+        d->ref = 0;
+    } else {
+        if(peek(d) == 'd') {
+            // entity in default argument
+            d->pos++;
+            uint64_t n = 1;
+            if(peek(d) != '_') {
+                n = parse_number(d, NULL) + 2;
+            }
+            expect(d, '_');
+
+            outs(d, "{default arg#");
+            out_number(d, n);
+            outs(d, "}::");
+        }
+        parse_name(d);
+    }
+
+    parse_discriminator(d);
+}
+
+static void parse_name(pst_demangler* d)
+{
+    char c = peek(d);
+    if(c == 'N') {
+        parse_nested(d);
+        return;
+    }
+
+    if(c == 'Z') {
+        parse_local(d);
+        return;
+    }
+
+    const char* start = d->pos;
+    bool sub = false;
+    bool ctor = false;
+    if(c == 'S' && peek_at(d, 1) == 't') {
+        d->pos += 2;
+        outs(d, "std::");
+        parse_unqualified(d);
+        ctor = d->ctor;
+    } else if(c == 'S') {
+        parse_substitution(d, false);
+        sub = true;
+    } else {
+        if(c == 'L') {
+            d->pos++;
+        }
+        parse_unqualified(d);
+        ctor = d->ctor;
+    }
+
+    bool templated = false;
+    if(peek(d) == 'I') {
+        if(!sub) {
+            record(d, start, SPAN_PREFIX);
+        }
+        parse_template_args(d);
+        templated = true;
+    }
+
+    d->templated = templated;
+    d->ctor = ctor;
+    d->cv = 0;
+    d->ref = 0;
+}
+
+// -----------------------------------------------------------------------------------
+// types
+// -----------------------------------------------------------------------------------
+static void parse_type(pst_demangler* d)
+{
+    pst_demangle_mods m;
+    m.count = 0;
+    m.printed = false;
+    m.member = false;
+    m.outer = NULL;
+    parse_type_mods(d, &m);
+}
+
+// put class name of pointer to member after the member type
+static void member_layout(pst_demangler* d, pst_demangle_mods* m, const char* sep)
+{
+    uint32_t type_len = d->len - m->cls_end;
+    rotate(d, m->cls_start, m->cls_end, d->len);
+    insert(d, m->cls_start + type_len, sep);
+    outs(d, "::*");
+    if(m->outer) {
+        print_mods(d, m->outer, 0, m->outer->count);
+        m->outer->printed = true;
+    }
+}
+
+static void parse_function_type(pst_demangler* d, pst_demangle_mods* m)
+{
+    d->pos++;
+    if(peek(d) == 'Y') {
+        d->pos++;
+    }
+
+    // cv-qualifiers applied directly to function type are qualifiers of member function
+    uint32_t top = m->count;
+    uint32_t cv = 0;
+    while(top && m->kind[top - 1] == 'Q') {
+        cv |= m->cv[--top];
+    }
+
+    d->hole = NO_HOLE;
+    parse_type(d);
+
+    // if return type is pointer or reference to function, declarator of this function goes inside of its parentheses
+    uint32_t hole = m->member ? NO_HOLE : d->hole;
+    uint32_t start = d->len;
+    uint32_t own_hole = NO_HOLE;
+
+    if(m->member) {
+        // return type follows class name in output, swap them
+        uint32_t ret_len = d->len - m->cls_end;
+        rotate(d, m->cls_start, m->cls_end, d->len);
+        insert(d, m->cls_start + ret_len, " (");
+        outs(d, "::*");
+        print_mods(d, m, 0, top);
+        if(m->outer) {
+            print_mods(d, m->outer, 0, m->outer->count);
+            m->outer->printed = true;
+        }
+        outs(d, ")");
+    } else if(top) {
+        outs(d, hole == NO_HOLE ? " (" : "(");
+        print_mods(d, m, 0, top);
+        own_hole = d->len;
+        outs(d, ")");
+    } else if(hole == NO_HOLE) {
+        outs(d, " ");
+    }
+
+    parse_params(d);
+
+    char ref = 0;
+    if(peek(d) == 'R' || peek(d) == 'O') {
+        ref = *d->pos++;
+    }
+    expect(d, 'E');
+
+    print_cv(d, cv);
+    print_ref(d, ref);
+    m->printed = true;
+
+    if(hole != NO_HOLE) {
+        rotate(d, hole, start, d->len);
+        if(own_hole != NO_HOLE) {
+            own_hole = hole + own_hole - start;
+        }
+    }
+    d->hole = own_hole;
+}
+
+static void parse_array_type(pst_demangler* d, pst_demangle_mods* m)
+{
+    const char* dims[8];
+    uint32_t ndims = 0;
+    while(d->ok && peek(d) == 'A') {
+        if(ndims >= sizeof(dims) / sizeof(dims[0])) {
+            fail(d);
+            return;
+        }
+        dims[ndims++] = d->pos;
+        d->pos++;
+        while(is_digit(peek(d))) {
+            d->pos++;
+        }
+        expect(d, '_');
+    }
+
+    parse_type(d);
+
+    // cv-qualifiers of array are the ones of its elements
+    uint32_t count = m->count;
+    while(count && m->kind[count - 1] == 'Q') {
+        print_cv(d, m->cv[--count]);
+    }
+
+    if(count) {
+        outs(d, " (");
+        print_mods(d, m, 0, count);
+        outs(d, ")");
+    }
+    outs(d, " ");
+    for(uint32_t i = 0; i < ndims; ++i) {
+        const char* dim = dims[i] + 1;
+        const char* end = dim;
+        while(is_digit(*end)) {
+            end++;
+        }
+        outs(d, "[");
+        out(d, dim, end - dim);
+        outs(d, "]");
+    }
+    m->printed = true;
+
+    // inner dimensions are substitution candidates too, the outermost one is recorded by caller
+    for(uint32_t i = ndims; i > 1; --i) {
+        record(d, dims[i - 1], SPAN_TYPE);
+    }
+}
+
+static void parse_member_type(pst_demangler* d, pst_demangle_mods* m)
+{
+    d->pos++;
+
+    pst_demangle_mods mm;
+    mm.count = 0;
+    mm.printed = false;
+    mm.member = true;
+    mm.outer = m;
+    mm.cls_start = d->len;
+    parse_type(d);
+    mm.cls_end = d->len;
+
+    parse_type_mods(d, &mm);
+    m->printed = true;
+}
+
+static bool is_type_modifier(char c)
+{
+    return c == 'P' || c == 'R' || c == 'O' || c == 'r' || c == 'V' || c == 'K';
+}
+
+static void parse_type_mods(pst_demangler* d, pst_demangle_mods* m)
+{
+    if(++d->depth > PST_DEMANGLE_DEPTH) {
+        fail(d);
+        d->depth--;
+        return;
+    }
+
+    // collect pointers, references and cv-qualifiers
+    uint32_t base_mod = m->count;
+    while(d->ok && is_type_modifier(peek(d))) {
+        if(m->count >= PST_DEMANGLE_MODS) {
+            fail(d);
+            break;
+        }
+
+        uint32_t i = m->count++;
+        m->start[i] = d->pos - d->str;
+        m->rec[i] = !d->nosub;
+        m->cv[i] = 0;
+        if(peek(d) == 'P' || peek(d) == 'R' || peek(d) == 'O') {
+            m->kind[i] = *d->pos++;
+        } else {
+            uint32_t cv;
+            parse_cv(d, &cv);
+            m->kind[i] = 'Q';
+            m->cv[i] = cv;
+        }
+    }
+
+    const char* start = d->pos;
+    bool rec = true;
+    bool chained = false;
+    char c = peek(d);
+    char c1 = peek_at(d, 1);
+    const char* name = NULL;
+
+    if(c == 'F') {
+        // cv-qualifiers of function type apply to 'this', so only the qualified function type is substitution candidate
+        rec = !(m->count > base_mod && m->kind[m->count - 1] == 'Q');
+        parse_function_type(d, m);
+    } else if(c == 'A') {
+        parse_array_type(d, m);
+    } else if(c == 'M') {
+        parse_member_type(d, m);
+    } else if(c == 'S' && (c1 == '_' || is_digit(c1) || is_upper(c1))) {
+        // look ahead whether substitution is template name
+        const char* pos = d->pos;
+        d->pos++;
+        uint32_t idx = parse_seq_id(d);
+        if(d->ok && peek(d) == 'I') {
+            d->pos = pos;
+            parse_name(d);
+        } else if(d->ok && idx < d->nsubs) {
+            // substituted type continues the chain of modifiers
+            reparse(d, &d->subs[idx], m);
+            rec = false;
+            chained = true;
+        } else {
+            fail(d);
+        }
+    } else if(c == 'T') {
+        chained = true;
+        parse_template_param(d, peek_at(d, 2) == 'I' || (c1 != '_' && peek_at(d, 3) == 'I') ? NULL : m);
+        if(peek(d) == 'I') {
+            record(d, start, SPAN_TYPE);
+            parse_template_args(d);
+        }
+    } else if(c == 'S' || c == 'N' || c == 'Z' || c == 'U' || is_digit(c)) {
+        // std:: abbreviations without template arguments aren't substitution candidates
+        if(c == 'S' && c1 != 't' && peek_at(d, 2) != 'I') {
+            rec = false;
+        }
+        parse_name(d);
+    } else if(c == 'D' && c1 == 'p') {
+        d->pos += 2;
+        parse_pack_expansion(d);
+    } else if(c == 'D' && c1 == 'v') {
+        d->pos += 2;
+        const char* dim = d->pos;
+        parse_number(d, NULL);
+        const char* end = d->pos;
+        expect(d, '_');
+        parse_type(d);
+        outs(d, " __vector(");
+        out(d, dim, end - dim);
+        outs(d, ")");
+    } else if(c == 'D' && (name = builtin_d(c1)) != NULL) {
+        d->pos += 2;
+        outs(d, name);
+        rec = false;
+    } else if(c == 'u') {
+        d->pos++;
+        parse_source_name(d);
+    } else if(c == 'C' || c == 'G') {
+        d->pos++;
+        parse_type(d);
+        outs(d, c == 'C' ? " _Complex" : " _Imaginary");
+    } else if((name = builtin(c)) != NULL) {
+        d->pos++;
+        outs(d, name);
+        rec = false;
+    } else {
+        fail(d);
+    }
+
+    if(c != 'F' && !chained) {
+        d->hole = NO_HOLE;
+    }
+
+    if(!m->printed) {
+        print_mods(d, m, 0, m->count);
+        if(m->member) {
+            member_layout(d, m, " ");
+        }
+        m->printed = true;
+    }
+
+    if(rec) {
+        record(d, start, SPAN_TYPE);
+    }
+    for(uint32_t i = m->count; i > base_mod; --i) {
+        if(m->rec[i - 1]) {
+            record(d, d->str + m->start[i - 1], SPAN_TYPE);
+        }
+    }
+    m->count = base_mod;
+
+    d->depth--;
+}
+
+// -----------------------------------------------------------------------------------
+// encoding
+// -----------------------------------------------------------------------------------
+static void parse_call_offset(pst_demangler* d)
+{
+    char c = peek(d);
+    d->pos++;
+    bool negative;
+    parse_number(d, &negative);
+    expect(d, '_');
+    if(c == 'v') {
+        parse_number(d, &negative);
+        expect(d, '_');
+    } else if(c != 'h') {
+        fail(d);
+    }
+}
+
+static void parse_special(pst_demangler* d)
+{
+    char c = *d->pos++;
+    char c1 = *d->pos++;
+    if(c == 'T') {
+        switch(c1) {
+            case 'V':
+                outs(d, "vtable for ");
+                parse_type(d);
+                return;
+            case 'T':
+                outs(d, "VTT for ");
+                parse_type(d);
+                return;
+            case 'I':
+                outs(d, "typeinfo for ");
+                parse_type(d);
+                return;
+            case 'S':
+                outs(d, "typeinfo name for ");
+                parse_type(d);
+                return;
+            case 'h':
+                outs(d, "non-virtual thunk to ");
+                d->pos--;
+                parse_call_offset(d);
+                parse_encoding(d, false);
+                return;
+            case 'v':
+                outs(d, "virtual thunk to ");
+                d->pos--;
+                parse_call_offset(d);
+                parse_encoding(d, false);
+                return;
+            case 'c':
+                outs(d, "covariant return thunk to ");
+                parse_call_offset(d);
+                parse_call_offset(d);
+                parse_encoding(d, false);
+                return;
+            case 'H':
+                outs(d, "TLS init function for ");
+                parse_name(d);
+                return;
+            case 'W':
+                outs(d, "TLS wrapper function for ");
+                parse_name(d);
+                return;
+            case 'C': {
+                // construction vtable: derived type, offset, base type. printed as "base-in-derived"
+                outs(d, "construction vtable for ");
+                uint32_t derived = d->len;
+                parse_type(d);
+                uint32_t base = d->len;
+                parse_number(d, NULL);
+                expect(d, '_');
+                parse_type(d);
+                rotate(d, derived, base, d->len);
+                insert(d, derived + (d->len - base), "-in-");
+                return;
+            }
+        }
+    } else if(c == 'G') {
+        switch(c1) {
+            case 'V':
+                outs(d, "guard variable for ");
+                parse_name(d);
+                return;
+            case 'R':
+                outs(d, "reference temporary #");
+                {
+                    uint32_t start = d->len;
+                    parse_name(d);
+                    uint32_t end = d->len;
+                    out_number(d, parse_seq_id(d));
+                    outs(d, " for ");
+                    rotate(d, start, end, d->len);
+                }
+                return;
+            case 'T':
+                outs(d, "transaction clone for ");
+                if(peek(d) == 't' || peek(d) == 'n') {
+                    d->pos++;
+                    parse_encoding(d, false);
+                    return;
+                }
+                break;
+        }
+    }
+
+    fail(d);
+}
+
+// return type of function template isn't printed for encoding of local name
+static void parse_encoding(pst_demangler* d, bool local)
+{
+    if(++d->depth > PST_DEMANGLE_DEPTH) {
+        fail(d);
+        d->depth--;
+        return;
+    }
+
+    char c = peek(d);
+    if((c == 'T' && peek_at(d, 1) != '_' && !is_digit(peek_at(d, 1))) || (c == 'G' && (peek_at(d, 1) == 'V' || peek_at(d, 1) == 'R' || peek_at(d, 1) == 'T'))) {
+        parse_special(d);
+        d->depth--;
+        return;
+    }
+
+    // nested encoding has its own template arguments, which are placed after the ones of enclosing encoding
+    uint32_t targ_base = d->targ_base;
+    uint32_t ntargs = d->ntargs;
+    d->targ_base = ntargs;
+
+    uint32_t name_start = d->len;
+    bool capture = d->capture;
+    d->capture = true;
+    parse_name(d);
+    d->capture = false;
+
+    bool templated = d->templated;
+    bool ctor = d->ctor;
+    uint32_t cv = d->cv;
+    char ref = d->ref;
+
+    c = peek(d);
+    if(c == 0 || c == 'E' || c == '.') {
+        // data object or function without parameters in mangled name
+        d->capture = capture;
+        d->targ_base = targ_base;
+        d->ntargs = ntargs;
+        d->depth--;
+        return;
+    }
+
+    // in mode of name only, parse the rest of encoding just to find its end. function enclosing local name is printed in full
+    bool suppress = d->mode == DEMANGLE_NAME_ONLY && !local;
+    if(suppress) {
+        d->suppress++;
+    }
+
+    if(templated && !ctor) {
+        if(local) {
+            d->suppress++;
+        }
+        uint32_t ret_start = d->len;
+        parse_type(d);
+        rotate(d, name_start, ret_start, d->len);
+        insert(d, name_start + (d->len - ret_start), " ");
+        if(local) {
+            d->suppress--;
+        }
+    }
+
+    parse_params(d);
+    print_cv(d, cv);
+    print_ref(d, ref);
+
+    if(suppress) {
+        d->suppress--;
+    }
+
+    d->capture = capture;
+    d->targ_base = targ_base;
+    d->ntargs = ntargs;
+    d->depth--;
+}
+
+// demangle Itanium C++ ABI name to 'buff' of 'size' bytes. returns false if name isn't mangled, isn't supported or doesn't fit 'buff'
+bool pst_demangle(const char* mangled, char* buff, uint32_t size, int mode)
+{
+    if(!mangled || !buff || !size || mangled[0] != '_' || mangled[1] != 'Z') {
+        return false;
+    }
+
+    uint32_t len = strlen(mangled);
+    if(len > UINT16_MAX) {
+        return false;
+    }
+
+    pst_demangler d;
+    d.str = mangled;
+    d.pos = mangled + 2;
+    d.end = mangled + len;
+    d.out = buff;
+    d.size = size;
+    d.len = 0;
+    d.mode = mode;
+    d.ok = true;
+    d.depth = 0;
+    d.suppress = 0;
+    d.nosub = 0;
+    d.capture = false;
+    d.nsubs = 0;
+    d.ntargs = 0;
+    d.targ_base = 0;
+    d.lambda = 0;
+    d.last_name = NULL;
+    d.last_len = 0;
+    d.templated = false;
+    d.ctor = false;
+    d.cv = 0;
+    d.ref = 0;
+    d.pack = -1;
+    d.pack_elem = 0;
+    d.pack_found = -1;
+    d.hole = NO_HOLE;
+
+    parse_encoding(&d, false);
+
+    // GCC appends clone suffixes like ".isra.0" or ".cold" to names of optimized copies of functions
+    const char* clone = d.pos;
+    if(!d.ok || (*clone && *clone != '.')) {
+        return false;
+    }
+
+    if(*clone && mode == DEMANGLE_FULL) {
+        const char* s = clone;
+        while(d.ok && *s == '.') {
+            const char* e = s + 1;
+            while(is_lower(*e) || is_upper(*e) || *e == '_') {
+                e++;
+            }
+            if(e == s + 1) {
+                return false;
+            }
+            while(*e == '.' && is_digit(e[1])) {
+                e++;
+                while(is_digit(*e)) {
+                    e++;
+                }
+            }
+            outs(&d, " [clone ");
+            out(&d, s, e - s);
+            outs(&d, "]");
+            s = e;
+        }
+        if(*s) {
+            return false;
+        }
+    }
+
+    if(!d.ok) {
+        return false;
+    }
+    buff[d.len] = 0;
+
+    return true;
+}
@@ -0,0 +1,71 @@
+/*
+ * demangle.h
+ *
+ * Itanium C++ ABI demangler which doesn't allocate memory
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_DEMANGLE_H__
+#define __PST_DEMANGLE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PST_DEMANGLE_SUBS   (256)   // maximum number of substitution candidates in mangled name
+#define PST_DEMANGLE_TARGS  (64)    // maximum number of template arguments of the function
+#define PST_DEMANGLE_MODS   (32)    // maximum number of pointer, reference and cv-qualifiers applied to a type
+#define PST_DEMANGLE_DEPTH  (128)   // maximum depth of recursion
+
+typedef enum {
+    DEMANGLE_FULL       = 0,    // the same as c++filt prints, i.e. with return type of templates, parameters, qualifiers and clone suffixes
+    DEMANGLE_NAME_ONLY  = 1,    // qualified name of the function with template arguments only
+} pst_demangle_mode;
+
+// source span of substitution candidate or template argument as offsets in mangled name
+typedef struct pst_demangle_span {
+    uint16_t        start;
+    uint16_t        end;
+    uint8_t         kind;       // what production the span should be parsed as
+} pst_demangle_span;
+
+// -----------------------------------------------------------------------------------
+// pst_demangler
+// -----------------------------------------------------------------------------------
+// Recursive descent parser which writes result directly to caller's buffer. Substitutions and template arguments are kept as spans
+// of mangled name and parsed once again on each reference, so no memory is allocated and the parser is async-signal-safe.
+typedef struct pst_demangler {
+    const char*         str;            // mangled name
+    const char*         pos;            // current position in mangled name
+    const char*         end;            // end of the encoding, i.e. start of clone suffix if any
+    char*               out;            // output buffer
+    uint32_t            size;           // size of 'out'
+    uint32_t            len;            // length of output
+    int                 mode;           // one of pst_demangle_mode
+    bool                ok;             // false if mangled name is invalid, not supported or output doesn't fit
+    uint32_t            depth;          // current depth of recursion
+    uint32_t            suppress;       // output is dropped while non-zero
+    uint32_t            nosub;          // substitutions aren't recorded while non-zero (when span is parsed once again)
+    bool                capture;        // template arguments are saved as the ones of the function
+    pst_demangle_span   subs[PST_DEMANGLE_SUBS];
+    uint32_t            nsubs;
+    pst_demangle_span   targs[PST_DEMANGLE_TARGS];
+    uint32_t            ntargs;
+    uint32_t            targ_base;      // index of the first template argument of current encoding in 'targs'
+    uint32_t            lambda;         // non-zero while signature of lambda is parsed
+    const char*         last_name;      // last source name, used as name of constructor and destructor
+    uint32_t            last_len;       // length of 'last_name'
+    bool                templated;      // whether the last parsed name ends with template arguments
+    bool                ctor;           // whether the last parsed name is constructor, destructor or conversion operator
+    uint32_t            cv;             // cv-qualifiers of the last parsed nested name
+    char                ref;            // ref-qualifier of the last parsed nested name
+    int32_t             pack;           // template parameter which is expanded at the moment or -1
+    uint32_t            pack_elem;      // current element of expanded parameter pack
+    int32_t             pack_found;     // the first parameter pack found in pattern of expansion or -1
+    uint32_t            hole;           // output offset where declarator of function returning the last parsed function type goes
+} pst_demangler;
+
+bool pst_demangle(const char* mangled, char* buff, uint32_t size, int mode);
+
+#endif /* __PST_DEMANGLE_H__ */
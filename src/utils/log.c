@@ -1,7 +1,11 @@
 
 #include <time.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include "log.h"
 
@@ -12,55 +16,289 @@ const char * const severity_map[] = {
         " [ERROR]  : "
 };
 
-static void format_string(pst_logger* log, const char* fmt, va_list args)
+#define RED     "\e[0;31m"
+#define GREEN   "\e[0;32m"
+#define YELLOW  "\e[1;33m"
+#define NC      "\e[0m" // No Color
+
+static const char* severity_color(SC_LogSeverity severity)
+{
+    switch(severity) {
+        case SEVERITY_ERROR:
+            return RED;
+        case SEVERITY_INFO:
+            return GREEN;
+        case SEVERITY_WARNING:
+            return YELLOW;
+        default:
+            return NC;
+    }
+}
+
+static void append(pst_logger* log, uint32_t* len, const char* msg, uint32_t size)
+{
+    if(*len + size > sizeof(log->mBatch)) {
+        log->send_message(log, log->mBatch, *len);
+        *len = 0;
+    }
+    memcpy(log->mBatch + *len, msg, size);
+    *len += size;
+}
+
+// format message to the record
+static void format_string(pst_log_record* r, const char* fmt, va_list args)
 {
-    log->mStringLen += vsnprintf(log->mString + log->mStringLen, log->mStringSize - log->mStringLen, fmt, args);
+    int len = vsnprintf(r->text, sizeof(r->text), fmt, args);
+    r->len = len < 0 ? 0 : ((uint32_t)len < sizeof(r->text) ? (uint32_t)len : sizeof(r->text) - 1);
 }
 
-static void format_prefix(pst_logger* log, SC_LogSeverity severity)
+static uint64_t now_ms()
 {
-    time_t rawTime;
-    struct tm * timeinfo;
-    time(&rawTime);
-    timeinfo = gmtime(&rawTime);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
 
-    log->mStringLen += strftime(log->mString, sizeof(log->mString), "%d-%m-%Y %H:%M:%S", timeinfo);
-    log->mStringLen += snprintf(log->mString + log->mStringLen, sizeof(log->mString) - log->mStringLen, "%s", severity_map[(int)severity]);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-static void format_postfix(pst_logger* log)
+// decorate message by time, severity and color and add it to batch. done by the consumer only, since gmtime_r() and strftime() take
+// lock of time zone
+static void append_line(pst_logger* log, uint32_t* len, SC_LogSeverity severity, const struct timespec* ts, const char* text, uint32_t size)
 {
-    if((log->mStringLen + 2) < log->mStringSize) {
-        log->mString[log->mStringLen++] = '\n';
-        log->mString[log->mStringLen++] = 0;
+    char line[LOG_LINE_SIZE];
+    uint32_t pos = 0;
+    if(log->mColored) {
+        const char* color = severity_color(severity);
+        memcpy(line, color, strlen(color));
+        pos += strlen(color);
+    }
+
+    struct tm timeinfo;
+    gmtime_r(&ts->tv_sec, &timeinfo);
+    pos += strftime(line + pos, sizeof(line) - pos, "%d-%m-%Y %H:%M:%S", &timeinfo);
+    memcpy(line + pos, severity_map[(int)severity], strlen(severity_map[(int)severity]));
+    pos += strlen(severity_map[(int)severity]);
+
+    // keep room for the postfix
+    uint32_t room = sizeof(line) - pos - sizeof(NC);
+    size = size < room ? size : room;
+    memcpy(line + pos, text, size);
+    pos += size;
+
+    if(log->mColored) {
+        memcpy(line + pos, NC, sizeof(NC) - 1);
+        pos += sizeof(NC) - 1;
     }
+    line[pos++] = '\n';
+
+    append(log, len, line, pos);
 }
 
-//variable argument number logging
+// wake the consumer if it's idle. called after message is published, so either the consumer sees message before it waits or producer
+// sees it idle. futex() is async-signal-safe, so message logged by signal handler wakes the consumer too
+static void wake(pst_logger* log)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&log->mIdle, __ATOMIC_RELAXED)) {
+        __atomic_add_fetch(&log->mWake, 1, __ATOMIC_RELEASE);
+        syscall(SYS_futex, &log->mWake, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+}
+
+// claim the next free record of ring. returns NULL if ring is full
+static pst_log_record* ring_claim(pst_logger* log, uint64_t* pos)
+{
+    *pos = __atomic_load_n(&log->mHead, __ATOMIC_RELAXED);
+    for(;;) {
+        pst_log_record* r = &log->mRing[*pos & (log->mRingSize - 1)];
+        int64_t diff = (int64_t)(__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) - *pos);
+        if(diff == 0) {
+            if(__atomic_compare_exchange_n(&log->mHead, pos, *pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                return r;
+            }
+        } else if(diff < 0) {
+            // the consumer hasn't written the record claimed ring size positions ago
+            return NULL;
+        } else {
+            *pos = __atomic_load_n(&log->mHead, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// variable argument number logging. message is formatted right in the ring, so concurrent producers don't wait for each other
 static void log_base(pst_logger* log, SC_LogSeverity severity, const char* fmt, ...)
 {
-    if (severity < log->mCurrentSeverity)
+    if (severity < log->mCurrentSeverity || !log->mRing)
         return;
 
-    pthread_mutex_lock(&log->mLock);
+    if(__atomic_load_n(&log->mDeferred, __ATOMIC_ACQUIRE)) {
+        va_list args;
+        va_start(args, fmt);
+        bool stored = pst_binlog_write(log->mBinlog, severity, fmt, args);
+        va_end(args);
+        if(stored) {
+            wake(log);
+        } else {
+            __atomic_add_fetch(&log->mDeferredDropped, 1, __ATOMIC_RELAXED);
+        }
+        return;
+    }
 
-    if(!log->is_opened(log)) {
-        log->open(log);
+    uint64_t pos;
+    pst_log_record* r = ring_claim(log, &pos);
+    if(!r) {
+        __atomic_add_fetch(&log->mDropped, 1, __ATOMIC_RELAXED);
+        return;
     }
 
-    log->mStringLen = 0;
-    format_prefix(log, severity);
+    clock_gettime(CLOCK_REALTIME, &r->time);
+    r->severity = severity;
     va_list args;
     va_start(args, fmt);
-    format_string(log, fmt, args);
+    format_string(r, fmt, args);
     va_end(args);
-    format_postfix(log);
-    log->send_message(log, severity);
 
-    pthread_mutex_unlock(&log->mLock);
+    // the consumer may have skipped the record while producer was interrupted, then message is lost and already counted
+    uint64_t expected = pos;
+    if(__atomic_compare_exchange_n(&r->seq, &expected, pos + 1, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        wake(log);
+    }
+}
+
+// state of drain passed to renderer of deferred messages
+typedef struct drain_ctx {
+    pst_logger*     log;
+    uint32_t*       len;    // number of bytes in batch
+} drain_ctx;
+
+// decorate rendered deferred message as the ring one and add it to batch
+static void append_deferred(void* arg, int severity, const struct timespec* time, const char* text, uint32_t len)
+{
+    drain_ctx* ctx = (drain_ctx*)arg;
+    append_line(ctx->log, ctx->len, (SC_LogSeverity)severity, time, text, len);
+}
+
+// decide whether to skip record at the tail, which is claimed by producer, but isn't published yet. sets 'stalled' while it's waited for
+static bool skip_unpublished(pst_logger* log, pst_log_record* r, bool* stalled)
+{
+    if(__atomic_load_n(&log->mHead, __ATOMIC_RELAXED) == log->mTail) {
+        // record isn't claimed at all
+        return false;
+    }
+
+    uint64_t now = now_ms();
+    if(log->mStallPos != log->mTail) {
+        log->mStallPos = log->mTail;
+        log->mStallSince = now;
+    }
+    if(now - log->mStallSince < LOG_PUBLISH_TIMEOUT) {
+        *stalled = true;
+        return false;
+    }
+
+    // producer which publishes it right now wins, then the record is written as usual
+    uint64_t expected = log->mTail;
+    if(!__atomic_compare_exchange_n(&r->seq, &expected, log->mTail + log->mRingSize, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return true;
+    }
+
+    __atomic_add_fetch(&log->mSkipped, 1, __ATOMIC_RELAXED);
+    log->mTail++;
+
+    return true;
+}
+
+// write all filled records of ring and deferred messages in batches. returns false if there was nothing to write.
+// 'stalled' is set if the consumer waits for unpublished record
+static bool drain(pst_logger* log, bool* stalled)
+{
+    uint32_t len = 0;
+    bool written = false;
+    *stalled = false;
+    for(;;) {
+        pst_log_record* r = &log->mRing[log->mTail & (log->mRingSize - 1)];
+        if(__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != log->mTail + 1) {
+            if(skip_unpublished(log, r, stalled)) {
+                continue;
+            }
+            break;
+        }
+
+        if(!log->is_opened(log)) {
+            log->open(log);
+        }
+        append_line(log, &len, (SC_LogSeverity)r->severity, &r->time, r->text, r->len);
+        __atomic_store_n(&r->seq, log->mTail + log->mRingSize, __ATOMIC_RELEASE);
+        log->mTail++;
+        written = true;
+    }
+
+    pst_binlog* binlog = __atomic_load_n(&log->mBinlog, __ATOMIC_ACQUIRE);
+    if(binlog) {
+        if(!log->is_opened(log)) {
+            log->open(log);
+        }
+        drain_ctx ctx = { log, &len };
+        written = pst_binlog_drain(binlog, append_deferred, &ctx) || written;
+    }
+
+    uint64_t dropped = __atomic_load_n(&log->mDropped, __ATOMIC_RELAXED);
+    if(dropped != log->mReported) {
+        char msg[128];
+        int size = snprintf(msg, sizeof(msg), "%lu log messages dropped since log ring is full\n", dropped - log->mReported);
+        log->mReported = dropped;
+        append(log, &len, msg, size);
+    }
+
+    dropped = __atomic_load_n(&log->mSkipped, __ATOMIC_RELAXED);
+    if(dropped != log->mSkipReported) {
+        char msg[128];
+        int size = snprintf(msg, sizeof(msg), "%lu log messages dropped since their producers didn't finish them in time\n",
+                            dropped - log->mSkipReported);
+        log->mSkipReported = dropped;
+        append(log, &len, msg, size);
+    }
+
+    dropped = __atomic_load_n(&log->mDeferredDropped, __ATOMIC_RELAXED);
+    if(dropped != log->mDeferredReported) {
+        char msg[128];
+        int size = snprintf(msg, sizeof(msg), "%lu deferred log messages dropped since buffer of thread is full or busy\n",
+                            dropped - log->mDeferredReported);
+        log->mDeferredReported = dropped;
+        append(log, &len, msg, size);
+    }
+
+    if(len) {
+        log->send_message(log, log->mBatch, len);
+    }
+
+    return written;
+}
+
+static void* consume(void* arg)
+{
+    pst_logger* log = (pst_logger*)arg;
+    bool stalled;
+    while(__atomic_load_n(&log->mRunning, __ATOMIC_ACQUIRE)) {
+        if(drain(log, &stalled)) {
+            continue;
+        }
+
+        // announce waiting and drain once again, so message published before producer saw the consumer idle isn't missed.
+        // unpublished record is waited for a bounded time, since its producer may never publish it
+        uint32_t seq = __atomic_load_n(&log->mWake, __ATOMIC_ACQUIRE);
+        __atomic_store_n(&log->mIdle, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if(!drain(log, &stalled) && __atomic_load_n(&log->mRunning, __ATOMIC_ACQUIRE)) {
+            struct timespec ts = { 0, 10 * 1000000 };
+            syscall(SYS_futex, &log->mWake, FUTEX_WAIT_PRIVATE, seq, stalled ? &ts : NULL, NULL, 0);
+        }
+        __atomic_store_n(&log->mIdle, 0, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
 }
 
-static void log_init_base(pst_logger* plog, const char* source)
+static void log_init_base(pst_logger* plog, const char* source, uint32_t records)
 {
     // methods
     plog->log = log_base;
@@ -70,17 +308,74 @@ static void log_init_base(pst_logger* plog, const char* source)
     if(source) {
         plog->mpSource = strdup(source);
     }
-    plog->mString[0] = 0;
-    plog->mStringSize = sizeof(plog->mString);
-    plog->mStringLen = 0;
     plog->mCurrentSeverity = SEVERITY_DEBUG;
-    pthread_mutex_init(&plog->mLock, NULL);
+    plog->mColored = false;
     plog->child = 0;
+
+    // ring size is rounded up to power of two
+    uint32_t size = 1;
+    for(records = records ? records : LOG_RING_RECORDS; size < records; size <<= 1);
+    plog->mRing = (pst_log_record*)malloc(size * sizeof(pst_log_record));
+    plog->mRingSize = plog->mRing ? size : 0;
+    for(uint32_t i = 0; i < plog->mRingSize; ++i) {
+        plog->mRing[i].seq = i;
+    }
+    plog->mHead = 0;
+    plog->mTail = 0;
+    plog->mDropped = 0;
+    plog->mReported = 0;
+    plog->mSkipped = 0;
+    plog->mSkipReported = 0;
+    plog->mStallPos = UINT64_MAX;
+    plog->mStallSince = 0;
+    plog->mDeferredDropped = 0;
+    plog->mDeferredReported = 0;
+    plog->mRunning = false;
+    plog->mWake = 0;
+    plog->mIdle = 0;
+    plog->mDeferred = false;
+    plog->mBinlog = NULL;
+}
+
+// start the consumer, when backend is set up
+static void log_start(pst_logger* plog)
+{
+    if(!plog->mRing) {
+        fprintf(stderr, "Failed to allocate log ring\n");
+        return;
+    }
+
+    plog->mRunning = true;
+    if(pthread_create(&plog->mConsumer, NULL, consume, plog)) {
+        fprintf(stderr, "Failed to start log writer thread\n");
+        plog->mRunning = false;
+    }
 }
 
 void pst_log_fini(pst_logger* log)
 {
-    pthread_mutex_destroy(&log->mLock);
+    if(log->mRunning) {
+        __atomic_store_n(&log->mRunning, false, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&log->mWake, 1, __ATOMIC_SEQ_CST);
+        syscall(SYS_futex, &log->mWake, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+        pthread_join(log->mConsumer, NULL);
+    }
+
+    // write the rest of messages
+    if(log->mRing) {
+        bool stalled;
+        drain(log, &stalled);
+        if(log->mBinlog) {
+            pst_binlog_fini(log->mBinlog);
+            free(log->mBinlog);
+            log->mBinlog = NULL;
+        }
+        log->mDeferred = false;
+        free(log->mRing);
+        log->mRing = NULL;
+        log->mRingSize = 0;
+    }
+
     log->close(log);
     if(log->mpSource) {
         free(log->mpSource);
@@ -88,38 +383,66 @@ void pst_log_fini(pst_logger* log)
     }
 }
 
+// number of messages dropped since ring was full
+uint64_t pst_log_dropped(pst_logger* log)
+{
+    return __atomic_load_n(&log->mDropped, __ATOMIC_RELAXED);
+}
+
+// number of messages dropped since their producers didn't publish them in time
+uint64_t pst_log_skipped(pst_logger* log)
+{
+    return __atomic_load_n(&log->mSkipped, __ATOMIC_RELAXED);
+}
+
+// number of deferred messages dropped since buffer of thread was full or busy
+uint64_t pst_log_deferred_dropped(pst_logger* log)
+{
+    return __atomic_load_n(&log->mDeferredDropped, __ATOMIC_RELAXED);
+}
+
+// switch between formatting messages by the caller and deferred rendering by the consumer. buffers of deferred mode are kept till
+// pst_log_fini(), since producers may still write to them after switch
+bool pst_log_set_deferred(pst_logger* log, bool deferred)
+{
+    if(!log->mRunning) {
+        return false;
+    }
+
+    if(deferred && !__atomic_load_n(&log->mBinlog, __ATOMIC_ACQUIRE)) {
+        pst_binlog* b = (pst_binlog*)malloc(sizeof(pst_binlog));
+        if(!b || !pst_binlog_init(b)) {
+            fprintf(stderr, "Failed to allocate buffers of deferred log\n");
+            free(b);
+            return false;
+        }
+        __atomic_store_n(&log->mBinlog, b, __ATOMIC_RELEASE);
+    }
+
+    __atomic_store_n(&log->mDeferred, deferred, __ATOMIC_RELEASE);
+
+    return true;
+}
+
 
 //
 // Console logger implementation
 //
-#define RED     "\e[0;31m"
-#define GREEN   "\e[0;32m"
-#define YELLOW  "\e[1;33m"
-#define NC      "\e[0m" // No Color
 
 //actually sends message to the source
-static void send_msg_console(pst_logger* log, SC_LogSeverity severity)
+static void send_msg_console(pst_logger* log, const char* msg, uint32_t len)
 {
-    const char* color = NC;
-    switch(severity) {
-        case SEVERITY_DEBUG:
-            color = NC;
-            break;
-        case SEVERITY_ERROR:
-            color = RED;
-            break;
-        case SEVERITY_INFO:
-            color = GREEN;
-            break;
-        case SEVERITY_WARNING:
-            color = YELLOW;
-            break;
-        default:
-            color = NC;
+    while(len) {
+        ssize_t ret = write(STDERR_FILENO, msg, len);
+        if(ret < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
             break;
+        }
+        msg += ret;
+        len -= ret;
     }
-
-    fprintf(stderr, "%s%s%s", color, log->mString, NC);
 }
 
 static void close_console(pst_logger* log) {
@@ -134,13 +457,15 @@ static bool is_opened_console(pst_logger* log) {
     return true;
 }
 
-void pst_log_init_console(pst_logger* log)
+void pst_log_init_console(pst_logger* log, uint32_t records)
 {
-    log_init_base(log, NULL);
+    log_init_base(log, NULL, records);
     log->close = close_console;
     log->open = open_console;
     log->is_opened = is_opened_console;
     log->send_message = send_msg_console;
+    log->mColored = true;
+    log_start(log);
 }
 
 //
@@ -212,7 +537,7 @@ static bool is_file_opened(pst_logger* log)
     return (fsp->fd != 0);
 }
 
-static void send_msg_file(pst_logger* log, SC_LogSeverity severity)
+static void send_msg_file(pst_logger* log, const char* msg, uint32_t len)
 {
     file_spec* fsp = (file_spec*)log->child;
     if(!fsp) {
@@ -220,9 +545,9 @@ static void send_msg_file(pst_logger* log, SC_LogSeverity severity)
         return;
     }
     if(fsp->fd && fsp->num_bytes < fsp->max_bytes) {
-        if(fputs(log->mString, fsp->fd) >= 0) {
+        if(fwrite(msg, 1, len, fsp->fd) == len) {
             fflush(fsp->fd);
-            fsp->num_bytes += log->mStringLen;
+            fsp->num_bytes += len;
         } else {
             fclose(fsp->fd);
             fsp->fd = 0;
@@ -230,9 +555,9 @@ static void send_msg_file(pst_logger* log, SC_LogSeverity severity)
     }
 }
 
-void pst_log_init_file(pst_logger* log, const char* path, uint64_t max_bytes)
+void pst_log_init_file(pst_logger* log, const char* path, uint64_t max_bytes, uint32_t records)
 {
-    log_init_base(log, path);
+    log_init_base(log, path, records);
     file_spec* fsp = (file_spec*)malloc(sizeof(file_spec));
     fsp->fd = 0;
     fsp->max_bytes = max_bytes;
@@ -243,5 +568,5 @@ void pst_log_init_file(pst_logger* log, const char* path, uint64_t max_bytes)
     log->open = open_file;
     log->is_opened = is_file_opened;
     log->send_message = send_msg_file;
-
+    log_start(log);
 }
@@ -8,6 +8,9 @@
 #include <pthread.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <time.h>
+
+#include "binlog.h"
 
 // Log message severity
 typedef enum {
@@ -19,31 +22,75 @@ typedef enum {
     SEVERITY_MAX
 } SC_LogSeverity;
 
-#define LOG_BUFF_SIZE       (1024*1024)
+#define LOG_RECORD_SIZE     (1024)          // maximum length of formatted message without prefix, longer messages are truncated
+#define LOG_LINE_SIZE       (LOG_RECORD_SIZE + 64) // maximum length of message decorated by the consumer
+#define LOG_RING_RECORDS    (256)           // default number of records in ring, power of two
+#define LOG_BATCH_SIZE      (64 * 1024)     // maximum number of bytes written by the consumer at once
+#define LOG_PUBLISH_TIMEOUT (100)           // time in milliseconds the consumer waits for claimed record to be published before skipping it
+
+// formatted message waiting in ring for the consumer
+typedef struct __pst_log_record {
+    uint64_t                    seq;                    // sequence number of cell: position in ring when free, position + 1 when filled
+    struct timespec             time;                   // time of message, formatted by the consumer
+    uint32_t                    severity;               // severity of message
+    uint32_t                    len;                    // length of 'text'
+    char                        text[LOG_RECORD_SIZE];  // formatted message without prefix, not zero terminated
+} pst_log_record;
 
+// -----------------------------------------------------------------------------------
+// pst_logger
+// -----------------------------------------------------------------------------------
+// Producers format messages right into cells of bounded ring claimed by CAS of 'mHead', so logging neither takes locks nor waits for
+// output. Producers store only raw time of message, its prefix is formatted by the consumer, since gmtime_r() and strftime() take lock
+// of time zone. Messages which don't fit into the full ring are dropped and counted. The consumer thread collects formatted messages
+// into batches and passes them to send_message() of the backend. Record claimed, but not published in LOG_PUBLISH_TIMEOUT (i.e. its
+// producer is interrupted or killed) is skipped and counted, so it doesn't stall the ring. Idle consumer waits on futex, and only producer
+// which finds it idle wakes it. In deferred mode producers don't format messages at all, but store their arguments to per-thread binary
+// buffers, and the consumer renders them.
 typedef struct __pst_log {
     // methods
     void (*close) (struct __pst_log* log);
     bool (*open) (struct __pst_log* log);
     bool (*is_opened) (struct __pst_log* log);
     void (*log) (struct __pst_log* log, SC_LogSeverity severity, const char* fmt, ...);
-    void (*send_message) (struct __pst_log* log, SC_LogSeverity severity);
+    void (*send_message) (struct __pst_log* log, const char* msg, uint32_t len);
 
     // fields
     char*                       mpSource;               // source for store log messages (file, IP:port or something else)
 
-    char                        mString[LOG_BUFF_SIZE]; // formatted string to be printed
-    uint32_t                    mStringSize;            // size of the 'mString' buffer
-    uint32_t                    mStringLen;             // length of the formatted string
+    pst_log_record*             mRing;                  // ring of formatted messages
+    uint32_t                    mRingSize;              // number of records in 'mRing', power of two
+    uint64_t                    mHead;                  // position of the next record to be claimed by producer
+    uint64_t                    mTail;                  // position of the next record to be written by the consumer
+    uint64_t                    mDropped;               // number of messages dropped since ring was full
+    uint64_t                    mReported;              // number of dropped messages already reported to the log
+    uint64_t                    mSkipped;               // number of claimed records skipped since they weren't published in time
+    uint64_t                    mSkipReported;          // number of skipped records already reported to the log
+    uint64_t                    mStallPos;              // position of unpublished record the consumer waits for, UINT64_MAX if none
+    uint64_t                    mStallSince;            // time in milliseconds when the consumer started to wait for 'mStallPos'
+    uint64_t                    mDeferredDropped;       // number of deferred messages dropped since buffer of thread was full or busy
+    uint64_t                    mDeferredReported;      // number of dropped deferred messages already reported to the log
+
+    char                        mBatch[LOG_BATCH_SIZE]; // messages collected by the consumer to be written at once
+    pthread_t                   mConsumer;              // thread writing messages
+    bool                        mRunning;               // whether consumer thread is running
+    uint32_t                    mWake;                  // futex word the idle consumer waits on, changed to wake it
+    uint32_t                    mIdle;                  // whether the consumer is about to wait on 'mWake'
+    bool                        mColored;               // whether messages are colored by severity
+    bool                        mDeferred;              // whether messages are stored raw and rendered by the consumer
+    pst_binlog*                 mBinlog;                // per-thread buffers of deferred messages, NULL till deferred mode is enabled
 
     SC_LogSeverity            	mCurrentSeverity;       // maximum severity value to be logged
-    pthread_mutex_t             mLock;
 
     void*                       child;
 } pst_logger;
 
-void pst_log_init_console(pst_logger* log);
-void pst_log_init_file(pst_logger* log, const char* path, uint64_t max_bytes);
+void pst_log_init_console(pst_logger* log, uint32_t records);
+void pst_log_init_file(pst_logger* log, const char* path, uint64_t max_bytes, uint32_t records);
 void pst_log_fini(pst_logger* log);
+uint64_t pst_log_dropped(pst_logger* log);
+uint64_t pst_log_skipped(pst_logger* log);
+uint64_t pst_log_deferred_dropped(pst_logger* log);
+bool pst_log_set_deferred(pst_logger* log, bool deferred);
 
 #endif /* __PST_LOG_H_ */
@@ -0,0 +1,72 @@
+/*
+ * safe_read.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "context.h"
+#include "maps.h"
+#include "safe_read.h"
+
+// the way memory is read
+typedef enum {
+    READ_UNKNOWN    = 0,    // process_vm_readv() wasn't tried yet
+    READ_VM         = 1,    // process_vm_readv() of own process
+    READ_MAPS       = 2,    // memcpy() of ranges checked against index of mappings, when process_vm_readv() isn't permitted
+} pst_read_method;
+
+static uint32_t method = READ_UNKNOWN;
+
+// returns false if process_vm_readv() itself isn't available, sets 'ok' to whether the whole range was read
+static bool read_vm(void* dst, uintptr_t addr, uint32_t size, bool* ok)
+{
+    struct iovec local = { dst, size };
+    struct iovec remote = { (void*)addr, size };
+
+    ssize_t done;
+    while((done = process_vm_readv(getpid(), &local, 1, &remote, 1, 0)) < 0 && errno == EINTR);
+    if(done < 0 && (errno == ENOSYS || errno == EPERM)) {
+        return false;
+    }
+
+    // process_vm_readv() stops at the first unreadable byte
+    *ok = done == (ssize_t)size;
+
+    return true;
+}
+
+// read 'size' bytes at 'addr' to 'dst'. returns false if memory isn't readable, contents of 'dst' is undefined then.
+// used by signal handlers, so errno of the interrupted code is preserved
+bool pst_safe_read(void* dst, uintptr_t addr, uint32_t size)
+{
+    int err = errno;
+    bool ok = false;
+
+    uint32_t m = __atomic_load_n(&method, __ATOMIC_RELAXED);
+    if(m != READ_MAPS) {
+        if(read_vm(dst, addr, size, &ok)) {
+            if(m == READ_UNKNOWN) {
+                __atomic_store_n(&method, READ_VM, __ATOMIC_RELAXED);
+            }
+            errno = err;
+            return ok;
+        }
+
+        pst_log(SEVERITY_WARNING, "Reading of own memory by process_vm_readv() isn't permitted, fall back to index of mappings");
+        __atomic_store_n(&method, READ_MAPS, __ATOMIC_RELAXED);
+    }
+
+    ok = !pst_maps_check(addr, size);
+    if(ok) {
+        memcpy(dst, (void*)addr, size);
+    }
+    errno = err;
+
+    return ok;
+}
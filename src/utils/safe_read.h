@@ -0,0 +1,18 @@
+/*
+ * safe_read.h
+ *
+ * Reads of process memory which fail instead of crashing on invalid addresses
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_SAFE_READ_H__
+#define __PST_SAFE_READ_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+bool pst_safe_read(void* dst, uintptr_t addr, uint32_t size);
+
+#endif /* __PST_SAFE_READ_H__ */
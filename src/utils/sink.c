@@ -0,0 +1,456 @@
+/*
+ * sink.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "context.h"
+#include "sink.h"
+
+static void sink_init_base(pst_sink* s)
+{
+    s->iov_count = 0;
+    s->staged = 0;
+    s->failed = false;
+
+    s->fd = -1;
+    s->callback = NULL;
+    s->arg = NULL;
+    s->first = NULL;
+    s->last = NULL;
+    s->ring = NULL;
+    s->ring_size = 0;
+    s->total = 0;
+    s->allocated = false;
+}
+
+static void close_none(pst_sink* s)
+{
+    // do nothing
+}
+
+void pst_sink_fini(pst_sink* s)
+{
+    pst_sink_flush(s);
+    s->close(s);
+}
+
+//
+// File descriptor sink
+//
+static bool write_fd(pst_sink* s, const struct iovec* iov, int count)
+{
+    struct iovec pieces[PST_SINK_IOV];
+    memcpy(pieces, iov, count * sizeof(struct iovec));
+
+    struct iovec* p = pieces;
+    while(count) {
+        ssize_t ret = writev(s->fd, p, count);
+        if(ret < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        // skip written pieces and written part of partially written one
+        while(count && (size_t)ret >= p->iov_len) {
+            ret -= p->iov_len;
+            p++; count--;
+        }
+        if(count) {
+            p->iov_base = (char*)p->iov_base + ret;
+            p->iov_len -= ret;
+        }
+    }
+
+    return true;
+}
+
+void pst_sink_init_fd(pst_sink* s, int fd)
+{
+    sink_init_base(s);
+    s->write = write_fd;
+    s->close = close_none;
+    s->fd = fd;
+}
+
+//
+// Callback sink
+//
+static bool write_callback(pst_sink* s, const struct iovec* iov, int count)
+{
+    for(int i = 0; i < count; ++i) {
+        if(s->callback(s->arg, (const char*)iov[i].iov_base, iov[i].iov_len)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void pst_sink_init_callback(pst_sink* s, pst_sink_callback cb, void* arg)
+{
+    sink_init_base(s);
+    s->write = write_callback;
+    s->close = close_none;
+    s->callback = cb;
+    s->arg = arg;
+}
+
+//
+// Growable buffer sink
+//
+static bool write_buffer(pst_sink* s, const struct iovec* iov, int count)
+{
+    for(int i = 0; i < count; ++i) {
+        const char* data = (const char*)iov[i].iov_base;
+        uint32_t size = iov[i].iov_len;
+        while(size) {
+            if(!s->last || s->last->used == PST_SINK_CHUNK) {
+                pst_sink_chunk* chunk = (pst_sink_chunk*)malloc(sizeof(pst_sink_chunk));
+                if(!chunk) {
+                    return false;
+                }
+                chunk->next = NULL;
+                chunk->used = 0;
+
+                if(s->last) {
+                    s->last->next = chunk;
+                } else {
+                    s->first = chunk;
+                }
+                s->last = chunk;
+            }
+
+            uint32_t len = PST_SINK_CHUNK - s->last->used;
+            len = (len < size) ? len : size;
+            memcpy(s->last->data + s->last->used, data, len);
+            s->last->used += len;
+            s->total += len;
+            data += len;
+            size -= len;
+        }
+    }
+
+    return true;
+}
+
+static void close_buffer(pst_sink* s)
+{
+    while(s->first) {
+        pst_sink_chunk* next = s->first->next;
+        free(s->first);
+        s->first = next;
+    }
+    s->last = NULL;
+    s->total = 0;
+}
+
+void pst_sink_init_buffer(pst_sink* s)
+{
+    sink_init_base(s);
+    s->write = write_buffer;
+    s->close = close_buffer;
+}
+
+//
+// Ring buffer sink. keeps the last 'ring_size' bytes of output
+//
+static bool write_ring(pst_sink* s, const struct iovec* iov, int count)
+{
+    for(int i = 0; i < count; ++i) {
+        const char* data = (const char*)iov[i].iov_base;
+        uint32_t size = iov[i].iov_len;
+
+        // only tail of the piece longer than the ring survives
+        if(size > s->ring_size) {
+            s->total += size - s->ring_size;
+            data += size - s->ring_size;
+            size = s->ring_size;
+        }
+
+        while(size) {
+            uint32_t pos = s->total % s->ring_size;
+            uint32_t len = s->ring_size - pos;
+            len = (len < size) ? len : size;
+            memcpy(s->ring + pos, data, len);
+            s->total += len;
+            data += len;
+            size -= len;
+        }
+    }
+
+    return true;
+}
+
+static void close_ring(pst_sink* s)
+{
+    if(s->ring) {
+        free(s->ring);
+        s->ring = NULL;
+    }
+    s->total = 0;
+}
+
+bool pst_sink_init_ring(pst_sink* s, uint32_t size)
+{
+    sink_init_base(s);
+    s->write = write_ring;
+    s->close = close_ring;
+
+    s->ring = (char*)malloc(size);
+    if(!s->ring) {
+        pst_log(SEVERITY_ERROR, "Failed to allocate ring buffer of %u bytes", size);
+        return false;
+    }
+    s->ring_size = size;
+
+    return true;
+}
+
+//
+// allocation. sinks don't use allocator of the library, since they may be created before pst_lib_init() and outlive pst_lib_fini()
+//
+pst_sink* pst_sink_new_fd(int fd)
+{
+    pst_sink* s = (pst_sink*)malloc(sizeof(pst_sink));
+    if(s) {
+        pst_sink_init_fd(s, fd);
+        s->allocated = true;
+    }
+
+    return s;
+}
+
+pst_sink* pst_sink_new_callback(pst_sink_callback cb, void* arg)
+{
+    pst_sink* s = (pst_sink*)malloc(sizeof(pst_sink));
+    if(s) {
+        pst_sink_init_callback(s, cb, arg);
+        s->allocated = true;
+    }
+
+    return s;
+}
+
+pst_sink* pst_sink_new_buffer()
+{
+    pst_sink* s = (pst_sink*)malloc(sizeof(pst_sink));
+    if(s) {
+        pst_sink_init_buffer(s);
+        s->allocated = true;
+    }
+
+    return s;
+}
+
+pst_sink* pst_sink_new_ring(uint32_t size)
+{
+    if(!size) {
+        return NULL;
+    }
+
+    pst_sink* s = (pst_sink*)malloc(sizeof(pst_sink));
+    if(s) {
+        if(!pst_sink_init_ring(s, size)) {
+            free(s);
+            return NULL;
+        }
+        s->allocated = true;
+    }
+
+    return s;
+}
+
+void pst_sink_del(pst_sink* s)
+{
+    if(!s) {
+        return;
+    }
+
+    pst_sink_fini(s);
+    if(s->allocated) {
+        free(s);
+    }
+}
+
+//
+// output
+//
+
+// hand pending pieces of output to destination
+bool pst_sink_flush(pst_sink* s)
+{
+    if(s->iov_count && !s->write(s, s->iov, s->iov_count)) {
+        s->failed = true;
+    }
+
+    s->iov_count = 0;
+    s->staged = 0;
+
+    return !s->failed;
+}
+
+// add piece of output to the batch, piece adjacent to the previous one is merged with it
+static bool add_piece(pst_sink* s, const char* data, uint32_t size)
+{
+    if(s->iov_count) {
+        struct iovec* last = &s->iov[s->iov_count - 1];
+        if((const char*)last->iov_base + last->iov_len == data) {
+            last->iov_len += size;
+            return true;
+        }
+    }
+
+    if(s->iov_count == PST_SINK_IOV && !pst_sink_flush(s)) {
+        return false;
+    }
+
+    s->iov[s->iov_count].iov_base = (void*)data;
+    s->iov[s->iov_count].iov_len = size;
+    s->iov_count++;
+
+    return true;
+}
+
+// make room for 'size' bytes in staging buffer and for the piece referencing them. pending pieces reference staging buffer,
+// so it's reused only after they are flushed
+static bool stage(pst_sink* s, uint32_t size)
+{
+    bool merged = false;
+    if(s->iov_count) {
+        struct iovec* last = &s->iov[s->iov_count - 1];
+        merged = ((char*)last->iov_base + last->iov_len == s->staging + s->staged);
+    }
+
+    if((s->iov_count == PST_SINK_IOV && !merged) || sizeof(s->staging) - s->staged < size) {
+        return pst_sink_flush(s);
+    }
+
+    return true;
+}
+
+bool pst_sink_vprintf(pst_sink* s, const char* fmt, va_list args)
+{
+    if(!stage(s, 0)) {
+        return false;
+    }
+
+    va_list copy;
+    va_copy(copy, args);
+    uint32_t avail = sizeof(s->staging) - s->staged;
+    int len = vsnprintf(s->staging + s->staged, avail, fmt, copy);
+    va_end(copy);
+    if(len < 0) {
+        return false;
+    }
+
+    if((uint32_t)len >= avail) {
+        // doesn't fit into the rest of staging buffer, so flush it and format once again
+        if(!pst_sink_flush(s)) {
+            return false;
+        }
+
+        avail = sizeof(s->staging);
+        len = vsnprintf(s->staging, avail, fmt, args);
+        if(len < 0) {
+            return false;
+        }
+
+        if((uint32_t)len >= avail) {
+            pst_log(SEVERITY_WARNING, "Formatted output of %d bytes truncated to size of staging buffer", len);
+            len = avail - 1;
+        }
+    }
+
+    const char* data = s->staging + s->staged;
+    s->staged += len;
+
+    return add_piece(s, data, len);
+}
+
+bool pst_sink_printf(pst_sink* s, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    bool ret = pst_sink_vprintf(s, fmt, args);
+    va_end(args);
+
+    return ret;
+}
+
+// add data to output. long data is referenced in place, so it must stay valid till the next flush
+bool pst_sink_write(pst_sink* s, const char* data, uint32_t size)
+{
+    if(size >= PST_SINK_INLINE) {
+        return add_piece(s, data, size);
+    }
+
+    if(!stage(s, size)) {
+        return false;
+    }
+
+    char* copy = s->staging + s->staged;
+    memcpy(copy, data, size);
+    s->staged += size;
+
+    return add_piece(s, copy, size);
+}
+
+// number of bytes which can be read from buffer or ring sink
+uint64_t pst_sink_size(pst_sink* s)
+{
+    if(s->ring) {
+        return s->total < s->ring_size ? s->total : s->ring_size;
+    }
+
+    return s->first ? s->total : 0;
+}
+
+// copy output kept by buffer or ring sink. offset is counted from the oldest kept byte. returns number of copied bytes
+uint32_t pst_sink_read(pst_sink* s, uint64_t offset, char* buff, uint32_t size)
+{
+    uint64_t avail = pst_sink_size(s);
+    if(offset >= avail) {
+        return 0;
+    }
+    size = (avail - offset < size) ? (uint32_t)(avail - offset) : size;
+
+    uint32_t copied = 0;
+    if(s->ring) {
+        uint64_t pos = s->total - avail + offset;
+        while(copied < size) {
+            uint32_t idx = pos % s->ring_size;
+            uint32_t len = s->ring_size - idx;
+            len = (len < size - copied) ? len : size - copied;
+            memcpy(buff + copied, s->ring + idx, len);
+            copied += len;
+            pos += len;
+        }
+
+        return copied;
+    }
+
+    for(pst_sink_chunk* c = s->first; c && copied < size; c = c->next) {
+        if(offset >= c->used) {
+            offset -= c->used;
+            continue;
+        }
+
+        uint32_t len = c->used - offset;
+        len = (len < size - copied) ? len : size - copied;
+        memcpy(buff + copied, c->data + offset, len);
+        copied += len;
+        offset = 0;
+    }
+
+    return copied;
+}
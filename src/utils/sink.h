@@ -0,0 +1,84 @@
+/*
+ * sink.h
+ *
+ * Destinations of printed stack traces
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#ifndef __PST_SINK_H__
+#define __PST_SINK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <sys/uio.h>
+
+#include "utils/allocator.h"
+
+#define PST_SINK_STAGING    (16 * 1024) // size of buffer for formatted output awaiting flush
+#define PST_SINK_IOV        (64)        // maximum number of pieces of output written by one flush
+#define PST_SINK_INLINE     (256)       // pieces of output shorter than this are copied to staging buffer instead of referenced
+#define PST_SINK_CHUNK      (64 * 1024) // size of chunk of growable buffer sink
+
+typedef int (*pst_sink_callback)(void* arg, const char* data, uint32_t size);
+
+// chunk of storage of growable buffer sink
+typedef struct pst_sink_chunk {
+    struct pst_sink_chunk*  next;       // the next chunk
+    uint32_t                used;       // number of used bytes of 'data'
+    char                    data[PST_SINK_CHUNK];
+} pst_sink_chunk;
+
+// -----------------------------------------------------------------------------------
+// pst_sink
+// -----------------------------------------------------------------------------------
+// Output is formatted right into staging buffer or referenced in place and collected into batch of pieces, which is handed to
+// destination by single write() call when staging buffer or batch is full and on pst_sink_flush(). So output of any size passes
+// to the destination without truncation and without copying into intermediate buffers. Sinks, rings and chunks of buffer sinks are
+// allocated by malloc(), so sink doesn't depend on lifetime of the library's allocator.
+typedef struct pst_sink {
+    // methods
+    bool (*write)   (struct pst_sink* s, const struct iovec* iov, int count);  // hand batch of pieces to destination
+    void (*close)   (struct pst_sink* s);
+
+    // fields
+    struct iovec            iov[PST_SINK_IOV];          // pieces of output awaiting flush
+    int                     iov_count;                  // number of used items of 'iov'
+    char                    staging[PST_SINK_STAGING];  // formatted output
+    uint32_t                staged;                     // number of used bytes of 'staging'
+    bool                    failed;                     // whether destination failed to accept output
+
+    int                     fd;         // file descriptor of fd sink
+    pst_sink_callback       callback;   // function of callback sink
+    void*                   arg;        // argument of 'callback'
+    pst_sink_chunk*         first;      // chunks of buffer sink
+    pst_sink_chunk*         last;       // the last chunk of buffer sink
+    char*                   ring;       // storage of ring sink
+    uint32_t                ring_size;  // size of 'ring'
+    uint64_t                total;      // number of bytes written to buffer or ring sink
+    bool                    allocated;  // whether this object was allocated or not
+} pst_sink;
+
+void pst_sink_init_fd(pst_sink* s, int fd);
+void pst_sink_init_callback(pst_sink* s, pst_sink_callback cb, void* arg);
+void pst_sink_init_buffer(pst_sink* s);
+bool pst_sink_init_ring(pst_sink* s, uint32_t size);
+void pst_sink_fini(pst_sink* s);
+
+pst_sink* pst_sink_new_fd(int fd);
+pst_sink* pst_sink_new_callback(pst_sink_callback cb, void* arg);
+pst_sink* pst_sink_new_buffer();
+pst_sink* pst_sink_new_ring(uint32_t size);
+void pst_sink_del(pst_sink* s);
+
+bool pst_sink_vprintf(pst_sink* s, const char* fmt, va_list args);
+bool pst_sink_printf(pst_sink* s, const char* fmt, ...);
+bool pst_sink_write(pst_sink* s, const char* data, uint32_t size);
+bool pst_sink_flush(pst_sink* s);
+
+uint64_t pst_sink_size(pst_sink* s);
+uint32_t pst_sink_read(pst_sink* s, uint64_t offset, char* buff, uint32_t size);
+
+#endif /* __PST_SINK_H__ */
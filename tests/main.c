@@ -185,6 +185,7 @@ void ResetSignalHandler() {
 int main(int argc, char* argv[])
 {
     SetSignalHandler(SigusrHandler);
+    pst_thread_prepare();
 
     Fun1(1, DEF_2, 5);
 
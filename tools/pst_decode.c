@@ -0,0 +1,540 @@
+/*
+ * pst_decode.c
+ *
+ * Offline decoder of binary stack trace records written by pst_record_to_sink(). Resolves names, source lines and types from
+ * debug files of recorded modules and prints stack trace the same way as pst_print_pretty() does
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dwarf.h>
+#include <elfutils/libdwfl.h>
+
+#include "libpst-types.h"
+#include "record.h"
+#include "utils/demangle.h"
+
+// cursor in the record
+typedef struct pst_reader {
+    const uint8_t*  pos;        // current position
+    const uint8_t*  end;        // end of data
+    bool            ok;         // false if data is malformed or truncated
+} pst_reader;
+
+// module of the record and its counterpart reported to libdwfl
+typedef struct pst_decode_module {
+    uint64_t        start;      // start address of the module in recorded process
+    const uint8_t*  id;         // build ID
+    uint64_t        id_len;     // size of 'id'
+    char*           path;       // path of the module in recorded process
+    Dwfl_Module*    mod;        // module reported to libdwfl, NULL if it can't be opened
+    Dwarf_Addr      base;       // start address of 'mod'
+} pst_decode_module;
+
+static uint64_t get_varint(pst_reader* r)
+{
+    uint64_t value = 0;
+    uint32_t len = r->ok ? pst_varint_decode(r->pos, r->end - r->pos, &value) : 0;
+    if(!len) {
+        r->ok = false;
+        return 0;
+    }
+    r->pos += len;
+
+    return value;
+}
+
+static const uint8_t* get_bytes(pst_reader* r, uint64_t* size)
+{
+    *size = get_varint(r);
+    if(!r->ok || *size > (uint64_t)(r->end - r->pos)) {
+        r->ok = false;
+        *size = 0;
+        return NULL;
+    }
+
+    const uint8_t* data = r->pos;
+    r->pos += *size;
+
+    return data;
+}
+
+//
+// names and types from debug information
+//
+
+static Dwarf* module_dwarf(pst_decode_module* m)
+{
+    Dwarf_Addr bias;
+    return m && m->mod ? dwfl_module_getdwarf(m->mod, &bias) : NULL;
+}
+
+static bool get_die(pst_decode_module* m, uint64_t offset, Dwarf_Die* die)
+{
+    Dwarf* dwarf = module_dwarf(m);
+    return dwarf && offset && dwarf_offdie(dwarf, offset, die);
+}
+
+static const char* basename_of(const char* path)
+{
+    const char* file = path ? strrchr(path, '/') : NULL;
+    return (file && file[1]) ? file + 1 : path;
+}
+
+// file and line of the call of inlined function
+static const char* call_site(Dwarf_Die* die, int* line)
+{
+    Dwarf_Attribute attr_mem;
+    Dwarf_Word idx = 0, ln = 0;
+    if(dwarf_formudata(dwarf_attr(die, DW_AT_call_file, &attr_mem), &idx) || dwarf_formudata(dwarf_attr(die, DW_AT_call_line, &attr_mem), &ln)) {
+        return NULL;
+    }
+
+    Dwarf_Die cu;
+    Dwarf_Files* files;
+    size_t nfiles;
+    if(!dwarf_diecu(die, &cu, NULL, NULL) || dwarf_getsrcfiles(&cu, &files, &nfiles) || idx >= nfiles) {
+        return NULL;
+    }
+
+    *line = ln;
+    return basename_of(dwarf_filesrc(files, idx, NULL, NULL));
+}
+
+// type name per level of the chain the same way as parameter's type is printed by library
+static void print_type(Dwarf_Die* die)
+{
+    Dwarf_Die type = *die;
+    Dwarf_Attribute attr_mem;
+    if(!dwarf_formref_die(dwarf_attr_integrate(&type, DW_AT_type, &attr_mem), &type)) {
+        printf("void");
+        return;
+    }
+
+    // the first level gives qualifier, the first named level gives name, pointers and references follow it
+    const char* prefix = NULL;
+    const char* name = NULL;
+    char suffix[64] = "";
+    size_t len = 0;
+    bool funcptr = false;
+    for(int depth = 0; depth < 32; ++depth) {
+        int tag = dwarf_tag(&type);
+        if(!depth) {
+            switch(tag) {
+                case DW_TAG_const_type:         prefix = "const "; break;
+                case DW_TAG_volatile_type:      prefix = "volatile "; break;
+                case DW_TAG_structure_type:     prefix = "struct "; break;
+                case DW_TAG_union_type:         prefix = "union "; break;
+                case DW_TAG_enumeration_type:   prefix = "enum "; break;
+                case DW_TAG_class_type:         prefix = "class "; break;
+                default: break;
+            }
+        }
+
+        if(!name && (tag == DW_TAG_base_type || tag == DW_TAG_typedef)) {
+            name = dwarf_diename(&type);
+        } else if(!name && tag == DW_TAG_unspecified_type) {
+            name = "void";
+        }
+
+        const char* s = NULL;
+        switch(tag) {
+            case DW_TAG_pointer_type:           s = "*"; break;
+            case DW_TAG_reference_type:         s = "&"; break;
+            case DW_TAG_rvalue_reference_type:  s = "&&"; break;
+            case DW_TAG_array_type:             s = "[]"; break;
+            case DW_TAG_subroutine_type:        funcptr = true; break;
+            default: break;
+        }
+        if(s && len + strlen(s) < sizeof(suffix)) {
+            strcpy(suffix + len, s);
+            len += strlen(s);
+        }
+
+        if(!dwarf_formref_die(dwarf_attr(&type, DW_AT_type, &attr_mem), &type)) {
+            break;
+        }
+    }
+
+    if(funcptr) {
+        // library prints nothing but the name for pointer to function
+        suffix[0] = 0;
+    }
+
+    printf("%s%s%s", prefix ? prefix : "", name ? name : "", suffix);
+}
+
+static bool is_funcptr(Dwarf_Die* die, Dwarf_Die* subroutine)
+{
+    Dwarf_Attribute attr_mem;
+    Dwarf_Die type;
+    if(!dwarf_formref_die(dwarf_attr_integrate(die, DW_AT_type, &attr_mem), &type)) {
+        return false;
+    }
+
+    for(int depth = 0; depth < 32; ++depth) {
+        if(dwarf_tag(&type) == DW_TAG_subroutine_type) {
+            *subroutine = type;
+            return true;
+        }
+        if(!dwarf_formref_die(dwarf_attr(&type, DW_AT_type, &attr_mem), &type)) {
+            break;
+        }
+    }
+
+    return false;
+}
+
+static void print_param(pst_decode_module* m, uint64_t flags, uint64_t offset, uint64_t value)
+{
+    Dwarf_Die die, subroutine;
+    if(!get_die(m, offset, &die)) {
+        printf("<unknown> = ");
+    } else {
+        print_type(&die);
+        const char* name = dwarf_diename(&die);
+        if(is_funcptr(&die, &subroutine)) {
+            printf(" (*%s)(", name ? name : "");
+            Dwarf_Die child;
+            bool first = true;
+            if(dwarf_child(&subroutine, &child) == 0) {
+                do {
+                    if(dwarf_tag(&child) == DW_TAG_formal_parameter) {
+                        printf("%s", first ? "" : ", ");
+                        print_type(&child);
+                        first = false;
+                    }
+                } while(dwarf_siblingof(&child, &child) == 0);
+            }
+            printf(") = ");
+        } else {
+            printf(" %s = ", name ? name : "");
+        }
+    }
+
+    if(flags & PARAM_HAS_VALUE) {
+        printf("0x%lX", value);
+
+        // don't take care on NULL pointer since obviously it's invalid
+        if((flags & PARAM_INVALID) && value != 0) {
+            printf(" <invalid>");
+        }
+    } else {
+        printf("<undefined>");
+    }
+}
+
+//
+// record decoding
+//
+
+// registers aren't needed to print stack trace, so they are skipped
+static bool skip_registers(pst_reader* r, uint8_t flags)
+{
+    if(flags & RECORD_REGISTERS) {
+        uint64_t mask = get_varint(r);
+        for(int i = 0; i < PST_RECORD_REGS; ++i) {
+            if(mask & (1ULL << i)) {
+                get_varint(r);
+            }
+        }
+    }
+
+    return r->ok;
+}
+
+static bool decode_frame(pst_reader* r, uint8_t flags, pst_decode_module* mods, uint64_t nmods, uint32_t idx,
+                         const char** next_file, int* next_line)
+{
+    uint64_t fun_flags = get_varint(r);
+    uint64_t module = get_varint(r);
+    uint64_t offset = get_varint(r);
+    get_varint(r); // SP
+    uint64_t die_off = get_varint(r);
+    if(!skip_registers(r, flags) || module > nmods) {
+        r->ok = false;
+        return false;
+    }
+
+    pst_decode_module* m = module ? &mods[module - 1] : NULL;
+    uint64_t pc = m ? m->start + offset : offset;
+    Dwarf_Addr local_pc = (m && m->mod) ? m->base + offset : 0;
+
+    // name of the function
+    Dwarf_Die die;
+    bool has_die = get_die(m, die_off, &die);
+    const char* name = NULL;
+    char buff[1024];
+    if(!(fun_flags & IS_INLINED) && local_pc) {
+        const char* addrname = dwfl_module_addrname(m->mod, local_pc);
+        if(addrname && pst_demangle(addrname, buff, sizeof(buff), DEMANGLE_NAME_ONLY)) {
+            name = buff;
+        } else {
+            name = addrname;
+        }
+    }
+    if(!name && has_die) {
+        name = dwarf_diename(&die);
+    }
+
+    // source line of PC is executed by the innermost inlined function, and each enclosing one executes the call of the previous one
+    const char* file = *next_file;
+    int line = *next_line;
+    if(!file && local_pc) {
+        Dwfl_Line* dwline = dwfl_module_getsrc(m->mod, local_pc);
+        if(dwline) {
+            file = basename_of(dwfl_lineinfo(dwline, NULL, &line, NULL, NULL, NULL));
+        }
+    }
+    *next_file = NULL;
+    if((fun_flags & IS_INLINED) && has_die) {
+        *next_file = call_site(&die, next_line);
+    }
+
+    char at[1024];
+    if(file) {
+        snprintf(at, sizeof(at), " at %s:%d, %p", file, line, (void*)pc);
+    } else {
+        snprintf(at, sizeof(at), " at %p", (void*)pc);
+    }
+
+    uint64_t count = get_varint(r);
+    printf("[%-2u] ", idx);
+    if(!(flags & RECORD_DWARF)) {
+        printf("%s()%s\n", name ? name : "", at);
+        for(uint64_t i = 0; r->ok && i < count * 4; ++i) {
+            get_varint(r);
+        }
+        return r->ok;
+    }
+
+    bool first = true; bool start_variable = false; bool started = false;
+    for(uint64_t i = 0; r->ok && i < count; ++i) {
+        uint64_t p_flags = get_varint(r);
+        uint64_t p_die = get_varint(r);
+        get_varint(r); // size
+        uint64_t value = get_varint(r);
+        if(!r->ok) {
+            break;
+        }
+
+        if(p_flags & PARAM_RETURN) {
+            // print return value type, function name and start list of parameters
+            if(has_die) {
+                print_type(&die);
+            }
+            printf(" %s(", name ? name : "");
+            started = true;
+            continue;
+        }
+
+        if(!started) {
+            printf("%s(", name ? name : "");
+            started = true;
+        }
+
+        if(p_flags & PARAM_VARIABLE) {
+            if(!start_variable) {
+                printf(")%s\n{\n", at);
+                start_variable = true;
+            }
+            Dwarf_Die p;
+            int decl_line = 0;
+            if(get_die(m, p_die, &p) && !dwarf_decl_line(&p, &decl_line) && decl_line) {
+                printf("%04u:   ", decl_line);
+            } else {
+                printf("        ");
+            }
+            print_param(m, p_flags, p_die, value);
+            printf(";\n");
+        } else {
+            printf("%s", first ? "" : ", ");
+            first = false;
+            print_param(m, p_flags, p_die, value);
+        }
+    }
+
+    if(!started) {
+        printf("%s(", name ? name : "");
+    }
+    printf(start_variable ? "}\n\n" : ")%s\n\n", at);
+
+    return r->ok;
+}
+
+static bool decode_record(pst_reader* r, Dwfl* dwfl)
+{
+    if(r->end - r->pos < 6 || memcmp(r->pos, PST_RECORD_MAGIC, 4)) {
+        fprintf(stderr, "Not a stack trace record\n");
+        return false;
+    }
+    if(r->pos[4] != PST_RECORD_VERSION) {
+        fprintf(stderr, "Unsupported version %u of stack trace record\n", r->pos[4]);
+        return false;
+    }
+    uint8_t flags = r->pos[5];
+    r->pos += 6;
+
+    uint64_t pid = get_varint(r);
+    uint64_t tid = get_varint(r);
+    uint64_t nmods = get_varint(r);
+    if(!r->ok || nmods > PST_RECORD_MODULES) {
+        fprintf(stderr, "Malformed stack trace record\n");
+        return false;
+    }
+
+    // modules are reported at the recorded addresses, so offsets of frames are the same as in recorded process.
+    // only 'filled' entries are valid if record is truncated, frames referring to the rest are malformed
+    pst_decode_module mods[PST_RECORD_MODULES] = { 0 };
+    uint64_t filled = 0;
+    dwfl_report_begin(dwfl);
+    for(uint64_t i = 0; r->ok && i < nmods; ++i) {
+        pst_decode_module* m = &mods[i];
+        uint64_t len;
+        m->start = get_varint(r);
+        m->id = get_bytes(r, &m->id_len);
+        const uint8_t* path = get_bytes(r, &len);
+        m->path = r->ok ? strndup((const char*)path, len) : NULL;
+        m->mod = NULL;
+        m->base = 0;
+        if(!m->path) {
+            if(r->ok) {
+                fprintf(stderr, "Failed to allocate path of module\n");
+            }
+            r->ok = false;
+            break;
+        }
+        filled++;
+
+        m->mod = dwfl_report_elf(dwfl, m->path, m->path, -1, m->start, false);
+        if(!m->mod) {
+            fprintf(stderr, "Failed to open module %s: %s\n", m->path, dwfl_errmsg(-1));
+        }
+    }
+    dwfl_report_end(dwfl, NULL, NULL);
+
+    for(uint64_t i = 0; i < filled; ++i) {
+        pst_decode_module* m = &mods[i];
+        if(!m->mod) {
+            continue;
+        }
+        dwfl_module_info(m->mod, NULL, &m->base, NULL, NULL, NULL, NULL, NULL);
+
+        const unsigned char* id = NULL;
+        Dwarf_Addr vaddr;
+        int id_len = dwfl_module_build_id(m->mod, &id, &vaddr);
+        if(m->id_len && (id_len != (int)m->id_len || memcmp(id, m->id, id_len))) {
+            fprintf(stderr, "Build ID of %s differs from the recorded one, names and lines may be wrong\n", m->path);
+        }
+    }
+
+    uint64_t count = get_varint(r);
+    if(r->ok) {
+        printf("Stack trace of process %lu, thread %lu:\n", pid, tid);
+    }
+
+    const char* next_file = NULL;
+    int next_line = 0;
+    for(uint32_t i = 0; r->ok && i < count; ++i) {
+        decode_frame(r, flags, mods, filled, i, &next_file, &next_line);
+    }
+
+    for(uint64_t i = 0; i < filled; ++i) {
+        free(mods[i].path);
+    }
+
+    if(!r->ok) {
+        fprintf(stderr, "Malformed stack trace record\n");
+    }
+
+    return r->ok;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [-d debuginfo_path] record_file\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+    char* debuginfo_path = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "d:h")) != -1) {
+        switch(opt) {
+            case 'd':
+                debuginfo_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if(optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE* f = fopen(argv[optind], "rb");
+    if(!f) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    // file may contain several records one after another
+    uint8_t* data = NULL;
+    size_t size = 0, cap = 0;
+    for(;;) {
+        if(size == cap) {
+            cap = cap ? cap * 2 : 65536;
+            uint8_t* p = (uint8_t*)realloc(data, cap);
+            if(!p) {
+                fprintf(stderr, "Out of memory\n");
+                free(data);
+                fclose(f);
+                return 1;
+            }
+            data = p;
+        }
+
+        size_t ret = fread(data + size, 1, cap - size, f);
+        if(!ret) {
+            break;
+        }
+        size += ret;
+    }
+    fclose(f);
+
+    Dwfl_Callbacks callbacks = {
+        .find_elf           = dwfl_build_id_find_elf,
+        .find_debuginfo     = dwfl_standard_find_debuginfo,
+        .section_address    = dwfl_offline_section_address,
+        .debuginfo_path     = debuginfo_path ? &debuginfo_path : NULL,
+    };
+
+    int ret = 0;
+    pst_reader r = { data, data + size, true };
+    while(r.pos < r.end) {
+        Dwfl* dwfl = dwfl_begin(&callbacks);
+        if(!dwfl) {
+            fprintf(stderr, "Failed to start libdwfl session: %s\n", dwfl_errmsg(-1));
+            ret = 1;
+            break;
+        }
+
+        bool ok = decode_record(&r, dwfl);
+        dwfl_end(dwfl);
+        if(!ok) {
+            ret = 1;
+            break;
+        }
+    }
+
+    free(data);
+    return ret;
+}
@@ -0,0 +1,224 @@
+/*
+ * pst_demangle_check.c
+ *
+ * Checks pst_demangle() against cplus_demangle() of libiberty on corpus of mangled names and compares their speed. Corpus has
+ * a mangled name per line. Line may have the expected result after tab, which is used instead of libiberty's one where libiberty
+ * is known to be wrong. Empty lines and lines starting with '#' are skipped
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: nnosov
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <libiberty/demangle.h>
+
+#include "utils/demangle.h"
+
+#define CHECK_NAME_MAX  (8192)  // size of buffer of demangled name
+#define CHECK_ROUNDS    (20)    // default number of passes over corpus to measure speed
+
+// name of corpus with its expected demangling
+typedef struct pst_check_name {
+    char*   mangled;    // mangled name
+    char*   expected;   // expected result or NULL if it's the one of libiberty
+} pst_check_name;
+
+typedef struct pst_check_corpus {
+    pst_check_name* names;
+    uint32_t        count;
+    uint32_t        cap;
+} pst_check_corpus;
+
+static bool add_name(pst_check_corpus* c, const char* line)
+{
+    if(c->count == c->cap) {
+        uint32_t cap = c->cap ? c->cap * 2 : 1024;
+        pst_check_name* names = (pst_check_name*)realloc(c->names, cap * sizeof(pst_check_name));
+        if(!names) {
+            return false;
+        }
+        c->names = names;
+        c->cap = cap;
+    }
+
+    pst_check_name* n = &c->names[c->count];
+    n->mangled = strdup(line);
+    if(!n->mangled) {
+        return false;
+    }
+
+    char* tab = strchr(n->mangled, '\t');
+    n->expected = NULL;
+    if(tab) {
+        *tab = 0;
+        n->expected = tab + 1;
+    }
+    c->count++;
+
+    return true;
+}
+
+static bool read_corpus(pst_check_corpus* c, const char* path)
+{
+    FILE* f = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    if(!f) {
+        perror(path);
+        return false;
+    }
+
+    bool ret = true;
+    char line[CHECK_NAME_MAX];
+    while(ret && fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = 0;
+        if(line[0] && line[0] != '#') {
+            ret = add_name(c, line);
+        }
+    }
+
+    if(f != stdin) {
+        fclose(f);
+    }
+
+    return ret;
+}
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// compare result of pst_demangle() with expected one for each name. returns number of mismatches
+static uint32_t check(pst_check_corpus* c, bool verbose)
+{
+    uint32_t match = 0, mismatch = 0, unsupported = 0, extra = 0;
+    char buff[CHECK_NAME_MAX];
+    for(uint32_t i = 0; i < c->count; ++i) {
+        pst_check_name* n = &c->names[i];
+        char* ref = n->expected ? NULL : cplus_demangle(n->mangled, DMGL_PARAMS | DMGL_ANSI);
+        const char* expected = n->expected ? n->expected : ref;
+        bool ok = pst_demangle(n->mangled, buff, sizeof(buff), DEMANGLE_FULL);
+
+        if(ok && expected) {
+            if(!strcmp(buff, expected)) {
+                match++;
+            } else {
+                mismatch++;
+                printf("MISMATCH %s\n    pst: %s\n    ref: %s\n", n->mangled, buff, expected);
+            }
+        } else if(expected) {
+            // caller falls back to libiberty outside of signal handler
+            unsupported++;
+            if(verbose) {
+                printf("UNSUPPORTED %s\n", n->mangled);
+            }
+        } else if(ok) {
+            extra++;
+            if(verbose) {
+                printf("ONLY PST %s\n    pst: %s\n", n->mangled, buff);
+            }
+        }
+
+        free(ref);
+    }
+
+    printf("%u names: %u match, %u mismatch, %u not supported by pst_demangle(), %u demangled by pst_demangle() only\n",
+           c->count, match, mismatch, unsupported, extra);
+
+    return mismatch;
+}
+
+// measure average time per name of both demanglers
+static void bench(pst_check_corpus* c, uint32_t rounds)
+{
+    char buff[CHECK_NAME_MAX];
+    uint64_t total = (uint64_t)c->count * rounds;
+    if(!total) {
+        return;
+    }
+
+    uint64_t start = now_ns();
+    for(uint32_t r = 0; r < rounds; ++r) {
+        for(uint32_t i = 0; i < c->count; ++i) {
+            pst_demangle(c->names[i].mangled, buff, sizeof(buff), DEMANGLE_FULL);
+        }
+    }
+    uint64_t full = now_ns() - start;
+
+    start = now_ns();
+    for(uint32_t r = 0; r < rounds; ++r) {
+        for(uint32_t i = 0; i < c->count; ++i) {
+            pst_demangle(c->names[i].mangled, buff, sizeof(buff), DEMANGLE_NAME_ONLY);
+        }
+    }
+    uint64_t name_only = now_ns() - start;
+
+    start = now_ns();
+    for(uint32_t r = 0; r < rounds; ++r) {
+        for(uint32_t i = 0; i < c->count; ++i) {
+            free(cplus_demangle(c->names[i].mangled, DMGL_PARAMS | DMGL_ANSI));
+        }
+    }
+    uint64_t ref = now_ns() - start;
+
+    printf("pst_demangle() full:      %8.1f ns per name\n", (double)full / total);
+    printf("pst_demangle() name only: %8.1f ns per name\n", (double)name_only / total);
+    printf("cplus_demangle():         %8.1f ns per name\n", (double)ref / total);
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [-r rounds] [-v] corpus_file...\n", name);
+    fprintf(stderr, "    -r  number of passes over corpus to measure speed, 0 to skip measurement (default %u)\n", CHECK_ROUNDS);
+    fprintf(stderr, "    -v  list names which only one of demanglers supports\n");
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t rounds = CHECK_ROUNDS;
+    bool verbose = false;
+    int opt;
+    while((opt = getopt(argc, argv, "r:vh")) != -1) {
+        switch(opt) {
+            case 'r':
+                rounds = strtoul(optarg, NULL, 10);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if(optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    pst_check_corpus corpus = { NULL, 0, 0 };
+    for(int i = optind; i < argc; ++i) {
+        if(!read_corpus(&corpus, argv[i])) {
+            return 1;
+        }
+    }
+
+    uint32_t mismatch = check(&corpus, verbose);
+    if(rounds) {
+        bench(&corpus, rounds);
+    }
+
+    for(uint32_t i = 0; i < corpus.count; ++i) {
+        free(corpus.names[i].mangled);
+    }
+    free(corpus.names);
+
+    return mismatch ? 1 : 0;
+}
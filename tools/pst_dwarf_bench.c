@@ -0,0 +1,207 @@
+/*
+ * pst_dwarf_bench.c
+ *
+ * Measures cost per operation of DWARF expression evaluator: lookup of operation handler, compilation of expression, evaluation of
+ * compiled program and evaluation of expression compiled each time into arena on the stack, as it's done by handler without session
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nnosov
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <dwarf.h>
+
+#include "libpst.h"
+#include "context.h"
+#include "dwarf/dwarf_stack.h"
+#include "dwarf/dwarf_program.h"
+#include "dwarf/dwarf_operations.h"
+
+#define BENCH_ROUNDS    (1000000)   // default number of evaluations of each expression
+#define BENCH_OPS       (32)        // maximum number of operations in expression
+#define BENCH_OP_SIZE   (4)         // distance between offsets of operations, only branches depend on it
+
+// benchmarked expression
+typedef struct pst_bench_expr {
+    const char* name;               // what the expression exercises
+    Dwarf_Op    ops[BENCH_OPS];     // operations, offsets are assigned by the benchmark
+    uint32_t    count;              // number of items in 'ops'
+    uint32_t    executed;           // number of operations executed by one evaluation, differs from 'count' for loops
+} pst_bench_expr;
+
+static uint64_t memory_value = 0x1122334455667788ULL;   // read by memory access expression
+
+#define OP0(ATOM)           { .atom = ATOM }
+#define OP1(ATOM, N)        { .atom = ATOM, .number = N }
+
+static pst_bench_expr exprs[] = {
+    { "constants", {
+        OP0(DW_OP_lit5), OP0(DW_OP_lit7), OP0(DW_OP_plus), OP1(DW_OP_const1u, 3), OP0(DW_OP_mul), OP1(DW_OP_const2u, 1000), OP0(DW_OP_plus),
+        OP1(DW_OP_const4s, -20), OP0(DW_OP_plus), OP1(DW_OP_constu, 300), OP0(DW_OP_minus), OP1(DW_OP_plus_uconst, 16), OP0(DW_OP_stack_value)
+      }, 13, 13 },
+    { "stack manipulation", {
+        OP0(DW_OP_lit1), OP0(DW_OP_lit2), OP0(DW_OP_lit3), OP0(DW_OP_dup), OP0(DW_OP_over), OP0(DW_OP_swap), OP0(DW_OP_rot), OP1(DW_OP_pick, 3),
+        OP0(DW_OP_drop), OP0(DW_OP_plus), OP0(DW_OP_plus), OP0(DW_OP_plus), OP0(DW_OP_plus), OP0(DW_OP_stack_value)
+      }, 14, 14 },
+    { "arithmetic and logic", {
+        OP1(DW_OP_constu, 1000), OP0(DW_OP_lit3), OP0(DW_OP_div), OP0(DW_OP_lit7), OP0(DW_OP_mod), OP0(DW_OP_lit4), OP0(DW_OP_shl),
+        OP0(DW_OP_lit1), OP0(DW_OP_shr), OP1(DW_OP_const1u, 0xF0), OP0(DW_OP_and), OP1(DW_OP_const1u, 0x0F), OP0(DW_OP_or),
+        OP1(DW_OP_const1u, 0x55), OP0(DW_OP_xor), OP0(DW_OP_neg), OP0(DW_OP_abs), OP0(DW_OP_not), OP0(DW_OP_lit1), OP0(DW_OP_shra),
+        OP0(DW_OP_stack_value)
+      }, 21, 21 },
+    { "comparison and branch loop", {
+        OP1(DW_OP_const1u, 100), OP0(DW_OP_lit1), OP0(DW_OP_minus), OP0(DW_OP_dup), OP0(DW_OP_lit0), OP0(DW_OP_gt), OP1(DW_OP_bra, 1),
+        OP0(DW_OP_stack_value)
+      }, 8, 1 + 100 * 6 + 1 },
+    { "memory access", {
+        OP1(DW_OP_addr, (Dwarf_Word)&memory_value), OP0(DW_OP_deref), OP1(DW_OP_addr, (Dwarf_Word)&memory_value), OP1(DW_OP_deref_size, 4),
+        OP0(DW_OP_plus), OP0(DW_OP_stack_value)
+      }, 6, 6 },
+    { "pieces", {
+        OP0(DW_OP_lit1), OP0(DW_OP_stack_value), OP1(DW_OP_piece, 2), OP0(DW_OP_lit2), OP0(DW_OP_stack_value), OP1(DW_OP_piece, 2),
+        OP1(DW_OP_const2u, 0x1234), OP0(DW_OP_stack_value), OP1(DW_OP_piece, 4)
+      }, 9, 9 },
+};
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// assign byte offsets to operations and turn index of branch target kept in operand into offset relative to the end of branch
+static void assemble(pst_bench_expr* e)
+{
+    for(uint32_t i = 0; i < e->count; ++i) {
+        e->ops[i].offset = i * BENCH_OP_SIZE;
+    }
+
+    for(uint32_t i = 0; i < e->count; ++i) {
+        Dwarf_Op* op = &e->ops[i];
+        if(op->atom == DW_OP_bra || op->atom == DW_OP_skip) {
+            op->number = (Dwarf_Word)(int16_t)(op->number * BENCH_OP_SIZE - (op->offset + 3));
+        }
+    }
+}
+
+// lookup of handler of every opcode
+static void bench_dispatch(uint32_t rounds)
+{
+    uint32_t found = 0;
+    uint64_t start = now_ns();
+    for(uint32_t r = 0; r < rounds / 256 + 1; ++r) {
+        for(int op = 0; op < 256; ++op) {
+            found += find_op_map(op) != NULL;
+        }
+    }
+    uint64_t total = (uint64_t)(rounds / 256 + 1) * 256;
+
+    printf("%-28s %10.2f ns per op (%u handlers)\n", "handler lookup", (double)(now_ns() - start) / total, found / (rounds / 256 + 1));
+}
+
+// returns false if expression can't be compiled or evaluated
+static bool bench_expr(pst_bench_expr* e, pst_dwarf_stack* st, uint32_t rounds)
+{
+    pst_dwarf_program* prog = pst_dwarf_program_new(&allocator, e->ops, e->count, NULL);
+    if(!prog) {
+        printf("%-28s failed to compile\n", e->name);
+        return false;
+    }
+
+    uint64_t value = 0;
+    if(!pst_dwarf_stack_run(st, prog, NULL, NULL) || !pst_dwarf_stack_get_value(st, &value)) {
+        printf("%-28s failed to evaluate\n", e->name);
+        pst_dwarf_program_del(&allocator, prog);
+        return false;
+    }
+
+    // compilation alone
+    uint32_t compile_rounds = rounds / 10 + 1;
+    uint64_t start = now_ns();
+    for(uint32_t r = 0; r < compile_rounds; ++r) {
+        pst_dwarf_program_del(&allocator, pst_dwarf_program_new(&allocator, e->ops, e->count, NULL));
+    }
+    double compile = (double)(now_ns() - start) / ((uint64_t)compile_rounds * e->count);
+
+    // evaluation of compiled program, as for cached attributes
+    bool ret = true;
+    start = now_ns();
+    for(uint32_t r = 0; r < rounds && ret; ++r) {
+        ret = pst_dwarf_stack_run(st, prog, NULL, NULL);
+    }
+    double run = (double)(now_ns() - start) / ((uint64_t)rounds * e->executed);
+
+    // compilation and evaluation each time
+    start = now_ns();
+    for(uint32_t r = 0; r < compile_rounds && ret; ++r) {
+        ret = pst_dwarf_stack_calc(st, e->ops, e->count, NULL, NULL);
+    }
+    double calc = (double)(now_ns() - start) / ((uint64_t)compile_rounds * e->executed);
+
+    pst_dwarf_program_del(&allocator, prog);
+
+    printf("%-28s %10.2f %10.2f %10.2f %6u %#18lx\n", e->name, compile, run, calc, e->executed, value);
+
+    return ret;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [-r rounds]\n", name);
+    fprintf(stderr, "    -r  number of evaluations of each expression (default %u)\n", BENCH_ROUNDS);
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t rounds = BENCH_ROUNDS;
+    int opt;
+    while((opt = getopt(argc, argv, "r:h")) != -1) {
+        switch(opt) {
+            case 'r':
+                rounds = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if(!rounds) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    pst_handler* h = pst_lib_init(NULL, NULL, 0);
+    if(!h) {
+        fprintf(stderr, "Failed to initialize library\n");
+        return 1;
+    }
+
+    pst_context ctx;
+    pst_context_init(&ctx, NULL);
+    pst_dwarf_stack st;
+    pst_dwarf_stack_init(&st, &ctx);
+
+    bench_dispatch(rounds);
+
+    printf("\n%-28s %10s %10s %10s %6s %18s\n", "expression", "compile", "run", "calc", "ops", "value");
+    printf("%-28s %10s %10s %10s\n", "", "ns per op", "ns per op", "ns per op");
+
+    bool ret = true;
+    for(uint32_t i = 0; i < sizeof(exprs) / sizeof(exprs[0]); ++i) {
+        assemble(&exprs[i]);
+        ret = bench_expr(&exprs[i], &st, rounds) && ret;
+    }
+
+    pst_dwarf_stack_fini(&st);
+    pst_context_fini(&ctx);
+    pst_lib_fini(h);
+
+    return ret ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+/*
+ * pst_sink_check.c
+ *
+ * Checks that output passed to sink in mix of formatted, copied and referenced pieces reaches destination unchanged and in order,
+ * including the case when batch of pieces is full before staging buffer, and that sink outlives the library which wrote to it
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nnosov
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libpst.h"
+#include "utils/sink.h"
+
+#define CHECK_LINES     (1000)                          // number of iterations of output
+#define CHECK_BLOCK     (PST_SINK_INLINE + 44)          // size of referenced block, long enough to be not copied to staging
+#define CHECK_EXPECTED  (CHECK_LINES * (CHECK_BLOCK + 64)) // size of expected output
+
+static char blocks[CHECK_LINES][CHECK_BLOCK];  // referenced data must stay valid till flush
+static char expected[CHECK_EXPECTED];
+static char actual[CHECK_EXPECTED];
+
+// append to expected output
+static uint32_t add(uint32_t pos, const char* data, uint32_t size)
+{
+    memcpy(expected + pos, data, size);
+    return pos + size;
+}
+
+int main(int argc, char* argv[])
+{
+    // sink is created before and deleted after the library, since it doesn't use allocator of the library
+    pst_sink* s = pst_sink_new_buffer();
+    if(!s) {
+        fprintf(stderr, "Failed to create sink\n");
+        return 1;
+    }
+
+    pst_handler* h = pst_lib_init(NULL, NULL, 0);
+    if(!h) {
+        fprintf(stderr, "Failed to initialize library\n");
+        pst_sink_del(s);
+        return 1;
+    }
+
+    // each iteration adds formatted piece, referenced block and copied piece, so batch is full long before staging buffer
+    uint32_t pos = 0;
+    bool ret = true;
+    char line[64];
+    for(int i = 0; i < CHECK_LINES && ret; ++i) {
+        int len = snprintf(line, sizeof(line), "line %d\n", i);
+        pos = add(pos, line, len);
+        ret = pst_sink_printf(s, "line %d\n", i);
+
+        memset(blocks[i], 'a' + i % 26, CHECK_BLOCK - 1);
+        blocks[i][CHECK_BLOCK - 1] = '\n';
+        pos = add(pos, blocks[i], CHECK_BLOCK);
+        ret = ret && pst_sink_write(s, blocks[i], CHECK_BLOCK);
+
+        len = snprintf(line, sizeof(line), "end %d\n", i);
+        pos = add(pos, line, len);
+        ret = ret && pst_sink_write(s, line, len);
+    }
+    ret = ret && pst_sink_flush(s);
+    pst_lib_fini(h);
+
+    uint64_t size = pst_sink_size(s);
+    uint32_t copied = pst_sink_read(s, 0, actual, sizeof(actual));
+    pst_sink_del(s);
+
+    if(!ret) {
+        fprintf(stderr, "Sink failed to accept output\n");
+        return 1;
+    }
+
+    if(size != pos || copied != pos) {
+        fprintf(stderr, "Size of output %lu bytes, expected %u bytes\n", size, pos);
+        return 1;
+    }
+
+    for(uint32_t i = 0; i < pos; ++i) {
+        if(actual[i] != expected[i]) {
+            fprintf(stderr, "Output differs at offset %u: '%.40s', expected '%.40s'\n", i, actual + i, expected + i);
+            return 1;
+        }
+    }
+
+    printf("%u bytes of output match\n", pos);
+
+    return 0;
+}